@@ -0,0 +1,1998 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "btree.h"
+#include "coro.h"
+#include "shared_buffer.h"
+#include "wal.h"
+#include "page.h"
+#include "filescan.h"
+#include "page_iterator.h"
+#include "file_iterator.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+// Benchmarks for the buffer manager and the B+ tree. Build with
+//   $ make bench
+// and run one benchmark at a time:
+//   $ ./src/badgerdb_bench <name> [options]
+// Pass optimization flags through CFLAGS for meaningful numbers, e.g.
+//   $ make clean; make CFLAGS="-std=c++0x -O2 -pthread" bench
+// This file is compiled as C++20 for the coroutines of coro.h.
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const std::string relationName = "benchRel";
+
+// Same tuple layout as the tests in main.cpp
+typedef struct tuple {
+  int i;
+  double d;
+  char s[64];
+} RECORD;
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+double elapsedMicros(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+double percentile(std::vector<double> samples, double pct) {
+  if (samples.empty()) {
+    return 0;
+  }
+  std::sort(samples.begin(), samples.end());
+  std::size_t idx = (std::size_t)(pct / 100.0 * (samples.size() - 1));
+  return samples[idx];
+}
+
+void removeIfExists(const std::string& name) {
+  try {
+    File::remove(name);
+  } catch (FileNotFoundException e) {
+  }
+}
+
+// Create the relation with keys 0..numRecords-1 in random order, returning
+// the writes made.
+FileIoStats createRelation(int numRecords, PageCodec codec = CODEC_NONE) {
+  removeIfExists(relationName);
+  PageFile file(relationName, true, codec);
+
+  std::vector<int> keys(numRecords);
+  for (int i = 0; i < numRecords; i++) {
+    keys[i] = i;
+  }
+  std::random_shuffle(keys.begin(), keys.end());
+
+  RECORD record;
+  memset(record.s, ' ', sizeof(record.s));
+  PageId pageNo;
+  Page page = file.allocatePage(pageNo);
+  for (int i = 0; i < numRecords; i++) {
+    sprintf(record.s, "%05d string record", keys[i]);
+    record.i = keys[i];
+    record.d = keys[i];
+    std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+    while (1) {
+      try {
+        page.insertRecord(data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        file.writePage(pageNo, page);
+        page = file.allocatePage(pageNo);
+      }
+    }
+  }
+  file.writePage(pageNo, page);
+  return file.ioStats();
+}
+
+std::vector<PageId> relationPages(PageFile& file) {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  return pageNos;
+}
+
+// Point lookup of one key; returns the number of matching rids.
+int lookup(BTreeIndex& index, int key) {
+  int found = 0;
+  try {
+    index.startScan(&key, GTE, &key, LTE);
+  } catch (NoSuchKeyFoundException e) {
+    return 0;
+  }
+  try {
+    RecordId rid;
+    while (1) {
+      index.scanNext(rid);
+      found++;
+    }
+  } catch (IndexScanCompletedException e) {
+  }
+  index.endScan();
+  return found;
+}
+
+// -----------------------------------------------------------------------------
+// classes: index lookups mixed with large heap scans, with and without
+// page class hints
+// -----------------------------------------------------------------------------
+
+void runClassPhase(bool hints, int numRecords, std::uint32_t bufs, int rounds,
+                   int lookupsPerRound, int scanPagesPerRound) {
+  BufMgr* bufMgr = new BufMgr(bufs);
+  bufMgr->setClassHints(hints);
+
+  std::string indexName;
+  std::vector<double> latencies;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    PageFile heap(relationName, false);
+    std::vector<PageId> pageNos = relationPages(heap);
+    std::size_t scanPos = 0;
+    Page* page;
+
+    srandom(7);
+    bufMgr->clearBufStats();
+    int lookupReads = 0;
+    for (int round = 0; round < rounds; round++) {
+      for (int i = 0; i < lookupsPerRound; i++) {
+        int key = random() % numRecords;
+        int reads = bufMgr->getBufStats().diskreads;
+        Clock::time_point start = Clock::now();
+        lookup(index, key);
+        latencies.push_back(elapsedMicros(start));
+        lookupReads += bufMgr->getBufStats().diskreads - reads;
+      }
+
+      // a large scan through the shared pool, not a ring
+      for (int i = 0; i < scanPagesPerRound; i++) {
+        PageId pageNo = pageNos[scanPos++ % pageNos.size()];
+        bufMgr->readPage(&heap, pageNo, page);
+        bufMgr->unPinPage(&heap, pageNo, false);
+      }
+    }
+
+    std::cout << std::setw(8) << (hints ? "on" : "off") << std::setw(12)
+              << percentile(latencies, 50) << std::setw(12)
+              << percentile(latencies, 99) << std::setw(14) << lookupReads
+              << std::setw(12) << bufMgr->getBufStats().diskreads
+              << std::endl;
+    bufMgr->flushFile(&heap);
+  }
+  delete bufMgr;
+}
+
+void benchClasses(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 200000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 1024;
+  int rounds = argc > 2 ? atoi(argv[2]) : 200;
+  int lookupsPerRound = argc > 3 ? atoi(argv[3]) : 100;
+  int scanPagesPerRound = argc > 4 ? atoi(argv[4]) : 100;
+
+  std::cout << "classes: " << numRecords << " records, " << bufs
+            << " frames, " << rounds << " rounds of " << lookupsPerRound
+            << " lookups and a " << scanPagesPerRound << " page scan"
+            << std::endl;
+  createRelation(numRecords);
+  {
+    // build the index once; each phase reopens it with a cold pool
+    BufMgr* bufMgr = new BufMgr(bufs);
+    std::string indexName;
+    BTreeIndex* index = new BTreeIndex(relationName, indexName, bufMgr,
+                                       offsetof(tuple, i), INTEGER);
+    delete index;
+    delete bufMgr;
+  }
+
+  std::cout << std::setw(8) << "hints" << std::setw(12) << "p50 us"
+            << std::setw(12) << "p99 us" << std::setw(14) << "lookup reads"
+            << std::setw(12) << "diskreads" << std::endl;
+  runClassPhase(false, numRecords, bufs, rounds, lookupsPerRound,
+                scanPagesPerRound);
+  runClassPhase(true, numRecords, bufs, rounds, lookupsPerRound,
+                scanPagesPerRound);
+
+  removeIfExists(relationName + ".0");
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// eviction: clock sweeps over a pool of a million frames, with the frame table
+// bitmaps against the array of per-frame descriptors it replaced
+// -----------------------------------------------------------------------------
+
+// Layout of a frame descriptor before the frame table was split into arrays.
+struct FrameDesc {
+  File* file;
+  PageId pageNo;
+  FrameId frameNo;
+  int pinCnt;
+  bool dirty;
+  bool valid;
+  bool refbit;
+  AccessStrategy strategy;
+  PageClass pageClass;
+  std::uint8_t credit;
+};
+
+bool descSweep(std::vector<FrameDesc>& descs, FrameId& hand,
+               std::uint32_t maxScans) {
+  std::uint32_t numBufs = descs.size();
+  for (std::uint32_t scanned = 0; scanned < maxScans; scanned++) {
+    hand = (hand + 1) % numBufs;
+    FrameDesc& desc = descs[hand];
+    if (!desc.valid) {
+      return true;
+    } else if (desc.refbit) {
+      desc.refbit = false;
+    } else if (desc.credit > 0) {
+      desc.credit--;
+    } else if (desc.pinCnt == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Shared workload: every frame holds a page, a share of them pinned and every
+// tenth an interior page with sweep credit. Each eviction loads a page into
+// the victim and references 'refs' random frames.
+void runEviction(bool bitmaps, std::uint32_t bufs, int evictions, int refs,
+                 int pinnedPct) {
+  std::vector<FrameDesc> descs(bufs);
+  BufFrameTable table;
+  table.resize(bufs);
+
+  srandom(3);
+  for (FrameId i = 0; i < bufs; i++) {
+    bool pin = (int)(random() % 100) < pinnedPct;
+    std::uint8_t credit = i % 10 == 0 ? 2 : 0;
+    FrameDesc desc = {NULL, i, i, pin, false, true, true, NORMAL, PAGE_HEAP,
+                      credit};
+    descs[i] = desc;
+    table.Set(i, NULL, i);
+    table.setPinCnt(i, pin);
+    table.setCredit(i, credit);
+  }
+
+  std::vector<FrameId> hits(refs * (std::size_t)evictions);
+  for (std::size_t i = 0; i < hits.size(); i++) {
+    hits[i] = random() % bufs;
+  }
+
+  FrameId hand = bufs - 1;
+  std::uint32_t maxScans = 4 * bufs;
+  std::uint32_t refsCleared = 0;
+  std::size_t next = 0;
+  Clock::time_point start = Clock::now();
+  double firstSweep = 0;
+  for (int i = 0; i < evictions; i++) {
+    if (bitmaps) {
+      table.sweep(hand, bufs, maxScans, -1, refsCleared);
+      BufFrameTable::assign(table.refbit, hand, true);
+      table.pageNo[hand] = bufs + i;
+      for (int r = 0; r < refs; r++) {
+        BufFrameTable::assign(table.refbit, hits[next++], true);
+      }
+    } else {
+      descSweep(descs, hand, maxScans);
+      descs[hand].refbit = true;
+      descs[hand].pageNo = bufs + i;
+      for (int r = 0; r < refs; r++) {
+        descs[hits[next++]].refbit = true;
+      }
+    }
+    // the first victim needs a sweep through the whole warm pool
+    if (i == 0) {
+      firstSweep = elapsedMicros(start);
+    }
+  }
+  double total = elapsedMicros(start);
+
+  std::cout << std::setw(10) << (bitmaps ? "bitmaps" : "structs")
+            << std::setw(16) << firstSweep << std::setw(16)
+            << (total - firstSweep) / evictions * 1000 << std::setw(16)
+            << (long)(evictions / (total / 1e6)) << std::endl;
+}
+
+void benchEviction(int argc, char** argv) {
+  std::uint32_t bufs = argc > 0 ? atoi(argv[0]) : 1 << 20;
+  int evictions = argc > 1 ? atoi(argv[1]) : 1000000;
+  int refs = argc > 2 ? atoi(argv[2]) : 4;
+  int pinnedPct = argc > 3 ? atoi(argv[3]) : 1;
+
+  std::cout << "eviction: " << bufs << " frames, " << evictions
+            << " evictions, " << refs << " references per eviction, "
+            << pinnedPct << "% pinned" << std::endl;
+  std::cout << std::setw(10) << "metadata" << std::setw(16) << "first us"
+            << std::setw(16) << "ns/eviction" << std::setw(16)
+            << "evictions/s" << std::endl;
+  runEviction(false, bufs, evictions, refs, pinnedPct);
+  runEviction(true, bufs, evictions, refs, pinnedPct);
+}
+
+// -----------------------------------------------------------------------------
+// mrc: hit ratios estimated from one sampled run against those measured by
+// running the trace at each pool size
+// -----------------------------------------------------------------------------
+
+// Replay the trace through a pool of the given size; returns the hit ratio and
+// the time per access in 'micros'.
+double replayTrace(PageFile& file, const std::vector<PageId>& trace,
+                   std::uint32_t bufs, double rate, double& micros,
+                   BufMgr** keep = NULL) {
+  BufMgr* bufMgr = new BufMgr(bufs);
+  bufMgr->setMissRatioSampling(rate);
+  Page* page;
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < trace.size(); i++) {
+    bufMgr->readPage(&file, trace[i], page);
+    bufMgr->unPinPage(&file, trace[i], false);
+  }
+  micros = elapsedMicros(start) / trace.size();
+  double hitRatio = 1 - (double)bufMgr->getBufStats().diskreads / trace.size();
+  if (keep) {
+    *keep = bufMgr;
+  } else {
+    bufMgr->flushFile(&file);
+    delete bufMgr;
+  }
+  return hitRatio;
+}
+
+void benchMissRatio(int argc, char** argv) {
+  std::uint32_t numPages = argc > 0 ? atoi(argv[0]) : 8000;
+  int accesses = argc > 1 ? atoi(argv[1]) : 400000;
+  double rate = argc > 2 ? atof(argv[2]) : 0.05;
+
+  std::cout << "mrc: " << numPages << " pages, " << accesses
+            << " accesses, sampling rate " << rate << std::endl;
+  removeIfExists(relationName);
+  {
+    PageFile file(relationName, true);
+    std::vector<PageId> pageNos(numPages);
+    for (std::uint32_t i = 0; i < numPages; i++) {
+      Page page = file.allocatePage(pageNos[i]);
+      file.writePage(pageNos[i], page);
+    }
+
+    // skewed: the square of a uniform draw favours the low pages
+    srandom(5);
+    std::vector<PageId> trace(accesses);
+    for (int i = 0; i < accesses; i++) {
+      double u = (double)random() / RAND_MAX;
+      trace[i] = pageNos[(std::uint32_t)(u * u * (numPages - 1))];
+    }
+
+    double sampledMicros, plainMicros;
+    BufMgr* sampled;
+    replayTrace(file, trace, numPages / 16, rate, sampledMicros, &sampled);
+    replayTrace(file, trace, numPages / 16, 0, plainMicros);
+    std::cout << "working set estimate " << sampled->estimateWorkingSet()
+              << " pages; " << plainMicros << " us/access unsampled, "
+              << sampledMicros << " us/access sampled" << std::endl;
+
+    // the estimator alone, without the reads it is hooked into
+    MissRatioCurve curve(rate, 8192);
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < trace.size(); i++) {
+      curve.access(&file, trace[i]);
+    }
+    std::cout << "estimator " << elapsedMicros(start) * 1000 / trace.size()
+              << " ns/access" << std::endl;
+
+    std::cout << std::setw(10) << "frames" << std::setw(12) << "measured"
+              << std::setw(12) << "estimated" << std::endl;
+    for (std::uint32_t bufs = numPages / 16; bufs <= numPages; bufs *= 2) {
+      double micros;
+      double measured = replayTrace(file, trace, bufs, 0, micros);
+      std::cout << std::setw(10) << bufs << std::setw(12) << measured
+                << std::setw(12) << sampled->estimateHitRatio(bufs) << std::endl;
+    }
+
+    sampled->flushFile(&file);
+    delete sampled;
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// qdepth: random 8 KB reads at increasing queue depths, through each
+// asynchronous I/O backend and through the buffer pool
+// -----------------------------------------------------------------------------
+
+// Build a file of the given number of pages for the read benchmarks.
+void createPageFile(std::uint32_t numPages) {
+  removeIfExists(relationName);
+  BlobFile file(relationName, true);
+  PageId pageNo;
+  for (std::uint32_t i = 0; i < numPages; i++) {
+    file.allocatePage(pageNo);
+  }
+}
+
+// Drop the file from the page cache, so that reads go to the device.
+void dropCache(File& file) {
+  // dirty pages stay cached until written back
+  fdatasync(file.descriptor());
+  posix_fadvise(file.descriptor(), 0, 0, POSIX_FADV_DONTNEED);
+}
+
+void runQueueDepth(File& file, IoBackendKind kind, std::uint32_t depth,
+                   const std::vector<PageId>& pageNos) {
+  IoBackend* io = IoBackend::create(depth, kind);
+  if (io == NULL) {
+    std::cout << std::setw(10) << "io_uring" << " unavailable" << std::endl;
+    return;
+  }
+
+  std::vector<IoRequest> requests(depth);
+  std::vector<Page> pages(depth);
+  std::vector<IoRequest*> free, done;
+  for (std::uint32_t i = 0; i < depth; i++) {
+    requests[i].op = IO_READ;
+    requests[i].fd = file.descriptor();
+    requests[i].buf = &pages[i];
+    requests[i].len = Page::SIZE;
+    free.push_back(&requests[i]);
+  }
+
+  dropCache(file);
+  Clock::time_point start = Clock::now();
+  std::size_t next = 0;
+  int errors = 0;
+  while (next < pageNos.size() || io->inFlight() > 0) {
+    while (!free.empty() && next < pageNos.size()) {
+      IoRequest* request = free.back();
+      free.pop_back();
+      request->offset = file.pageOffset(pageNos[next++]);
+      io->submit(request);
+    }
+    done.clear();
+    io->reap(done, 1);
+    for (std::size_t i = 0; i < done.size(); i++) {
+      if (done[i]->result != (std::int64_t)Page::SIZE) {
+        errors++;
+      }
+      free.push_back(done[i]);
+    }
+  }
+  double micros = elapsedMicros(start);
+
+  std::cout << std::setw(10) << io->name() << std::setw(8) << depth
+            << std::setw(12) << (long)(pageNos.size() / (micros / 1e6))
+            << std::setw(12)
+            << pageNos.size() * Page::SIZE / micros << std::setw(14)
+            << micros * depth / pageNos.size();
+  if (errors > 0) {
+    std::cout << "  (" << errors << " failed)";
+  }
+  std::cout << std::endl;
+  delete io;
+}
+
+// Pin each page of a random batch through the buffer pool, with or without
+// prefetching the batch first.
+void runPoolBatch(BlobFile& file, const std::vector<PageId>& pageNos,
+                  std::uint32_t depth, bool prefetch) {
+  BufMgr* bufMgr = new BufMgr(pageNos.size());
+  if (prefetch) {
+    bufMgr->enableAsyncIo(depth);
+  }
+  dropCache(file);
+
+  Page* page;
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < pageNos.size(); i += depth) {
+    std::size_t end = std::min(pageNos.size(), i + depth);
+    if (prefetch) {
+      std::vector<PageId> batch(pageNos.begin() + i, pageNos.begin() + end);
+      bufMgr->prefetchPages(&file, batch);
+    }
+    for (std::size_t j = i; j < end; j++) {
+      bufMgr->readPage(&file, pageNos[j], page);
+      bufMgr->unPinPage(&file, pageNos[j], false);
+    }
+  }
+  double micros = elapsedMicros(start);
+
+  std::cout << std::setw(10) << (prefetch ? "prefetch" : "readPage")
+            << std::setw(8) << (prefetch ? depth : 1) << std::setw(12)
+            << (long)(pageNos.size() / (micros / 1e6)) << std::setw(12)
+            << pageNos.size() * Page::SIZE / micros << std::endl;
+  bufMgr->flushFile(&file);
+  delete bufMgr;
+}
+
+void benchQueueDepth(int argc, char** argv) {
+  std::uint32_t numPages = argc > 0 ? atoi(argv[0]) : 16384;
+  int reads = argc > 1 ? atoi(argv[1]) : 20000;
+  std::uint32_t maxDepth = argc > 2 ? atoi(argv[2]) : 64;
+
+  std::cout << "qdepth: " << reads << " random 8 KB reads from "
+            << numPages << " pages, page cache dropped before each run"
+            << std::endl;
+  createPageFile(numPages);
+  {
+    BlobFile file(relationName, false);
+    srandom(9);
+    std::vector<PageId> pageNos(reads);
+    for (int i = 0; i < reads; i++) {
+      pageNos[i] = 1 + random() % (numPages - 1);
+    }
+
+    std::cout << std::setw(10) << "backend" << std::setw(8) << "depth"
+              << std::setw(12) << "reads/s" << std::setw(12) << "MB/s"
+              << std::setw(14) << "latency us" << std::endl;
+    IoBackendKind kinds[] = {IO_URING, IO_THREADS};
+    for (int k = 0; k < 2; k++) {
+      for (std::uint32_t depth = 1; depth <= maxDepth; depth *= 2) {
+        runQueueDepth(file, kinds[k], depth, pageNos);
+      }
+    }
+
+    // the buffer pool, pinning a distinct page per read
+    std::sort(pageNos.begin(), pageNos.end());
+    pageNos.erase(std::unique(pageNos.begin(), pageNos.end()), pageNos.end());
+    std::random_shuffle(pageNos.begin(), pageNos.end());
+    std::cout << std::setw(10) << "bufmgr" << std::setw(8) << "depth"
+              << std::setw(12) << "pins/s" << std::setw(12) << "MB/s"
+              << std::endl;
+    runPoolBatch(file, pageNos, maxDepth, false);
+    runPoolBatch(file, pageNos, maxDepth, true);
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// direct: random reads and writes through a pool smaller than the file, with
+// pages read through the page cache, with O_DIRECT, and with O_DIRECT into
+// huge page backed frames
+// -----------------------------------------------------------------------------
+
+// Number of the file's pages held in the page cache.
+long cachedFilePages(File& file) {
+  struct stat st;
+  if (fstat(file.descriptor(), &st) != 0 || st.st_size == 0) {
+    return 0;
+  }
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file.descriptor(), 0);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+  long pageSize = sysconf(_SC_PAGESIZE);
+  std::vector<unsigned char> resident((st.st_size + pageSize - 1) / pageSize);
+  long cached = 0;
+  if (mincore(map, st.st_size, &resident[0]) == 0) {
+    for (std::size_t i = 0; i < resident.size(); i++) {
+      cached += resident[i] & 1;
+    }
+  }
+  munmap(map, st.st_size);
+  return cached * pageSize / Page::SIZE;
+}
+
+// Value in kB of a field of /proc/self/status or /proc/self/smaps_rollup.
+long procKb(const char* path, const std::string& field) {
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, field.size(), field) == 0) {
+      return atol(line.c_str() + field.size() + 1);
+    }
+  }
+  return -1;
+}
+
+void runDirect(BlobFile& file, const std::vector<PageId>& pageNos,
+               std::uint32_t bufs, int options, const char* label) {
+  dropCache(file);
+  BufMgr* bufMgr = new BufMgr(bufs, options);
+
+  Page* page;
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    // every fourth page is changed, so evictions write as well as read
+    bool dirty = i % 4 == 0;
+    bufMgr->readPage(&file, pageNos[i], page);
+    if (dirty) {
+      reinterpret_cast<char*>(page)[i % Page::SIZE]++;
+    }
+    bufMgr->unPinPage(&file, pageNos[i], dirty);
+  }
+  double micros = elapsedMicros(start);
+
+  BufStats stats = bufMgr->getBufStats();
+  std::cout << std::setw(14) << label << std::setw(9)
+            << bufMgr->getPoolMemory() << std::setw(11)
+            << (long)(pageNos.size() / (micros / 1e6)) << std::setw(9)
+            << stats.diskreads << std::setw(9) << stats.diskwrites
+            << std::setw(14) << cachedFilePages(file) << std::setw(10)
+            << procKb("/proc/self/status", "VmRSS:") / 1024 << std::setw(10)
+            << procKb("/proc/self/smaps_rollup", "AnonHugePages:") / 1024
+            << std::endl;
+  bufMgr->flushFile(&file);
+  delete bufMgr;
+}
+
+void benchDirect(int argc, char** argv) {
+  std::uint32_t numPages = argc > 0 ? atoi(argv[0]) : 16384;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 4096;
+  int accesses = argc > 2 ? atoi(argv[2]) : 100000;
+
+  std::cout << "direct: " << accesses << " random pins of " << numPages
+            << " pages through " << bufs
+            << " frames, a quarter of them dirtied" << std::endl;
+  createPageFile(numPages);
+  {
+    BlobFile file(relationName, false);
+    if (file.directDescriptor() < 0) {
+      std::cout << "O_DIRECT is not supported here; direct runs fall back "
+                << "to the page cache" << std::endl;
+    }
+    srandom(13);
+    std::vector<PageId> pageNos(accesses);
+    for (int i = 0; i < accesses; i++) {
+      pageNos[i] = 1 + random() % (numPages - 1);
+    }
+
+    std::cout << std::setw(14) << "pool" << std::setw(9) << "memory"
+              << std::setw(11) << "pins/s" << std::setw(9) << "reads"
+              << std::setw(9) << "writes" << std::setw(14) << "cached pages"
+              << std::setw(10) << "RSS MB" << std::setw(10) << "huge MB"
+              << std::endl;
+    runDirect(file, pageNos, bufs, POOL_DEFAULT, "buffered");
+    runDirect(file, pageNos, bufs, POOL_DIRECT_IO, "direct");
+    runDirect(file, pageNos, bufs, POOL_DIRECT_IO | POOL_HUGE_PAGES,
+              "direct+huge");
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// ridfetch: fetch the pages of a sorted list of record ids, as an index scan
+// does, one readPage() at a time or a batch at a time with readPages()
+// -----------------------------------------------------------------------------
+
+void runRidFetch(BlobFile& file, const std::vector<PageId>& ridPages,
+                 std::uint32_t bufs, std::size_t batchSize) {
+  BufMgr* bufMgr = new BufMgr(bufs);
+  dropCache(file);
+
+  Page* page;
+  std::vector<Page*> pages;
+  long checksum = 0;
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < ridPages.size(); i += batchSize) {
+    std::size_t end = std::min(ridPages.size(), i + batchSize);
+    if (batchSize == 1) {
+      bufMgr->readPage(&file, ridPages[i], page);
+      checksum += reinterpret_cast<char*>(page)[i % Page::SIZE];
+      bufMgr->unPinPage(&file, ridPages[i], false);
+      continue;
+    }
+    std::vector<PageId> batch(ridPages.begin() + i, ridPages.begin() + end);
+    bufMgr->readPages(&file, batch, pages);
+    for (std::size_t j = 0; j < batch.size(); j++) {
+      checksum += reinterpret_cast<char*>(pages[j])[(i + j) % Page::SIZE];
+      bufMgr->unPinPage(&file, batch[j], false);
+    }
+  }
+  double micros = elapsedMicros(start);
+
+  std::cout << std::setw(12) << (batchSize == 1 ? "readPage" : "readPages")
+            << std::setw(8) << batchSize << std::setw(12)
+            << (long)(ridPages.size() / (micros / 1e6)) << std::setw(10)
+            << bufMgr->getBufStats().diskreads << std::setw(12)
+            << (checksum & 0xff) << std::endl;
+  bufMgr->flushFile(&file);
+  delete bufMgr;
+}
+
+void benchRidFetch(int argc, char** argv) {
+  std::uint32_t numPages = argc > 0 ? atoi(argv[0]) : 16384;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 256;
+  int rids = argc > 2 ? atoi(argv[2]) : 50000;
+
+  std::cout << "ridfetch: " << rids << " sorted record ids on " << numPages
+            << " pages through " << bufs
+            << " frames, page cache dropped before each run" << std::endl;
+  createPageFile(numPages);
+  {
+    BlobFile file(relationName, false);
+    std::cout << std::setw(12) << "call" << std::setw(8) << "batch"
+              << std::setw(12) << "rids/s" << std::setw(10) << "reads"
+              << std::setw(12) << "checksum" << std::endl;
+
+    // from a selective predicate touching few pages to one touching most
+    double spreads[] = {1.0, 0.25, 0.05};
+    for (int s = 0; s < 3; s++) {
+      std::uint32_t span = (std::uint32_t)((numPages - 1) * spreads[s]);
+      srandom(17);
+      std::vector<PageId> ridPages(rids);
+      for (int i = 0; i < rids; i++) {
+        ridPages[i] = 1 + random() % span;
+      }
+      std::sort(ridPages.begin(), ridPages.end());
+      std::cout << "record ids on " << span << " pages" << std::endl;
+      std::size_t batchSizes[] = {1, 16, 64, 256};
+      for (int b = 0; b < 4; b++) {
+        if (batchSizes[b] <= bufs) {
+          runRidFetch(file, ridPages, bufs, batchSizes[b]);
+        }
+      }
+    }
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// probes: random index lookups, each followed by a fetch of a record, made one
+// at a time through the blocking API and interleaved by coroutines
+// -----------------------------------------------------------------------------
+
+// One of the coroutines sharing the probes; returns through found.
+PageTask<void> probeWorker(BTreeIndex& index, File* heap,
+                           const std::vector<PageId>& heapPages,
+                           const std::vector<int>& keys, std::size_t first,
+                           std::size_t step, long& found) {
+  BufMgr& bufMgr = *index.getBufMgr();
+  for (std::size_t i = first; i < keys.size(); i += step) {
+    found += co_await lookupAsync(index, keys[i]);
+    RecordId rid;
+    rid.page_number = heapPages[keys[i] % heapPages.size()];
+    rid.slot_number = 1;
+    std::string record = co_await fetchRecordAsync(bufMgr, heap, rid);
+    found += record.size() > 0 ? 0 : 1;
+  }
+}
+
+void runProbes(BTreeIndex& index, PageFile& heap, BufMgr* bufMgr,
+               const std::vector<int>& keys, std::uint32_t coroutines) {
+  dropCache(*index.getFile());
+  bufMgr->flushFile(index.getFile());
+  bufMgr->flushFile(&heap);
+  bufMgr->clearBufStats();
+
+  std::vector<PageId> heapPages = relationPages(heap);
+  long found = 0;
+  Clock::time_point start = Clock::now();
+  if (coroutines == 0) {
+    Page* page;
+    for (std::size_t i = 0; i < keys.size(); i++) {
+      found += lookup(index, keys[i]);
+      PageId pageNo = heapPages[keys[i] % heapPages.size()];
+      bufMgr->readPage(&heap, pageNo, page);
+      bufMgr->unPinPage(&heap, pageNo, false);
+    }
+  } else {
+    PageLoop loop(*bufMgr);
+    for (std::uint32_t c = 0; c < coroutines; c++) {
+      loop.spawn(
+          probeWorker(index, &heap, heapPages, keys, c, coroutines, found));
+    }
+    loop.run();
+  }
+  double micros = elapsedMicros(start);
+
+  std::cout << std::setw(12) << (coroutines == 0 ? "blocking" : "coroutines")
+            << std::setw(8) << coroutines << std::setw(12)
+            << (long)(keys.size() / (micros / 1e6)) << std::setw(10)
+            << bufMgr->getBufStats().diskreads << std::setw(10) << found
+            << std::endl;
+}
+
+void benchProbes(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 200000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 2048;
+  int probes = argc > 2 ? atoi(argv[2]) : 50000;
+
+  std::cout << "probes: " << probes << " random lookups plus record fetches on "
+            << numRecords << " records through " << bufs << " frames"
+            << std::endl;
+  createRelation(numRecords);
+  BufMgr* bufMgr = new BufMgr(bufs);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    PageFile heap(relationName, false);
+    if (!bufMgr->enableAsyncIo(256)) {
+      std::cout << "asynchronous I/O unavailable" << std::endl;
+    }
+    std::cout << "backend " << bufMgr->getAsyncIoBackend() << std::endl;
+
+    srandom(21);
+    std::vector<int> keys(probes);
+    for (int i = 0; i < probes; i++) {
+      keys[i] = random() % numRecords;
+    }
+
+    std::cout << std::setw(12) << "api" << std::setw(8) << "tasks"
+              << std::setw(12) << "probes/s" << std::setw(10) << "reads"
+              << std::setw(10) << "found" << std::endl;
+    runProbes(index, heap, bufMgr, keys, 0);
+    std::uint32_t counts[] = {1, 16, 128, 1024};
+    for (int c = 0; c < 4; c++) {
+      runProbes(index, heap, bufMgr, keys, counts[c]);
+    }
+    bufMgr->flushFile(&heap);
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// shm: processes pinning random pages of one file, each through a private
+// pool or all through one shared-memory pool
+// -----------------------------------------------------------------------------
+
+void runShm(const std::vector<PageId>& pageNos, int processes,
+            std::uint32_t bufs, bool shared, const char* label) {
+  const std::string segment = "/badgerdb_bench";
+  SharedBufMgr::unlink(segment);
+  SharedBufMgr* pool = shared ? new SharedBufMgr(segment, bufs) : NULL;
+
+  // disk reads of each process
+  long* reads = static_cast<long*>(mmap(NULL, processes * sizeof(long),
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  std::cout.flush();
+  Clock::time_point start = Clock::now();
+  for (int p = 0; p < processes; p++) {
+    if (fork() == 0) {
+      {
+        BlobFile file(relationName, false);
+        BufMgr* bufMgr = shared ? static_cast<BufMgr*>(new SharedBufMgr(segment, bufs))
+                                : new BufMgr(bufs);
+        Page* page;
+        for (std::size_t i = p; i < pageNos.size(); i += processes) {
+          bufMgr->readPage(&file, pageNos[i], page);
+          bufMgr->unPinPage(&file, pageNos[i], false);
+        }
+        reads[p] = bufMgr->getBufStats().diskreads;
+        delete bufMgr;
+      }
+      _exit(0);
+    }
+  }
+  for (int p = 0; p < processes; p++) {
+    wait(NULL);
+  }
+  double micros = elapsedMicros(start);
+
+  long total = 0;
+  for (int p = 0; p < processes; p++) {
+    total += reads[p];
+  }
+  std::uint32_t frames = shared ? bufs : bufs * processes;
+  std::cout << std::setw(10) << label << std::setw(11) << processes
+            << std::setw(14) << (std::size_t)frames * Page::SIZE / (1 << 20)
+            << std::setw(12) << total << std::setw(11)
+            << (long)(pageNos.size() / (micros / 1e6)) << std::endl;
+  munmap(reads, processes * sizeof(long));
+  delete pool;
+  SharedBufMgr::unlink(segment);
+}
+
+void benchShm(int argc, char** argv) {
+  std::uint32_t numPages = argc > 0 ? atoi(argv[0]) : 4096;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 2048;
+  int accesses = argc > 2 ? atoi(argv[2]) : 200000;
+  int maxProcesses = argc > 3 ? atoi(argv[3]) : 8;
+
+  std::cout << "shm: " << accesses << " random pins of " << numPages
+            << " pages split between processes, " << bufs
+            << " frames per pool" << std::endl;
+  createPageFile(numPages);
+  srandom(17);
+  std::vector<PageId> pageNos(accesses);
+  for (int i = 0; i < accesses; i++) {
+    pageNos[i] = 1 + random() % (numPages - 1);
+  }
+
+  std::cout << std::setw(10) << "pool" << std::setw(11) << "processes"
+            << std::setw(14) << "pool MB" << std::setw(12) << "disk reads"
+            << std::setw(11) << "pins/s" << std::endl;
+  for (int processes = 1; processes <= maxProcesses; processes *= 2) {
+    runShm(pageNos, processes, bufs, false, "private");
+    runShm(pageNos, processes, bufs, true, "shared");
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// tier: random pins of relation pages through a pool alone, a pool with a
+// compressed tier, and a pool twice the size
+// -----------------------------------------------------------------------------
+
+void runTier(PageFile& file, const std::vector<PageId>& trace,
+             std::uint32_t bufs, std::size_t tierBytes, const char* label) {
+  BufMgr* bufMgr = new BufMgr(bufs);
+  bufMgr->setCompressedCacheSize(tierBytes);
+
+  Page* page;
+  // one pass to fill the pool and the tier
+  for (std::size_t i = 0; i < trace.size(); i++) {
+    bufMgr->readPage(&file, trace[i], page);
+    bufMgr->unPinPage(&file, trace[i], false);
+  }
+  bufMgr->clearBufStats();
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < trace.size(); i++) {
+    bufMgr->readPage(&file, trace[i], page);
+    bufMgr->unPinPage(&file, trace[i], false);
+  }
+  double micros = elapsedMicros(start);
+
+  BufStats stats = bufMgr->getBufStats();
+  std::size_t tierPages = bufMgr->getCompressedCachePages();
+  std::cout << std::setw(12) << label << std::setw(10)
+            << ((std::size_t)bufs * Page::SIZE + tierBytes) / 1024
+            << std::setw(12) << stats.diskreads << std::setw(12)
+            << stats.tierhits << std::setw(12) << tierPages << std::setw(10)
+            << std::setprecision(2) << std::fixed
+            << (tierPages > 0 ? (double)tierPages * Page::SIZE /
+                                    bufMgr->getCompressedCacheBytes()
+                              : 0.0)
+            << std::setw(11) << (long)(trace.size() / (micros / 1e6))
+            << std::endl;
+  bufMgr->flushFile(&file);
+  delete bufMgr;
+}
+
+void benchTier(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 400000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 1024;
+  int accesses = argc > 2 ? atoi(argv[2]) : 200000;
+
+  std::cout << "tier: " << accesses << " random pins of the pages of "
+            << numRecords << " records" << std::endl;
+  srandom(19);
+  createRelation(numRecords);
+  {
+    PageFile file(relationName, false);
+    std::vector<PageId> pageNos = relationPages(file);
+    std::vector<PageId> trace(accesses);
+    for (int i = 0; i < accesses; i++) {
+      trace[i] = pageNos[random() % pageNos.size()];
+    }
+    std::cout << pageNos.size() << " pages" << std::endl;
+
+    std::cout << std::setw(12) << "pool" << std::setw(10) << "memory KB"
+              << std::setw(12) << "disk reads" << std::setw(12) << "tier hits"
+              << std::setw(12) << "tier pages" << std::setw(10) << "ratio"
+              << std::setw(11) << "pins/s" << std::endl;
+    std::size_t poolBytes = (std::size_t)bufs * Page::SIZE;
+    runTier(file, trace, bufs, 0, "pool");
+    runTier(file, trace, bufs, poolBytes, "pool+tier");
+    runTier(file, trace, 2 * bufs, 0, "2x pool");
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// compress: bytes moved and CPU time spent building, reading and probing a
+// relation and its index, stored plain and compressed
+// -----------------------------------------------------------------------------
+
+double cpuSeconds(std::clock_t start) {
+  return (double)(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+long fileKb(const std::string& name) {
+  struct stat st;
+  return stat(name.c_str(), &st) == 0 ? st.st_size / 1024 : -1;
+}
+
+void printCompressRow(const char* label, const char* phase, long kb,
+                      const FileIoStats& stats, double cpu) {
+  std::cout << std::setw(8) << label << std::setw(8) << phase << std::setw(10)
+            << kb << std::setw(9) << stats.pages_written + stats.pages_read
+            << std::setw(12)
+            << (stats.bytes_written + stats.bytes_read) / 1024 << std::setw(9)
+            << std::setprecision(1) << std::fixed
+            << 100.0 * (stats.bytes_written + stats.bytes_read) /
+                   ((stats.pages_written + stats.pages_read) * Page::SIZE)
+            << std::setw(10) << std::setprecision(2) << cpu * 1e6 /
+                   (stats.pages_written + stats.pages_read)
+            << std::endl;
+}
+
+void runCompress(int numRecords, std::uint32_t bufs, int probes,
+                 PageCodec codec, const char* label) {
+  srandom(23);
+  std::clock_t start = std::clock();
+  FileIoStats stats = createRelation(numRecords, codec);
+  printCompressRow(label, "load", fileKb(relationName), stats,
+                   cpuSeconds(start));
+
+  {
+    PageFile file(relationName, false);
+    std::vector<PageId> pageNos = relationPages(file);
+    file.clearIoStats();
+    start = std::clock();
+    for (std::size_t i = 0; i < pageNos.size(); i++) {
+      file.readPage(pageNos[i]);
+    }
+    printCompressRow(label, "scan", fileKb(relationName), file.ioStats(),
+                     cpuSeconds(start));
+  }
+
+  std::string indexName;
+  BufMgr* bufMgr = new BufMgr(bufs);
+  {
+    start = std::clock();
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, codec);
+    bufMgr->flushFile(index.getFile());
+    printCompressRow(label, "build", fileKb(indexName),
+                     index.getFile()->ioStats(), cpuSeconds(start));
+
+    index.getFile()->clearIoStats();
+    start = std::clock();
+    for (int i = 0; i < probes; i++) {
+      lookup(index, random() % numRecords);
+    }
+    printCompressRow(label, "probe", fileKb(indexName),
+                     index.getFile()->ioStats(), cpuSeconds(start));
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+  removeIfExists(relationName);
+}
+
+void benchCompress(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 200000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 64;
+  int probes = argc > 2 ? atoi(argv[2]) : 20000;
+
+  std::cout << "compress: " << numRecords << " records, index built and "
+            << probes << " lookups through " << bufs << " frames" << std::endl;
+  std::cout << std::setw(8) << "file" << std::setw(8) << "phase"
+            << std::setw(10) << "size KB" << std::setw(9) << "pages"
+            << std::setw(12) << "I/O KB" << std::setw(9) << "I/O %"
+            << std::setw(10) << "us/page" << std::endl;
+  runCompress(numRecords, bufs, probes, CODEC_NONE, "plain");
+  runCompress(numRecords, bufs, probes, CODEC_LZ, "lz");
+}
+
+// -----------------------------------------------------------------------------
+// wal: small transactions updating one record on each of a few pages, made
+// durable by writing the changed pages and syncing the file (force) or by a
+// commit record in the log
+// -----------------------------------------------------------------------------
+
+// Pages of records per thread, so that threads never share a page.
+const int WAL_PAGES = 16;
+
+std::string walFileName(int thread) {
+  return relationName + "." + std::to_string(thread);
+}
+
+void runWalThread(BufMgr* bufMgr, LogManager* log, int thread, int txns,
+                  int pagesPerTxn, std::uint64_t* pagesWritten) {
+  PageFile file(walFileName(thread), false);
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  Page* page;
+  for (int i = 0; i < txns; i++) {
+    TxnId txn = log != NULL ? log->begin() : 0;
+    for (int p = 0; p < pagesPerTxn; p++) {
+      // consecutive transactions spread over the pages, each page once per
+      // transaction, and a page's records take turns
+      PageId pageNo = pageNos[(i * 5 + p) % WAL_PAGES];
+      bufMgr->readPage(&file, pageNo, page);
+      RecordId rid = {pageNo, (SlotId)(1 + (i / WAL_PAGES + p) % 16)};
+      std::string record = page->getRecord(rid);
+      record[offsetof(RECORD, s)] = 'a' + i % 26;
+      if (log == NULL) {
+        page->updateRecord(rid, record);
+        file.writePage(pageNo, *page);
+        bufMgr->unPinPage(&file, pageNo, false);
+      } else {
+        log->updateRecord(txn, &file, page, rid, record);
+        bufMgr->unPinPage(&file, pageNo, true);
+      }
+    }
+    if (log == NULL) {
+      fdatasync(file.descriptor());
+    } else {
+      log->commit(txn);
+    }
+  }
+  bufMgr->flushFile(&file);
+  *pagesWritten = file.ioStats().pages_written;
+}
+
+void runWal(int threads, int txns, int pagesPerTxn, bool useLog,
+            const char* label) {
+  const std::string logName = relationName + ".log";
+  removeIfExists(logName);
+  BufMgr* bufMgr = new BufMgr(64 + threads * WAL_PAGES);
+  LogManager* log = useLog ? new LogManager(logName, bufMgr) : NULL;
+
+  std::vector<std::thread> workers;
+  std::vector<std::uint64_t> pagesWritten(threads);
+  Clock::time_point start = Clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread(runWalThread, bufMgr, log, t, txns,
+                                  pagesPerTxn, &pagesWritten[t]));
+  }
+  std::uint64_t totalWritten = 0;
+  for (int t = 0; t < threads; t++) {
+    workers[t].join();
+    totalWritten += pagesWritten[t];
+  }
+  double micros = elapsedMicros(start);
+
+  LogStats stats = log != NULL ? log->getStats() : LogStats();
+  std::cout << std::setw(8) << label << std::setw(9) << threads
+            << std::setw(11) << (long)(threads * txns / (micros / 1e6))
+            << std::setw(13) << totalWritten << std::setw(13) << stats.flushes << std::setw(10)
+            << stats.bytes / 1024 << std::endl;
+  delete log;
+  delete bufMgr;
+  removeIfExists(logName);
+}
+
+void benchWal(int argc, char** argv) {
+  int txns = argc > 0 ? atoi(argv[0]) : 2000;
+  int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+  int pagesPerTxn = argc > 2 ? std::min(atoi(argv[2]), WAL_PAGES) : 1;
+
+  std::cout << "wal: " << txns << " transactions per thread, each updating "
+            << "a record on " << pagesPerTxn << " of " << WAL_PAGES
+            << " pages" << std::endl;
+  for (int t = 0; t < maxThreads; t++) {
+    removeIfExists(walFileName(t));
+    PageFile file(walFileName(t), true);
+    for (int p = 0; p < WAL_PAGES; p++) {
+      PageId pageNo;
+      Page page = file.allocatePage(pageNo);
+      RECORD record;
+      memset(record.s, ' ', sizeof(record.s));
+      for (int i = 0; i < 16; i++) {
+        record.i = i;
+        record.d = i;
+        page.insertRecord(std::string(reinterpret_cast<char*>(&record),
+                                      sizeof(record)));
+      }
+      file.writePage(pageNo, page);
+    }
+  }
+
+  std::cout << std::setw(8) << "commit" << std::setw(9) << "threads"
+            << std::setw(11) << "txns/s" << std::setw(13) << "page writes"
+            << std::setw(13) << "log flushes" << std::setw(10) << "log KB"
+            << std::endl;
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    runWal(threads, txns, pagesPerTxn, false, "force");
+    runWal(threads, txns, pagesPerTxn, true, "wal");
+  }
+  for (int t = 0; t < maxThreads; t++) {
+    removeIfExists(walFileName(t));
+  }
+}
+
+// -----------------------------------------------------------------------------
+// checkpoint: transactions updating random records through a pool that holds
+// the whole relation until a crash, then recovery, without checkpoints, with
+// checkpoints, and with checkpoints and pages written in the background
+// -----------------------------------------------------------------------------
+
+void runCheckpoint(int numRecords, int txns, std::uint64_t logBytes,
+                   std::uint32_t pagesPerRound, const char* label) {
+  const std::string logName = relationName + ".log";
+  removeIfExists(logName);
+
+  // a new relation each time, as pages keep the LSNs of the last log
+  srandom(29);
+  createRelation(numRecords);
+  std::vector<RecordId> rids(txns);
+  std::uint32_t bufs;
+  {
+    PageFile file(relationName, false);
+    std::vector<PageId> pageNos = relationPages(file);
+    bufs = pageNos.size() + 64;
+    for (int i = 0; i < txns; i++) {
+      rids[i].page_number = pageNos[random() % pageNos.size()];
+      rids[i].slot_number = 1 + random() % 20;
+    }
+  }
+
+  // results of the process that crashes: txns/s, pages written, checkpoints
+  // and dirty pages left
+  long* results = static_cast<long*>(mmap(NULL, 4 * sizeof(long),
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  std::cout.flush();
+  if (fork() == 0) {
+    BufMgr* bufMgr = new BufMgr(bufs);
+    LogManager* log = new LogManager(logName, bufMgr);
+    PageFile* file = new PageFile(relationName, false);
+    if (logBytes > 0) {
+      log->startCheckpointer(logBytes, pagesPerRound, 10);
+    }
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < rids.size(); i++) {
+      TxnId txn = log->begin();
+      Page* page;
+      bufMgr->readPage(file, rids[i].page_number, page);
+      std::string record = page->getRecord(rids[i]);
+      record[offsetof(RECORD, s)] = 'a' + i % 26;
+      log->updateRecord(txn, file, page, rids[i], record);
+      bufMgr->unPinPage(file, rids[i].page_number, true);
+      log->commit(txn);
+    }
+    results[0] = (long)(rids.size() / (elapsedMicros(start) / 1e6));
+    log->stopCheckpointer();
+    std::vector<DirtyPage> pages;
+    bufMgr->getDirtyPages(pages);
+    results[1] = bufMgr->getBufStats().diskwrites;
+    results[2] = log->getStats().checkpoints;
+    results[3] = pages.size();
+    _exit(0);
+  }
+  wait(NULL);
+
+  Clock::time_point start = Clock::now();
+  LogStats stats;
+  {
+    BufMgr bufMgr(bufs);
+    LogManager log(logName, &bufMgr);
+    log.recover();
+    stats = log.getStats();
+  }
+  double micros = elapsedMicros(start);
+
+  std::cout << std::setw(14) << label << std::setw(9) << results[0]
+            << std::setw(12) << results[1] << std::setw(13) << results[2]
+            << std::setw(13) << results[3] << std::setw(10) << stats.redone
+            << std::setw(13) << std::setprecision(1) << std::fixed
+            << micros / 1000 << std::endl;
+  munmap(results, 4 * sizeof(long));
+  removeIfExists(logName);
+  removeIfExists(relationName);
+}
+
+void benchCheckpoint(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 50000;
+  int txns = argc > 1 ? atoi(argv[1]) : 20000;
+  std::uint64_t logBytes = argc > 2 ? atoll(argv[2]) : 1 << 20;
+  std::uint32_t pagesPerRound = argc > 3 ? atoi(argv[3]) : 8;
+
+  std::cout << "checkpoint: " << txns << " update transactions on "
+            << numRecords << " records, then a crash; checkpoints every "
+            << logBytes / 1024 << " kB of log, " << pagesPerRound
+            << " pages written every 10 ms" << std::endl;
+  std::cout << std::setw(14) << "mode" << std::setw(9) << "txns/s"
+            << std::setw(12) << "pages out" << std::setw(13) << "checkpoints"
+            << std::setw(13) << "dirty left" << std::setw(10) << "redone"
+            << std::setw(13) << "recovery ms" << std::endl;
+  runCheckpoint(numRecords, txns, 0, 0, "none");
+  runCheckpoint(numRecords, txns, logBytes, 0, "checkpoints");
+  runCheckpoint(numRecords, txns, logBytes, pagesPerRound, "+trickle");
+}
+
+// -----------------------------------------------------------------------------
+// keytypes: building and probing indexes on the int, double and string
+// attributes, with the pool large enough to hold every index
+// -----------------------------------------------------------------------------
+
+void runKeyType(const char* label, int attrByteOffset, Datatype type,
+                int numRecords, std::uint32_t bufs, int lookups) {
+  BufMgr* bufMgr = new BufMgr(bufs);
+  std::string indexName;
+  {
+    Clock::time_point start = Clock::now();
+    BTreeIndex index(relationName, indexName, bufMgr, attrByteOffset, type);
+    double buildMicros = elapsedMicros(start);
+
+    srandom(11);
+    std::vector<int> keys(lookups);
+    for (int i = 0; i < lookups; i++) {
+      keys[i] = random() % numRecords;
+    }
+
+    int found = 0;
+    start = Clock::now();
+    for (int i = 0; i < lookups; i++) {
+      int intKey = keys[i];
+      double doubleKey = keys[i];
+      char stringKey[64];
+      sprintf(stringKey, "%05d string record", keys[i]);
+      const void* key = type == INTEGER  ? (const void*)&intKey
+                        : type == DOUBLE ? (const void*)&doubleKey
+                                         : (const void*)stringKey;
+      index.startScan(key, GTE, key, LTE);
+      try {
+        RecordId rid;
+        while (1) {
+          index.scanNext(rid);
+          found++;
+        }
+      } catch (IndexScanCompletedException e) {
+      }
+      index.endScan();
+    }
+    double lookupMicros = elapsedMicros(start);
+
+    std::cout << std::setw(8) << label << std::setw(14) << std::setprecision(1)
+              << std::fixed << buildMicros / 1000 << std::setw(14)
+              << std::setprecision(2) << lookupMicros / lookups
+              << std::setw(10) << found << std::endl;
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+}
+
+void benchKeyTypes(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 200000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 8192;
+  int lookups = argc > 2 ? atoi(argv[2]) : 200000;
+
+  std::cout << "keytypes: " << numRecords << " records, " << bufs
+            << " frames, " << lookups << " point lookups per key type"
+            << std::endl;
+  createRelation(numRecords);
+  std::cout << std::setw(8) << "key" << std::setw(14) << "build ms"
+            << std::setw(14) << "lookup us" << std::setw(10) << "found"
+            << std::endl;
+  runKeyType("int", offsetof(tuple, i), INTEGER, numRecords, bufs, lookups);
+  runKeyType("double", offsetof(tuple, d), DOUBLE, numRecords, bufs, lookups);
+  runKeyType("string", offsetof(tuple, s), STRING, numRecords, bufs, lookups);
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// search: point lookups on int indexes of growing size with each strategy for
+// searching the keys of a node, beside the search of a full leaf on its own
+// -----------------------------------------------------------------------------
+
+// Nanoseconds per upper bound search of a full leaf of sorted keys.
+double nodeSearchNanos(SearchStrategy strategy, int searches) {
+  std::vector<int> keys(INTARRAYLEAFSIZE);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    keys[i] = 2 * i;
+  }
+  std::vector<int> probes(4096);
+  for (std::size_t i = 0; i < probes.size(); i++) {
+    probes[i] = random() % (2 * INTARRAYLEAFSIZE);
+  }
+
+  long sum = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < searches; i++) {
+    sum += KeySearch::upperBound(keys.data(), INTARRAYLEAFSIZE,
+                                 probes[i & 4095], strategy);
+  }
+  double micros = elapsedMicros(start);
+  if (sum == 42) {
+    std::cout << "";
+  }
+  return micros * 1000 / searches;
+}
+
+void benchSearch(int argc, char** argv) {
+  int maxRecords = argc > 0 ? atoi(argv[0]) : 1000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 16384;
+  int lookups = argc > 2 ? atoi(argv[2]) : 200000;
+
+  std::cout << "search: int indexes of up to " << maxRecords << " records, "
+            << bufs << " frames, " << lookups << " point lookups per strategy"
+            << std::endl;
+  std::cout << "best strategy of this CPU: "
+            << KeySearch::name(KeySearch::best()) << std::endl;
+
+  std::cout << std::setw(10) << "strategy" << std::setw(14) << "leaf ns"
+            << std::endl;
+  for (int s = SEARCH_LINEAR; s <= SEARCH_AVX2; s++) {
+    SearchStrategy strategy = (SearchStrategy)s;
+    if (KeySearch::supported(strategy)) {
+      std::cout << std::setw(10) << KeySearch::name(strategy) << std::setw(14)
+                << std::setprecision(1) << std::fixed
+                << nodeSearchNanos(strategy, 10000000) << std::endl;
+    }
+  }
+
+  std::cout << std::setw(10) << "records" << std::setw(10) << "strategy"
+            << std::setw(14) << "lookup us" << std::setw(10) << "found"
+            << std::endl;
+  for (int numRecords = 10000; numRecords <= maxRecords; numRecords *= 10) {
+    createRelation(numRecords);
+    BufMgr* bufMgr = new BufMgr(bufs);
+    std::string indexName;
+    {
+      BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+      srandom(11);
+      std::vector<int> keys(lookups);
+      for (int i = 0; i < lookups; i++) {
+        keys[i] = random() % numRecords;
+      }
+
+      for (int s = SEARCH_LINEAR; s <= SEARCH_AVX2; s++) {
+        SearchStrategy strategy = (SearchStrategy)s;
+        if (!KeySearch::supported(strategy)) {
+          continue;
+        }
+        index.setSearchStrategy(strategy);
+        int found = 0;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < lookups; i++) {
+          found += lookup(index, keys[i]);
+        }
+        double micros = elapsedMicros(start);
+
+        std::cout << std::setw(10) << numRecords << std::setw(10)
+                  << KeySearch::name(strategy) << std::setw(14)
+                  << std::setprecision(2) << std::fixed << micros / lookups
+                  << std::setw(10) << found << std::endl;
+      }
+    }
+    delete bufMgr;
+    removeIfExists(indexName);
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// bulkload: building an int index by inserting the entries one by one against
+// sorting them and packing the nodes bottom-up
+// -----------------------------------------------------------------------------
+
+void runBuild(const char* label, const BuildOptions& build, int numRecords,
+              std::uint32_t bufs, int lookups) {
+  BufMgr* bufMgr = new BufMgr(bufs);
+  std::string indexName;
+  {
+    Clock::time_point start = Clock::now();
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, CODEC_NONE, build);
+    double buildMicros = elapsedMicros(start);
+
+    srandom(11);
+    int found = 0;
+    start = Clock::now();
+    for (int i = 0; i < lookups; i++) {
+      found += lookup(index, random() % numRecords);
+    }
+    double lookupMicros = elapsedMicros(start);
+
+    struct stat st;
+    stat(indexName.c_str(), &st);
+    std::cout << std::setw(18) << label << std::setw(12)
+              << std::setprecision(2) << std::fixed << buildMicros / 1e6
+              << std::setw(12) << st.st_size / Page::SIZE << std::setw(12)
+              << lookupMicros / lookups << std::setw(10) << found
+              << std::endl;
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+}
+
+void benchBulkLoad(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 10000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 8192;
+  std::size_t sortMemory = (argc > 2 ? atoi(argv[2]) : 64) << 20;
+  int lookups = argc > 3 ? atoi(argv[3]) : 100000;
+
+  std::cout << "bulkload: " << numRecords << " records, " << bufs
+            << " frames, " << (sortMemory >> 20) << " MB of sort memory, "
+            << lookups << " point lookups" << std::endl;
+  Clock::time_point start = Clock::now();
+  createRelation(numRecords);
+  std::cout << "relation created in " << std::setprecision(1) << std::fixed
+            << elapsedMicros(start) / 1e6 << " s" << std::endl;
+
+  std::cout << std::setw(18) << "build" << std::setw(12) << "seconds"
+            << std::setw(12) << "pages" << std::setw(12) << "lookup us"
+            << std::setw(10) << "found" << std::endl;
+  runBuild("insert", BuildOptions(false), numRecords, bufs, lookups);
+  runBuild("bulk fill 1.0", BuildOptions(true, 1.0, sortMemory), numRecords,
+           bufs, lookups);
+  runBuild("bulk fill 0.9", BuildOptions(true, 0.9, sortMemory), numRecords,
+           bufs, lookups);
+  runBuild("bulk in memory", BuildOptions(true, 0.9, (std::size_t)1 << 40),
+           numRecords, bufs, lookups);
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// parallelbuild: bulk loading an int index on 1, 2, 4, ... threads
+// -----------------------------------------------------------------------------
+
+void benchParallelBuild(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 10000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 8192;
+  int maxThreads = argc > 2 ? atoi(argv[2])
+                            : std::max(1u, std::thread::hardware_concurrency());
+  int lookups = argc > 3 ? atoi(argv[3]) : 100000;
+
+  std::cout << "parallelbuild: " << numRecords << " records, " << bufs
+            << " frames, up to " << maxThreads << " threads on "
+            << std::thread::hardware_concurrency() << " cores" << std::endl;
+  Clock::time_point start = Clock::now();
+  createRelation(numRecords);
+  std::cout << "relation created in " << std::setprecision(1) << std::fixed
+            << elapsedMicros(start) / 1e6 << " s" << std::endl;
+
+  std::cout << std::setw(18) << "build" << std::setw(12) << "seconds"
+            << std::setw(12) << "pages" << std::setw(12) << "lookup us"
+            << std::setw(10) << "found" << std::endl;
+  for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+    std::ostringstream label;
+    label << threads << (threads == 1 ? " thread" : " threads");
+    runBuild(label.str().c_str(),
+             BuildOptions(true, 0.9, (std::size_t)1 << 40, threads),
+             numRecords, bufs, lookups);
+    if (threads >= maxThreads) {
+      break;
+    }
+  }
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// churn: rounds of random deletes each followed by an insert, keeping the int
+// index at a steady number of entries, with the index size after each round,
+// against the same inserts without the deletes
+// -----------------------------------------------------------------------------
+
+void runChurn(bool deletes, int entries, std::uint32_t bufs, int rounds,
+              int ops) {
+  createRelation(0);
+  BufMgr* bufMgr = new BufMgr(bufs);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    srandom(13);
+    int serial = 0;
+    std::vector<std::pair<int, RecordId> > live(entries);
+    for (int i = 0; i < entries; i++) {
+      live[i].first = random() % (entries * 10);
+      live[i].second.page_number = 1 + serial / 100;
+      live[i].second.slot_number = 1 + serial % 100;
+      serial++;
+      index.insertEntry(&live[i].first, live[i].second);
+    }
+
+    const char* mode = deletes ? "delete+insert" : "insert only";
+    for (int round = 0; round <= rounds; round++) {
+      Clock::time_point start = Clock::now();
+      for (int i = 0; round > 0 && i < ops; i++) {
+        std::pair<int, RecordId> entry;
+        entry.first = random() % (entries * 10);
+        entry.second.page_number = 1 + serial / 100;
+        entry.second.slot_number = 1 + serial % 100;
+        serial++;
+        if (deletes) {
+          std::pair<int, RecordId>& victim = live[random() % entries];
+          index.deleteEntry(&victim.first, victim.second);
+          victim = entry;
+        }
+        index.insertEntry(&entry.first, entry.second);
+      }
+      double micros = elapsedMicros(start);
+
+      struct stat st;
+      stat(indexName.c_str(), &st);
+      std::cout << std::setw(14) << mode << std::setw(8) << round
+                << std::setw(12)
+                << (deletes ? entries : entries + round * ops)
+                << std::setw(12) << std::setprecision(2) << std::fixed
+                << (round > 0 ? micros / ops : 0.0) << std::setw(12)
+                << st.st_size / Page::SIZE << std::endl;
+    }
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+  removeIfExists(relationName);
+}
+
+void benchChurn(int argc, char** argv) {
+  int entries = argc > 0 ? atoi(argv[0]) : 1000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 8192;
+  int rounds = argc > 2 ? atoi(argv[2]) : 10;
+  int ops = argc > 3 ? atoi(argv[3]) : 200000;
+
+  std::cout << "churn: " << entries << " entries, " << bufs << " frames, "
+            << rounds << " rounds of " << ops << " operations" << std::endl;
+  std::cout << std::setw(14) << "mode" << std::setw(8) << "round"
+            << std::setw(12) << "entries" << std::setw(12) << "us per op"
+            << std::setw(12) << "pages" << std::endl;
+  runChurn(true, entries, bufs, rounds, ops);
+  runChurn(false, entries, bufs, rounds, ops);
+}
+
+// -----------------------------------------------------------------------------
+// blink: random inserts into an empty int index and random lookups of the
+// keys inserted, shared among increasing numbers of threads
+// -----------------------------------------------------------------------------
+
+// Run work(t) on each of the threads, returning the wall time.
+template <class Work>
+double timeThreads(int threads, Work work) {
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread(work, t));
+  }
+  for (int t = 0; t < threads; t++) {
+    workers[t].join();
+  }
+  return elapsedMicros(start);
+}
+
+void runBlink(int threads, const std::vector<int>& keys, std::uint32_t bufs) {
+  createRelation(0);
+  BufMgr* bufMgr = new BufMgr(bufs);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const int entries = keys.size();
+
+    // thread t inserts every threads-th key, from the t-th on
+    double insertMicros = timeThreads(threads, [&](int t) {
+      for (int i = t; i < entries; i += threads) {
+        RecordId rid;
+        rid.page_number = 1 + keys[i] / 100;
+        rid.slot_number = 1 + keys[i] % 100;
+        index.insertEntry(&keys[i], rid);
+      }
+    });
+
+    std::vector<int> found(threads);
+    double lookupMicros = timeThreads(threads, [&](int t) {
+      std::vector<RecordId> rids;
+      unsigned int seed = t + 1;
+      for (int i = t; i < entries; i += threads) {
+        int key = keys[rand_r(&seed) % entries];
+        rids.clear();
+        found[t] += index.lookupEntries(&key, rids);
+      }
+    });
+
+    int total = 0;
+    for (int t = 0; t < threads; t++) {
+      total += found[t];
+    }
+    std::cout << std::setw(10) << threads << std::setw(16)
+              << std::setprecision(2) << std::fixed
+              << entries / insertMicros << std::setw(16)
+              << entries / lookupMicros << std::setw(10) << total
+              << std::endl;
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+  removeIfExists(relationName);
+}
+
+void benchBlink(int argc, char** argv) {
+  int entries = argc > 0 ? atoi(argv[0]) : 2000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 16384;
+  int maxThreads = argc > 2 ? atoi(argv[2])
+                            : std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << "blink: " << entries << " entries, " << bufs
+            << " frames, up to " << maxThreads << " threads on "
+            << std::thread::hardware_concurrency() << " cores" << std::endl;
+  std::vector<int> keys(entries);
+  for (int i = 0; i < entries; i++) {
+    keys[i] = i;
+  }
+  srandom(17);
+  std::random_shuffle(keys.begin(), keys.end());
+
+  std::cout << std::setw(10) << "threads" << std::setw(16) << "inserts/us"
+            << std::setw(16) << "lookups/us" << std::setw(10) << "found"
+            << std::endl;
+  for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+    runBlink(threads, keys, bufs);
+    if (threads >= maxThreads) {
+      break;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// olc: random lookups of an int index, shared among increasing numbers of
+// threads, with every node pinned for each read and with the nodes peeked at
+// in the pool, which takes neither its latch nor a pin
+// -----------------------------------------------------------------------------
+
+// Buffer manager whose peekPage() can be turned off, so that every node read
+// pins its page.
+class PeekingBufMgr : public BufMgr {
+ public:
+  PeekingBufMgr(std::uint32_t bufs) : BufMgr(bufs), peeking(true) {}
+
+  Page* peekPage(File* file, const PageId pageNo, PagePeek& peek) {
+    return peeking ? BufMgr::peekPage(file, pageNo, peek) : NULL;
+  }
+
+  bool peeking;
+};
+
+// Look up random keys on each of the threads, returning lookups per us.
+double runOlcLookups(BTreeIndex& index, int threads, const std::vector<int>& keys,
+                     int lookups, int& total) {
+  const int entries = keys.size();
+  std::vector<int> found(threads);
+  double micros = timeThreads(threads, [&](int t) {
+    std::vector<RecordId> rids;
+    unsigned int seed = t + 1;
+    for (int i = t; i < lookups; i += threads) {
+      int key = keys[rand_r(&seed) % entries];
+      rids.clear();
+      found[t] += index.lookupEntries(&key, rids);
+    }
+  });
+  total = 0;
+  for (int t = 0; t < threads; t++) {
+    total += found[t];
+  }
+  return lookups / micros;
+}
+
+void benchOlc(int argc, char** argv) {
+  int entries = argc > 0 ? atoi(argv[0]) : 2000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 16384;
+  int maxThreads = argc > 2 ? atoi(argv[2])
+                            : std::max(1u, std::thread::hardware_concurrency());
+  int lookups = argc > 3 ? atoi(argv[3]) : 2000000;
+
+  std::cout << "olc: " << entries << " entries, " << bufs << " frames, "
+            << lookups << " lookups, up to " << maxThreads << " threads on "
+            << std::thread::hardware_concurrency() << " cores" << std::endl;
+  std::vector<int> keys(entries);
+  for (int i = 0; i < entries; i++) {
+    keys[i] = i;
+  }
+  srandom(17);
+  std::random_shuffle(keys.begin(), keys.end());
+
+  createRelation(0);
+  PeekingBufMgr* bufMgr = new PeekingBufMgr(bufs);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    for (int i = 0; i < entries; i++) {
+      RecordId rid;
+      rid.page_number = 1 + keys[i] / 100;
+      rid.slot_number = 1 + keys[i] % 100;
+      index.insertEntry(&keys[i], rid);
+    }
+
+    std::cout << std::setw(10) << "threads" << std::setw(18)
+              << "pinned lookups/us" << std::setw(18) << "peeked lookups/us"
+              << std::setw(10) << "found" << std::endl;
+    for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+      int pinnedFound;
+      int peekedFound;
+      bufMgr->peeking = false;
+      double pinned = runOlcLookups(index, threads, keys, lookups, pinnedFound);
+      bufMgr->peeking = true;
+      double peeked = runOlcLookups(index, threads, keys, lookups, peekedFound);
+      std::cout << std::setw(10) << threads << std::setw(18)
+                << std::setprecision(2) << std::fixed << pinned
+                << std::setw(18) << peeked << std::setw(10)
+                << (pinnedFound == peekedFound ? peekedFound : -1) << std::endl;
+      if (threads >= maxThreads) {
+        break;
+      }
+    }
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// scanbatch: long range scans of an int index, fetching the record ids one at
+// a time with scanNext() and a batch at a time with scanNextBatch()
+// -----------------------------------------------------------------------------
+
+// Scan [low, low + range) for each of the lows, returning the record ids found.
+long runRangeScans(BTreeIndex& index, const std::vector<int>& lows, int range,
+                   int batch, double& micros) {
+  long found = 0;
+  std::vector<RecordId> rids(std::max(batch, 1));
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < lows.size(); i++) {
+    int low = lows[i];
+    int high = low + range;
+    index.startScan(&low, GTE, &high, LT);
+    if (batch == 0) {
+      try {
+        while (1) {
+          index.scanNext(rids[0]);
+          found++;
+        }
+      } catch (IndexScanCompletedException e) {
+      }
+    } else {
+      int got;
+      while ((got = index.scanNextBatch(rids.data(), batch)) > 0) {
+        found += got;
+      }
+    }
+    index.endScan();
+  }
+  micros = elapsedMicros(start);
+  return found;
+}
+
+void benchScanBatch(int argc, char** argv) {
+  int numRecords = argc > 0 ? atoi(argv[0]) : 1000000;
+  std::uint32_t bufs = argc > 1 ? atoi(argv[1]) : 16384;
+  int range = argc > 2 ? atoi(argv[2]) : 100000;
+  int scans = argc > 3 ? atoi(argv[3]) : 200;
+
+  std::cout << "scanbatch: " << numRecords << " records, " << bufs
+            << " frames, " << scans << " scans of " << range << " keys"
+            << std::endl;
+  createRelation(numRecords);
+  BufMgr* bufMgr = new BufMgr(bufs);
+  std::string indexName;
+  {
+    BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    srandom(23);
+    std::vector<int> lows(scans);
+    for (int i = 0; i < scans; i++) {
+      lows[i] = random() % std::max(numRecords - range, 1);
+    }
+
+    // a first pass brings the leaves into the pool
+    double micros;
+    runRangeScans(index, lows, range, 0, micros);
+
+    std::cout << std::setw(12) << "api" << std::setw(14) << "us per scan"
+              << std::setw(14) << "rids/us" << std::setw(12) << "found"
+              << std::endl;
+    const int batches[] = {0, 16, 256, 4096};
+    for (int b = 0; b < 4; b++) {
+      long found = runRangeScans(index, lows, range, batches[b], micros);
+      std::string api = batches[b] ? "batch " + std::to_string(batches[b])
+                                   : std::string("scanNext");
+      std::cout << std::setw(12) << api << std::setw(14)
+                << std::setprecision(1) << std::fixed << micros / scans
+                << std::setw(14) << std::setprecision(2) << found / micros
+                << std::setw(12) << found << std::endl;
+    }
+  }
+  delete bufMgr;
+  removeIfExists(indexName);
+  removeIfExists(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// main
+// -----------------------------------------------------------------------------
+
+void usage() {
+  std::cout << "usage: badgerdb_bench <benchmark> [options]" << std::endl;
+  std::cout << "  classes [records] [frames] [rounds] [lookups] [scan pages]"
+            << std::endl;
+  std::cout << "  eviction [frames] [evictions] [references] [pinned %]"
+            << std::endl;
+  std::cout << "  mrc [pages] [accesses] [sampling rate]" << std::endl;
+  std::cout << "  qdepth [pages] [reads] [max depth]" << std::endl;
+  std::cout << "  direct [pages] [frames] [accesses]" << std::endl;
+  std::cout << "  ridfetch [pages] [frames] [record ids]" << std::endl;
+  std::cout << "  probes [records] [frames] [probes]" << std::endl;
+  std::cout << "  shm [pages] [frames] [accesses] [max processes]" << std::endl;
+  std::cout << "  tier [records] [frames] [accesses]" << std::endl;
+  std::cout << "  compress [records] [frames] [lookups]" << std::endl;
+  std::cout << "  wal [transactions] [max threads] [pages per transaction]" << std::endl;
+  std::cout << "  checkpoint [records] [transactions] [log bytes] [pages per round]"
+            << std::endl;
+  std::cout << "  keytypes [records] [frames] [lookups]" << std::endl;
+  std::cout << "  search [max records] [frames] [lookups]" << std::endl;
+  std::cout << "  bulkload [records] [frames] [sort MB] [lookups]" << std::endl;
+  std::cout << "  parallelbuild [records] [frames] [max threads] [lookups]"
+            << std::endl;
+  std::cout << "  churn [entries] [frames] [rounds] [operations per round]"
+            << std::endl;
+  std::cout << "  blink [entries] [frames] [max threads]" << std::endl;
+  std::cout << "  olc [entries] [frames] [max threads] [lookups]" << std::endl;
+  std::cout << "  scanbatch [records] [frames] [range] [scans]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+
+  std::string name = argv[1];
+  if (name == "classes") {
+    benchClasses(argc - 2, argv + 2);
+  } else if (name == "eviction") {
+    benchEviction(argc - 2, argv + 2);
+  } else if (name == "mrc") {
+    benchMissRatio(argc - 2, argv + 2);
+  } else if (name == "qdepth") {
+    benchQueueDepth(argc - 2, argv + 2);
+  } else if (name == "direct") {
+    benchDirect(argc - 2, argv + 2);
+  } else if (name == "ridfetch") {
+    benchRidFetch(argc - 2, argv + 2);
+  } else if (name == "probes") {
+    benchProbes(argc - 2, argv + 2);
+  } else if (name == "shm") {
+    benchShm(argc - 2, argv + 2);
+  } else if (name == "tier") {
+    benchTier(argc - 2, argv + 2);
+  } else if (name == "compress") {
+    benchCompress(argc - 2, argv + 2);
+  } else if (name == "wal") {
+    benchWal(argc - 2, argv + 2);
+  } else if (name == "checkpoint") {
+    benchCheckpoint(argc - 2, argv + 2);
+  } else if (name == "keytypes") {
+    benchKeyTypes(argc - 2, argv + 2);
+  } else if (name == "search") {
+    benchSearch(argc - 2, argv + 2);
+  } else if (name == "bulkload") {
+    benchBulkLoad(argc - 2, argv + 2);
+  } else if (name == "parallelbuild") {
+    benchParallelBuild(argc - 2, argv + 2);
+  } else if (name == "churn") {
+    benchChurn(argc - 2, argv + 2);
+  } else if (name == "blink") {
+    benchBlink(argc - 2, argv + 2);
+  } else if (name == "olc") {
+    benchOlc(argc - 2, argv + 2);
+  } else if (name == "scanbatch") {
+    benchScanBatch(argc - 2, argv + 2);
+  } else {
+    usage();
+    return 1;
+  }
+  return 0;
+}
@@ -5,6 +5,12 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <unistd.h>
 #include "btree.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
@@ -15,12 +21,292 @@
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/log_exception.h"
+#include "exceptions/sort_exception.h"
 
 
 //#define DEBUG
 
 namespace badgerdb
 {
+namespace {
+
+// key at the address passed to insertEntry() and startScan(), which need not be aligned
+template <class T>
+T keyAt(const void *key) {
+    T value;
+    memcpy(&value, key, sizeof(T));
+    return value;
+}
+
+template <>
+StringKey keyAt <StringKey>(const void *key) {
+    StringKey value;
+    strncpy(value.data, (const char *) key, STRINGSIZE);
+    return value;
+}
+
+// counts an operation on an index for as long as it runs, in builds with assertions
+class InFlight {
+public:
+    explicit InFlight(std::atomic<int> &count) : count(count) {
+#ifndef NDEBUG
+        count++;
+#endif
+    }
+
+    ~InFlight() {
+#ifndef NDEBUG
+        count--;
+#endif
+    }
+
+private:
+    std::atomic<int> &count;
+};
+
+// number of keys of a node read without its latch, which may be torn until validated, kept within the node
+int keysRead(const int numKeys, const int size) {
+    return std::max(0, std::min(numKeys, size));
+}
+
+// Entries of an index being bulk loaded, put back in order: sorted in memory while they fit in the
+// budget, otherwise sorted a budget at a time into runs on temporary files, which are then merged.
+template <class T>
+class EntrySorter {
+public:
+    explicit EntrySorter(const std::size_t memory)
+        : capacity(std::max(memory / sizeof(RIDKeyPair <T>), (std::size_t) 1024)), next(0) {
+    }
+
+    ~EntrySorter() {
+        for (size_t i = 0; i < runs.size(); i++) {
+            fclose(runs[i].file);
+        }
+    }
+
+    void add(const RIDKeyPair <T> &entry) {
+        if (buffer.size() == capacity) {
+            spill();
+        }
+        buffer.push_back(entry);
+    }
+
+    // Sort what add() was given, after which nextEntry() returns it in order.
+    void sort() {
+        if (runs.empty()) {
+            std::sort(buffer.begin(), buffer.end());
+            return;
+        }
+
+        spill();
+        std::vector<RIDKeyPair <T> >().swap(buffer);
+
+        // the budget is shared by the read buffers of the runs
+        size_t share = std::max(capacity / runs.size(), (size_t) 256);
+        for (size_t i = 0; i < runs.size(); i++) {
+            rewind(runs[i].file);
+            runs[i].entries.resize(share);
+            runs[i].count = 0;
+            runs[i].next  = 0;
+            if (refill(runs[i])) {
+                heap.push_back(i);
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), Later(runs));
+    }
+
+    bool nextEntry(RIDKeyPair <T> &entry) {
+        if (runs.empty()) {
+            if (next == buffer.size()) {
+                return false;
+            }
+            entry = buffer[next++];
+            return true;
+        }
+
+        if (heap.empty()) {
+            return false;
+        }
+        std::pop_heap(heap.begin(), heap.end(), Later(runs));
+        Run &run = runs[heap.back()];
+        entry = run.entries[run.next++];
+        if (run.next < run.count || refill(run)) {
+            std::push_heap(heap.begin(), heap.end(), Later(runs));
+        }
+        else {
+            heap.pop_back();
+        }
+        return true;
+    }
+
+private:
+    struct Run {
+        FILE *file;
+        std::vector<RIDKeyPair <T> > entries;
+        size_t count;
+        size_t next;
+    };
+
+    // orders the heap of runs so that the run with the smallest next entry is on top
+    struct Later {
+        const std::vector<Run> &runs;
+        explicit Later(const std::vector<Run> &runs) : runs(runs) {
+        }
+        bool operator()(const size_t a, const size_t b) const {
+            return runs[b].entries[runs[b].next] < runs[a].entries[runs[a].next];
+        }
+    };
+
+    void spill() {
+        std::sort(buffer.begin(), buffer.end());
+        Run run;
+        run.file = tmpfile();
+        if (!run.file) {
+            throw SortException("cannot create a temporary file for a run");
+        }
+        runs.push_back(run);
+        if (fwrite(buffer.data(), sizeof(RIDKeyPair <T>), buffer.size(), run.file) != buffer.size()) {
+            throw SortException("cannot write a run");
+        }
+        buffer.clear();
+    }
+
+    bool refill(Run &run) {
+        run.count = fread(run.entries.data(), sizeof(RIDKeyPair <T>), run.entries.size(), run.file);
+        run.next  = 0;
+        if (run.count == 0 && ferror(run.file)) {
+            throw SortException("cannot read a run back");
+        }
+        return run.count > 0;
+    }
+
+    size_t capacity;
+    std::vector<RIDKeyPair <T> > buffer;
+    size_t next;
+    std::vector<Run> runs;
+    std::vector<size_t> heap;
+};
+
+// Run work(0) to work(threads - 1) on a thread each, and rethrow the first exception any of them threw.
+template <class Work>
+void runThreads(const int threads, Work work) {
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&errors, &work, t]() {
+            try {
+                work(t);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    for (int t = 0; t < threads; t++) {
+        if (errors[t]) {
+            std::rethrow_exception(errors[t]);
+        }
+    }
+}
+
+// Sort the entries of pages [first, last) of the relation into entries.
+template <class T>
+void extractEntries(BufMgr *bufMgr, PageFile *relation, const std::vector<PageId> &pageNos,
+                    const size_t first, const size_t last, const int attrByteOffset,
+                    std::vector<RIDKeyPair <T> > &entries) {
+    for (size_t i = first; i < last; i++) {
+        Page *page;
+        bufMgr->readPage(relation, pageNos[i], page, BULK_READ);
+        for (PageIterator it = page->begin(); it != page->end(); ++it) {
+            std::string record = *it;
+            RIDKeyPair <T> entry;
+            entry.set(it.getCurrentRecord(), keyAt <T>(record.c_str() + attrByteOffset));
+            entries.push_back(entry);
+        }
+        bufMgr->unPinPage(relation, pageNos[i], false);
+    }
+    std::sort(entries.begin(), entries.end());
+}
+
+// Merge slice r, [cuts[p][r], cuts[p][r + 1]), of each sorted part p into merged, neighbouring slices
+// pairwise until one is left.
+template <class T>
+void mergeSlices(const std::vector<std::vector<RIDKeyPair <T> > > &parts,
+                 const std::vector<std::vector<size_t> > &cuts, const size_t r,
+                 std::vector<RIDKeyPair <T> > &merged) {
+    std::vector<size_t> bounds(1, 0);
+    for (size_t p = 0; p < parts.size(); p++) {
+        merged.insert(merged.end(), parts[p].begin() + cuts[p][r], parts[p].begin() + cuts[p][r + 1]);
+        bounds.push_back(merged.size());
+    }
+    while (bounds.size() > 2) {
+        std::vector<size_t> halved(1, 0);
+        for (size_t i = 2; i < bounds.size(); i += 2) {
+            std::inplace_merge(merged.begin() + bounds[i - 2], merged.begin() + bounds[i - 1],
+                               merged.begin() + bounds[i]);
+            halved.push_back(bounds[i]);
+        }
+        if (bounds.size() % 2 == 0) {
+            halved.push_back(bounds.back());
+        }
+        bounds.swap(halved);
+    }
+}
+
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::IndexCursor, IndexCursor::~IndexCursor
+// -----------------------------------------------------------------------------
+
+IndexCursor::IndexCursor()
+    : index(NULL), scanExecuting(false), nextEntry(0), currentPageNum(0), nextPageNum(0), rangeEnds(false),
+      lowOp(GTE), highOp(LTE), scanSlot(-1) {
+}
+
+IndexCursor::~IndexCursor() {
+    if (scanExecuting) {
+        index->endScan(*this);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::lowVal, IndexCursor::highVal
+// -----------------------------------------------------------------------------
+
+template <>
+int &IndexCursor::lowVal <int>() {
+    return lowValInt;
+}
+
+template <>
+double &IndexCursor::lowVal <double>() {
+    return lowValDouble;
+}
+
+template <>
+StringKey &IndexCursor::lowVal <StringKey>() {
+    return lowValString;
+}
+
+template <>
+int &IndexCursor::highVal <int>() {
+    return highValInt;
+}
+
+template <>
+double &IndexCursor::highVal <double>() {
+    return highValDouble;
+}
+
+template <>
+StringKey &IndexCursor::highVal <StringKey>() {
+    return highValString;
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
@@ -29,15 +315,21 @@ BTreeIndex::BTreeIndex(const std::string& relationName,
                        std::string& outIndexName,
                        BufMgr *bufMgrIn,
                        const int attrByteOffset,
-                       const Datatype attrType) {
+                       const Datatype attrType,
+                       const PageCodec codec,
+                       const BuildOptions& build) {
     this->bufMgr        = bufMgrIn;
-    this->scanExecuting = false;
-
-    this->leafOccupancy = INTARRAYLEAFSIZE;
-    this->nodeOccupancy = INTARRAYNONLEAFSIZE;
-
-    // this->leafOccupancy = 10;
-    // this->nodeOccupancy = 10;
+    this->log           = NULL;
+    this->txn           = 0;
+    this->shadowPaging  = false;
+    this->publishedRoot = 0;
+    this->linkedRoot    = 0;
+    this->operationsInFlight = 0;
+    this->searchStrategy = KeySearch::best();
+
+    for (int i = 0; i < MAX_SHADOW_READERS; i++) {
+        readerVersions[i] = 0;
+    }
 
     this->attributeType  = attrType;
     this->attrByteOffset = attrByteOffset;
@@ -54,51 +346,124 @@ BTreeIndex::BTreeIndex(const std::string& relationName,
         Page *metaPage;
 
         headerPageNum = file->getFirstPageNo();
-        bufMgr->readPage(file, headerPageNum, metaPage);
+        bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
 
         IndexMetaInfo *indexMetaInfo = (IndexMetaInfo *) metaPage;
 
+        const char *badInfo = NULL;
         if ((indexMetaInfo->attrType != attrType) ||
             (indexMetaInfo->attrByteOffset != attrByteOffset) ||
             (indexMetaInfo->relationName != relationName)) {
-            throw BadIndexInfoException("Error: Index meta attributes don't match!");
+            badInfo = "Error: Index meta attributes don't match!";
+        }
+        else if (indexMetaInfo->formatVersion != (INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION) &&
+                 (indexMetaInfo->formatVersion & ~0xffff) == INDEX_FORMAT_TAG) {
+            badInfo = "Error: Index file format version not supported!";
+        }
+
+        if (badInfo) {
+            // the file is closed again, for the index is never opened
+            bufMgr->unPinPage(file, headerPageNum, false);
+            bufMgr->flushFile(file);
+            delete file;
+            throw BadIndexInfoException(badInfo);
         }
 
-        rootPageNum = indexMetaInfo->rootPageNo;
+        if (indexMetaInfo->formatVersion != (INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION)) {
+            bufMgr->unPinPage(file, headerPageNum, false);
+            upgradeFormat();
+            bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+            indexMetaInfo = (IndexMetaInfo *) metaPage;
+        }
+
+        PageId rootNum = indexMetaInfo->rootPageNo;
+        bool   isLeaf  = indexMetaInfo->shadowPaging ? indexMetaInfo->rootIsLeaf : rootNum == 2;
+
+        switch (attributeType) {
+        case INTEGER:
+            setRoot(rootNum, treeHeight <int>(rootNum, isLeaf));
+            break;
+        case DOUBLE:
+            setRoot(rootNum, treeHeight <double>(rootNum, isLeaf));
+            break;
+        case STRING:
+            setRoot(rootNum, treeHeight <StringKey>(rootNum, isLeaf));
+            break;
+        }
+
+        if (!indexMetaInfo->shadowPaging && indexMetaInfo->freeCount == 0) {
+            this->bufMgr->unPinPage(this->file, headerPageNum, false);
+            return;
+        }
+
+        if (indexMetaInfo->shadowPaging) {
+            shadowPaging = true;
+        }
+        freePages.assign(indexMetaInfo->freePages, indexMetaInfo->freePages + indexMetaInfo->freeCount);
 
-        rootIsLeaf = rootPageNum == 2;
+        // pages reused from here on are no longer free should the index not be closed
+        indexMetaInfo->freeCount = 0;
+        this->bufMgr->unPinPage(this->file, headerPageNum, true);
+        bufMgr->writePages(file, std::vector<PageId>(1, headerPageNum));
+        fdatasync(file->descriptor());
 
-        this->bufMgr->unPinPage(this->file, headerPageNum, false);
+        publishedRoot = (std::uint64_t) 1 << 33 | (std::uint64_t) rootIsLeaf << 32 | rootPageNum;
     }
     else {
-        rootIsLeaf = true;
-
-        file = new BlobFile(outIndexName, true);
+        file = new BlobFile(outIndexName, true, codec);
         Page *indexMetaInfoPage;
-        this->bufMgr->allocPage(this->file, headerPageNum, indexMetaInfoPage);
+        this->bufMgr->allocPage(this->file, headerPageNum, indexMetaInfoPage, NORMAL, PAGE_INDEX_INTERIOR);
 
         struct IndexMetaInfo *metaInfo = (struct IndexMetaInfo *) indexMetaInfoPage;
         metaInfo->attrByteOffset = attrByteOffset;
         metaInfo->attrType       = attrType;
         strncpy(metaInfo->relationName, relationName.c_str(),
                 sizeof(metaInfo->relationName));
-
-        Page *rootPage;
-        bufMgr->allocPage(this->file, rootPageNum, rootPage);
-        LeafNodeInt *root = (LeafNodeInt *) rootPage;
-
-        for (int idx = 0; idx < leafOccupancy; idx++) {
-            (root->ridArray[idx]).page_number = 0;
+        metaInfo->shadowPaging = 0;
+        metaInfo->rootIsLeaf   = 1;
+        metaInfo->freeCount    = 0;
+        metaInfo->formatVersion = INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION;
+
+        Page  *rootPage;
+        PageId rootNum;
+        bufMgr->allocPage(this->file, rootNum, rootPage, NORMAL, PAGE_INDEX_LEAF);
+        setRoot(rootNum, 0);
+
+        switch (attributeType) {
+        case INTEGER:
+            initLeaf((LeafNodeInt *) rootPage);
+            break;
+        case DOUBLE:
+            initLeaf((LeafNodeDouble *) rootPage);
+            break;
+        case STRING:
+            initLeaf((LeafNodeString *) rootPage);
+            break;
         }
-        root->rightSibPageNo = 0;
 
         metaInfo->rootPageNo = rootPageNum; // Starts at 2
 
         bufMgr->unPinPage(file, headerPageNum, true);
         bufMgr->unPinPage(file, rootPageNum, true);
 
+        if (build.bulk) {
+            switch (attributeType) {
+            case INTEGER:
+                bulkLoad <int>(relationName, build);
+                break;
+            case DOUBLE:
+                bulkLoad <double>(relationName, build);
+                break;
+            case STRING:
+                bulkLoad <StringKey>(relationName, build);
+                break;
+            }
+            bufMgr->flushFile(file);
+            return;
+        }
+
         RecordId  curr_rid;
-        FileScan *fs = new FileScan(relationName, bufMgr);
+        FileScan *fs = new FileScan(relationName, bufMgr, BULK_READ);
 
         try {
             while (true) {
@@ -121,8 +486,28 @@ BTreeIndex::BTreeIndex(const std::string& relationName,
 // -----------------------------------------------------------------------------
 
 BTreeIndex::~BTreeIndex() {
+    if (scanCursor.scanExecuting) {
+        endScan(scanCursor);
+    }
+
+    if (shadowPaging) {
+        // inserts not committed are dropped along with their pages; no scan is left to read old versions
+        freePages.insert(freePages.end(), pendingPages.begin(), pendingPages.end());
+        for (size_t i = 0; i < retiredPages.size(); i++) {
+            freePages.push_back(retiredPages[i].second);
+        }
+    }
+
+    if (!freePages.empty()) {
+        Page *metaPage;
+        bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+        IndexMetaInfo *metaInfo = (IndexMetaInfo *) metaPage;
+        metaInfo->freeCount = std::min((int) freePages.size(), METAFREEPAGES);
+        std::copy(freePages.begin(), freePages.begin() + metaInfo->freeCount, metaInfo->freePages);
+        bufMgr->unPinPage(file, headerPageNum, true);
+    }
+
     bufMgr->flushFile(this->file);
-    scanExecuting = false;
     delete file;
 }
 
@@ -131,92 +516,871 @@ BTreeIndex::~BTreeIndex() {
 // -----------------------------------------------------------------------------
 
 const void BTreeIndex::insertEntry(const void *key, const RecordId rid) {
-    RIDKeyPair <int> ridkey_entry;
-    ridkey_entry.set(rid, *(int *) key);
+    InFlight inFlight(operationsInFlight);
+    switch (attributeType) {
+    case INTEGER: {
+        RIDKeyPair <int> ridkey_entry;
+        ridkey_entry.set(rid, keyAt <int>(key));
+        insertKey(&ridkey_entry);
+        break;
+    }
+    case DOUBLE: {
+        RIDKeyPair <double> ridkey_entry;
+        ridkey_entry.set(rid, keyAt <double>(key));
+        insertKey(&ridkey_entry);
+        break;
+    }
+    case STRING: {
+        RIDKeyPair <StringKey> ridkey_entry;
+        ridkey_entry.set(rid, keyAt <StringKey>(key));
+        insertKey(&ridkey_entry);
+        break;
+    }
+    }
+}
 
-    SplitData <int> *splitData;
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
 
-    if (rootIsLeaf) {
-        splitData = insertLeafEntry(rootPageNum, &ridkey_entry);
+const void BTreeIndex::deleteEntry(const void *key, const RecordId rid) {
+    assert(shadowPaging || operationsInFlight == 0);
+    switch (attributeType) {
+    case INTEGER: {
+        RIDKeyPair <int> ridkey_entry;
+        ridkey_entry.set(rid, keyAt <int>(key));
+        deleteKey(ridkey_entry);
+        break;
     }
-    else {
-        splitData = insertNonLeafEntry(rootPageNum, &ridkey_entry);
+    case DOUBLE: {
+        RIDKeyPair <double> ridkey_entry;
+        ridkey_entry.set(rid, keyAt <double>(key));
+        deleteKey(ridkey_entry);
+        break;
     }
+    case STRING: {
+        RIDKeyPair <StringKey> ridkey_entry;
+        ridkey_entry.set(rid, keyAt <StringKey>(key));
+        deleteKey(ridkey_entry);
+        break;
+    }
+    }
+}
 
-    if (splitData) {
-        Page * newRootPage;
-        PageId newPageId;
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupEntries
+// -----------------------------------------------------------------------------
 
-        bufMgr->allocPage(file, newPageId, newRootPage);
+int BTreeIndex::lookupEntries(const void *key, std::vector<RecordId> &rids) {
+    InFlight inFlight(operationsInFlight);
+    switch (attributeType) {
+    case INTEGER:
+        return lookupKey(keyAt <int>(key), rids);
+    case DOUBLE:
+        return lookupKey(keyAt <double>(key), rids);
+    case STRING:
+        return lookupKey(keyAt <StringKey>(key), rids);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoad
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::bulkLoad(const std::string& relationName, const BuildOptions& build) {
+    if (build.threads > 1) {
+        parallelLoad <T>(relationName, build);
+        return;
+    }
 
-        struct NonLeafNodeInt *newRoot = (struct NonLeafNodeInt *) newRootPage;
-        for (int i = 0; i <= nodeOccupancy; i++) {
-            newRoot->pageNoArray[i] = 0;
+    EntrySorter <T> sorter(build.sortMemory);
+    {
+        RecordId rid;
+        FileScan fs(relationName, bufMgr, BULK_READ);
+        try {
+            while (true) {
+                fs.scanNext(rid);
+                std::string record = fs.getRecord();
+                RIDKeyPair <T> entry;
+                entry.set(rid, keyAt <T>(record.c_str() + attrByteOffset));
+                sorter.add(entry);
+            }
+        } catch (EndOfFileException e) {
         }
+    }
+    sorter.sort();
+
+    // first key and page number of each node of the level last built
+    std::vector<SplitData <T> > level;
+
+    const int leafFill = std::max(1, (int) (build.fillFactor * LeafNode <T>::SIZE));
+    PageId leafNum = rootPageNum;
+    Page  *leafPage;
+    bufMgr->readPage(file, leafNum, leafPage, NORMAL, PAGE_INDEX_LEAF);
+    LeafNode <T> *leaf = (LeafNode <T> *) leafPage;
+
+    RIDKeyPair <T> entry;
+    while (sorter.nextEntry(entry)) {
+        if (leaf->numKeys == leafFill) {
+            PageId nextNum;
+            Page  *nextPage;
+            bufMgr->allocPage(file, nextNum, nextPage, NORMAL, PAGE_INDEX_LEAF);
+            initLeaf((LeafNode <T> *) nextPage);
+            leaf->rightSibPageNo = nextNum;
+            bufMgr->unPinPage(file, leafNum, true);
+
+            leafNum = nextNum;
+            leaf    = (LeafNode <T> *) nextPage;
+        }
+        if (leaf->numKeys == 0) {
+            level.push_back(SplitData <T>());
+            level.back().set(leafNum, entry.key);
+        }
+        leaf->keyArray[leaf->numKeys] = entry.key;
+        leaf->ridArray[leaf->numKeys] = entry.rid;
+        leaf->numKeys++;
+    }
+    bufMgr->unPinPage(file, leafNum, true);
+
+    buildNonLeafLevels(level, build);
+}
 
-        newRoot->keyArray[0]    = splitData->key;
-        newRoot->pageNoArray[0] = rootPageNum;
-        newRoot->pageNoArray[1] = splitData->newPageId;
+// -----------------------------------------------------------------------------
+// BTreeIndex::parallelLoad
+// -----------------------------------------------------------------------------
 
-        newRoot->level = rootIsLeaf ? 1 : 0;
+template <class T>
+void BTreeIndex::parallelLoad(const std::string& relationName, const BuildOptions& build) {
+    const int threads = build.threads;
 
-        rootIsLeaf  = false;
-        rootPageNum = newPageId;
+    // pages of the relation, from the page headers only
+    PageFile relation(relationName, false);
+    std::vector<PageId> pageNos;
+    for (FileIterator it = relation.begin(); it != relation.end(); ++it) {
+        pageNos.push_back(it.page_number());
+    }
 
-        Page *metaPage;
-        bufMgr->readPage(file, headerPageNum, metaPage);
+    // each thread sorts the entries of a share of the pages
+    std::vector<std::vector<RIDKeyPair <T> > > parts(threads);
+    runThreads(threads, [&](const int t) {
+        extractEntries(bufMgr, &relation, pageNos, pageNos.size() * t / threads,
+                       pageNos.size() * (t + 1) / threads, attrByteOffset, parts[t]);
+    });
+    bufMgr->flushFile(&relation);
+
+    // key ranges of about as many entries each, split at keys sampled evenly from every part
+    const size_t samplesPerPart = 16 * threads;
+    std::vector<RIDKeyPair <T> > samples;
+    for (int p = 0; p < threads; p++) {
+        for (size_t i = 0; i < samplesPerPart && i < parts[p].size(); i++) {
+            samples.push_back(parts[p][parts[p].size() * i / samplesPerPart]);
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+
+    std::vector<std::vector<size_t> > cuts(threads, std::vector<size_t>(threads + 1, 0));
+    for (int p = 0; p < threads; p++) {
+        cuts[p][threads] = parts[p].size();
+        for (int r = 1; r < threads && !samples.empty(); r++) {
+            cuts[p][r] = std::lower_bound(parts[p].begin(), parts[p].end(),
+                                          samples[samples.size() * r / threads]) - parts[p].begin();
+        }
+    }
+
+    // each thread merges a range from all parts
+    std::vector<std::vector<RIDKeyPair <T> > > ranges(threads);
+    runThreads(threads, [&](const int r) {
+        mergeSlices(parts, cuts, r, ranges[r]);
+    });
+    std::vector<std::vector<RIDKeyPair <T> > >().swap(parts);
+
+    // index of the first entry of each range among all of them
+    std::vector<size_t> rangeStart(1, 0);
+    for (int r = 0; r < threads; r++) {
+        rangeStart.push_back(rangeStart.back() + ranges[r].size());
+    }
+    const size_t entries = rangeStart.back();
+    if (entries == 0) {
+        return;
+    }
+
+    // the leaves get consecutive pages from the root leaf on, as bulkLoad() gives them
+    const size_t leafFill = std::max(1, (int) (build.fillFactor * LeafNode <T>::SIZE));
+    const size_t leaves = (entries + leafFill - 1) / leafFill;
+    std::vector<PageId> leafNos(1, rootPageNum);
+    for (size_t l = 1; l < leaves; l++) {
+        PageId leafNum;
+        Page  *leafPage;
+        bufMgr->allocPage(file, leafNum, leafPage, NORMAL, PAGE_INDEX_LEAF);
+        bufMgr->unPinPage(file, leafNum, true);
+        leafNos.push_back(leafNum);
+    }
+
+    // each thread fills a share of the leaves, which may take entries of more than one range
+    std::vector<SplitData <T> > level(leaves);
+    runThreads(threads, [&](const int t) {
+        const size_t firstLeaf = leaves * t / threads;
+        const size_t lastLeaf  = leaves * (t + 1) / threads;
+        if (firstLeaf == lastLeaf) {
+            return;
+        }
+
+        size_t r = std::upper_bound(rangeStart.begin(), rangeStart.end(), firstLeaf * leafFill)
+                   - rangeStart.begin() - 1;
+        size_t next = firstLeaf * leafFill - rangeStart[r];
+
+        for (size_t l = firstLeaf; l < lastLeaf; l++) {
+            Page *leafPage;
+            bufMgr->readPage(file, leafNos[l], leafPage, NORMAL, PAGE_INDEX_LEAF);
+            LeafNode <T> *leaf = (LeafNode <T> *) leafPage;
+
+            const int count = std::min(leafFill, entries - l * leafFill);
+            for (int i = 0; i < count; i++) {
+                while (next == ranges[r].size()) {
+                    r++;
+                    next = 0;
+                }
+                leaf->keyArray[i] = ranges[r][next].key;
+                leaf->ridArray[i] = ranges[r][next].rid;
+                next++;
+            }
+            leaf->numKeys        = count;
+            leaf->rightSibPageNo = l + 1 < leaves ? leafNos[l + 1] : 0;
+            level[l].set(leafNos[l], leaf->keyArray[0]);
+            bufMgr->unPinPage(file, leafNos[l], true);
+        }
+    });
+
+    buildNonLeafLevels(level, build);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildNonLeafLevels
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::buildNonLeafLevels(std::vector<SplitData <T> > &level, const BuildOptions& build) {
+    const int nodeFill = std::max(1, (int) (build.fillFactor * NonLeafNode <T>::SIZE));
+    int height = 0;
+
+    while (level.size() > 1) {
+        // as few nodes as the fill factor allows, with the children shared evenly
+        size_t nodes = (level.size() + nodeFill) / (nodeFill + 1);
+        std::vector<SplitData <T> > parents;
+        size_t first = 0;
+
+        for (size_t n = 0; n < nodes; n++) {
+            size_t children = (level.size() - first) / (nodes - n);
+
+            PageId nodeNum;
+            Page  *nodePage;
+            bufMgr->allocPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+            NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+
+            node->level          = height == 0 ? 1 : 0;
+            node->numKeys        = children - 1;
+            node->pageNoArray[0] = level[first].newPageId;
+            for (size_t c = 1; c < children; c++) {
+                node->keyArray[c - 1] = level[first + c].key;
+                node->pageNoArray[c]  = level[first + c].newPageId;
+            }
+            bufMgr->unPinPage(file, nodeNum, true);
+
+            parents.push_back(SplitData <T>());
+            parents.back().set(nodeNum, level[first].key);
+            first += children;
+        }
+
+        level.swap(parents);
+        height++;
+    }
+
+    if (level.empty() || height == 0) {
+        return;
+    }
+
+    setRoot(level[0].newPageId, height);
+
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    ((IndexMetaInfo *) metaPage)->rootPageNo = rootPageNum;
+    bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertKey
+// -----------------------------------------------------------------------------
+
+template <class T>
+const void BTreeIndex::insertKey(RIDKeyPair <T> *ridKeyPair) {
+    std::unique_lock<std::mutex> shadowGuard(writeLatch, std::defer_lock);
+    if (shadowPaging) {
+        shadowGuard.lock();
+    }
 
-        struct IndexMetaInfo *metaInfo = (struct IndexMetaInfo *) metaPage;
-        metaInfo->rootPageNo = rootPageNum;
+    std::vector<PageId> path;
+    PageId splitNum;
+    SplitData <T> *splitData = insertLeafEntry(findLeaf(ridKeyPair->key, path), ridKeyPair, splitNum);
 
+    // each split goes up to the parent of the node that split, path[0] being the root when descending
+    for (int height = 1; splitData; height++) {
+        PageId parentNum = height <= (int) path.size() ? path[path.size() - height] : 0;
+        SplitData <T> *parentSplit = insertNonLeafEntry(parentNum, height, splitNum, splitData);
         delete splitData;
+        splitData = parentSplit;
+    }
+}
 
-        bufMgr->unPinPage(file, headerPageNum, true);
-        bufMgr->unPinPage(file, rootPageNum, true);
+// -----------------------------------------------------------------------------
+// BTreeIndex::growRoot
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::growRoot(const PageId rootNum, const int height, SplitData <T> *splitData) {
+    Page * newRootPage;
+    PageId newPageId;
+
+    allocNode(newPageId, newRootPage, PAGE_INDEX_INTERIOR);
+    if (log) log->track(txn, file, newPageId, newRootPage, true);
+
+    NonLeafNode <T> *newRoot = (NonLeafNode <T> *) newRootPage;
+    newRoot->numKeys        = 1;
+    newRoot->keyArray[0]    = splitData->key;
+    newRoot->pageNoArray[0] = rootNum;
+    newRoot->pageNoArray[1] = splitData->newPageId;
+
+    newRoot->level = height == 0 ? 1 : 0;
+
+    // threads descending from the new root find it written
+    setRoot(newPageId, height + 1);
+
+    if (shadowPaging) {
+        // the meta page takes the new root when the version is committed
+        bufMgr->unPinPage(file, newPageId, true);
+        return;
     }
+
+    // only the thread holding the latch of the root grows it, so the meta page has one writer
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    if (log) log->track(txn, file, headerPageNum, metaPage);
+
+    struct IndexMetaInfo *metaInfo = (struct IndexMetaInfo *) metaPage;
+    metaInfo->rootPageNo = newPageId;
+
+    if (log) log->logChanges(txn, LOG_SPLIT);
+
+    bufMgr->unPinPage(file, headerPageNum, true);
+    bufMgr->unPinPage(file, newPageId, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setLog
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setLog(LogManager *logIn, const TxnId txnIn) {
+    if (logIn && shadowPaging) {
+        throw LogException(file->filename(), "a shadow-paged index is not logged");
+    }
+
+    log = logIn;
+    txn = txnIn;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::enableShadowPaging
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::enableShadowPaging() {
+    if (shadowPaging) {
+        return;
+    }
+
+    if (log) {
+        throw LogException(file->filename(), "a shadow-paged index is not logged");
+    }
+
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    IndexMetaInfo *metaInfo = (IndexMetaInfo *) metaPage;
+    metaInfo->shadowPaging = 1;
+    metaInfo->rootIsLeaf   = rootIsLeaf;
+    metaInfo->freeCount    = 0;
+    bufMgr->unPinPage(file, headerPageNum, true);
+
+    // the tree is on disk before any of its pages is replaced
+    bufMgr->flushFile(file);
+    fdatasync(file->descriptor());
+
+    shadowPaging  = true;
+    publishedRoot = (std::uint64_t) 1 << 33 | (std::uint64_t) rootIsLeaf << 32 | rootPageNum;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::commitVersion
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::commitVersion() {
+    std::lock_guard<std::mutex> guard(writeLatch);
+
+    if (!shadowPaging || pendingPages.empty()) {
+        return;
+    }
+
+    // the new nodes are on disk before the meta page points at them
+    bufMgr->writePages(file, std::vector<PageId>(pendingPages.begin(), pendingPages.end()));
+    fdatasync(file->descriptor());
+
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    IndexMetaInfo *metaInfo = (IndexMetaInfo *) metaPage;
+    metaInfo->rootPageNo = rootPageNum;
+    metaInfo->rootIsLeaf = rootIsLeaf;
+    bufMgr->unPinPage(file, headerPageNum, true);
+    bufMgr->writePages(file, std::vector<PageId>(1, headerPageNum));
+    fdatasync(file->descriptor());
+
+    std::uint64_t version = (publishedRoot >> 33) + 1;
+    publishedRoot = version << 33 | (std::uint64_t) rootIsLeaf << 32 | rootPageNum;
+
+    for (size_t i = 0; i < replacedPages.size(); i++) {
+        retiredPages.push_back(std::make_pair(version, replacedPages[i]));
+    }
+    replacedPages.clear();
+    pendingPages.clear();
+
+    reclaimPages();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::allocNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::allocNode(PageId &pageNo, Page *&page, const PageClass pageClass) {
+    std::unique_lock<std::mutex> guard(allocLatch);
+    if (freePages.empty() && !(shadowPaging && reclaimPages())) {
+        guard.unlock();
+        bufMgr->allocPage(file, pageNo, page, NORMAL, pageClass);
+    }
+    else {
+        pageNo = freePages.back();
+        freePages.pop_back();
+        guard.unlock();
+        bufMgr->readPage(file, pageNo, page, NORMAL, pageClass);
+    }
+
+    if (shadowPaging) {
+        pendingPages.insert(pageNo);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::freeNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::freeNode(const PageId pageNo) {
+    if (log) {
+        return;
+    }
+
+    // a shadow-paged tree only frees nodes of the version being written, which no scan reads
+    if (shadowPaging) {
+        pendingPages.erase(pageNo);
+    }
+    std::lock_guard<std::mutex> guard(allocLatch);
+    freePages.push_back(pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::shadowCopy
+// -----------------------------------------------------------------------------
+
+PageId BTreeIndex::shadowCopy(const PageId pageNo, const PageClass pageClass) {
+    if (pendingPages.count(pageNo)) {
+        return pageNo;
+    }
+
+    Page *page;
+    bufMgr->readPage(file, pageNo, page, NORMAL, pageClass);
+
+    Page * copyPage;
+    PageId copyNum;
+    allocNode(copyNum, copyPage, pageClass);
+    memcpy(copyPage, page, Page::SIZE);
+
+    bufMgr->unPinPage(file, pageNo, false);
+    bufMgr->unPinPage(file, copyNum, true);
+
+    replacedPages.push_back(pageNo);
+    return copyNum;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::reclaimPages
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::reclaimPages() {
+    // a scan announces its version before checking it is still the committed one, so a scan missed here
+    // reads a version that no longer sees the pages retired before it
+    std::uint64_t oldest = publishedRoot >> 33;
+    for (int i = 0; i < MAX_SHADOW_READERS; i++) {
+        std::uint64_t version = readerVersions[i];
+        if (version && version < oldest) {
+            oldest = version;
+        }
+    }
+
+    while (!retiredPages.empty() && retiredPages.front().first <= oldest) {
+        freePages.push_back(retiredPages.front().second);
+        retiredPages.pop_front();
+    }
+    return !freePages.empty();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::enterVersion
+// -----------------------------------------------------------------------------
+
+std::uint64_t BTreeIndex::enterVersion(int &slot) {
+    while (true) {
+        for (slot = 0; slot < MAX_SHADOW_READERS; slot++) {
+            std::uint64_t root = publishedRoot;
+            std::uint64_t free = 0;
+            if (!readerVersions[slot].compare_exchange_strong(free, root >> 33)) {
+                continue;
+            }
+
+            // a commit between loading the root and announcing its version may have missed the announcement
+            std::uint64_t now;
+            while ((now = publishedRoot) != root) {
+                root = now;
+                readerVersions[slot] = root >> 33;
+            }
+
+            return root;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leaveVersion
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::leaveVersion(int &slot) {
+    readerVersions[slot] = 0;
+    slot = -1;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setRoot
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setRoot(const PageId pageNo, const int height) {
+    rootPageNum = pageNo;
+    rootIsLeaf  = height == 0;
+    linkedRoot  = (std::uint64_t) height << 32 | pageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::treeHeight
+// -----------------------------------------------------------------------------
+
+template <class T>
+int BTreeIndex::treeHeight(const PageId pageNo, const bool isLeaf) {
+    int    height  = 0;
+    PageId nodeNum = pageNo;
+    bool   atLeaf  = isLeaf;
+
+    while (!atLeaf) {
+        Page *nodePage;
+        bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+        NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+        PageId childNum = node->pageNoArray[0];
+        atLeaf = node->level == 1;
+        bufMgr->unPinPage(file, nodeNum, false);
+
+        nodeNum = childNum;
+        height++;
+    }
+    return height;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nodeLatch, BTreeIndex::latchNode, BTreeIndex::unlatchNode
+// -----------------------------------------------------------------------------
+
+NodeLatch &BTreeIndex::nodeLatch(const int height, const PageId pageNo) {
+    return nodeLatches[std::min(height, LATCH_HEIGHTS - 1)][pageNo % LATCHES_PER_HEIGHT];
+}
+
+void BTreeIndex::latchNode(const int height, const PageId pageNo) {
+    if (!shadowPaging) {
+        nodeLatch(height, pageNo).lock();
+    }
+}
+
+void BTreeIndex::unlatchNode(const int height, const PageId pageNo) {
+    if (!shadowPaging) {
+        nodeLatch(height, pageNo).unlock();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readNode
+// -----------------------------------------------------------------------------
+
+template <class F>
+void BTreeIndex::readNode(const PageId pageNo, const int height, F read) {
+    NodeLatch    &latch = nodeLatch(height, pageNo);
+    std::uint64_t version;
+
+    PagePeek peek;
+    Page    *page = bufMgr->peekPage(file, pageNo, peek);
+    if (page) {
+        do {
+            version = latch.readBegin();
+            read(page);
+        } while (!latch.validate(version));
+
+        if (bufMgr->validatePeek(peek)) {
+            return;
+        }
+    }
+
+    // the node is not in the pool, or what was read of it may be of another page
+    bufMgr->readPage(file, pageNo, page, NORMAL, height > 0 ? PAGE_INDEX_INTERIOR : PAGE_INDEX_LEAF);
+    do {
+        version = latch.readBegin();
+        read(page);
+    } while (!latch.validate(version));
+    bufMgr->unPinPage(file, pageNo, false);
 }
 
 // -----------------------------------------------------------------------------
 // BTreeIndex::getLastFullIndex
 // -----------------------------------------------------------------------------
 
+template <class T>
 const int BTreeIndex::getLastFullIndex(Page *node, bool isLeaf) {
     if (isLeaf) {
-        LeafNodeInt *leafNode = (LeafNodeInt *) node;
-
-        int idx;
-        for (idx = 0; idx < leafOccupancy && (leafNode->ridArray[idx]).page_number != 0; idx++);
-        return idx - 1;
+        return ((LeafNode <T> *) node)->numKeys - 1;
     }
     else {
-        NonLeafNodeInt *nonLeafNode = (NonLeafNodeInt *) node;
+        return ((NonLeafNode <T> *) node)->numKeys;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::initLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::initLeaf(LeafNode <T> *leafNode) {
+    leafNode->numKeys        = 0;
+    leafNode->rightSibPageNo = 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::upgradeFormat
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::upgradeFormat() {
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    IndexMetaInfo *metaInfo = (IndexMetaInfo *) metaPage;
+    PageId root   = metaInfo->rootPageNo;
+    bool   isLeaf = metaInfo->shadowPaging ? metaInfo->rootIsLeaf : root == 2;
+    bufMgr->unPinPage(file, headerPageNum, false);
+
+    switch (attributeType) {
+    case INTEGER:
+        countNodeKeys <int>(root, isLeaf);
+        break;
+    case DOUBLE:
+        countNodeKeys <double>(root, isLeaf);
+        break;
+    case STRING:
+        countNodeKeys <StringKey>(root, isLeaf);
+        break;
+    }
+
+    // the counts are on disk before the version saying they are there
+    bufMgr->flushFile(file);
+    fdatasync(file->descriptor());
+
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    metaInfo = (IndexMetaInfo *) metaPage;
+
+    // the free list of version 1 began where formatVersion is
+    metaInfo->freeCount = std::min(metaInfo->freeCount, METAFREEPAGES);
+    memmove(metaInfo->freePages, &metaInfo->formatVersion, metaInfo->freeCount * sizeof(PageId));
+    metaInfo->formatVersion = INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION;
+
+    bufMgr->unPinPage(file, headerPageNum, true);
+    bufMgr->writePages(file, std::vector<PageId>(1, headerPageNum));
+    fdatasync(file->descriptor());
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countNodeKeys
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::countNodeKeys(const PageId pageNo, const bool isLeaf) {
+    Page *page;
+    int   idx;
+
+    if (isLeaf) {
+        bufMgr->readPage(file, pageNo, page, NORMAL, PAGE_INDEX_LEAF);
+        LeafNode <T> *leafNode = (LeafNode <T> *) page;
+
+        for (idx = 0; idx < LeafNode <T>::SIZE && (leafNode->ridArray[idx]).page_number != 0; idx++);
+        leafNode->numKeys = idx;
+
+        bufMgr->unPinPage(file, pageNo, true);
+        return;
+    }
+
+    bufMgr->readPage(file, pageNo, page, NORMAL, PAGE_INDEX_INTERIOR);
+    NonLeafNode <T> *node = (NonLeafNode <T> *) page;
+
+    for (idx = 0; idx <= NonLeafNode <T>::SIZE && node->pageNoArray[idx] != 0; idx++);
+    node->numKeys = idx - 1;
+
+    // the level of version 1 was an int, whose lower half is level and upper half numKeys
+    std::vector<PageId> children(node->pageNoArray, node->pageNoArray + idx);
+    bool childrenAreLeaves = node->level;
+    bufMgr->unPinPage(file, pageNo, true);
+
+    for (size_t i = 0; i < children.size(); i++) {
+        countNodeKeys <T>(children[i], childrenAreLeaves);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+PageId BTreeIndex::findLeaf(const T &key, std::vector<PageId> &path) {
+    std::uint64_t root    = linkedRoot;
+    PageId        nodeNum = (PageId) root;
+    int           height  = root >> 32;
+
+    if (shadowPaging) {
+        nodeNum = shadowCopy(nodeNum, height == 0 ? PAGE_INDEX_LEAF : PAGE_INDEX_INTERIOR);
+        setRoot(nodeNum, height);
+    }
+
+    for (; height > 0; height--) {
+        PageId childNum;
+        if (shadowPaging) {
+            // the node is pointed at the copy of its child, which only the writer descending reads
+            Page *nodePage;
+            bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+            NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+
+            int idx = KeySearch::upperBound(node->keyArray, node->numKeys, key, searchStrategy);
+            childNum = node->pageNoArray[idx];
+
+            PageId copyNum = shadowCopy(childNum, height == 1 ? PAGE_INDEX_LEAF : PAGE_INDEX_INTERIOR);
+            bool   copied  = copyNum != childNum;
+            node->pageNoArray[idx] = childNum = copyNum;
+            bufMgr->unPinPage(file, nodeNum, copied);
+        }
+        else {
+            readNode(nodeNum, height, [&](Page *nodePage) {
+                NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+                childNum = node->pageNoArray[KeySearch::upperBound(node->keyArray,
+                                                                   keysRead(node->numKeys, NonLeafNode <T>::SIZE),
+                                                                   key, searchStrategy)];
+            });
+        }
+
+        path.push_back(nodeNum);
+        nodeNum = childNum;
+    }
+    return nodeNum;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::latchLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+PageId BTreeIndex::latchLeaf(PageId leafNum, const T &key, Page *&leafPage) {
+    while (true) {
+        bufMgr->readPage(file, leafNum, leafPage, NORMAL, PAGE_INDEX_LEAF);
+        latchNode(0, leafNum);
+        LeafNode <T> *leaf = (LeafNode <T> *) leafPage;
+
+        // keys before the last one of the leaf are in it; sibling links of a shadow-paged tree are stale,
+        // but its descents are never raced
+        const PageId rightNum = leaf->rightSibPageNo;
+        if (shadowPaging || !rightNum || (leaf->numKeys > 0 && key < leaf->keyArray[leaf->numKeys - 1])) {
+            return leafNum;
+        }
+        unlatchNode(0, leafNum);
+
+        bool moveRight = movesRight(rightNum, key);
+        if (!moveRight) {
+            // the key is in the leaf, unless it split while unlatched
+            latchNode(0, leafNum);
+            if (leaf->rightSibPageNo == rightNum) {
+                return leafNum;
+            }
+            unlatchNode(0, leafNum);
+        }
 
-        int idx;
-        for (idx = 0; idx <= nodeOccupancy && nonLeafNode->pageNoArray[idx] != 0; idx++);
-        return idx - 1;
+        bufMgr->unPinPage(file, leafNum, false);
+        if (moveRight) {
+            leafNum = rightNum;
+        }
     }
 }
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::movesRight
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::movesRight(const PageId rightNum, const T &key) {
+    bool moveRight;
+    readNode(rightNum, 0, [&](Page *rightPage) {
+        LeafNode <T> *right = (LeafNode <T> *) rightPage;
+        moveRight = right->numKeys > 0 && right->keyArray[0] <= key;
+    });
+    return moveRight;
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::insertLeafEntry
 // -----------------------------------------------------------------------------
 
-SplitData <int> *BTreeIndex::insertLeafEntry(PageId leafNum, RIDKeyPair <int> *ridKeyPair) {
+template <class T>
+SplitData <T> *BTreeIndex::insertLeafEntry(PageId leafNum, RIDKeyPair <T> *ridKeyPair, PageId &splitNum) {
     Page *leafPage;
 
-    bufMgr->readPage(file, leafNum, leafPage);
-    struct LeafNodeInt *leafNode = (struct LeafNodeInt *) leafPage;
+    leafNum = latchLeaf(leafNum, ridKeyPair->key, leafPage);
+    if (log) log->track(txn, file, leafNum, leafPage);
+    LeafNode <T> *leafNode = (LeafNode <T> *) leafPage;
 
-    int lastFullIndex = getLastFullIndex(leafPage, true);
+    int lastFullIndex = getLastFullIndex <T>(leafPage, true);
 
-    if (lastFullIndex >= leafOccupancy - 1) {
-        SplitData <int> *splitData = splitLeafNode(leafNode, ridKeyPair);
+    if (lastFullIndex >= LeafNode <T>::SIZE - 1) {
+        SplitData <T> *splitData = splitLeafNode(leafNode, ridKeyPair);
         bufMgr->unPinPage(file, leafNum, true);
+        splitNum = leafNum;
         return splitData;
     }
 
 
-    insertToLeaf(leafNode, ridKeyPair, getLastFullIndex(leafPage, true));
+    insertToLeaf(leafNode, ridKeyPair, lastFullIndex);
+    if (log) log->logChanges(txn, LOG_INSERT);
+    unlatchNode(0, leafNum);
     bufMgr->unPinPage(file, leafNum, true);
     return NULL;
 }
@@ -225,60 +1389,61 @@ SplitData <int> *BTreeIndex::insertLeafEntry(PageId leafNum, RIDKeyPair <int> *r
 // BTreeIndex::splitLeafNode
 // -----------------------------------------------------------------------------
 
-SplitData <int> *BTreeIndex::splitLeafNode(LeafNodeInt *leafNode, RIDKeyPair <int> *ridKeyPair) {
+template <class T>
+SplitData <T> *BTreeIndex::splitLeafNode(LeafNode <T> *leafNode, RIDKeyPair <T> *ridKeyPair) {
     Page * newLeafPage;
     PageId newLeafId;
 
-    bufMgr->allocPage(file, newLeafId, newLeafPage);
-    struct LeafNodeInt *newLeaf = (struct LeafNodeInt *) newLeafPage;
-    for (int i = 0; i < leafOccupancy; i++) {
-        newLeaf->ridArray[i].page_number = 0;
-    }
+    allocNode(newLeafId, newLeafPage, PAGE_INDEX_LEAF);
+    if (log) log->track(txn, file, newLeafId, newLeafPage, true);
+    LeafNode <T> *newLeaf = (LeafNode <T> *) newLeafPage;
+    initLeaf(newLeaf);
     newLeaf->rightSibPageNo  = leafNode->rightSibPageNo;
     leafNode->rightSibPageNo = newLeafId;
 
-    int key  = ridKeyPair->key;
-    int pIdx = 0;
-
-    for (pIdx = 0; pIdx < leafOccupancy && key >= leafNode->keyArray[pIdx]; pIdx++);
+    const int leafOccupancy = LeafNode <T>::SIZE;
+    const T &key = ridKeyPair->key;
+    int pIdx     = KeySearch::upperBound(leafNode->keyArray, leafOccupancy, key, searchStrategy);
 
     int mid = (leafOccupancy + 1) / 2;
 
     if (pIdx < mid) {
-        int midKey = leafNode->keyArray[mid - 1];
+        T midKey = leafNode->keyArray[mid - 1];
 
         int lIdx = 0;
         for (int i = mid - 1; i < leafOccupancy; i++, lIdx++) {
-            newLeaf->keyArray[lIdx]             = leafNode->keyArray[i];
-            newLeaf->ridArray[lIdx].page_number = leafNode->ridArray[i].page_number;
-            newLeaf->ridArray[lIdx].slot_number = leafNode->ridArray[i].slot_number;
-            leafNode->ridArray[i].page_number   = 0;
+            newLeaf->keyArray[lIdx] = leafNode->keyArray[i];
+            newLeaf->ridArray[lIdx] = leafNode->ridArray[i];
         }
+        newLeaf->numKeys  = lIdx;
+        leafNode->numKeys = mid - 1;
 
         insertToLeaf(leafNode, ridKeyPair, mid - 2);
 
-        SplitData <int> *splitData = new SplitData <int> ();
+        SplitData <T> *splitData = new SplitData <T> ();
         splitData->set(newLeafId, midKey);
 
+        if (log) log->logChanges(txn, LOG_SPLIT);
         bufMgr->unPinPage(file, newLeafId, true);
         return splitData;
     }
     else {
         int lIdx = 0;
         for (int i = mid; i < leafOccupancy; i++, lIdx++) {
-            newLeaf->keyArray[lIdx]             = leafNode->keyArray[i];
-            newLeaf->ridArray[lIdx].page_number = leafNode->ridArray[i].page_number;
-            newLeaf->ridArray[lIdx].slot_number = leafNode->ridArray[i].slot_number;
-            leafNode->ridArray[i].page_number   = 0;
+            newLeaf->keyArray[lIdx] = leafNode->keyArray[i];
+            newLeaf->ridArray[lIdx] = leafNode->ridArray[i];
         }
+        newLeaf->numKeys  = lIdx;
+        leafNode->numKeys = mid;
 
         insertToLeaf(newLeaf, ridKeyPair, lIdx - 1);
 
-        int midKey = newLeaf->keyArray[0];
+        T midKey = newLeaf->keyArray[0];
 
-        SplitData <int> *splitData = new SplitData <int> ();
+        SplitData <T> *splitData = new SplitData <T> ();
         splitData->set(newLeafId, midKey);
 
+        if (log) log->logChanges(txn, LOG_SPLIT);
         bufMgr->unPinPage(file, newLeafId, true);
         return splitData;
     }
@@ -288,11 +1453,10 @@ SplitData <int> *BTreeIndex::splitLeafNode(LeafNodeInt *leafNode, RIDKeyPair <in
 // BTreeIndex::insertToLeaf
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::insertToLeaf(LeafNodeInt *leafNode, RIDKeyPair <int> *ridKeyPair, int lastFullIndex) {
-    int key = ridKeyPair->key;
-    int idx = 0;
-
-    for (idx = 0; idx <= lastFullIndex && key >= leafNode->keyArray[idx]; idx++);
+template <class T>
+const void BTreeIndex::insertToLeaf(LeafNode <T> *leafNode, RIDKeyPair <T> *ridKeyPair, int lastFullIndex) {
+    const T &key = ridKeyPair->key;
+    int idx      = KeySearch::upperBound(leafNode->keyArray, lastFullIndex + 1, key, searchStrategy);
 
     for (int i = lastFullIndex; i >= idx; i--) {
         leafNode->keyArray[i + 1] = leafNode->keyArray[i];
@@ -301,135 +1465,211 @@ const void BTreeIndex::insertToLeaf(LeafNodeInt *leafNode, RIDKeyPair <int> *rid
 
     leafNode->keyArray[idx] = key;
     leafNode->ridArray[idx] = ridKeyPair->rid;
+    leafNode->numKeys       = lastFullIndex + 2;
 }
 
 // -----------------------------------------------------------------------------
 // BTreeIndex::insertNonLeafEntry
 // -----------------------------------------------------------------------------
 
-SplitData <int> *BTreeIndex::insertNonLeafEntry(PageId nodeNum, RIDKeyPair <int> *ridKeyPair) {
+template <class T>
+SplitData <T> *BTreeIndex::insertNonLeafEntry(PageId nodeNum, const int height, PageId &childNum,
+                                              SplitData <T> *splitData) {
     Page *nodePage;
+    NonLeafNode <T> *node;
+    int childIdx = -1;
+
+    if (nodeNum) {
+        bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+        latchNode(height, nodeNum);
+        node = (NonLeafNode <T> *) nodePage;
+        childIdx = std::find(node->pageNoArray, node->pageNoArray + node->numKeys + 1, childNum) - node->pageNoArray;
+        if (childIdx > node->numKeys) {
+            childIdx = -1;
+            unlatchNode(height, nodeNum);
+            bufMgr->unPinPage(file, nodeNum, false);
+        }
+    }
 
-    bufMgr->readPage(file, nodeNum, nodePage);
-    struct NonLeafNodeInt *node = (struct NonLeafNodeInt *) nodePage;
-
-    int key           = ridKeyPair->key;
-    int idx           = 0;
-    int lastFullIndex = getLastFullIndex(nodePage, false);
+    if (childIdx < 0) {
+        // the parent descended through split since, or the node was the root
+        nodeNum = findParent(height, childNum, splitData->key);
+        if (!nodeNum) {
+            growRoot(childNum, height - 1, splitData);
+            unlatchNode(height - 1, childNum);
+            return NULL;
+        }
+        bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+        node = (NonLeafNode <T> *) nodePage;
+        childIdx = std::find(node->pageNoArray, node->pageNoArray + node->numKeys + 1, childNum) - node->pageNoArray;
+    }
 
-    for (idx = 0; idx < lastFullIndex && key >= node->keyArray[idx]; idx++);
-    PageId nextPage = node->pageNoArray[idx];
-    int    level    = node->level;
+    if (log) log->track(txn, file, nodeNum, nodePage);
+    int lastFullIndex = getLastFullIndex <T>(nodePage, false);
+    SplitData <T> *data;
 
-    bufMgr->unPinPage(file, nodeNum, false);
+    if (lastFullIndex >= NonLeafNode <T>::SIZE) {
+        data = splitNonLeafNode(node, splitData, childIdx);
+    }
+    else {
+        insertToNonLeaf(node, splitData, lastFullIndex, childIdx);
+        if (log) log->logChanges(txn, LOG_SPLIT);
+        data = NULL;
+    }
 
-    SplitData <int> *splitData;
+    bufMgr->unPinPage(file, nodeNum, true);
+    unlatchNode(height - 1, childNum);
 
-    if (level) {
-        splitData = insertLeafEntry(nextPage, ridKeyPair);
+    if (data) {
+        childNum = nodeNum;
     }
     else {
-        splitData = insertNonLeafEntry(nextPage, ridKeyPair);
+        unlatchNode(height, nodeNum);
     }
+    return data;
+}
 
-    if (splitData) {
-        bufMgr->readPage(file, nodeNum, nodePage);
-        node = (struct NonLeafNodeInt *) nodePage;
-        SplitData <int> *data;
+// -----------------------------------------------------------------------------
+// BTreeIndex::findParent
+// -----------------------------------------------------------------------------
 
-        if (lastFullIndex >= nodeOccupancy) {
-            data = splitNonLeafNode(node, splitData);
+template <class T>
+PageId BTreeIndex::findParent(const int height, const PageId childNum, const T &key) {
+    while (true) {
+        // the root only grows above the node while its latch, held by the caller, is released
+        std::uint64_t root       = linkedRoot;
+        int           rootHeight = root >> 32;
+        if (rootHeight < height) {
+            return 0;
         }
-        else {
-            insertToNonLeaf(node, splitData, lastFullIndex);
-            data = NULL;
+
+        PageId nodeNum = searchParent((PageId) root, rootHeight, height, childNum, key);
+        if (nodeNum) {
+            Page *nodePage;
+            bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+            latchNode(height, nodeNum);
+            NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+            bool found = std::count(node->pageNoArray, node->pageNoArray + node->numKeys + 1, childNum) > 0;
+            bufMgr->unPinPage(file, nodeNum, false);
+            if (found) {
+                return nodeNum;
+            }
+            unlatchNode(height, nodeNum);
         }
 
-        bufMgr->unPinPage(file, nodeNum, true);
-        delete splitData;
+        // a split above, not posted yet, hides the parent for now
+        std::this_thread::yield();
+    }
+}
 
-        return data;
+// -----------------------------------------------------------------------------
+// BTreeIndex::searchParent
+// -----------------------------------------------------------------------------
+
+template <class T>
+PageId BTreeIndex::searchParent(const PageId nodeNum, const int nodeHeight, const int height,
+                                const PageId childNum, const T &key) {
+    std::vector<PageId> children;
+    bool                found;
+    readNode(nodeNum, nodeHeight, [&](Page *nodePage) {
+        NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+
+        // the children between keys equal to the key may all hold it
+        int numKeys = keysRead(node->numKeys, NonLeafNode <T>::SIZE);
+        int first   = KeySearch::lowerBound(node->keyArray, numKeys, key, searchStrategy);
+        int last    = std::max(first - 1, KeySearch::upperBound(node->keyArray, numKeys, key, searchStrategy));
+        children.assign(node->pageNoArray + first, node->pageNoArray + last + 1);
+        found = nodeHeight == height && std::count(node->pageNoArray, node->pageNoArray + numKeys + 1, childNum) > 0;
+    });
+
+    if (nodeHeight == height) {
+        return found ? nodeNum : 0;
     }
 
-    return NULL;
+    for (size_t c = 0; c < children.size(); c++) {
+        PageId parentNum = searchParent(children[c], nodeHeight - 1, height, childNum, key);
+        if (parentNum) {
+            return parentNum;
+        }
+    }
+    return 0;
 }
 
 // -----------------------------------------------------------------------------
 // BTreeIndex::splitNonLeafNode
 // -----------------------------------------------------------------------------
 
-SplitData <int> *BTreeIndex::splitNonLeafNode(NonLeafNodeInt *node, SplitData <int> *splitData) {
+template <class T>
+SplitData <T> *BTreeIndex::splitNonLeafNode(NonLeafNode <T> *node, SplitData <T> *splitData, const int idx) {
     Page * newNodePage;
     PageId newPageId;
 
-    bufMgr->allocPage(file, newPageId, newNodePage);
-    struct NonLeafNodeInt *newNode = (struct NonLeafNodeInt *) newNodePage;
-    for (int i = 0; i <= nodeOccupancy; i++) {
-        newNode->pageNoArray[i] = 0;
-    }
+    allocNode(newPageId, newNodePage, PAGE_INDEX_INTERIOR);
+    if (log) log->track(txn, file, newPageId, newNodePage, true);
+    NonLeafNode <T> *newNode = (NonLeafNode <T> *) newNodePage;
+    const int nodeOccupancy  = NonLeafNode <T>::SIZE;
     newNode->level = node->level;
 
-    int key = splitData->key;
-    int idx = 0;
-
-    for (idx = 0; idx < nodeOccupancy && key >= node->keyArray[idx]; idx++);
-
     int mid = (nodeOccupancy + 1) / 2;
 
     if (idx < mid) {
-        int midKey = node->keyArray[mid - 1];
+        T midKey = node->keyArray[mid - 1];
         newNode->pageNoArray[0] = node->pageNoArray[mid];
-        node->pageNoArray[mid]  = 0;
 
         int nIdx = 0;
         for (int i = mid; i < nodeOccupancy; i++, nIdx++) {
             newNode->keyArray[nIdx]        = node->keyArray[i];
             newNode->pageNoArray[nIdx + 1] = node->pageNoArray[i + 1];
-            node->pageNoArray[i + 1]       = 0;
         }
+        newNode->numKeys = nIdx;
+        node->numKeys    = mid - 1;
 
-        insertToNonLeaf(node, splitData, mid - 1);
+        insertToNonLeaf(node, splitData, mid - 1, idx);
 
-        SplitData <int> *data = new SplitData <int> ();
+        SplitData <T> *data = new SplitData <T> ();
         data->set(newPageId, midKey);
 
+        if (log) log->logChanges(txn, LOG_SPLIT);
         bufMgr->unPinPage(file, newPageId, true);
         return data;
     }
     else if (idx == mid) {
-        int midKey = splitData->key;
+        T midKey = splitData->key;
         newNode->pageNoArray[0] = splitData->newPageId;
 
         int nIdx = 0;
         for (int i = mid; i < nodeOccupancy; i++, nIdx++) {
             newNode->keyArray[nIdx]        = node->keyArray[i];
             newNode->pageNoArray[nIdx + 1] = node->pageNoArray[i + 1];
-            node->pageNoArray[i + 1]       = 0;
         }
+        newNode->numKeys = nIdx;
+        node->numKeys    = mid;
 
-        SplitData <int> *data = new SplitData <int> ();
+        SplitData <T> *data = new SplitData <T> ();
         data->set(newPageId, midKey);
 
+        if (log) log->logChanges(txn, LOG_SPLIT);
         bufMgr->unPinPage(file, newPageId, true);
         return data;
     }
     else {
-        int midKey = node->keyArray[mid];
-        newNode->pageNoArray[0]    = node->pageNoArray[mid + 1];
-        node->pageNoArray[mid + 1] = 0;
+        T midKey = node->keyArray[mid];
+        newNode->pageNoArray[0] = node->pageNoArray[mid + 1];
 
         int nIdx = 0;
         for (int i = mid + 1; i < nodeOccupancy; i++, nIdx++) {
             newNode->keyArray[nIdx]        = node->keyArray[i];
             newNode->pageNoArray[nIdx + 1] = node->pageNoArray[i + 1];
-            node->pageNoArray[i + 1]       = 0;
         }
+        newNode->numKeys = nIdx;
+        node->numKeys    = mid;
 
-        insertToNonLeaf(newNode, splitData, nIdx);
+        insertToNonLeaf(newNode, splitData, nIdx, idx - mid - 1);
 
-        SplitData <int> *data = new SplitData <int> ();
+        SplitData <T> *data = new SplitData <T> ();
         data->set(newPageId, midKey);
 
+        if (log) log->logChanges(txn, LOG_SPLIT);
         bufMgr->unPinPage(file, newPageId, true);
         return data;
     }
@@ -439,19 +1679,278 @@ SplitData <int> *BTreeIndex::splitNonLeafNode(NonLeafNodeInt *node, SplitData <i
 // BTreeIndex::insertToNonLeaf
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::insertToNonLeaf(NonLeafNodeInt *node, SplitData <int> *splitData, int lastFullIndex) {
-    int idx = 0;
-    int key = splitData->key;
-
-    for (idx = 0; idx < lastFullIndex && key >= node->keyArray[idx]; idx++);
-
+template <class T>
+const void BTreeIndex::insertToNonLeaf(NonLeafNode <T> *node, SplitData <T> *splitData, int lastFullIndex,
+                                        const int idx) {
     for (int i = lastFullIndex - 1; i >= idx; i--) {
         node->keyArray[i + 1]    = node->keyArray[i];
         node->pageNoArray[i + 2] = node->pageNoArray[i + 1];
     }
 
-    node->keyArray[idx]        = key;
+    node->keyArray[idx]        = splitData->key;
     node->pageNoArray[idx + 1] = splitData->newPageId;
+    node->numKeys              = lastFullIndex + 1;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteKey
+// -----------------------------------------------------------------------------
+
+template <class T>
+const void BTreeIndex::deleteKey(const RIDKeyPair <T> &ridKeyPair) {
+    std::unique_lock<std::mutex> shadowGuard(writeLatch, std::defer_lock);
+    if (shadowPaging) {
+        shadowGuard.lock();
+    }
+
+    std::vector<std::pair<PageId, int> > path;
+    PageId leafNum;
+    int    entryIdx;
+    if (!findEntry(rootPageNum, rootIsLeaf, ridKeyPair, path, leafNum, entryIdx)) {
+        throw NoSuchKeyFoundException();
+    }
+
+    if (shadowPaging) {
+        // copy the path down to the leaf, each node pointing at the copy of the next one
+        PageId nodeNum = shadowCopy(rootPageNum, rootIsLeaf ? PAGE_INDEX_LEAF : PAGE_INDEX_INTERIOR);
+        setRoot(nodeNum, path.size());
+        for (size_t i = 0; i < path.size(); i++) {
+            path[i].first = nodeNum;
+
+            Page *nodePage;
+            bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+            NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+            PageId childNum = node->pageNoArray[path[i].second];
+            nodeNum = shadowCopy(childNum, i + 1 == path.size() ? PAGE_INDEX_LEAF : PAGE_INDEX_INTERIOR);
+            node->pageNoArray[path[i].second] = nodeNum;
+            bufMgr->unPinPage(file, path[i].first, nodeNum != childNum);
+        }
+        leafNum = nodeNum;
+    }
+
+    Page *leafPage;
+    bufMgr->readPage(file, leafNum, leafPage, NORMAL, PAGE_INDEX_LEAF);
+    if (log) log->track(txn, file, leafNum, leafPage);
+    LeafNode <T> *leaf = (LeafNode <T> *) leafPage;
+
+    leaf->numKeys--;
+    for (int i = entryIdx; i < leaf->numKeys; i++) {
+        leaf->keyArray[i] = leaf->keyArray[i + 1];
+        leaf->ridArray[i] = leaf->ridArray[i + 1];
+    }
+    bool underflow = leaf->numKeys < LeafNode <T>::SIZE / 2;
+
+    // the separator of a leaf stays its first key, which concurrent inserts take as the high key of the
+    // leaf on its left
+    int sepIdx = (int) path.size() - 1;
+    while (sepIdx >= 0 && path[sepIdx].second == 0) {
+        sepIdx--;
+    }
+    bool newFirst = entryIdx == 0 && leaf->numKeys > 0 && sepIdx >= 0;
+    if (newFirst) {
+        Page *nodePage;
+        bufMgr->readPage(file, path[sepIdx].first, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+        if (log) log->track(txn, file, path[sepIdx].first, nodePage);
+        ((NonLeafNode <T> *) nodePage)->keyArray[path[sepIdx].second - 1] = leaf->keyArray[0];
+    }
+
+    if (log) log->logChanges(txn, LOG_DELETE);
+    bufMgr->unPinPage(file, leafNum, true);
+    if (newFirst) {
+        bufMgr->unPinPage(file, path[sepIdx].first, true);
+    }
+
+    // each merge takes a key from the parent, which may leave it less than half full in turn
+    bool   childIsLeaf = true;
+    PageId newRootNum  = 0;
+    for (int i = (int) path.size() - 1; i >= 0 && underflow; i--) {
+        if (!rebalanceChild <T>(path[i].first, path[i].second, childIsLeaf)) {
+            break;
+        }
+        childIsLeaf = false;
+
+        Page *nodePage;
+        bufMgr->readPage(file, path[i].first, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+        NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+        underflow = node->numKeys < NonLeafNode <T>::SIZE / 2;
+        if (i == 0 && node->numKeys == 0) {
+            newRootNum = node->pageNoArray[0];
+        }
+        bufMgr->unPinPage(file, path[i].first, false);
+    }
+
+    if (!newRootNum) {
+        return;
+    }
+
+    // the root is left with a single child; when that is a leaf it is the leftmost one, page 2
+    freeNode(rootPageNum);
+    setRoot(newRootNum, path.size() - 1);
+
+    if (shadowPaging) {
+        // the meta page takes the new root when the version is committed
+        return;
+    }
+
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage, NORMAL, PAGE_INDEX_INTERIOR);
+    if (log) log->track(txn, file, headerPageNum, metaPage);
+    ((IndexMetaInfo *) metaPage)->rootPageNo = rootPageNum;
+    if (log) log->logChanges(txn, LOG_PAGE);
+    bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findEntry
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::findEntry(const PageId nodeNum, const bool isLeaf, const RIDKeyPair <T> &ridKeyPair,
+                           std::vector<std::pair<PageId, int> > &path, PageId &leafNum, int &entryIdx) {
+    const T &key = ridKeyPair.key;
+    Page    *nodePage;
+
+    if (isLeaf) {
+        bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_LEAF);
+        LeafNode <T> *leaf = (LeafNode <T> *) nodePage;
+
+        int idx = KeySearch::lowerBound(leaf->keyArray, leaf->numKeys, key, searchStrategy);
+        while (idx < leaf->numKeys && leaf->keyArray[idx] == key && leaf->ridArray[idx] != ridKeyPair.rid) {
+            idx++;
+        }
+        bool found = idx < leaf->numKeys && leaf->keyArray[idx] == key;
+        bufMgr->unPinPage(file, nodeNum, false);
+
+        if (found) {
+            leafNum  = nodeNum;
+            entryIdx = idx;
+        }
+        return found;
+    }
+
+    bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+    NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+
+    // the children between keys equal to the key may all hold it
+    int  first       = KeySearch::lowerBound(node->keyArray, (int) node->numKeys, key, searchStrategy);
+    int  last        = KeySearch::upperBound(node->keyArray, (int) node->numKeys, key, searchStrategy);
+    bool childIsLeaf = node->level == 1;
+    std::vector<PageId> children(node->pageNoArray + first, node->pageNoArray + last + 1);
+    bufMgr->unPinPage(file, nodeNum, false);
+
+    path.push_back(std::make_pair(nodeNum, 0));
+    for (int c = first; c <= last; c++) {
+        path.back().second = c;
+        if (findEntry(children[c - first], childIsLeaf, ridKeyPair, path, leafNum, entryIdx)) {
+            return true;
+        }
+    }
+    path.pop_back();
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalanceChild
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::rebalanceChild(const PageId parentNum, const int childIdx, const bool childIsLeaf) {
+    const PageClass pageClass = childIsLeaf ? PAGE_INDEX_LEAF : PAGE_INDEX_INTERIOR;
+
+    Page *parentPage;
+    bufMgr->readPage(file, parentNum, parentPage, NORMAL, PAGE_INDEX_INTERIOR);
+    if (log) log->track(txn, file, parentNum, parentPage);
+    NonLeafNode <T> *parent = (NonLeafNode <T> *) parentPage;
+
+    // the child and its right neighbour, or its left neighbour if it is the last child
+    const int leftIdx = childIdx < parent->numKeys ? childIdx : childIdx - 1;
+    if (shadowPaging) {
+        // the child is a copy already
+        const int siblingIdx = leftIdx == childIdx ? childIdx + 1 : leftIdx;
+        parent->pageNoArray[siblingIdx] = shadowCopy(parent->pageNoArray[siblingIdx], pageClass);
+    }
+
+    const PageId leftNum  = parent->pageNoArray[leftIdx];
+    const PageId rightNum = parent->pageNoArray[leftIdx + 1];
+    Page *leftPage;
+    Page *rightPage;
+    bufMgr->readPage(file, leftNum, leftPage, NORMAL, pageClass);
+    bufMgr->readPage(file, rightNum, rightPage, NORMAL, pageClass);
+    if (log) log->track(txn, file, leftNum, leftPage);
+    if (log) log->track(txn, file, rightNum, rightPage);
+
+    bool merged;
+
+    if (childIsLeaf) {
+        LeafNode <T> *left  = (LeafNode <T> *) leftPage;
+        LeafNode <T> *right = (LeafNode <T> *) rightPage;
+
+        std::vector<T>        keys(left->keyArray, left->keyArray + left->numKeys);
+        std::vector<RecordId> rids(left->ridArray, left->ridArray + left->numKeys);
+        keys.insert(keys.end(), right->keyArray, right->keyArray + right->numKeys);
+        rids.insert(rids.end(), right->ridArray, right->ridArray + right->numKeys);
+
+        // merged unless sharing the entries evenly leaves both at least half full
+        const int total = keys.size();
+        merged = total < LeafNode <T>::SIZE / 2 * 2;
+        const int leftCount = merged ? total : total / 2;
+
+        std::copy(keys.begin(), keys.begin() + leftCount, left->keyArray);
+        std::copy(rids.begin(), rids.begin() + leftCount, left->ridArray);
+        left->numKeys = leftCount;
+        if (merged) {
+            left->rightSibPageNo = right->rightSibPageNo;
+        }
+        else {
+            std::copy(keys.begin() + leftCount, keys.end(), right->keyArray);
+            std::copy(rids.begin() + leftCount, rids.end(), right->ridArray);
+            right->numKeys = total - leftCount;
+            parent->keyArray[leftIdx] = right->keyArray[0];
+        }
+    }
+    else {
+        NonLeafNode <T> *left  = (NonLeafNode <T> *) leftPage;
+        NonLeafNode <T> *right = (NonLeafNode <T> *) rightPage;
+
+        // the separator comes down between the keys of the two
+        std::vector<T>      keys(left->keyArray, left->keyArray + left->numKeys);
+        std::vector<PageId> children(left->pageNoArray, left->pageNoArray + left->numKeys + 1);
+        keys.push_back(parent->keyArray[leftIdx]);
+        keys.insert(keys.end(), right->keyArray, right->keyArray + right->numKeys);
+        children.insert(children.end(), right->pageNoArray, right->pageNoArray + right->numKeys + 1);
+
+        const int total = keys.size();
+        merged = total - 1 < NonLeafNode <T>::SIZE / 2 * 2;
+        const int leftCount = merged ? total : (total - 1) / 2;
+
+        std::copy(keys.begin(), keys.begin() + leftCount, left->keyArray);
+        std::copy(children.begin(), children.begin() + leftCount + 1, left->pageNoArray);
+        left->numKeys = leftCount;
+        if (!merged) {
+            parent->keyArray[leftIdx] = keys[leftCount];
+            std::copy(keys.begin() + leftCount + 1, keys.end(), right->keyArray);
+            std::copy(children.begin() + leftCount + 1, children.end(), right->pageNoArray);
+            right->numKeys = total - leftCount - 1;
+        }
+    }
+
+    if (merged) {
+        for (int i = leftIdx; i < parent->numKeys - 1; i++) {
+            parent->keyArray[i]        = parent->keyArray[i + 1];
+            parent->pageNoArray[i + 1] = parent->pageNoArray[i + 2];
+        }
+        parent->numKeys--;
+    }
+
+    if (log) log->logChanges(txn, LOG_PAGE);
+    bufMgr->unPinPage(file, leftNum, true);
+    bufMgr->unPinPage(file, rightNum, true);
+    bufMgr->unPinPage(file, parentNum, true);
+
+    if (merged) {
+        freeNode(rightNum);
+    }
+    return merged;
 }
 
 // -----------------------------------------------------------------------------
@@ -462,93 +1961,389 @@ const void BTreeIndex::startScan(const void *lowValParm,
                                  const Operator lowOpParm,
                                  const void *highValParm,
                                  const Operator highOpParm) {
-    if (*(int *) lowValParm > *(int *) highValParm) {
-        scanExecuting = false;
-        currentPageNum  = 0;
-        currentPageData = NULL;
+    startScan(scanCursor, lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+const void BTreeIndex::startScan(IndexCursor &cursor,
+                                 const void *lowValParm,
+                                 const Operator lowOpParm,
+                                 const void *highValParm,
+                                 const Operator highOpParm) {
+    // the scan the cursor was running ends, whether or not the new one starts
+    if (cursor.scanExecuting) {
+        cursor.index->endScan(cursor);
+    }
+
+    bool badRange = false;
+    switch (attributeType) {
+    case INTEGER:
+        badRange = keyAt <int>(lowValParm) > keyAt <int>(highValParm);
+        break;
+    case DOUBLE:
+        badRange = keyAt <double>(lowValParm) > keyAt <double>(highValParm);
+        break;
+    case STRING:
+        badRange = keyAt <StringKey>(lowValParm) > keyAt <StringKey>(highValParm);
+        break;
+    }
+
+    if (badRange) {
         throw BadScanrangeException();
     }
 
     if (lowOpParm != GT && lowOpParm != GTE) {
-        scanExecuting   = false;
-        currentPageNum  = 0;
-        currentPageData = NULL;
         throw BadOpcodesException();
     }
 
     if (highOpParm != LT && highOpParm != LTE) {
-        scanExecuting   = false;
-        currentPageNum  = 0;
-        currentPageData = NULL;
         throw BadOpcodesException();
     }
 
-    if (scanExecuting) {
-        endScan();
+    cursor.index         = this;
+    cursor.scanExecuting = true;
+#ifndef NDEBUG
+    operationsInFlight++;
+#endif
+
+    cursor.lowOp  = lowOpParm;
+    cursor.highOp = highOpParm;
+
+    cursor.nextEntry = 0;
+
+    switch (attributeType) {
+    case INTEGER:
+        cursor.lowValInt  = keyAt <int>(lowValParm);
+        cursor.highValInt = keyAt <int>(highValParm);
+        startKeyScan <int>(cursor);
+        break;
+    case DOUBLE:
+        cursor.lowValDouble  = keyAt <double>(lowValParm);
+        cursor.highValDouble = keyAt <double>(highValParm);
+        startKeyScan <double>(cursor);
+        break;
+    case STRING:
+        cursor.lowValString  = keyAt <StringKey>(lowValParm);
+        cursor.highValString = keyAt <StringKey>(highValParm);
+        startKeyScan <StringKey>(cursor);
+        break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startKeyScan
+// -----------------------------------------------------------------------------
+
+template <class T>
+const void BTreeIndex::startKeyScan(IndexCursor &cursor) {
+    const T &lowValue = cursor.lowVal <T>();
+
+    if (shadowPaging) {
+        startShadowScan <T>(cursor);
+    }
+    else {
+        std::uint64_t root    = linkedRoot;
+        PageId        nodeNum = (PageId) root;
+
+        // down to the leftmost leaf that may hold entries of the range, reading each node without latching it
+        for (int height = root >> 32; height > 0; height--) {
+            readNode(nodeNum, height, [&](Page *nodePage) {
+                NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+                int numKeys = keysRead(node->numKeys, NonLeafNode <T>::SIZE);
+                int idx     = cursor.lowOp == GT
+                                  ? KeySearch::upperBound(node->keyArray, numKeys, lowValue, searchStrategy)
+                                  : KeySearch::lowerBound(node->keyArray, numKeys, lowValue, searchStrategy);
+                nodeNum = node->pageNoArray[idx];
+            });
+        }
+        cursor.currentPageNum = nodeNum;
+    }
+
+    // leaves with no entry from the low value on, as a leaf split after the descent passed it may be, are
+    // passed along the sibling links
+    while (true) {
+        copyScanLeaf <T>(cursor, true);
+        if (!cursor.leafEntries.empty() || cursor.rangeEnds) {
+            return;
+        }
+        if (!nextScanLeaf <T>(cursor)) {
+            completeScan(cursor);
+            return;
+        }
     }
+}
 
-    scanExecuting = true;
+// -----------------------------------------------------------------------------
+// BTreeIndex::startShadowScan
+// -----------------------------------------------------------------------------
 
-    lowValInt  = *(int *) lowValParm;
-    highValInt = *(int *) highValParm;
-    lowOp      = lowOpParm;
-    highOp     = highOpParm;
+template <class T>
+const void BTreeIndex::startShadowScan(IndexCursor &cursor) {
+    const T &lowValue = cursor.lowVal <T>();
 
-    nextEntry = 0;
+    std::uint64_t root = enterVersion(cursor.scanSlot);
+    cursor.scanPath.clear();
 
-    bool isLeaf = rootIsLeaf;
-    currentPageNum = rootPageNum;
+    bool isLeaf = (root >> 32) & 1;
+    cursor.currentPageNum = (PageId) root;
 
     while (!isLeaf) {
         Page *page;
-        bufMgr->readPage(file, currentPageNum, page);
+        bufMgr->readPage(file, cursor.currentPageNum, page, NORMAL, PAGE_INDEX_INTERIOR);
+        NonLeafNode <T> *node = (NonLeafNode <T> *) page;
 
-        int lastFullIndex = getLastFullIndex(page, false);
+        int lastFullIndex = getLastFullIndex <T>(page, false);
+        int idx = cursor.lowOp == GT
+                      ? KeySearch::upperBound(node->keyArray, lastFullIndex, lowValue, searchStrategy)
+                      : KeySearch::lowerBound(node->keyArray, lastFullIndex, lowValue, searchStrategy);
 
-        struct NonLeafNodeInt *node = (struct NonLeafNodeInt *) page;
-
-        int idx = 0;
-        for (idx = 0; idx < lastFullIndex && lowValInt >= node->keyArray[idx]; idx++);
+        cursor.scanPath.push_back(std::make_pair(cursor.currentPageNum, idx));
+        PageId child = node->pageNoArray[idx];
         isLeaf = node->level;
-        PageId prev_page = currentPageNum;
-        currentPageNum = node->pageNoArray[idx];
 
-        bufMgr->unPinPage(file, prev_page, false);
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageNum = child;
     }
+}
 
-    bool stop = false;
+// -----------------------------------------------------------------------------
+// BTreeIndex::nextShadowLeaf
+// -----------------------------------------------------------------------------
 
-    while (!stop) {
-        if (!currentPageNum) {
-            stop = true;
+template <class T>
+bool BTreeIndex::nextShadowLeaf(IndexCursor &cursor) {
+    std::vector<std::pair<PageId, int> > &scanPath = cursor.scanPath;
+
+    while (!scanPath.empty()) {
+        Page *page;
+        PageId nodeNum = scanPath.back().first;
+        bufMgr->readPage(file, nodeNum, page, NORMAL, PAGE_INDEX_INTERIOR);
+        NonLeafNode <T> *node = (NonLeafNode <T> *) page;
+
+        if (scanPath.back().second >= getLastFullIndex <T>(page, false)) {
+            bufMgr->unPinPage(file, nodeNum, false);
+            scanPath.pop_back();
+            continue;
         }
-        else {
-            Page *page;
-            bufMgr->readPage(file, currentPageNum, page);
 
-            int lastFullIndex        = getLastFullIndex(page, true);
-            struct LeafNodeInt *leaf = (struct LeafNodeInt *) page;
+        int    idx    = ++scanPath.back().second;
+        PageId child  = node->pageNoArray[idx];
+        bool   isLeaf = node->level;
+        bufMgr->unPinPage(file, nodeNum, false);
 
-            int idx = 0;
-            if (lowOp == GT) {
-                for (idx = 0; idx <= lastFullIndex && lowValInt >= leaf->keyArray[idx]; idx++);
-            }
-            else {
-                for (idx = 0; idx <= lastFullIndex && lowValInt > leaf->keyArray[idx]; idx++);
-            }
+        // leftmost leaf below the next child
+        while (!isLeaf) {
+            bufMgr->readPage(file, child, page, NORMAL, PAGE_INDEX_INTERIOR);
+            node = (NonLeafNode <T> *) page;
 
-            if (idx > lastFullIndex) {
-                PageId next_page = leaf->rightSibPageNo;
-                bufMgr->unPinPage(file, currentPageNum, false);
-                currentPageNum = next_page;
-            }
-            else {
-                currentPageData = page;
-                stop            = true;
-                nextEntry       = idx;
+            scanPath.push_back(std::make_pair(child, 0));
+            PageId next = node->pageNoArray[0];
+            isLeaf = node->level;
+
+            bufMgr->unPinPage(file, child, false);
+            child = next;
+        }
+
+        cursor.currentPageNum = child;
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::copyScanLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::copyScanLeaf(IndexCursor &cursor, const bool fromLow) {
+    const T &lowValue  = cursor.lowVal <T>();
+    const T &highValue = cursor.highVal <T>();
+
+    // the entries and the sibling link are read as of one version, so that entries a split moves on are
+    // either copied here or found along the link, never both
+    readNode(cursor.currentPageNum, 0, [&](Page *leafPage) {
+        LeafNode <T> *leaf = (LeafNode <T> *) leafPage;
+
+        int numKeys = keysRead(leaf->numKeys, LeafNode <T>::SIZE);
+        int begin   = 0;
+        if (fromLow) {
+            begin = cursor.lowOp == GT ? KeySearch::upperBound(leaf->keyArray, numKeys, lowValue, searchStrategy)
+                                       : KeySearch::lowerBound(leaf->keyArray, numKeys, lowValue, searchStrategy);
+        }
+        int end = cursor.highOp == LT ? KeySearch::lowerBound(leaf->keyArray, numKeys, highValue, searchStrategy)
+                                      : KeySearch::upperBound(leaf->keyArray, numKeys, highValue, searchStrategy);
+        end = std::max(begin, end);
+
+        cursor.leafEntries.assign(leaf->ridArray + begin, leaf->ridArray + end);
+        cursor.rangeEnds   = end < numKeys;
+        cursor.nextPageNum = leaf->rightSibPageNo;
+    });
+    cursor.nextEntry = 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nextScanLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+bool BTreeIndex::nextScanLeaf(IndexCursor &cursor) {
+    // sibling links of a shadow-paged tree are stale
+    if (shadowPaging) {
+        return nextShadowLeaf <T>(cursor);
+    }
+
+    if (!cursor.nextPageNum) {
+        return false;
+    }
+    cursor.currentPageNum = cursor.nextPageNum;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getRootPageNum
+// -----------------------------------------------------------------------------
+
+PageId BTreeIndex::getRootPageNum(bool &isLeaf) const {
+    isLeaf = rootIsLeaf;
+    return rootPageNum;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setSearchStrategy
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setSearchStrategy(const SearchStrategy strategy) {
+    searchStrategy = KeySearch::supported(strategy) ? strategy : SEARCH_BINARY;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::childForKey
+// -----------------------------------------------------------------------------
+
+template <class T>
+PageId BTreeIndex::childForKey(Page *node, const T &key, bool &childIsLeaf) {
+    int lastFullIndex        = getLastFullIndex <T>(node, false);
+    NonLeafNode <T> *nonLeaf = (NonLeafNode <T> *) node;
+
+    int idx = KeySearch::upperBound(nonLeaf->keyArray, lastFullIndex, key, searchStrategy);
+    childIsLeaf = nonLeaf->level;
+    return nonLeaf->pageNoArray[idx];
+}
+
+template PageId BTreeIndex::childForKey <int>(Page *node, const int &key, bool &childIsLeaf);
+template PageId BTreeIndex::childForKey <double>(Page *node, const double &key, bool &childIsLeaf);
+template PageId BTreeIndex::childForKey <StringKey>(Page *node, const StringKey &key, bool &childIsLeaf);
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countInLeaf
+// -----------------------------------------------------------------------------
+
+template <class T>
+int BTreeIndex::countInLeaf(Page *leaf, const T &key, PageId &nextLeaf) {
+    int lastFullIndex      = getLastFullIndex <T>(leaf, true);
+    LeafNode <T> *leafNode = (LeafNode <T> *) leaf;
+
+    int idx   = KeySearch::lowerBound(leafNode->keyArray, lastFullIndex + 1, key, searchStrategy);
+    int found = 0;
+    for (; idx <= lastFullIndex && key == leafNode->keyArray[idx]; idx++, found++);
+
+    nextLeaf = idx > lastFullIndex ? leafNode->rightSibPageNo : 0;
+    return found;
+}
+
+template int BTreeIndex::countInLeaf <int>(Page *leaf, const int &key, PageId &nextLeaf);
+template int BTreeIndex::countInLeaf <double>(Page *leaf, const double &key, PageId &nextLeaf);
+template int BTreeIndex::countInLeaf <StringKey>(Page *leaf, const StringKey &key, PageId &nextLeaf);
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupKey
+// -----------------------------------------------------------------------------
+
+template <class T>
+int BTreeIndex::lookupKey(const T &key, std::vector<RecordId> &rids) {
+    if (shadowPaging) {
+        int slot;
+        std::uint64_t root = enterVersion(slot);
+        int found = collectEntries((PageId) root, (root >> 32) & 1, key, rids);
+        leaveVersion(slot);
+        return found;
+    }
+
+    std::uint64_t root    = linkedRoot;
+    PageId        nodeNum = (PageId) root;
+
+    // down to the leftmost leaf that may hold the key, reading each node without latching it
+    for (int height = root >> 32; height > 0; height--) {
+        readNode(nodeNum, height, [&](Page *nodePage) {
+            NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+            nodeNum = node->pageNoArray[KeySearch::lowerBound(node->keyArray,
+                                                              keysRead(node->numKeys, NonLeafNode <T>::SIZE),
+                                                              key, searchStrategy)];
+        });
+    }
+
+    const size_t first = rids.size();
+    while (true) {
+        // entries equal to the key may go on in the right sibling, or all be there after a split the descent
+        // missed; entries read while the leaf changed are read again
+        const size_t leafFirst = rids.size();
+        PageId       nextNum;
+        readNode(nodeNum, 0, [&](Page *leafPage) {
+            LeafNode <T> *leaf = (LeafNode <T> *) leafPage;
+            rids.resize(leafFirst);
+
+            int numKeys = keysRead(leaf->numKeys, LeafNode <T>::SIZE);
+            int idx     = KeySearch::lowerBound(leaf->keyArray, numKeys, key, searchStrategy);
+            for (; idx < numKeys && leaf->keyArray[idx] == key; idx++) {
+                rids.push_back(leaf->ridArray[idx]);
             }
+            nextNum = idx == numKeys ? leaf->rightSibPageNo : 0;
+        });
+
+        if (nextNum && (rids.size() > leafFirst || movesRight(nextNum, key))) {
+            nodeNum = nextNum;
+            continue;
+        }
+        return (int) (rids.size() - first);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::collectEntries
+// -----------------------------------------------------------------------------
+
+template <class T>
+int BTreeIndex::collectEntries(const PageId nodeNum, const bool isLeaf, const T &key, std::vector<RecordId> &rids) {
+    Page *nodePage;
+
+    if (isLeaf) {
+        bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_LEAF);
+        LeafNode <T> *leaf = (LeafNode <T> *) nodePage;
+
+        int idx   = KeySearch::lowerBound(leaf->keyArray, leaf->numKeys, key, searchStrategy);
+        int found = 0;
+        for (; idx < leaf->numKeys && leaf->keyArray[idx] == key; idx++, found++) {
+            rids.push_back(leaf->ridArray[idx]);
         }
+        bufMgr->unPinPage(file, nodeNum, false);
+        return found;
+    }
+
+    bufMgr->readPage(file, nodeNum, nodePage, NORMAL, PAGE_INDEX_INTERIOR);
+    NonLeafNode <T> *node = (NonLeafNode <T> *) nodePage;
+
+    // the children between keys equal to the key may all hold it
+    int  first       = KeySearch::lowerBound(node->keyArray, (int) node->numKeys, key, searchStrategy);
+    int  last        = KeySearch::upperBound(node->keyArray, (int) node->numKeys, key, searchStrategy);
+    bool childIsLeaf = node->level == 1;
+    std::vector<PageId> children(node->pageNoArray + first, node->pageNoArray + last + 1);
+    bufMgr->unPinPage(file, nodeNum, false);
+
+    int found = 0;
+    for (size_t c = 0; c < children.size(); c++) {
+        found += collectEntries(children[c], childIsLeaf, key, rids);
     }
+    return found;
 }
 
 // -----------------------------------------------------------------------------
@@ -556,35 +2351,125 @@ const void BTreeIndex::startScan(const void *lowValParm,
 // -----------------------------------------------------------------------------
 
 const void BTreeIndex::scanNext(RecordId& outRid) {
-    if (!scanExecuting) {
+    scanNext(scanCursor, outRid);
+}
+
+const void BTreeIndex::scanNext(IndexCursor &cursor, RecordId& outRid) {
+    if (!cursor.scanExecuting || cursor.index != this) {
         throw ScanNotInitializedException();
     }
 
-    if (this->currentPageNum == 0) {
+    if (cursor.currentPageNum == 0) {
         throw IndexScanCompletedException();
     }
 
-    struct LeafNodeInt *leaf = (struct LeafNodeInt *) currentPageData;
-    if (highValInt > leaf->keyArray[nextEntry] && highOp == LT) {
-        outRid = leaf->ridArray[nextEntry++];
+    switch (attributeType) {
+    case INTEGER:
+        scanNextKey <int>(cursor, outRid);
+        break;
+    case DOUBLE:
+        scanNextKey <double>(cursor, outRid);
+        break;
+    case STRING:
+        scanNextKey <StringKey>(cursor, outRid);
+        break;
     }
-    else if (highValInt >= leaf->keyArray[nextEntry] && highOp == LTE) {
-        outRid = leaf->ridArray[nextEntry++];
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextKey
+// -----------------------------------------------------------------------------
+
+template <class T>
+const void BTreeIndex::scanNextKey(IndexCursor &cursor, RecordId& outRid) {
+    // leaves are copied as the last entry of the one before is returned, so only a range ending in the leaf
+    // runs out of entries here
+    if (cursor.nextEntry >= (int) cursor.leafEntries.size()) {
+        completeScan(cursor);
+        throw IndexScanCompletedException();
     }
-    else {
-        bufMgr->unPinPage(file, currentPageNum, false);
+
+    outRid = cursor.leafEntries[cursor.nextEntry++];
+    if (cursor.nextEntry < (int) cursor.leafEntries.size() || cursor.rangeEnds) {
+        return;
+    }
+
+    while (nextScanLeaf <T>(cursor)) {
+        copyScanLeaf <T>(cursor, false);
+        if (!cursor.leafEntries.empty() || cursor.rangeEnds) {
+            return;
+        }
+    }
+
+    // the entry just returned was the last of the tree; the scan of a tree changed in place reports it done
+    // at once, as it always has
+    completeScan(cursor);
+    if (!shadowPaging) {
         throw IndexScanCompletedException();
     }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+
+int BTreeIndex::scanNextBatch(RecordId *outRids, const int maxRids) {
+    return scanNextBatch(scanCursor, outRids, maxRids);
+}
+
+int BTreeIndex::scanNextBatch(IndexCursor &cursor, RecordId *outRids, const int maxRids) {
+    if (!cursor.scanExecuting || cursor.index != this) {
+        throw ScanNotInitializedException();
+    }
+
+    switch (attributeType) {
+    case INTEGER:
+        return scanNextBatchKey <int>(cursor, outRids, maxRids);
+    case DOUBLE:
+        return scanNextBatchKey <double>(cursor, outRids, maxRids);
+    case STRING:
+        return scanNextBatchKey <StringKey>(cursor, outRids, maxRids);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatchKey
+// -----------------------------------------------------------------------------
 
-    if (nextEntry >= leafOccupancy || leaf->ridArray[nextEntry].page_number == 0) {
-        PageId nextPage = leaf->rightSibPageNo;
-        nextEntry = 0;
-        bufMgr->unPinPage(file, currentPageNum, false);
-        currentPageNum = nextPage;
-        if (!currentPageNum) {
-            throw IndexScanCompletedException();
+template <class T>
+int BTreeIndex::scanNextBatchKey(IndexCursor &cursor, RecordId *outRids, const int maxRids) {
+    int count = 0;
+
+    while (count < maxRids && cursor.currentPageNum) {
+        // the entries copied from the leaf, as many as are still wanted
+        int take = std::min((int) cursor.leafEntries.size() - cursor.nextEntry, maxRids - count);
+        std::copy(cursor.leafEntries.begin() + cursor.nextEntry, cursor.leafEntries.begin() + cursor.nextEntry + take,
+                  outRids + count);
+        count            += take;
+        cursor.nextEntry += take;
+
+        if (cursor.nextEntry < (int) cursor.leafEntries.size()) {
+            break;
         }
-        bufMgr->readPage(file, currentPageNum, currentPageData);
+        if (cursor.rangeEnds || !nextScanLeaf <T>(cursor)) {
+            completeScan(cursor);
+            break;
+        }
+        copyScanLeaf <T>(cursor, false);
+    }
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::completeScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::completeScan(IndexCursor &cursor) {
+    cursor.currentPageNum = 0;
+    cursor.leafEntries.clear();
+    if (cursor.scanSlot >= 0) {
+        leaveVersion(cursor.scanSlot);
     }
 }
 
@@ -593,12 +2478,20 @@ const void BTreeIndex::scanNext(RecordId& outRid) {
 // -----------------------------------------------------------------------------
 //
 const void BTreeIndex::endScan() {
-    if (!scanExecuting) {
+    endScan(scanCursor);
+}
+
+const void BTreeIndex::endScan(IndexCursor &cursor) {
+    if (!cursor.scanExecuting || cursor.index != this) {
         throw ScanNotInitializedException();
     }
 
-    scanExecuting   = false;
-    currentPageNum  = 0;
-    currentPageData = NULL;
+    // a cursor is done with its version of a shadow-paged tree unless the scan completed
+    completeScan(cursor);
+
+    cursor.scanExecuting = false;
+#ifndef NDEBUG
+    operationsInFlight--;
+#endif
 }
 }
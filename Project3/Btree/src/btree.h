@@ -7,15 +7,26 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "wal.h"
+#include "key_search.h"
+#include "latch.h"
 
 namespace badgerdb
 {
@@ -38,18 +49,93 @@ enum Operator {
     GT      /* Greater Than */
 };
 
+/**
+ * @brief Size of String key.
+ */
+const int STRINGSIZE = 10;
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief Key of a STRING index: the first STRINGSIZE characters of the attribute, padded with zeros,
+ * so that keys compare bytewise as strncmp() compares the strings.
+ */
+struct StringKey {
+    char data[STRINGSIZE];
+};
+
+inline bool operator<(const StringKey& k1, const StringKey& k2) {
+    return memcmp(k1.data, k2.data, STRINGSIZE) < 0;
+}
+
+inline bool operator>(const StringKey& k1, const StringKey& k2) {
+    return memcmp(k1.data, k2.data, STRINGSIZE) > 0;
+}
+
+inline bool operator<=(const StringKey& k1, const StringKey& k2) {
+    return memcmp(k1.data, k2.data, STRINGSIZE) <= 0;
+}
+
+inline bool operator>=(const StringKey& k1, const StringKey& k2) {
+    return memcmp(k1.data, k2.data, STRINGSIZE) >= 0;
+}
+
+inline bool operator==(const StringKey& k1, const StringKey& k2) {
+    return memcmp(k1.data, k2.data, STRINGSIZE) == 0;
+}
+
+inline bool operator!=(const StringKey& k1, const StringKey& k2) {
+    return memcmp(k1.data, k2.data, STRINGSIZE) != 0;
+}
+
+/**
+ * @brief Number of free page numbers the meta page holds.
  */
-//                                        sibling ptr             key               rid
-const int INTARRAYLEAFSIZE = (Page::SIZE - sizeof(PageId)) / (sizeof(int) + sizeof(RecordId));
+//                                        name  offset, type, root, shadow, leaf root, count, format
+const int METAFREEPAGES = (Page::SIZE - 20 - 7 * sizeof(int)) / sizeof(PageId);
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Version of the layout of index files. Version 1 had no entry counts in the nodes, which
+ * were found by scanning for the first empty slot; files of version 1 are upgraded when opened.
+ */
+const int INDEX_FORMAT_VERSION = 2;
+
+/**
+ * @brief Tag in the upper half of IndexMetaInfo::formatVersion. The field holds the first free page
+ * number or zero in files of version 1, neither of which carries the tag.
+ */
+const int INDEX_FORMAT_TAG = 0x4254 << 16;
+
+/**
+ * @brief How the BTreeIndex constructor builds a new index file from the relation.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const int INTARRAYNONLEAFSIZE = (Page::SIZE - sizeof(int) - sizeof(PageId)) / (sizeof(int) + sizeof(PageId));
+struct BuildOptions {
+    /**
+     * Sort the entries and pack the nodes bottom-up if true, otherwise insert the entries one by one.
+     */
+    bool        bulk;
+
+    /**
+     * Share of the slots of each node filled by bulk loading, in (0, 1]. Slots left free take later
+     * inserts without splits.
+     */
+    double      fillFactor;
+
+    /**
+     * Bytes of entries bulk loading sorts in memory. More entries are sorted in runs written to
+     * temporary files and merged.
+     */
+    std::size_t sortMemory;
+
+    /**
+     * Threads bulk loading scans, sorts and packs the leaves with. More than one thread sorts all
+     * the entries in memory, whatever the sort memory.
+     */
+    int         threads;
+
+    BuildOptions(const bool bulk = true, const double fillFactor = 0.9,
+                 const std::size_t sortMemory = 64 << 20, const int threads = 1)
+        : bulk(bulk), fillFactor(fillFactor), sortMemory(sortMemory), threads(threads) {
+    }
+};
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that
@@ -124,6 +210,32 @@ struct IndexMetaInfo {
      * Page number of root page of the B+ Tree inside the file index file.
      */
     PageId   rootPageNo;
+
+    /**
+     * Nonzero if the tree is changed by shadow paging, see BTreeIndex::enableShadowPaging().
+     */
+    int      shadowPaging;
+
+    /**
+     * Nonzero if the root page is a leaf. Kept by shadow-paged trees, whose root moves on every commit.
+     */
+    int      rootIsLeaf;
+
+    /**
+     * Number of page numbers in freePages.
+     */
+    int      freeCount;
+
+    /**
+     * INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION.
+     */
+    int      formatVersion;
+
+    /**
+     * Pages no longer part of the tree, saved when the index is closed and reused by later splits and
+     * commits. Pages beyond METAFREEPAGES are not saved and stay unused.
+     */
+    PageId   freePages[METAFREEPAGES];
 };
 
 /*
@@ -131,56 +243,287 @@ struct IndexMetaInfo {
  * These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of
  * node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes
  * at this level are just above the leaf nodes. Otherwise set to 0.
+ * The structures are templated for the key, so that the number of key slots of each key type is known at compile time.
+ * Each node holds its number of keys, and slots past them are left as they are. The counts take bytes
+ * that version 1 of the file format left unused, the upper half of the level of a non-leaf node and
+ * the end of a leaf, so that a file of version 1 is upgraded without moving any key.
  */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes, for keys of type T.
  */
-struct NonLeafNodeInt {
+template <class T>
+struct NonLeafNode {
+    /**
+     * Number of key slots.
+     */
+    //                        level and count, padded to align the keys     extra pageNo        key       pageNo
+    static const int SIZE = (Page::SIZE - (alignof(T) > sizeof(int) ? alignof(T) : sizeof(int)) - sizeof(PageId))
+                            / (sizeof(T) + sizeof(PageId));
+
     /**
      * Level of the node in the tree.
      */
-    int    level;
+    std::int16_t level;
+
+    /**
+     * Number of keys, one less than the number of children.
+     */
+    std::int16_t numKeys;
 
     /**
      * Stores keys.
      */
-    int    keyArray[INTARRAYNONLEAFSIZE];
+    T            keyArray[SIZE];
 
     /**
      * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
      */
-    PageId pageNoArray[INTARRAYNONLEAFSIZE + 1];
+    PageId       pageNoArray[SIZE + 1];
 };
 
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all leaf nodes, for keys of type T.
  */
-struct LeafNodeInt {
+template <class T>
+struct LeafNode {
+    /**
+     * Number of key slots.
+     */
+    //                                    sibling ptr      count          key           rid
+    static const int SIZE = (Page::SIZE - sizeof(PageId) - sizeof(int)) / (sizeof(T) + sizeof(RecordId));
+
     /**
      * Stores keys.
      */
-    int      keyArray[INTARRAYLEAFSIZE];
+    T        keyArray[SIZE];
 
     /**
      * Stores RecordIds.
      */
-    RecordId ridArray[INTARRAYLEAFSIZE];
+    RecordId ridArray[SIZE];
 
     /**
      * Page number of the leaf on the right side.
      * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
      */
     PageId   rightSibPageNo;
+
+    /**
+     * Number of entries.
+     */
+    int      numKeys;
+};
+
+typedef NonLeafNode <int>       NonLeafNodeInt;
+typedef NonLeafNode <double>    NonLeafNodeDouble;
+typedef NonLeafNode <StringKey> NonLeafNodeString;
+typedef LeafNode <int>          LeafNodeInt;
+typedef LeafNode <double>       LeafNodeDouble;
+typedef LeafNode <StringKey>    LeafNodeString;
+
+static_assert(sizeof(NonLeafNodeInt) <= Page::SIZE && sizeof(LeafNodeInt) <= Page::SIZE &&
+              sizeof(NonLeafNodeDouble) <= Page::SIZE && sizeof(LeafNodeDouble) <= Page::SIZE &&
+              sizeof(NonLeafNodeString) <= Page::SIZE && sizeof(LeafNodeString) <= Page::SIZE,
+              "a node does not fit in a page");
+
+/**
+ * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ */
+const int INTARRAYLEAFSIZE = LeafNodeInt::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ */
+const int INTARRAYNONLEAFSIZE = NonLeafNodeInt::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+const int DOUBLEARRAYLEAFSIZE = LeafNodeDouble::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+const int DOUBLEARRAYNONLEAFSIZE = NonLeafNodeDouble::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for STRING key.
+ */
+const int STRINGARRAYLEAFSIZE = LeafNodeString::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for STRING key.
+ */
+const int STRINGARRAYNONLEAFSIZE = NonLeafNodeString::SIZE;
+
+class BTreeIndex;
+
+/**
+ * @brief State of one range scan of a BTreeIndex, so that many scans can read the same index at once,
+ * as the inner side of an index nested-loop join does. A cursor is bound to an index by
+ * BTreeIndex::startScan() and may be started again once its scan ended, its memory being reused.
+ * A cursor still scanning when destroyed ends its scan, so it must not outlive its index.
+ */
+class IndexCursor {
+public:
+    IndexCursor();
+
+    ~IndexCursor();
+
+    /**
+     * True if the cursor has been started and not ended.
+     */
+    bool isScanning() const { return scanExecuting; }
+
+private:
+    friend class BTreeIndex;
+
+    IndexCursor(const IndexCursor&) = delete;
+    IndexCursor& operator=(const IndexCursor&) = delete;
+
+    /**
+     * Index scanned, or NULL before the first scan.
+     */
+    BTreeIndex *index;
+
+    /**
+     * True if an index scan has been started.
+     */
+    bool scanExecuting;
+
+    /**
+     * Entries of the range in the leaf being scanned, copied out of it so that the leaf stays unpinned.
+     */
+    std::vector<RecordId> leafEntries;
+
+    /**
+     * Index of next entry to be scanned in leafEntries.
+     */
+    int nextEntry;
+
+    /**
+     * Page number of the leaf being scanned, or 0 once the scan completed.
+     */
+    PageId currentPageNum;
+
+    /**
+     * Right sibling of the leaf as it was copied, 0 if it had none.
+     */
+    PageId nextPageNum;
+
+    /**
+     * True if the range ends in the leaf, so that no leaf after it is read.
+     */
+    bool rangeEnds;
+
+    /**
+     * Low INTEGER value for scan.
+     */
+    int lowValInt;
+
+    /**
+     * Low DOUBLE value for scan.
+     */
+    double lowValDouble;
+
+    /**
+     * Low STRING value for scan.
+     */
+    StringKey lowValString;
+
+    /**
+     * High INTEGER value for scan.
+     */
+    int highValInt;
+
+    /**
+     * High DOUBLE value for scan.
+     */
+    double highValDouble;
+
+    /**
+     * High STRING value for scan.
+     */
+    StringKey highValString;
+
+    /**
+     * Low Operator. Can only be GT(>) or GTE(>=).
+     */
+    Operator lowOp;
+
+    /**
+     * High Operator. Can only be LT(<) or LTE(<=).
+     */
+    Operator highOp;
+
+    /**
+     * Slot of the readerVersions of a shadow-paged tree held by the scan, or -1.
+     */
+    int scanSlot;
+
+    /**
+     * Non-leaf nodes above the leaf being scanned in a shadow-paged tree, each with the index of the child
+     * taken, through which the scan finds the next leaf.
+     */
+    std::vector<std::pair<PageId, int> > scanPath;
+
+    /**
+     * Low value for scan, of the type of the keys.
+     */
+    template <class T>
+    T &lowVal();
+
+    /**
+     * High value for scan, of the type of the keys.
+     */
+    template <class T>
+    T &highVal();
 };
 
 
 /**
  * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * relation. The state of a scan is kept in an IndexCursor, so that many scans can read the index at
+ * once; startScan(), scanNext() and endScan() without one use a cursor of the index's own.
+ *
+ * Once enableShadowPaging() is called the index never changes a node readers may see: insertEntry()
+ * copies the nodes on its path to new pages, and commitVersion() makes the copies the tree by swapping
+ * the root. A scan on one thread then reads the last committed version while another thread inserts
+ * and commits, neither waiting for the other.
+ *
+ * A tree changed in place takes insertEntry() and lookupEntries() from many threads at once, as a B-link
+ * tree: each node is latched only while it is changed, and a thread that reaches a leaf after it split
+ * moves right along the sibling links, the first key of the right sibling being the high key of a leaf.
+ * A split is posted to the parent with the node that split still latched, so a writer holds two latches
+ * at most. Nodes are read optimistically, without latching: a reader notes the version of the latch,
+ * reads the node and reads it again if a writer took the latch meanwhile. A node in the buffer pool is
+ * read through BufMgr::peekPage(), without a pin, so that a lookup writes no shared state on its way
+ * down; one whose frame was given another page meanwhile is read again pinned.
+ * Scans run on many threads at once, each with its own cursor, alongside insertEntry(): a scan copies the
+ * entries of each leaf it reaches the same way, and goes on along the right sibling it read with them, so
+ * that the entries a split moved on are read once. deleteEntry() and logged inserts need the index to
+ * themselves.
  */
 class BTreeIndex {
+public:
+
+    /**
+     * Most scans of a shadow-paged tree reading at once.
+     */
+    static const int MAX_SHADOW_READERS = 64;
+
+    /**
+     * Heights above the leaves with latches of their own; taller trees share the top ones.
+     */
+    static const int LATCH_HEIGHTS = 8;
+
+    /**
+     * Latches of the nodes of one height, each node taking the one its page number falls on.
+     */
+    static const int LATCHES_PER_HEIGHT = 256;
+
 private:
 
     /**
@@ -193,6 +536,16 @@ private:
      */
     BufMgr *bufMgr;
 
+    /**
+     * Write-ahead log the changes of insertEntry() go to, or NULL.
+     */
+    LogManager *log;
+
+    /**
+     * Transaction the changes are logged under.
+     */
+    TxnId txn;
+
     /**
      * Page number of meta page.
      */
@@ -213,100 +566,318 @@ private:
      */
     int attrByteOffset;
 
+
+    // MEMBERS SPECIFIC TO SCANNING
+
     /**
-     * Number of keys in leaf node, depending upon the type of key.
+     * Cursor of the scan of startScan(), scanNext() and endScan() called without one.
      */
-    int leafOccupancy;
+    IndexCursor scanCursor;
+
+    /*
+    * boolean: is root the leaf for the B+ tree
+    */
+    bool rootIsLeaf;
 
     /**
-     * Number of keys in non-leaf node, depending upon the type of key.
+     * How the keys of a node are searched.
      */
-    int nodeOccupancy;
+    SearchStrategy searchStrategy;
 
+    // MEMBERS SPECIFIC TO SHADOW PAGING
 
-    // MEMBERS SPECIFIC TO SCANNING
+    /**
+     * True if nodes are copied on write. rootPageNum and rootIsLeaf are then the root of the version
+     * being written, and readers take the committed root from publishedRoot.
+     */
+    bool shadowPaging;
 
     /**
-     * True if an index scan has been started.
+     * Root of the last committed version, as (version << 33) | (root is leaf << 32) | page number.
      */
-    bool scanExecuting;
+    std::atomic<std::uint64_t> publishedRoot;
 
     /**
-     * Index of next entry to be scanned in current leaf being scanned.
+     * Version read by each scan of the tree, or 0 for a free slot.
      */
-    int nextEntry;
+    std::atomic<std::uint64_t> readerVersions[MAX_SHADOW_READERS];
+
 
     /**
-     * Page number of current page being scanned.
+     * Pages written since the last commit, changed in place until it.
      */
-    PageId currentPageNum;
+    std::set<PageId> pendingPages;
 
     /**
-     * Current Page being scanned.
+     * Pages of the committed tree copied since the last commit.
      */
-    Page *currentPageData;
+    std::vector<PageId> replacedPages;
 
     /**
-     * Low INTEGER value for scan.
+     * Pages replaced by commits, each with the first version not reading it, oldest first.
      */
-    int lowValInt;
+    std::deque<std::pair<std::uint64_t, PageId> > retiredPages;
 
     /**
-     * Low DOUBLE value for scan.
+     * Pages no reader sees any more, and pages of nodes merged away, reused before the file is extended.
      */
-    double lowValDouble;
+    std::vector<PageId> freePages;
 
     /**
-     * Low STRING value for scan.
+     * Serializes insertEntry() and commitVersion() of a shadow-paged tree.
      */
-    std::string lowValString;
+    std::mutex writeLatch;
+
+
+    // MEMBERS SPECIFIC TO CONCURRENT ACCESS
 
     /**
-     * High INTEGER value for scan.
+     * Latches of the nodes of a tree changed in place, by height above the leaves. A thread holds at most
+     * one of each height and takes them going up, so that nodes sharing a latch never deadlock.
      */
-    int highValInt;
+    NodeLatch nodeLatches[LATCH_HEIGHTS][LATCHES_PER_HEIGHT];
 
     /**
-     * High DOUBLE value for scan.
+     * Root and its height above the leaves, as (height << 32) | page number, which threads inserting
+     * and looking up at once descend from. Set with rootPageNum and rootIsLeaf by setRoot().
      */
-    double highValDouble;
+    std::atomic<std::uint64_t> linkedRoot;
 
     /**
-     * High STRING value for scan.
+     * Inserts, lookups and executing scans, which deleteEntry() on a tree changed in place asserts there
+     * are none of. Counted only in builds with assertions, so that lookups write no shared state otherwise.
      */
-    std::string highValString;
+    std::atomic<int> operationsInFlight;
 
     /**
-     * Low Operator. Can only be GT(>) or GTE(>=).
+     * Serializes allocNode() and freeNode().
      */
-    Operator lowOp;
+    std::mutex allocLatch;
 
     /**
-     * High Operator. Can only be LT(<) or LTE(<=).
+     * Allocate a page for a new node, reusing a free page if there is one.
+     * @param pageNo     Set to the page number
+     * @param page       Set to the page, pinned
+     * @param pageClass  Class of the node
      */
-    Operator highOp;
+    void allocNode(PageId &pageNo, Page *&page, const PageClass pageClass);
 
-    /*
-    * boolean: is root the leaf for the B+ tree
-    */
-    bool rootIsLeaf;
+    /**
+     * Give back the page of a node no longer in the tree. It is reused once no scan may read it, or never
+     * while a log is set, for rolling back the transaction would bring the node back.
+     * @param pageNo     Page number of the node
+     */
+    void freeNode(const PageId pageNo);
+
+    /**
+     * Node of the version being written in place of a node, copying the node unless this version
+     * already wrote it.
+     * @param pageNo     Page number of the node
+     * @param pageClass  Class of the node
+     * @return page number of the node to change
+     */
+    PageId shadowCopy(const PageId pageNo, const PageClass pageClass);
+
+    /**
+     * Move the pages no reader sees any more from retiredPages to freePages.
+     * @return true if there are free pages
+     */
+    bool reclaimPages();
+
+    /**
+     * Take a slot of readerVersions, announcing the committed version read.
+     * @param slot       Set to the slot
+     * @return the committed root, as held by publishedRoot
+     */
+    std::uint64_t enterVersion(int &slot);
+
+    /**
+     * Release a slot of readerVersions.
+     * @param slot       Slot, set to -1
+     */
+    void leaveVersion(int &slot);
+
+    /**
+     * Make a node the root, setting rootPageNum, rootIsLeaf and linkedRoot.
+     * @param pageNo     Page number of the node
+     * @param height     Height of the node above the leaves, 0 for a leaf
+     */
+    void setRoot(const PageId pageNo, const int height);
+
+    /**
+     * Height above the leaves of a subtree, found along its leftmost children.
+     * @param pageNo     root of the subtree
+     * @param isLeaf     true if the root of the subtree is a leaf
+     */
+    template <class T>
+    int treeHeight(const PageId pageNo, const bool isLeaf);
+
+    /**
+     * Latch of a node of a tree changed in place.
+     * @param height     Height of the node above the leaves
+     * @param pageNo     Page number of the node
+     */
+    NodeLatch &nodeLatch(const int height, const PageId pageNo);
+
+    /**
+     * Take the latch of a node to change it, unless the tree is shadow paged, whose writers are serialized
+     * and whose readers read committed nodes.
+     * @param height     Height of the node above the leaves
+     * @param pageNo     Page number of the node
+     */
+    void latchNode(const int height, const PageId pageNo);
+
+    /**
+     * Release the latch of a node taken by latchNode().
+     */
+    void unlatchNode(const int height, const PageId pageNo);
+
+    /**
+     * Read a node without latching it, calling read with its page until the version of its latch is the
+     * same after as before. The page is peeked at in the buffer pool, and pinned if it is not there or its
+     * frame was given another page during the read, so read starts afresh on each call.
+     * @param pageNo     Page number of the node
+     * @param height     Height of the node, 0 for a leaf
+     * @param read       Called with the page of the node
+     */
+    template <class F>
+    void readNode(const PageId pageNo, const int height, F read);
+
+    /**
+     * Descend the last committed version of a shadow-paged tree to the leaf the scan of a cursor starts in,
+     * taking a slot of readerVersions and noting the path in the scanPath of the cursor.
+     */
+    template <class T>
+    const void startShadowScan(IndexCursor &cursor);
 
     /**
-    * Helper call to fetch the last occupied index in the tree node
+     * Move the scan of a shadow-paged tree to the next leaf, through the scanPath of the cursor.
+     * @return false if the leaf scanned was the last one
+     */
+    template <class T>
+    bool nextShadowLeaf(IndexCursor &cursor);
+
+    /**
+     * Copy the entries of the range from the leaf a cursor has reached into its leafEntries, with the right
+     * sibling and whether the range ends there, reading the leaf again if a writer changed it meanwhile.
+     * @param cursor     cursor of the scan
+     * @param fromLow    true to skip the entries below the low value, which only the first leaves hold
+     */
+    template <class T>
+    void copyScanLeaf(IndexCursor &cursor, const bool fromLow);
+
+    /**
+     * Move a scan to the leaf after the one it copied.
+     * @return false if that leaf was the last one
+     */
+    template <class T>
+    bool nextScanLeaf(IndexCursor &cursor);
+
+    /**
+    * Helper call to fetch the last occupied index in the tree node, from its count of keys
     * @param node
     * @param isLeaf
     * @return the last occupied index in node
     */
+    template <class T>
     const int getLastFullIndex(Page *node, bool isLeaf);
 
+    /**
+    * Makes a new leaf empty.
+    * @param leafNode    pointer to the leafNode
+    */
+    template <class T>
+    void initLeaf(LeafNode <T> *leafNode);
+
+    /**
+    * Bring an index file of version 1 up to INDEX_FORMAT_VERSION: the counts of keys are set and
+    * written before the meta page takes the new version, so an upgrade cut short is done again.
+    * No page of the index may be pinned.
+    */
+    void upgradeFormat();
+
+    /**
+    * Set the count of keys of each node of a tree of version 1 from its empty slots.
+    * @param pageNo      root of the subtree
+    * @param isLeaf      true if the root of the subtree is a leaf
+    */
+    template <class T>
+    void countNodeKeys(const PageId pageNo, const bool isLeaf);
+
+    /**
+    * Build the tree of a new index file bottom-up from the entries of the relation in key order:
+    * leaves filled to the fill factor on consecutive pages from the root leaf on, then each level of
+    * non-leaf nodes above them, sharing the children evenly, up to the root.
+    * @param relationName  name of the relation
+    * @param build         fill factor, sort memory and threads
+    */
+    template <class T>
+    void bulkLoad(const std::string& relationName, const BuildOptions& build);
+
+    /**
+    * bulkLoad() on several threads. Each scans a share of the pages of the relation and sorts its
+    * entries, then merges one key range of the entries of all of them, then fills a share of the
+    * leaves, whose pages are allocated beforehand so that the leaves stay on consecutive pages.
+    * @param relationName  name of the relation
+    * @param build         fill factor and threads
+    */
+    template <class T>
+    void parallelLoad(const std::string& relationName, const BuildOptions& build);
+
+    /**
+    * Build the non-leaf levels of a bulk loaded tree over its leaves, and make the top node the root.
+    * @param level         first key and page number of each leaf, in key order
+    * @param build         fill factor
+    */
+    template <class T>
+    void buildNonLeafLevels(std::vector<SplitData <T> > &level, const BuildOptions& build);
+
+    /**
+    * Body of insertEntry() for keys of type T.
+    * @param ridKeyPair  record-id key pair
+    */
+    template <class T>
+    const void insertKey(RIDKeyPair <T> *ridKeyPair);
+
+    /**
+    * Descend from the root to the leaf an insert of a key goes to, copying the nodes on the way in a
+    * shadow-paged tree.
+    * @param key         key inserted
+    * @param path        non-leaf nodes descended through, root first, appended to
+    * @return page number of the leaf, which a concurrent split may have left left of the key
+    */
+    template <class T>
+    PageId findLeaf(const T &key, std::vector<PageId> &path);
+
+    /**
+    * Latch the leaf an insert of a key goes to, moving right from a leaf reached along the sibling links
+    * while the key sorts at or after the first key of the right sibling, as after a split the descent missed.
+    * @param leafNum     leaf descended to
+    * @param key         key inserted, after the entries equal to it
+    * @param leafPage    set to the page of the leaf, pinned
+    * @return page number of the leaf
+    */
+    template <class T>
+    PageId latchLeaf(PageId leafNum, const T &key, Page *&leafPage);
+
+    /**
+    * True if a key sorts at or after the first key of the right sibling of a leaf, read optimistically.
+    * @param rightNum    right sibling
+    * @param key         key looked for
+    */
+    template <class T>
+    bool movesRight(const PageId rightNum, const T &key);
+
     /**
     * Function containing the high level logic for adding to a leaf, 
     * and splitting the leaf if necessary.
-    * @param leafNum
+    * @param leafNum     leaf descended to
     * @param ridKeyPair
-    * @return SplitData
+    * @param splitNum    set to the leaf that split, left latched until the split is posted to its parent
+    * @return SplitData, or NULL if the leaf did not split
     */
-    SplitData <int> *insertLeafEntry(PageId leafNum, RIDKeyPair <int> *ridKeyPair);
+    template <class T>
+    SplitData <T> *insertLeafEntry(PageId leafNum, RIDKeyPair <T> *ridKeyPair, PageId &splitNum);
     
     /**
     * Splits the leaf node and returns the split data.
@@ -316,7 +887,8 @@ private:
     * @param ridKeyPair  record-id key pair 
     * @return SplitData 
     */
-    SplitData <int> *splitLeafNode(LeafNodeInt *leafNode, RIDKeyPair <int> *ridKeyPair);
+    template <class T>
+    SplitData <T> *splitLeafNode(LeafNode <T> *leafNode, RIDKeyPair <T> *ridKeyPair);
     
     /**
     * Inserts an entry into the leaf.
@@ -325,25 +897,65 @@ private:
     * @param RIDKeyPair     recordid-key pair to insert
     * @param lastFullIndex  last occupied index in the leaf node
     */
-    const void insertToLeaf(LeafNodeInt *leafNode, RIDKeyPair <int> *ridKeyPair, int lastFullIndex);
+    template <class T>
+    const void insertToLeaf(LeafNode <T> *leafNode, RIDKeyPair <T> *ridKeyPair, int lastFullIndex);
     
     /**
-    * Function to recursively traverse the tree and add to appropriate leaf. 
-    * This Function is also responsible for propagating splits back up if needed.
-    * @return SplitData
-    * @param nodeNum
-    * @param ridKeyPair
+    * Post the split of a node to its parent, just after the node, splitting the parent if it is full
+    * or making a new root if the node is the root. The node is unlatched once the split is posted.
+    * @param nodeNum     parent descended through, or 0 if the node was the root then
+    * @param height      height of the parent above the leaves
+    * @param childNum    node that split, latched; set to the parent if that split in turn, left latched
+    * @param splitData   new node and its separator
+    * @return SplitData of the parent, or NULL if the parent did not split
     */
-    SplitData <int> *insertNonLeafEntry(PageId nodeNum, RIDKeyPair <int> *ridKeyPair);
-    
+    template <class T>
+    SplitData <T> *insertNonLeafEntry(PageId nodeNum, const int height, PageId &childNum, SplitData <T> *splitData);
+
+    /**
+    * Latch the parent of a node for posting a split to it, when the parent descended through has split
+    * since or the root has grown above the node.
+    * @param height      height of the parent above the leaves
+    * @param childNum    node whose parent is found, latched by the caller
+    * @param key         key in the range of the node
+    * @return page number of the parent, latched, or 0 if the node is the root
+    */
+    template <class T>
+    PageId findParent(const int height, const PageId childNum, const T &key);
+
+    /**
+    * Search a subtree for the parent of a node, through each child whose range holds a key in the
+    * range of the node.
+    * @param nodeNum     root of the subtree
+    * @param nodeHeight  height of the root of the subtree above the leaves
+    * @param height      height of the parent above the leaves
+    * @param childNum    node whose parent is found
+    * @param key         key in the range of the node
+    * @return page number of the parent, or 0 if the subtree does not hold it
+    */
+    template <class T>
+    PageId searchParent(const PageId nodeNum, const int nodeHeight, const int height, const PageId childNum,
+                        const T &key);
+
+    /**
+    * Make a new root above the root that split.
+    * @param rootNum     root that split
+    * @param height      height of the root that split above the leaves
+    * @param splitData   new node and its separator
+    */
+    template <class T>
+    void growRoot(const PageId rootNum, const int height, SplitData <T> *splitData);
+
     /**
     * Splits non-leaf node (splitting the middle key)
     * Function containing specific logic to split a full non-leaf node.
     * @return SplitData
     * @param node
     * @param splitData
+    * @param idx         index of the child that split, after which the new node goes
     */
-    SplitData <int> *splitNonLeafNode(NonLeafNodeInt *node, SplitData <int> *splitData);
+    template <class T>
+    SplitData <T> *splitNonLeafNode(NonLeafNode <T> *node, SplitData <T> *splitData, const int idx);
     
     /**
     * Inserts entry to non-leaf, the page,key pair comes from splitdata
@@ -351,8 +963,95 @@ private:
     * @param node
     * @param splitData
     * @param lastFullIndex
+    * @param idx         index of the child that split, after which the new node goes
     */
-    const void insertToNonLeaf(NonLeafNodeInt *node, SplitData <int> *splitData, int lastFullIndex);
+    template <class T>
+    const void insertToNonLeaf(NonLeafNode <T> *node, SplitData <T> *splitData, int lastFullIndex, const int idx);
+
+    /**
+    * Body of deleteEntry() for keys of type T.
+    * @param ridKeyPair  record-id key pair
+    */
+    template <class T>
+    const void deleteKey(const RIDKeyPair <T> &ridKeyPair);
+
+    /**
+    * Find the leaf entry of a record-id key pair in a subtree, trying each child whose range holds the
+    * key, for equal keys may be split between neighbouring nodes.
+    * @param nodeNum     root of the subtree
+    * @param isLeaf      true if the root of the subtree is a leaf
+    * @param ridKeyPair  record-id key pair
+    * @param path        non-leaf nodes descended through, each with the index of the child taken, appended to
+    * @param leafNum     set to the leaf holding the entry
+    * @param entryIdx    set to the index of the entry in the leaf
+    * @return true if the entry was found
+    */
+    template <class T>
+    bool findEntry(const PageId nodeNum, const bool isLeaf, const RIDKeyPair <T> &ridKeyPair,
+                   std::vector<std::pair<PageId, int> > &path, PageId &leafNum, int &entryIdx);
+
+    /**
+    * Bring a child left less than half full back to half full, with entries of its neighbour under the
+    * same parent if the neighbour has more than half, otherwise by merging the right one of the two
+    * into the left one, so that the leftmost leaf stays on page 2.
+    * @param parentNum   parent of the child
+    * @param childIdx    index of the child in the parent
+    * @param childIsLeaf true if the child is a leaf
+    * @return true if the children were merged, which takes a key from the parent
+    */
+    template <class T>
+    bool rebalanceChild(const PageId parentNum, const int childIdx, const bool childIsLeaf);
+
+    /**
+    * Body of lookupEntries() for keys of type T.
+    * @param key         key looked for
+    * @param rids        record ids of the entries found, appended to
+    * @return number of entries found
+    */
+    template <class T>
+    int lookupKey(const T &key, std::vector<RecordId> &rids);
+
+    /**
+    * Collect the entries equal to a key in a subtree of the committed version of a shadow-paged tree,
+    * through each child whose range holds the key.
+    * @param nodeNum     root of the subtree
+    * @param isLeaf      true if the root of the subtree is a leaf
+    * @param key         key looked for
+    * @param rids        record ids of the entries found, appended to
+    * @return number of entries found
+    */
+    template <class T>
+    int collectEntries(const PageId nodeNum, const bool isLeaf, const T &key, std::vector<RecordId> &rids);
+
+    /**
+    * Body of startScan() for keys of type T, once the scan values of the cursor are set.
+    */
+    template <class T>
+    const void startKeyScan(IndexCursor &cursor);
+
+    /**
+    * Body of scanNext() for keys of type T.
+    * @param cursor  cursor of the scan
+    * @param outRid  RecordId of the next entry
+    */
+    template <class T>
+    const void scanNextKey(IndexCursor &cursor, RecordId& outRid);
+
+    /**
+    * Body of scanNextBatch() for keys of type T.
+    * @param cursor  cursor of the scan
+    * @param outRids set to the record ids of the next entries
+    * @param maxRids most entries returned
+    * @return number of entries returned
+    */
+    template <class T>
+    int scanNextBatchKey(IndexCursor &cursor, RecordId *outRids, const int maxRids);
+
+    /**
+    * Mark the scan of a cursor completed and give back its version of a shadow-paged tree, once its scan
+    * found no more entries.
+    */
+    void completeScan(IndexCursor &cursor);
 
 public:
 
@@ -366,10 +1065,14 @@ public:
      * @param bufMgrIn						Buffer Manager Instance
      * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
      * @param attrType						Datatype of attribute over which index is built
+     * @param codec							Codec of the pages of the index file, if it is created
+     * @param build							How the index file is built, if it is created
      * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+     * @throws  SortException     If bulk loading cannot write or read back a sorted run
      */
     BTreeIndex(const std::string& relationName, std::string& outIndexName,
-               BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
+               BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+               const PageCodec codec = CODEC_NONE, const BuildOptions& build = BuildOptions());
 
 
     /**
@@ -387,11 +1090,72 @@ public:
      * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
      * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
      * Make sure to unpin pages as soon as you can.
-     * @param key			Key to insert, pointer to integer/double/char string
+     * Threads may insert at once, and look up with lookupEntries(), unless the changes are logged.
+     * @param key			Key to insert, pointer to integer/double/char string; only the first STRINGSIZE characters of a string are kept
      * @param rid			Record ID of a record whose entry is getting inserted into the index.
      **/
     const void insertEntry(const void *key, const RecordId rid);
 
+    /**
+     * Record ids of the entries with a key, in key order. Lookups keep no state in the index, and may run on
+     * many threads at once, alongside insertEntry() and scans through cursors of their own on others.
+     * @param key			Key looked for, pointer to integer/double/char string
+     * @param rids			Record ids of the entries found, appended to
+     * @return number of entries found
+     **/
+    int lookupEntries(const void *key, std::vector<RecordId> &rids);
+
+    /**
+     * Delete the entry <key, rid>.
+     * Start from root to find the leaf holding the entry, removing it from the leaf. A node left less than
+     * half full takes entries from a neighbour that can spare some, or is merged with it, which removes a key
+     * from the parent that may leave the parent less than half full in turn. A root left with a single child
+     * is replaced by the child. Pages of merged nodes are reused by later splits and saved in the meta page
+     * when the index is closed, up to METAFREEPAGES of them.
+     * In a tree changed in place no scan may be executing, nor any other thread use the index, as asserted
+     * in builds with assertions: a delete changes nodes without their latches, and moves entries left and
+     * frees merged nodes, which readers that descended before it would not find their way back from.
+     * Scans of a shadow-paged tree read the committed version alongside it. The changes are logged and
+     * shadow paged as those of insertEntry() are.
+     * @param key			Key to delete, pointer to integer/double/char string
+     * @param rid			Record ID of the record whose entry is deleted
+     * @throws  NoSuchKeyFoundException  If the index has no entry <key, rid>
+     **/
+    const void deleteEntry(const void *key, const RecordId rid);
+
+    /**
+     * Log the changes made by later calls to insertEntry() and deleteEntry() as part of a transaction,
+     * each leaf insert as a LOG_INSERT record, each node split with its posting to the parent as LOG_SPLIT
+     * records, each leaf delete as a LOG_DELETE record and each merge or sharing of entries between
+     * nodes as a LOG_PAGE record, so that a crash or an abort of the transaction leaves the tree without
+     * its changes. Nodes a split allocates are marked so in its record, for recovery to allocate them
+     * again if the index file lost its growth in the crash. The root page number is held in memory, so
+     * reopen the index after rolling back a transaction that split the root or replaced it by its only
+     * child.
+     * @param logIn		Write-ahead log of the buffer manager, or NULL to stop logging
+     * @param txnIn		Transaction
+     **/
+    void setLog(LogManager *logIn, const TxnId txnIn);
+
+    /**
+     * Change the tree by shadow paging from now on, for this and later openings of the index file.
+     * insertEntry() writes modified nodes to new pages, and its inserts are seen by scans, and are on
+     * disk, once commitVersion() is called. Pages of older versions are reused once no scan reads them.
+     * Scans of a shadow-paged tree find the next leaf through the parents rather than sibling links, which
+     * copying leaves stale, so getRootPageNum(), childForKey() and countInLeaf() are only meant for it
+     * while no thread inserts. No page of the index may be pinned, as by a scan.
+     * @throws  LogException  If the changes are logged, see setLog()
+     * @throws  PagePinnedException  If a page of the index is pinned
+     **/
+    void enableShadowPaging();
+
+    /**
+     * Make the inserts since the last commit of a shadow-paged tree durable and visible to scans started
+     * from now on: the new nodes are written and synced, then the meta page with the new root, and then
+     * the root is swapped in memory. Inserts not committed when the index is closed are dropped.
+     **/
+    void commitVersion();
+
     /**
      * Begin a filtered scan of the index.  For instance, if the method is called
      * using ("a",GT,"d",LTE) then we should seek all entries with a value
@@ -409,21 +1173,131 @@ public:
      **/
     const void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
 
+    /**
+     * Begin a filtered scan of the index with a cursor, as startScan() does with the index's own, ending
+     * the scan the cursor was running, on this index or another.
+     * @param cursor	Cursor of the scan
+     * @param lowVal	Low value of range, pointer to integer / double / char string
+     * @param lowOp		Low operator (GT/GTE)
+     * @param highVal	High value of range, pointer to integer / double / char string
+     * @param highOp	High operator (LT/LTE)
+     * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+     * @throws  BadScanrangeException If lowVal > highval
+     **/
+    const void startScan(IndexCursor &cursor, const void *lowVal, const Operator lowOp, const void *highVal,
+                         const Operator highOp);
+
 
     /**
      * Fetch the record id of the next index entry that matches the scan.
      * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
+     * Unless the index is shadow-paged, the scan completes on the last entry of the tree: outRid is set
+     * to it and IndexScanCompletedException is thrown in place of returning it, as the scan always has.
      * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
      * @throws ScanNotInitializedException If no scan has been initialized.
      * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
      **/
     const void scanNext(RecordId& outRid);  // returned record id
 
+    /**
+     * Fetch the record id of the next index entry that matches the scan of a cursor.
+     * @param cursor	Cursor of the scan
+     * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+     * @throws ScanNotInitializedException If the cursor is not scanning this index.
+     * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+     **/
+    const void scanNext(IndexCursor &cursor, RecordId& outRid);
+
+    /**
+     * Fetch the record ids of the next index entries that match the scan, copied a leaf at a time
+     * straight from the leaves. Fewer than maxRids are returned only once the scan found no more
+     * entries, after which every call returns 0; the end of the scan throws no exception, so unlike
+     * scanNext() a batch holds the last entry of the tree too. Calls may be mixed with those of scanNext().
+     * @param outRids	Array of at least maxRids record ids, set to the record ids of the entries found
+     * @param maxRids	Most entries returned, at least 1
+     * @return number of entries returned, 0 once the scan completed
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     **/
+    int scanNextBatch(RecordId *outRids, const int maxRids);
+
+    /**
+     * Fetch the record ids of the next index entries that match the scan of a cursor, as scanNextBatch()
+     * does for the scan of the index's own cursor.
+     * @param cursor	Cursor of the scan
+     * @param outRids	Array of at least maxRids record ids, set to the record ids of the entries found
+     * @param maxRids	Most entries returned, at least 1
+     * @return number of entries returned, 0 once the scan completed
+     * @throws ScanNotInitializedException If the cursor is not scanning this index.
+     **/
+    int scanNextBatch(IndexCursor &cursor, RecordId *outRids, const int maxRids);
+
 
     /**
      * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
      * @throws ScanNotInitializedException If no scan has been initialized.
      **/
     const void endScan();
+
+    /**
+     * Terminate the scan of a cursor, unpinning the leaf it holds, after which the cursor may be reused.
+     * @param cursor	Cursor of the scan
+     * @throws ScanNotInitializedException If the cursor is not scanning this index.
+     **/
+    const void endScan(IndexCursor &cursor);
+
+    /**
+     * Index file, for callers that read the nodes of the tree themselves.
+     * @return the index file
+     **/
+    File *getFile() const { return file; }
+
+    /**
+     * Buffer manager through which the index reads its nodes.
+     * @return the buffer manager
+     **/
+    BufMgr *getBufMgr() const { return bufMgr; }
+
+    /**
+     * Change how the keys of a node are searched, which is by default the fastest way the CPU supports.
+     * A vectorized strategy the CPU lacks falls back to the binary search.
+     * @param strategy	Search of the keys of a node
+     **/
+    void setSearchStrategy(const SearchStrategy strategy);
+
+    /**
+     * How the keys of a node are searched.
+     * @return the search strategy
+     **/
+    SearchStrategy getSearchStrategy() const { return searchStrategy; }
+
+    /**
+     * Root of the tree, from which callers reading the nodes themselves, for instance to have many
+     * lookups in flight at once, descend with childForKey() and countInLeaf().
+     * @param isLeaf	Set to true if the root is a leaf
+     * @return page number of the root
+     **/
+    PageId getRootPageNum(bool &isLeaf) const;
+
+    /**
+     * Child of a non-leaf node to descend to when looking for a key, as startScan() does.
+     * T is the type of the keys: int, double or StringKey.
+     * @param node			Page of the non-leaf node, pinned by the caller
+     * @param key			Key looked for
+     * @param childIsLeaf	Set to true if the child is a leaf
+     * @return page number of the child
+     **/
+    template <class T>
+    PageId childForKey(Page *node, const T &key, bool &childIsLeaf);
+
+    /**
+     * Number of entries of a leaf equal to a key.
+     * T is the type of the keys: int, double or StringKey.
+     * @param leaf			Page of the leaf, pinned by the caller
+     * @param key			Key looked for
+     * @param nextLeaf		Set to the right sibling if entries equal to the key may continue there, otherwise 0
+     * @return number of entries found
+     **/
+    template <class T>
+    int countInLeaf(Page *leaf, const T &key, PageId &nextLeaf);
 };
 }
@@ -111,4 +111,27 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
   throw HashNotFoundException(file->filename(), pageNo);
 }
 
+void BufHashTbl::resize(const int htSize)
+{
+  hashBucket** oldHt = ht;
+  int oldSize = HTSIZE;
+
+  HTSIZE = htSize;
+  ht = new hashBucket* [htSize];
+  for(int i=0; i < HTSIZE; i++)
+    ht[i] = NULL;
+
+  for(int i = 0; i < oldSize; i++) {
+    while (oldHt[i]) {
+      hashBucket* tmpBuc = oldHt[i];
+      oldHt[i] = tmpBuc->next;
+
+      int index = hash(tmpBuc->file, tmpBuc->pageNo);
+      tmpBuc->next = ht[index];
+      ht[index] = tmpBuc;
+    }
+  }
+  delete [] oldHt;
+}
+
 }
@@ -104,6 +104,19 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Rehash every entry into a table with the given number of buckets. Entries
+   * are relinked in place; no bucket is reallocated.
+	 *
+	 * @param htSize  New number of buckets
+	 */
+  void resize(const int htSize);
+
+	/**
+   * Returns the number of buckets in the hash table.
+	 */
+  int size() const { return HTSIZE; }
 };
 
 }
@@ -6,13 +6,23 @@
  */
 
 #include <memory>
+#include <new>
 #include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include "buffer.h"
+#include "wal.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 namespace badgerdb { 
 
@@ -20,19 +30,23 @@ namespace badgerdb {
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
-
-  for (FrameId i = 0; i < bufs; i++) 
+BufMgr::BufMgr(std::uint32_t bufs, const int options)
+	: numBufs(bufs), poolFrames(0), poolOptions(options), classHints(true), io(NULL), flushHand(0),
+	  log(NULL), recordReads(false) {
+  for (int i = 0; i < NUM_PAGE_CLASSES; i++)
   {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+  	classFrames[i] = 0;
+  	classQuota[i] = 0;
   }
 
-  bufPool = new Page[bufs];
+  peekBlocks = new std::atomic<FramePeek*>[MAX_PEEK_BLOCKS];
+  for (std::uint32_t i = 0; i < MAX_PEEK_BLOCKS; i++)
+  	peekBlocks[i] = NULL;
+  peekHints = NULL;
+
+  growPool(bufs);
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
+  int htsize = hashTableSize(bufs);
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
 
   clockHand = bufs - 1;
@@ -40,85 +54,839 @@ BufMgr::BufMgr(std::uint32_t bufs)
 
 
 BufMgr::~BufMgr() {
+  if (io != NULL)
+  {
+  	drainIo();
+  	delete io;
+  }
+
   //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  for (std::uint32_t i = 0; i < poolFrames; i++) 
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+  	if (frames.test(frames.valid, i) && frames.test(frames.dirty, i))
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			writeFrame(i);
   	}
   }
 
-  delete [] bufDescTable;
-  delete [] bufPool;
+  while (!poolSegments.empty())
+  {
+  	FrameId start = segmentStart.back();
+  	releaseSegment(poolFrames);
+  	poolFrames = start;
+  }
+  for (std::size_t i = 0; i < retiredSegments.size(); i++)
+  	freeSegment(retiredSegments[i].segment, retiredSegments[i].count, retiredSegments[i].memory,
+  	            retiredSegments[i].bytes);
+  delete hashTable;
+
+  for (std::uint32_t i = 0; i < MAX_PEEK_BLOCKS; i++)
+  	delete [] peekBlocks[i].load();
+  delete [] peekBlocks;
+  delete peekHints.load();
+  for (std::size_t i = 0; i < oldPeekHints.size(); i++)
+  	delete oldPeekHints[i];
+
+  for (std::map<std::pair<std::uint64_t, std::uint64_t>, int>::iterator it = unsyncedFiles.begin();
+       it != unsyncedFiles.end(); ++it)
+  	close(it->second);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+//----------------------------------------
+// Frame table
+//----------------------------------------
+
+void BufFrameTable::resize(std::uint32_t frames)
+{
+  std::uint32_t words = (frames + FRAMES_PER_WORD - 1) / FRAMES_PER_WORD;
+  std::uint32_t kept = frames < numFrames ? frames : numFrames;
+
+  file.resize(frames);
+  pageNo.resize(frames);
+  pinCnt.resize(frames);
+  credit.resize(frames);
+  pageClass.resize(frames);
+  strategy.resize(frames);
+  lsn.resize(frames);
+  recLsn.resize(frames);
+
+  valid.resize(words, 0);
+  refbit.resize(words, 0);
+  pinned.resize(words, 0);
+  dirty.resize(words, 0);
+  credited.resize(words, 0);
+  reading.resize(words, 0);
+  for (int i = 0; i < NUM_PAGE_CLASSES; i++)
+  	classBits[i].resize(words, 0);
+
+  numFrames = frames;
+
+  // the dropped frames are empty, so only the added ones need setting up
+  for (FrameId i = kept; i < frames; i++)
+  	Clear(i);
+}
+
+void BufFrameTable::Clear(FrameId frameNo)
+{
+  file[frameNo] = NULL;
+  pageNo[frameNo] = Page::INVALID_NUMBER;
+  strategy[frameNo] = NORMAL;
+  lsn[frameNo] = 0;
+  recLsn[frameNo] = 0;
+  setPinCnt(frameNo, 0);
+  setCredit(frameNo, 0);
+  assign(classBits[pageClass[frameNo]], frameNo, false);
+  pageClass[frameNo] = PAGE_HEAP;
+  assign(valid, frameNo, false);
+  assign(refbit, frameNo, false);
+  assign(dirty, frameNo, false);
+  assign(reading, frameNo, false);
+}
+
+void BufFrameTable::Set(FrameId frameNo, File* filePtr, PageId pageNum)
+{
+  file[frameNo] = filePtr;
+  pageNo[frameNo] = pageNum;
+  strategy[frameNo] = NORMAL;
+  lsn[frameNo] = 0;
+  recLsn[frameNo] = 0;
+  setPinCnt(frameNo, 1);
+  setCredit(frameNo, 0);
+  assign(classBits[pageClass[frameNo]], frameNo, false);
+  pageClass[frameNo] = PAGE_HEAP;
+  assign(classBits[PAGE_HEAP], frameNo, true);
+  assign(valid, frameNo, true);
+  assign(refbit, frameNo, true);
+  assign(dirty, frameNo, false);
+}
+
+void BufFrameTable::Copy(FrameId to, FrameId from)
+{
+  file[to] = file[from];
+  pageNo[to] = pageNo[from];
+  strategy[to] = strategy[from];
+  lsn[to] = lsn[from];
+  recLsn[to] = recLsn[from];
+  setPinCnt(to, pinCnt[from]);
+  setCredit(to, credit[from]);
+  assign(classBits[pageClass[to]], to, false);
+  pageClass[to] = pageClass[from];
+  assign(classBits[pageClass[to]], to, test(valid, from));
+  assign(valid, to, test(valid, from));
+  assign(refbit, to, test(refbit, from));
+  assign(dirty, to, test(dirty, from));
+  assign(reading, to, test(reading, from));
+}
+
+void BufFrameTable::Print(FrameId frameNo) const
+{
+  if(file[frameNo] != NULL)
+  {
+  	std::cout << "file:" << file[frameNo]->filename() << " ";
+  	std::cout << "pageNo:" << pageNo[frameNo] << " ";
+  }
+  else
+  	std::cout << "file:NULL ";
+
+  std::cout << "valid:" << test(valid, frameNo) << " ";
+  std::cout << "pinCnt:" << pinCnt[frameNo] << " ";
+  std::cout << "dirty:" << test(dirty, frameNo) << " ";
+  std::cout << "class:" << pageClass[frameNo] << " ";
+  std::cout << "refbit:" << test(refbit, frameNo) << "\n";
+}
+
+bool BufFrameTable::sweep(FrameId& hand, std::uint32_t numBufs, std::uint32_t maxScans, const int onlyClass,
+                          std::uint32_t& refsCleared)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
   std::uint32_t numScanned = 0;
-  bool found = 0;
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  while (numScanned < maxScans)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    // the frames from the one after the hand to the end of its word
+    FrameId start = (hand + 1) % numBufs;
+    std::uint32_t w = start / FRAMES_PER_WORD;
+    std::uint32_t first = start % FRAMES_PER_WORD;
+    std::uint32_t last = numBufs - w * FRAMES_PER_WORD;
+    if (last > FRAMES_PER_WORD)
+      last = FRAMES_PER_WORD;
+    if (last - first > maxScans - numScanned)
+      last = first + (maxScans - numScanned);
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
-    {
-      break;
-    }
+    std::uint64_t range = (last == FRAMES_PER_WORD ? ~std::uint64_t(0) : (std::uint64_t(1) << last) - 1) &
+                          ~((std::uint64_t(1) << first) - 1);
+
+    // a class at its quota only looks at its own pages, and never at free frames
+    std::uint64_t looked = valid[w] & range;
+    std::uint64_t freeFrames = 0;
+    if (onlyClass >= 0)
+      looked &= classBits[onlyClass][w];
+    else
+      freeFrames = ~valid[w] & range;
+
+    // a referenced frame has its bit cleared, else a frame with credit uses one up, else it is a victim if unpinned
+    std::uint64_t referenced = refbit[w] & looked;
+    std::uint64_t withCredit = credited[w] & looked & ~referenced;
+    std::uint64_t victims = (looked & ~referenced & ~withCredit & ~pinned[w]) | freeFrames;
+
+    // only the frames ahead of the victim are passed over
+    std::uint32_t stop = last;
+    if (victims)
+      stop = __builtin_ctzll(victims);
+    std::uint64_t passed = stop == FRAMES_PER_WORD ? ~std::uint64_t(0) : (std::uint64_t(1) << stop) - 1;
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    referenced &= passed;
+    refbit[w] &= ~referenced;
+    refsCleared += __builtin_popcountll(referenced);
+
+    withCredit &= passed;
+    while (withCredit)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
+      FrameId frameNo = w * FRAMES_PER_WORD + __builtin_ctzll(withCredit);
+      setCredit(frameNo, credit[frameNo] - 1);
+      withCredit &= withCredit - 1;
     }
-    else
+
+    if (victims)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      hand = w * FRAMES_PER_WORD + stop;
+      return true;
     }
+
+    hand = w * FRAMES_PER_WORD + last - 1;
+    numScanned += last - first;
+  }
+
+  return false;
+}
+
+//----------------------------------------
+// Buffer pool
+//----------------------------------------
+
+void BufMgr::growPool(std::uint32_t bufs)
+{
+  if (bufs <= poolFrames)
+  	return;
+
+  frames.resize(bufs);
+
+  // allocate the new frames a block at a time so that shrinking can give them back
+  while (poolFrames < bufs)
+  {
+  	std::uint32_t count = bufs - poolFrames;
+  	if (count > FRAMES_PER_SEGMENT)
+  		count = FRAMES_PER_SEGMENT;
+
+  	Page* segment = allocSegment(count, poolFrames);
+  	for (std::uint32_t i = 0; i < count; i++)
+  		bufPool.push_back(&segment[i]);
+  	poolFrames += count;
+  }
+
+  // the new frames get their FramePeek, and the hints a table with room for them
+  for (std::uint32_t b = 0; b < MAX_PEEK_BLOCKS && b * PEEK_BLOCK_FRAMES < bufs; b++)
+  	if (peekBlocks[b].load(std::memory_order_relaxed) == NULL)
+  		peekBlocks[b].store(new FramePeek[PEEK_BLOCK_FRAMES], std::memory_order_release);
+
+  std::vector<std::atomic<FrameId> >* hints = peekHints.load(std::memory_order_relaxed);
+  if (hints != NULL && hints->size() >= 2 * (std::size_t) bufs)
+  	return;
+
+  std::size_t slots = 1;
+  while (slots < 2 * (std::size_t) bufs)
+  	slots *= 2;
+  std::vector<std::atomic<FrameId> >* grown = new std::vector<std::atomic<FrameId> >(slots);
+  for (FrameId i = 0; i < poolFrames; i++)
+  {
+  	FramePeek* peek = framePeek(i);
+  	if (peek != NULL && !(peek->version.load(std::memory_order_relaxed) & 1))
+  		(*grown)[peekHash(frames.file[i], frames.pageNo[i], slots)].store(i + 1, std::memory_order_relaxed);
+  }
+  peekHints.store(grown, std::memory_order_release);
+
+  // readers may still be looking at the table replaced
+  if (hints != NULL)
+  	oldPeekHints.push_back(hints);
+}
+
+Page* BufMgr::allocSegment(std::uint32_t count, FrameId start)
+{
+  std::size_t bytes = count * sizeof(Page);
+  void* memory = NULL;
+  SegmentMemory kind = SEGMENT_HEAP;
+
+  if (poolOptions & POOL_HUGE_PAGES)
+  {
+  	// whole huge pages only; the reserved pool is tried first, then transparent huge pages
+  	bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  	memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  	if (memory != MAP_FAILED)
+  		kind = SEGMENT_HUGETLB;
+  	else if (posix_memalign(&memory, HUGE_PAGE_SIZE, bytes) == 0)
+  	{
+  		madvise(memory, bytes, MADV_HUGEPAGE);
+  		kind = SEGMENT_THP;
+  	}
+  	else
+  		memory = NULL;
+  }
+
+  if (memory == NULL && (poolOptions & POOL_DIRECT_IO))
+  {
+  	bytes = count * sizeof(Page);
+  	if (posix_memalign(&memory, File::DIRECT_IO_ALIGNMENT, bytes) != 0)
+  		throw std::bad_alloc();
+  	kind = SEGMENT_ALIGNED;
+  }
+
+  Page* segment;
+  if (memory == NULL)
+  {
+  	bytes = count * sizeof(Page);
+  	segment = new Page[count];
+  }
+  else
+  {
+  	segment = static_cast<Page*>(memory);
+  	for (std::uint32_t i = 0; i < count; i++)
+  		new (&segment[i]) Page();
+  }
+
+  poolSegments.push_back(segment);
+  segmentStart.push_back(start);
+  segmentMemory.push_back(kind);
+  segmentBytes.push_back(bytes);
+  return segment;
+}
+
+void BufMgr::releaseSegment(FrameId end, const bool keep)
+{
+  Page* segment = poolSegments.back();
+  std::uint32_t count = end - segmentStart.back();
+
+  if (keep)
+  {
+  	RetiredSegment retired;
+  	retired.segment = segment;
+  	retired.count = count;
+  	retired.memory = segmentMemory.back();
+  	retired.bytes = segmentBytes.back();
+  	retiredSegments.push_back(retired);
+  }
+  else
+  	freeSegment(segment, count, segmentMemory.back(), segmentBytes.back());
+
+  poolSegments.pop_back();
+  segmentStart.pop_back();
+  segmentMemory.pop_back();
+  segmentBytes.pop_back();
+}
+
+void BufMgr::freeSegment(Page* segment, std::uint32_t count, SegmentMemory memory, std::size_t bytes)
+{
+  if (memory == SEGMENT_HEAP)
+  	delete [] segment;
+  else
+  {
+  	for (std::uint32_t i = 0; i < count; i++)
+  		segment[i].~Page();
+  	if (memory == SEGMENT_HUGETLB)
+  		munmap(segment, bytes);
+  	else
+  		free(segment);
+  }
+}
+
+void BufMgr::readFrame(File* file, const PageId pageNo, FrameId frameNo)
+{
+  int fd = usesDirectIo() ? file->directDescriptor() : -1;
+  if (fd >= 0)
+  {
+  	file->beginRawRead(pageNo);
+  	ssize_t ret = pread(fd, bufPool[frameNo], Page::SIZE, file->pageOffset(pageNo));
+  	if (ret == Page::SIZE)
+  	{
+  		file->endRawRead(pageNo, *bufPool[frameNo]);
+  		return;
+  	}
+  	// a short or refused read is retried through the stream, which reports it as the file does
+  }
+  *bufPool[frameNo] = file->readPage(pageNo);
+}
+
+bool BufMgr::takeCompressed(File* file, const PageId pageNo, FrameId frameNo)
+{
+  if (!compressedCache.enabled() || !compressedCache.take(file, pageNo, *bufPool[frameNo]))
+  	return false;
+  bufStats.tierhits++;
+  return true;
+}
+
+void BufMgr::forceLog(FrameId frameNo)
+{
+  if (log != NULL && frames.lsn[frameNo] != 0)
+  	log->flush(frames.lsn[frameNo]);
+}
+
+void BufMgr::writeFrame(FrameId frameNo)
+{
+  forceLog(frameNo);
+
+  File* file = frames.file[frameNo];
+  PageId pageNo = frames.pageNo[frameNo];
+  int fd = usesDirectIo() ? file->directDescriptor() : -1;
+  bool written = false;
+  if (fd >= 0)
+  {
+  	// the image has to be adjusted in place, as it is the aligned buffer written
+  	file->beginRawWrite(pageNo, *bufPool[frameNo]);
+  	written = pwrite(fd, bufPool[frameNo], Page::SIZE, file->pageOffset(pageNo)) == Page::SIZE;
   }
+  if (!written)
+  	file->writePage(pageNo, *bufPool[frameNo]);
+  frameWritten(frameNo);
+}
+
+void BufMgr::frameWritten(FrameId frameNo)
+{
+  frames.recLsn[frameNo] = 0;
+  if (log == NULL)
+  	return;
+
+  // a file is known by its inode, as a File object may be gone and another in its place by the sync
+  struct stat st;
+  int fd = frames.file[frameNo]->descriptor();
+  if (fstat(fd, &st) != 0)
+  	return;
+  std::pair<std::uint64_t, std::uint64_t> key(st.st_dev, st.st_ino);
+  if (unsyncedFiles.find(key) == unsyncedFiles.end())
+  {
+  	int copy = dup(fd);
+  	if (copy >= 0)
+  		unsyncedFiles[key] = copy;
+  }
+}
+
+void BufMgr::setLog(LogManager* log)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  this->log = log;
+}
+
+void BufMgr::setPageLsn(File* file, const PageId pageNo, const Lsn lsn)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  FrameId frameNo;
+  hashTable->lookup(file, pageNo, frameNo);
+  frames.lsn[frameNo] = lsn;
+  if (frames.recLsn[frameNo] == 0)
+  	frames.recLsn[frameNo] = lsn;
+}
+
+void BufMgr::getDirtyPages(std::vector<DirtyPage>& pages)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  pages.clear();
+  for (FrameId i = 0; i < poolFrames; i++)
+  {
+  	if (!frames.test(frames.valid, i) || frames.recLsn[i] == 0)
+  		continue;
+  	DirtyPage page = { frames.file[i]->filename(), frames.pageNo[i], frames.recLsn[i] };
+  	pages.push_back(page);
+  }
+}
+
+std::uint32_t BufMgr::writeOldestPages(const std::uint32_t maxPages)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  std::vector<std::pair<Lsn, FrameId> > oldest;
+  for (FrameId i = 0; i < poolFrames; i++)
+  	if (frames.recLsn[i] != 0 && frames.test(frames.dirty, i) && frames.pinCnt[i] == 0)
+  		oldest.push_back(std::make_pair(frames.recLsn[i], i));
+  if (oldest.size() > maxPages)
+  {
+  	std::nth_element(oldest.begin(), oldest.begin() + maxPages, oldest.end());
+  	oldest.resize(maxPages);
+  }
+
+  std::uint32_t written = 0;
+  for (std::size_t i = 0; i < oldest.size(); i++)
+  {
+  	FrameId frameNo = oldest[i].second;
+  	try
+  	{
+  		writeFrame(frameNo);
+  	}
+  	catch (InvalidPageException e)
+  	{
+  		continue;
+  	}
+  	frames.assign(frames.dirty, frameNo, false);
+  	bufStats.diskwrites++;
+  	written++;
+  }
+  return written;
+}
+
+void BufMgr::syncWrittenFiles()
+{
+  std::map<std::pair<std::uint64_t, std::uint64_t>, int> files;
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	files.swap(unsyncedFiles);
+  }
+
+  for (std::map<std::pair<std::uint64_t, std::uint64_t>, int>::iterator it = files.begin(); it != files.end(); ++it)
+  {
+  	fdatasync(it->second);
+  	close(it->second);
+  }
+}
+
+void BufMgr::writePages(File* file, const std::vector<PageId>& pageNos)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  for (std::size_t i = 0; i < pageNos.size(); i++)
+  {
+  	FrameId frameNo;
+  	try
+  	{
+  		hashTable->lookup(file, pageNos[i], frameNo);
+  	}
+  	catch (HashNotFoundException e)
+  	{
+  		continue;
+  	}
+  	if (!frames.test(frames.dirty, frameNo))
+  		continue;
+  	writeFrame(frameNo);
+  	frames.assign(frames.dirty, frameNo, false);
+  	bufStats.diskwrites++;
+  }
+}
+
+const char* BufMgr::getPoolMemory()
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  static const char* names[] = { "heap", "aligned", "thp", "hugetlb" };
+  return segmentMemory.empty() ? names[SEGMENT_HEAP] : names[segmentMemory.front()];
+}
+
+void BufMgr::retireFrame(FrameId frameNo, FrameId &freeScan)
+{
+  if (!frames.test(frames.valid, frameNo))
+  	return;
+
+  // look for a free frame below the pool size to migrate the page into
+  while (freeScan < numBufs && frames.test(frames.valid, freeScan))
+  	freeScan++;
+
+  if (freeScan < numBufs)
+  {
+  	FrameId target = freeScan++;
+  	*bufPool[target] = *bufPool[frameNo];
+  	frames.Copy(target, frameNo);
+
+  	hashTable->remove(frames.file[frameNo], frames.pageNo[frameNo]);
+  	hashTable->insert(frames.file[frameNo], frames.pageNo[frameNo], target);
+
+  	// the page and its class count move with it
+  	unpublishFrame(frameNo);
+  	frames.Clear(frameNo);
+  }
+  else
+  {
+  	// no room left, so the page leaves the buffer pool
+  	if (frames.test(frames.dirty, frameNo))
+  	{
+  		bufStats.diskwrites++;
+  		writeFrame(frameNo);
+  	}
+  	hashTable->remove(frames.file[frameNo], frames.pageNo[frameNo]);
+  	clearFrame(frameNo);
+  }
+}
+
+void BufMgr::trimPool()
+{
+  // find the highest frame still in use
+  FrameId top = poolFrames;
+  while (top > numBufs && !frames.test(frames.valid, top - 1))
+  	top--;
+
+  if (top == poolFrames)
+  	return;
+
+  // release every block lying entirely above it
+  std::uint32_t kept = poolFrames;
+  while (!segmentStart.empty() && segmentStart.back() >= top)
+  {
+  	FrameId start = segmentStart.back();
+  	releaseSegment(kept, true);
+  	kept = start;
+  }
+
+  if (kept == poolFrames)
+  	return;
+
+  frames.resize(kept);
+  bufPool.resize(kept);
+  poolFrames = kept;
+}
+
+void BufMgr::resize(std::uint32_t bufs)
+{
+  assert(bufs > 0);
+
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+
+  	if (bufs >= numBufs)
+  	{
+  		growPool(bufs);
+  		numBufs = bufs;
+  		hashTable->resize(hashTableSize(bufs));
+  		return;
+  	}
+
+  	// stop the clock from handing out frames above the new size
+  	numBufs = bufs;
+  	clockHand = bufs - 1;
+  }
+
+  // empty the frames above the new size a batch at a time, letting other callers in between batches
+  const std::uint32_t batch = 64;
+  FrameId freeScan = 0;
+  for (FrameId start = bufs; ; start += batch)
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+
+  	// a later resize has taken over
+  	if (numBufs != bufs || start >= poolFrames)
+  		break;
+
+  	FrameId end = start + batch < poolFrames ? start + batch : poolFrames;
+  	for (FrameId i = start; i < end; i++)
+  	{
+  		if (frames.test(frames.valid, i) && frames.pinCnt[i] == 0)
+  			retireFrame(i, freeScan);
+  	}
+  }
+
+  std::lock_guard<std::mutex> guard(latch);
+  if (numBufs == bufs)
+  {
+  	trimPool();
+  	hashTable->resize(hashTableSize(bufs));
+  }
+}
+
+void BufMgr::allocBuf(FrameId & frame, const PageClass pageClass) 
+{
+  // perform first part of clock algorithm to search for 
+  // open buffer frame
+  // a class at its quota replaces one of its own pages if it can
+  bool restrictToClass = classHints && classQuota[pageClass] > 0 &&
+                         classFrames[pageClass] >= classQuota[pageClass];
+  std::uint32_t maxScans = (2 + classCredit(PAGE_INDEX_INTERIOR)) * numBufs;	//Need to scan until every credit is used up
+  std::uint32_t refsCleared = 0;
+  bool found = frames.sweep(clockHand, numBufs, maxScans, restrictToClass ? pageClass : -1, refsCleared);
+
+  // frames pinned by reads and writes in flight are released once these complete
+  if (!found && io != NULL && io->inFlight() > 0)
+  {
+    drainIo();
+    found = frames.sweep(clockHand, numBufs, maxScans, restrictToClass ? pageClass : -1, refsCleared);
+  }
+
+  // every page of the class is pinned, so take any frame after all
+  if (!found && restrictToClass)
+    found = frames.sweep(clockHand, numBufs, maxScans, -1, refsCleared);
+  bufStats.accesses += refsCleared;
   
   // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  if (!found)
   {
     throw BufferExceededException();
   }
+
+  // remove previous entry from hash table
+  if (frames.test(frames.valid, clockHand))
+    hashTable->remove(frames.file[clockHand], frames.pageNo[clockHand]);
   
   // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  if (frames.test(frames.dirty, clockHand))
   {
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    writeFrame(clockHand);
   }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  // the page is clean by now, so the compressed tier may keep it
+  if (compressedCache.enabled() && frames.test(frames.valid, clockHand) &&
+      frames.strategy[clockHand] == NORMAL && frames.pageClass[clockHand] != PAGE_TEMP)
+    compressedCache.put(frames.file[clockHand], frames.pageNo[clockHand], *bufPool[clockHand]);
+
+	//Reset the frame table entry for the frame before returning the frame
+  clearFrame(clockHand);
 
   // return new frame number
   frame = clockHand;
 } // end allocBuf
 
+
+void BufMgr::clearFrame(FrameId frameNo)
+{
+  unpublishFrame(frameNo);
+  if (frames.test(frames.valid, frameNo))
+  	classFrames[frames.pageClass[frameNo]]--;
+  frames.Clear(frameNo);
+}
+
+void BufMgr::assignFrame(FrameId frameNo, File* file, const PageId pageNo,
+                         const AccessStrategy strategy, PageClass pageClass)
+{
+  if (!classHints)
+  	pageClass = PAGE_HEAP;
+
+  frames.Set(frameNo, file, pageNo);
+  frames.strategy[frameNo] = strategy;
+  frames.setClass(frameNo, pageClass);
+  frames.setCredit(frameNo, classCredit(pageClass));
+  classFrames[pageClass]++;
+
+  // ring and temporary pages are replaced before anything that was referenced
+  if (strategy != NORMAL || pageClass == PAGE_TEMP)
+  {
+  	frames.assign(frames.refbit, frameNo, false);
+  	frames.setCredit(frameNo, 0);
+  }
+}
+
+FramePeek* BufMgr::framePeek(FrameId frameNo) const
+{
+  std::uint32_t block = frameNo / PEEK_BLOCK_FRAMES;
+  if (block >= MAX_PEEK_BLOCKS)
+  	return NULL;
+
+  FramePeek* peeks = peekBlocks[block].load(std::memory_order_acquire);
+  return peeks == NULL ? NULL : &peeks[frameNo % PEEK_BLOCK_FRAMES];
+}
+
+void BufMgr::publishFrame(FrameId frameNo)
+{
+  FramePeek* peek = framePeek(frameNo);
+  if (peek == NULL)
+  	return;
+
+  std::uint64_t version = peek->version.load(std::memory_order_relaxed);
+  if (version & 1)
+  {
+  	peek->file.store(frames.file[frameNo], std::memory_order_relaxed);
+  	peek->pageNo.store(frames.pageNo[frameNo], std::memory_order_relaxed);
+  	peek->page.store(bufPool[frameNo], std::memory_order_relaxed);
+  	peek->version.store(version + 1, std::memory_order_release);
+  }
+
+  std::vector<std::atomic<FrameId> >& hints = *peekHints.load(std::memory_order_relaxed);
+  hints[peekHash(frames.file[frameNo], frames.pageNo[frameNo], hints.size())].store(frameNo + 1,
+                                                                                   std::memory_order_relaxed);
+}
+
+void BufMgr::unpublishFrame(FrameId frameNo)
+{
+  FramePeek* peek = framePeek(frameNo);
+  if (peek == NULL)
+  	return;
+
+  std::uint64_t version = peek->version.load(std::memory_order_relaxed);
+  if (!(version & 1))
+  {
+  	peek->version.store(version + 1, std::memory_order_relaxed);
+  	// readers seeing the frame read into or copied from after see the odd version too
+  	std::atomic_thread_fence(std::memory_order_release);
+  }
+}
+
+void BufMgr::referenceFrame(FrameId frameNo, const AccessStrategy strategy, PageClass pageClass)
+{
+  // a ring access leaves the page where it is
+  if (strategy != NORMAL)
+  	return;
+
+  if (!classHints)
+  	pageClass = PAGE_HEAP;
+
+  // a normal access moves a ring page into the shared pool
+  frames.strategy[frameNo] = NORMAL;
+  classFrames[frames.pageClass[frameNo]]--;
+  classFrames[pageClass]++;
+  frames.setClass(frameNo, pageClass);
+  frames.setCredit(frameNo, classCredit(pageClass));
+  frames.assign(frames.refbit, frameNo, pageClass != PAGE_TEMP);
+}
+
+void BufMgr::setClassQuota(const PageClass pageClass, const std::uint32_t frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  classQuota[pageClass] = frames;
+}
+
+void BufMgr::allocRingBuf(AccessStrategy strategy, FrameId & frame, const PageClass pageClass)
+{
+  BufRing& ring = bufRings[strategy];
+
+  // a ring takes at most an eighth of the pool
+  std::uint32_t ringSize = numBufs / 8;
+  if (ringSize > BULK_RING_FRAMES)
+  	ringSize = BULK_RING_FRAMES;
+  if (ringSize == 0)
+  	ringSize = 1;
+
+  if (ring.frames.size() != ringSize)
+  {
+  	ring.frames.assign(ringSize, static_cast<FrameId>(-1));
+  	ring.next = 0;
+  }
+
+  FrameId& slot = ring.frames[ring.next];
+  ring.next = (ring.next + 1) % ringSize;
+
+  if (slot < numBufs)
+  {
+  	bool valid = frames.test(frames.valid, slot);
+
+  	// recycle the frame unless someone pinned it or it has since joined the shared pool
+  	if (!valid || (frames.strategy[slot] == strategy && frames.pinCnt[slot] == 0))
+  	{
+  		if (valid)
+  		{
+  			if (frames.test(frames.dirty, slot))
+  			{
+  				bufStats.diskwrites++;
+  				writeFrame(slot);
+  			}
+  			hashTable->remove(frames.file[slot], frames.pageNo[slot]);
+  		}
+  		clearFrame(slot);
+  		frame = slot;
+  		return;
+  	}
+  }
+
+  allocBuf(frame, pageClass);
+  slot = frame;
+}
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, const AccessStrategy strategy,
+                      const PageClass pageClass)
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
@@ -126,121 +894,678 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 	{
   	hashTable->lookup(file, pageNo, frameNo);
 
+    // wait for a read-ahead of the page; if it failed the page is read below
+    while (frames.test(frames.reading, frameNo))
+    {
+      reapIo(1);
+      hashTable->lookup(file, pageNo, frameNo);
+    }
+
+    if (missRatioCurve.enabled())
+      missRatioCurve.access(file, pageNo);
+
     // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+    referenceFrame(frameNo, strategy, pageClass);
+    frames.setPinCnt(frameNo, frames.pinCnt[frameNo] + 1);
+    page = bufPool[frameNo];
+    publishFrame(frameNo);
   }
   catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
   {
+    if (missRatioCurve.enabled())
+      missRatioCurve.access(file, pageNo);
+
     // alloc a new frame
-    allocBuf(frameNo);
+    if (strategy == NORMAL)
+      allocBuf(frameNo, pageClass);
+    else
+      allocRingBuf(strategy, frameNo, pageClass);
 
     // read the page into the new frame
-    bufStats.diskreads++;
     //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    if (!takeCompressed(file, pageNo, frameNo))
+    {
+      bufStats.diskreads++;
+      readFrame(file, pageNo, frameNo);
+    }
 
     // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+    assignFrame(frameNo, file, pageNo, strategy, pageClass);
+    page = bufPool[frameNo];
 
     // insert in the hash table
     hashTable->insert(file, pageNo, frameNo);
+    publishFrame(frameNo);
+  }
+}
+
+
+Page* BufMgr::peekPage(File* file, const PageId pageNo, PagePeek& peek)
+{
+  // the hint names the frame the page was last given, which may have been given another since
+  const std::vector<std::atomic<FrameId> >& hints = *peekHints.load(std::memory_order_acquire);
+  FrameId hint = hints[peekHash(file, pageNo, hints.size())].load(std::memory_order_relaxed);
+  FramePeek* framePeeked = hint == 0 ? NULL : framePeek(hint - 1);
+  if (framePeeked == NULL)
+  	return NULL;
+
+  std::uint64_t version = framePeeked->version.load(std::memory_order_acquire);
+  if ((version & 1) || framePeeked->file.load(std::memory_order_relaxed) != file ||
+      framePeeked->pageNo.load(std::memory_order_relaxed) != pageNo)
+  	return NULL;
+
+  peek.frameNo = hint - 1;
+  peek.version = version;
+  return framePeeked->page.load(std::memory_order_relaxed);
+}
+
+bool BufMgr::validatePeek(const PagePeek& peek)
+{
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return framePeek(peek.frameNo)->version.load(std::memory_order_relaxed) == peek.version;
+}
+
+
+void BufMgr::readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages,
+                       const PageClass pageClass)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  pages.assign(pageNos.size(), NULL);
+
+  // visit the pages in page order, so that each is looked up once and runs of missing pages are adjacent
+  std::vector<std::pair<PageId, std::size_t> > order(pageNos.size());
+  for (std::size_t i = 0; i < pageNos.size(); i++)
+  	order[i] = std::make_pair(pageNos[i], i);
+  std::sort(order.begin(), order.end());
+
+  std::vector<FrameId> hitFrames;
+  std::vector<PageId> missPages;
+  std::vector<FrameId> missFrames;
+  std::vector<PageId> readPageNos;
+  std::vector<FrameId> readFrameNos;
+  try
+  {
+  	for (std::size_t i = 0; i < order.size(); )
+  	{
+  		PageId pageNo = order[i].first;
+  		std::size_t next = i + 1;
+  		while (next < order.size() && order[next].first == pageNo)
+  			next++;
+
+  		if (missRatioCurve.enabled())
+  			for (std::size_t j = i; j < next; j++)
+  				missRatioCurve.access(file, pageNo);
+
+  		FrameId frameNo = 0;
+  		bool hit = true;
+  		try
+  		{
+  			hashTable->lookup(file, pageNo, frameNo);
+  			while (frames.test(frames.reading, frameNo))
+  			{
+  				reapIo(1);
+  				hashTable->lookup(file, pageNo, frameNo);
+  			}
+  		}
+  		catch (HashNotFoundException e)
+  		{
+  			hit = false;
+  		}
+
+  		if (hit)
+  		{
+  			referenceFrame(frameNo, NORMAL, pageClass);
+  			frames.setPinCnt(frameNo, frames.pinCnt[frameNo] + (next - i));
+  			hitFrames.insert(hitFrames.end(), next - i, frameNo);
+  		}
+  		else
+  		{
+  			allocBuf(frameNo, pageClass);
+  			assignFrame(frameNo, file, pageNo, NORMAL, pageClass);
+  			frames.setPinCnt(frameNo, next - i);
+  			hashTable->insert(file, pageNo, frameNo);
+  			missPages.push_back(pageNo);
+  			missFrames.push_back(frameNo);
+  			if (!takeCompressed(file, pageNo, frameNo))
+  			{
+  				readPageNos.push_back(pageNo);
+  				readFrameNos.push_back(frameNo);
+  			}
+  		}
+
+  		for (std::size_t j = i; j < next; j++)
+  			pages[order[j].second] = bufPool[frameNo];
+  		i = next;
+  	}
+
+  	readFrames(file, readPageNos, readFrameNos);
+  }
+  catch (...)
+  {
+  	// leave the pool as it was
+  	for (std::size_t i = 0; i < missFrames.size(); i++)
+  	{
+  		hashTable->remove(file, missPages[i]);
+  		clearFrame(missFrames[i]);
+  	}
+  	for (std::size_t i = 0; i < hitFrames.size(); i++)
+  		releasePin(hitFrames[i]);
+  	pages.assign(pageNos.size(), NULL);
+  	throw;
   }
 }
 
+void BufMgr::readFrames(File* file, const std::vector<PageId>& pageNos, const std::vector<FrameId>& frameNos)
+{
+  int fd = usesDirectIo() && file->directDescriptor() >= 0 ? file->directDescriptor() : file->descriptor();
+  if (file->isCompressed())
+  	fd = -1;
+  struct iovec iov[READ_RUN_PAGES];
+
+  std::size_t begin = 0;
+  while (begin < pageNos.size())
+  {
+  	std::size_t end = begin + 1;
+  	while (end < pageNos.size() && end - begin < READ_RUN_PAGES && pageNos[end] == pageNos[end - 1] + 1)
+  		end++;
+  	bufStats.diskreads += end - begin;
+
+  	// the file only checks that a page number is in range, so the last page of the run stands for all
+  	ssize_t ret = -1;
+  	if (fd >= 0)
+  	{
+  		file->beginRawRead(pageNos[end - 1]);
+  		for (std::size_t i = begin; i < end; i++)
+  		{
+  			iov[i - begin].iov_base = bufPool[frameNos[i]];
+  			iov[i - begin].iov_len = Page::SIZE;
+  		}
+  		ret = preadv(fd, iov, end - begin, file->pageOffset(pageNos[begin]));
+  	}
+
+  	for (std::size_t i = begin; i < end; i++)
+  	{
+  		if (ret >= static_cast<ssize_t>((i - begin + 1) * Page::SIZE))
+  			file->endRawRead(pageNos[i], *bufPool[frameNos[i]]);
+  		else
+  			readFrame(file, pageNos[i], frameNos[i]);
+  	}
+  	begin = end;
+  }
+}
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  if (dirty == true) frames.assign(frames.dirty, frameNo, true);
 
   // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  if (frames.pinCnt[frameNo] == 0)
   {
   	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
   }
-  else bufDescTable[frameNo].pinCnt--;
+  else releasePin(frameNo);
+}
+
+void BufMgr::releasePin(FrameId frameNo)
+{
+  frames.setPinCnt(frameNo, frames.pinCnt[frameNo] - 1);
+
+  // last pin on a frame left above the pool size by a shrink
+  if (frameNo >= numBufs && frames.pinCnt[frameNo] == 0)
+  {
+  	FrameId freeScan = 0;
+  	retireFrame(frameNo, freeScan);
+  	trimPool();
+  }
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  std::lock_guard<std::mutex> guard(latch);
+
+  // pages of the file may be pinned by reads and writes in flight
+  drainIo();
+
+  for (std::uint32_t i = 0; i < poolFrames; i++)
 	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
+  	bool valid = frames.test(frames.valid, i);
+  	if(valid == true && frames.file[i] == file)
 		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+	    if (frames.pinCnt[i] > 0)
+  			throw PagePinnedException(file->filename(), frames.pageNo[i], i);
 
-	    if (tmpbuf->dirty == true)
+	    if (frames.test(frames.dirty, i) == true)
 			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
+				writeFrame(i);
+				frames.assign(frames.dirty, i, false);
     	}
 
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
+    	hashTable->remove(file,frames.pageNo[i]);
+    	clearFrame(i);
   	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+		else if (valid == false && frames.file[i] == file)
+  		throw BadBufferException(i, frames.test(frames.dirty, i), valid, frames.test(frames.refbit, i));
   }
+
+  // the file may be closed once flushed, and another opened at the same address
+  compressedCache.eraseFile(file);
+  trimPool();
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+  drainIo();
+  compressedCache.erase(file, pageNo);
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
 	// clear the page
-	bufDescTable[frameNo].Clear();
+	clearFrame(frameNo);
 
 	hashTable->remove(file, pageNo);
+	if (frameNo >= numBufs)
+		trimPool();
 
   // deallocate it in the file	
   file->deletePage(pageNo);
 }
 
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page, const AccessStrategy strategy,
+                       const PageClass pageClass) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  if (strategy == NORMAL)
+    allocBuf(frameNo, pageClass);
+  else
+    allocRingBuf(strategy, frameNo, pageClass);
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  *bufPool[frameNo] = file->allocatePage(pageNo);
+  compressedCache.erase(file, pageNo);
+  page = bufPool[frameNo];
+
+  if (missRatioCurve.enabled())
+    missRatioCurve.access(file, pageNo);
 
   // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  assignFrame(frameNo, file, pageNo, strategy, pageClass);
 
   // insert in the hash table
   hashTable->insert(file, pageNo, frameNo);
+  publishFrame(frameNo);
+}
+
+void BufMgr::setMissRatioSampling(const double rate, const std::uint32_t maxSamples)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  missRatioCurve.reset(rate, maxSamples);
+}
+
+double BufMgr::estimateHitRatio(const std::uint32_t bufs)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return missRatioCurve.hitRatio(bufs);
+}
+
+std::uint64_t BufMgr::estimateWorkingSet()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return missRatioCurve.workingSet();
+}
+
+void BufMgr::setCompressedCacheSize(const std::size_t bytes)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  compressedCache.setBudget(bytes);
+}
+
+std::size_t BufMgr::getCompressedCachePages()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return compressedCache.pages();
+}
+
+std::size_t BufMgr::getCompressedCacheBytes()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return compressedCache.bytes();
+}
+
+//----------------------------------------
+// Asynchronous I/O
+//----------------------------------------
+
+bool BufMgr::enableAsyncIo(const std::uint32_t queueDepth, const IoBackendKind kind)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  IoBackend* backend = IoBackend::create(queueDepth, kind);
+  if (backend == NULL)
+  	return false;
+
+  if (io != NULL)
+  {
+  	drainIo();
+  	delete io;
+  }
+  io = backend;
+  return true;
+}
+
+const char* BufMgr::getAsyncIoBackend()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return io != NULL ? io->name() : "none";
+}
+
+void BufMgr::submitIo(PageIo* request)
+{
+  while (io->inFlight() >= io->queueDepth())
+  	reapIo(1);
+  io->submit(request);
+}
+
+void BufMgr::reapIo(std::uint32_t minDone)
+{
+  if (io == NULL)
+  	return;
+
+  std::vector<IoRequest*> done;
+  io->reap(done, minDone);
+  for (std::size_t i = 0; i < done.size(); i++)
+  	completeIo(static_cast<PageIo*>(done[i]));
+}
+
+void BufMgr::drainIo()
+{
+  while (io != NULL && io->inFlight() > 0)
+  	reapIo(io->inFlight());
+}
+
+void BufMgr::completeIo(PageIo* request)
+{
+  FrameId frameNo = request->frameNo;
+
+  if (request->op == IO_READ)
+  {
+  	bool ok = request->result == static_cast<std::int64_t>(Page::SIZE);
+  	if (ok)
+  	{
+  		try
+  		{
+  			request->file->endRawRead(request->pageNo, *bufPool[frameNo]);
+  		}
+  		catch (InvalidPageException e)
+  		{
+  			ok = false;
+  		}
+  	}
+
+  	if (recordReads)
+  	{
+  		ReadCompletion completion;
+  		completion.file = request->file;
+  		completion.pageNo = request->pageNo;
+  		completion.ok = ok;
+  		completion.pinned = ok && request->keepPin;
+  		completion.page = completion.pinned ? bufPool[frameNo] : NULL;
+  		completedReads.push_back(completion);
+  	}
+
+  	frames.assign(frames.reading, frameNo, false);
+  	if (ok && !request->keepPin)
+  		releasePin(frameNo);
+  	else if (!ok)
+  	{
+  		// the page is not there after all, so the frame goes back to the clock
+  		hashTable->remove(request->file, request->pageNo);
+  		clearFrame(frameNo);
+  		if (frameNo >= numBufs)
+  			trimPool();
+  	}
+  }
+  else
+  {
+  	// write it again later if it did not make it to disk; if it did, the page on disk only has every
+  	// logged change if nobody has changed it or pinned it to do so since the copy was taken
+  	if (request->result != static_cast<std::int64_t>(Page::SIZE))
+  		frames.assign(frames.dirty, frameNo, true);
+  	else if (!frames.test(frames.dirty, frameNo) && frames.pinCnt[frameNo] == 1)
+  		frameWritten(frameNo);
+  	releasePin(frameNo);
+  }
+
+  delete request;
+}
+
+void BufMgr::readFrameAsync(File* file, const PageId pageNo, FrameId frameNo, const PageClass pageClass,
+                            const bool keepPin)
+{
+  // the frame stays pinned by the read until it completes
+  assignFrame(frameNo, file, pageNo, NORMAL, pageClass);
+  frames.assign(frames.reading, frameNo, true);
+  hashTable->insert(file, pageNo, frameNo);
+  bufStats.diskreads++;
+
+  PageIo* request = new PageIo;
+  // frames are aligned in a direct pool, so the read may bypass the page cache
+  request->op = IO_READ;
+  request->fd = usesDirectIo() && file->directDescriptor() >= 0 ? file->directDescriptor() : file->descriptor();
+  request->offset = file->pageOffset(pageNo);
+  request->buf = bufPool[frameNo];
+  request->len = Page::SIZE;
+  request->file = file;
+  request->pageNo = pageNo;
+  request->frameNo = frameNo;
+  request->keepPin = keepPin;
+  submitIo(request);
+}
+
+std::uint32_t BufMgr::prefetchPages(File* file, const std::vector<PageId>& pageNos, const PageClass pageClass)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  // compressed pages are only read through the file
+  if (io == NULL || file->isCompressed())
+  	return 0;
+
+  std::uint32_t issued = 0;
+  for (std::size_t i = 0; i < pageNos.size(); i++)
+  {
+  	FrameId frameNo;
+  	try
+  	{
+  		hashTable->lookup(file, pageNos[i], frameNo);
+  		continue;
+  	}
+  	catch (HashNotFoundException e)
+  	{
+  	}
+
+  	try
+  	{
+  		file->beginRawRead(pageNos[i]);
+  		allocBuf(frameNo, pageClass);
+  	}
+  	catch (InvalidPageException e)
+  	{
+  		continue;
+  	}
+  	catch (BufferExceededException e)
+  	{
+  		break;
+  	}
+
+  	if (missRatioCurve.enabled())
+  		missRatioCurve.access(file, pageNos[i]);
+
+  	// a page in the compressed tier is there at once
+  	if (takeCompressed(file, pageNos[i], frameNo))
+  	{
+  		assignFrame(frameNo, file, pageNos[i], NORMAL, pageClass);
+  		frames.setPinCnt(frameNo, 0);
+  		hashTable->insert(file, pageNos[i], frameNo);
+  		continue;
+  	}
+
+  	readFrameAsync(file, pageNos[i], frameNo, pageClass, false);
+  	issued++;
+  }
+
+  // send the batch on its way
+  reapIo(0);
+  return issued;
+}
+
+std::uint32_t BufMgr::flushDirtyAsync(const std::uint32_t maxPages)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  if (io == NULL)
+  	return 0;
+
+  std::uint32_t issued = 0;
+  for (std::uint32_t scanned = 0; scanned < poolFrames && issued < maxPages; scanned++)
+  {
+  	FrameId frameNo = flushHand;
+  	flushHand = (flushHand + 1) % poolFrames;
+  	if (!frames.test(frames.dirty, frameNo) || frames.pinCnt[frameNo] > 0 ||
+  	    frames.file[frameNo]->isCompressed())
+  		continue;
+
+  	PageIo* request = new PageIo;
+  	request->image = *bufPool[frameNo];
+  	try
+  	{
+  		frames.file[frameNo]->beginRawWrite(frames.pageNo[frameNo], request->image);
+  	}
+  	catch (InvalidPageException e)
+  	{
+  		delete request;
+  		continue;
+  	}
+
+  	// the copy is written, so the page is clean until it is changed again
+  	forceLog(frameNo);
+  	frames.assign(frames.dirty, frameNo, false);
+  	frames.setPinCnt(frameNo, 1);
+  	bufStats.diskwrites++;
+
+  	request->op = IO_WRITE;
+  	request->keepPin = false;
+  	request->fd = frames.file[frameNo]->descriptor();
+  	request->offset = frames.file[frameNo]->pageOffset(frames.pageNo[frameNo]);
+  	request->buf = &request->image;
+  	request->len = Page::SIZE;
+  	request->file = frames.file[frameNo];
+  	request->pageNo = frames.pageNo[frameNo];
+  	request->frameNo = frameNo;
+  	submitIo(request);
+  	issued++;
+  }
+
+  reapIo(0);
+  return issued;
+}
+
+void BufMgr::pollIo()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  reapIo(0);
+}
+
+bool BufMgr::startReadPage(File* file, const PageId pageNo, Page*& page, const PageClass pageClass)
+{
+  std::unique_lock<std::mutex> guard(latch);
+
+  if (io == NULL || file->isCompressed())
+  {
+  	guard.unlock();
+  	readPage(file, pageNo, page, NORMAL, pageClass);
+  	return true;
+  }
+
+  recordReads = true;
+  if (missRatioCurve.enabled())
+  	missRatioCurve.access(file, pageNo);
+
+  FrameId frameNo = 0;
+  try
+  {
+  	hashTable->lookup(file, pageNo, frameNo);
+  }
+  catch (HashNotFoundException e)
+  {
+  	file->beginRawRead(pageNo);
+  	allocBuf(frameNo, pageClass);
+  	if (takeCompressed(file, pageNo, frameNo))
+  	{
+  		assignFrame(frameNo, file, pageNo, NORMAL, pageClass);
+  		hashTable->insert(file, pageNo, frameNo);
+  		page = bufPool[frameNo];
+  		return true;
+  	}
+  	readFrameAsync(file, pageNo, frameNo, pageClass, true);
+  	reapIo(0);
+  	page = NULL;
+  	return false;
+  }
+
+  // a read in flight is waited for by the caller
+  if (frames.test(frames.reading, frameNo))
+  {
+  	page = NULL;
+  	return false;
+  }
+
+  referenceFrame(frameNo, NORMAL, pageClass);
+  frames.setPinCnt(frameNo, frames.pinCnt[frameNo] + 1);
+  page = bufPool[frameNo];
+  return true;
+}
+
+void BufMgr::takeCompletedReads(std::vector<ReadCompletion>& done, const bool wait)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  reapIo(0);
+  if (wait && completedReads.empty() && io != NULL && io->inFlight() > 0)
+  	reapIo(1);
+
+  done.insert(done.end(), completedReads.begin(), completedReads.end());
+  completedReads.clear();
 }
 
 void BufMgr::printSelf(void) 
 {
-  BufDesc* tmpbuf;
+  std::lock_guard<std::mutex> guard(latch);
+
 	int validFrames = 0;
   
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  for (std::uint32_t i = 0; i < poolFrames; i++)
 	{
-  	tmpbuf = &(bufDescTable[i]);
 		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		frames.Print(i);
 
-  	if (tmpbuf->valid == true)
+  	if (frames.test(frames.valid, i) == true)
     	validFrames++;
   }
 
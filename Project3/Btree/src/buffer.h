@@ -9,7 +9,16 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "mrc.h"
+#include "compressed_cache.h"
+#include "io.h"
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace badgerdb {
 
@@ -18,206 +27,951 @@ namespace badgerdb {
 */
 class BufMgr;
 
+#if __cplusplus >= 202002L
 /**
-* @brief Class for maintaining information about buffer pool frames
+* forward declaration of PageRead, the awaitable page read of coro.h
 */
-class BufDesc {
+struct PageRead;
+#endif
 
-	friend class BufMgr;
+/**
+* forward declaration of LogManager, the write-ahead log of wal.h
+*/
+class LogManager;
+
+/**
+* @brief Access strategy hint passed to BufMgr::readPage() and BufMgr::allocPage().
+*/
+enum AccessStrategy {
+  NORMAL     = 0,   /* Page is cached in the shared part of the pool and managed by the clock */
+  BULK_READ  = 1,   /* Page is read once by a sequential scan */
+  BULK_WRITE = 2    /* Page is written once by a bulk load */
+};
+
+/**
+* @brief Priority class of a page, passed to BufMgr::readPage() and BufMgr::allocPage().
+* Pages of a higher class survive more sweeps of the clock after their last reference.
+*/
+enum PageClass {
+  PAGE_TEMP           = 0,   /* Scratch page, replaced first */
+  PAGE_HEAP           = 1,   /* Relation page */
+  PAGE_INDEX_LEAF     = 2,   /* B+ tree leaf */
+  PAGE_INDEX_INTERIOR = 3    /* B+ tree root, interior node or meta page */
+};
+
+/**
+* @brief Options of the memory and I/O of a buffer pool, combined with | and passed to BufMgr::BufMgr().
+*/
+enum PoolOption {
+  POOL_DEFAULT    = 0,   /* Frames allocated on the heap, pages read and written through the page cache */
+  POOL_HUGE_PAGES = 1,   /* Frames allocated in 2 MB aligned blocks backed by huge pages where the system allows */
+  POOL_DIRECT_IO  = 2    /* Pages of aligned files read and written with O_DIRECT, bypassing the page cache */
+};
+
+/**
+* @brief Memory backing a block of buffer pool frames.
+*/
+enum SegmentMemory {
+  SEGMENT_HEAP     = 0,   /* Allocated with new */
+  SEGMENT_ALIGNED  = 1,   /* Aligned to File::DIRECT_IO_ALIGNMENT */
+  SEGMENT_THP      = 2,   /* Aligned to 2 MB and advised to use transparent huge pages */
+  SEGMENT_HUGETLB  = 3    /* Mapped from the reserved huge page pool */
+};
+
+/**
+* @brief Block of buffer pool frames given back by a shrink, kept until the pool is freed.
+*/
+struct RetiredSegment
+{
+	/**
+   * Frames of the block
+	 */
+  Page* segment;
+
+	/**
+   * Number of frames in the block
+	 */
+  std::uint32_t count;
+
+	/**
+   * Memory backing the block, and its size in bytes
+	 */
+  SegmentMemory memory;
+  std::size_t bytes;
+};
+
+/**
+* @brief Number of page priority classes.
+*/
+const int NUM_PAGE_CLASSES = 4;
+
+/**
+* @brief Information about the buffer pool frames, kept as one dense array per field. The flags the clock
+* tests on every frame are bitmaps of 64 frames per word, so that a sweep examines a whole word of frames
+* at a time and never touches the file, page number or pin count of a frame it passes over.
+*/
+struct BufFrameTable
+{
+	/**
+   * Number of frames held by the word of a bitmap
+	 */
+  static const std::uint32_t FRAMES_PER_WORD = 64;
+
+	/**
+   * Number of frames described by the table
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Pointer to file to which each frame is assigned
+	 */
+  std::vector<File*> file;
+
+	/**
+   * Page within file to which each frame is assigned
+	 */
+  std::vector<PageId> pageNo;
+
+	/**
+   * Number of times the page of each frame has been pinned
+	 */
+  std::vector<int> pinCnt;
+
+	/**
+   * Number of further clock sweeps each frame survives once its reference bit has been cleared
+	 */
+  std::vector<std::uint8_t> credit;
+
+	/**
+   * Priority class of the page held by each frame
+	 */
+  std::vector<PageClass> pageClass;
+
+	/**
+   * Bulk strategy whose ring loaded each frame, or NORMAL once the page belongs to the shared pool
+	 */
+  std::vector<AccessStrategy> strategy;
+
+	/**
+   * LSN of the last logged change to the page of each frame, up to which the log is flushed before the
+   * page is written; 0 if the page has not changed through the log since it was read
+	 */
+  std::vector<Lsn> lsn;
+
+	/**
+   * LSN of the first logged change to the page of each frame since it was last written, from which
+   * recovery would have to redo it; 0 if the page on disk has every logged change
+	 */
+  std::vector<Lsn> recLsn;
+
+	/**
+   * Bitmap of frames holding a valid page
+	 */
+  std::vector<std::uint64_t> valid;
+
+	/**
+   * Bitmap of frames referenced since the clock last passed them
+	 */
+  std::vector<std::uint64_t> refbit;
+
+	/**
+   * Bitmap of frames whose pin count is not zero
+	 */
+  std::vector<std::uint64_t> pinned;
+
+	/**
+   * Bitmap of frames whose page is dirty
+	 */
+  std::vector<std::uint64_t> dirty;
+
+	/**
+   * Bitmap of frames whose credit is not zero
+	 */
+  std::vector<std::uint64_t> credited;
+
+	/**
+   * Bitmap of frames with an asynchronous read of their page in flight
+	 */
+  std::vector<std::uint64_t> reading;
+
+	/**
+   * Bitmap of the frames holding pages of each PageClass
+	 */
+  std::vector<std::uint64_t> classBits[NUM_PAGE_CLASSES];
+
+	/**
+   * Constructor of BufFrameTable class 
+	 */
+  BufFrameTable()
+  {
+		numFrames = 0;
+  }
+
+	/**
+	 * Resize the table to the given number of frames, keeping the entries of frames below it. Added frames
+	 * are cleared.
+	 *
+	 * @param frames 	New number of frames
+	 */
+  void resize(std::uint32_t frames);
+
+	/**
+	 * Initialize frame for a new user
+	 *
+	 * @param frameNo 	Frame number
+	 */
+  void Clear(FrameId frameNo);
+
+	/**
+	 * Set values corresponding to assignment of frame to a page in the file. Called when a frame 
+	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 *
+	 * @param frameNo 	Frame number
+	 * @param filePtr	File object
+	 * @param pageNum	Page number in the file
+	 */
+  void Set(FrameId frameNo, File* filePtr, PageId pageNum);
+
+	/**
+	 * Copy the entry of one frame over another.
+	 *
+	 * @param to     	Frame number overwritten
+	 * @param from   	Frame number copied
+	 */
+  void Copy(FrameId to, FrameId from);
+
+	/**
+	 * Print the entry of a frame.
+	 *
+	 * @param frameNo 	Frame number
+	 */
+  void Print(FrameId frameNo) const;
+
+	/**
+	 * Advance the clock hand to the next victim: a free frame, or an unpinned frame with its reference
+	 * bit clear and no credit left. Reference bits and credits of the frames passed over on the way are
+	 * cleared and used up, exactly as a frame-by-frame clock would, but a word of frames at a time.
+	 *
+	 * @param hand   	Clock hand, left on the victim, or on the last frame examined if none was found
+	 * @param numBufs	Number of frames the clock sweeps, from frame 0
+	 * @param maxScans	Most frames to examine
+	 * @param onlyClass	PageClass the victim must hold, or -1 for any frame including free ones
+	 * @param refsCleared	Incremented by the number of reference bits cleared
+	 * @return True if a victim was found
+	 */
+  bool sweep(FrameId& hand, std::uint32_t numBufs, std::uint32_t maxScans, const int onlyClass,
+             std::uint32_t& refsCleared);
+
+	/**
+	 * Test the bit of a frame in one of the bitmaps.
+	 *
+	 * @param bits   	Bitmap
+	 * @param frameNo 	Frame number
+	 */
+  static bool test(const std::vector<std::uint64_t>& bits, FrameId frameNo)
+  {
+		return (bits[frameNo / FRAMES_PER_WORD] >> (frameNo % FRAMES_PER_WORD)) & 1;
+  }
+
+	/**
+	 * Set or clear the bit of a frame in one of the bitmaps.
+	 *
+	 * @param bits   	Bitmap
+	 * @param frameNo 	Frame number
+	 * @param value  	New value of the bit
+	 */
+  static void assign(std::vector<std::uint64_t>& bits, FrameId frameNo, bool value)
+  {
+		std::uint64_t mask = std::uint64_t(1) << (frameNo % FRAMES_PER_WORD);
+		if (value)
+			bits[frameNo / FRAMES_PER_WORD] |= mask;
+		else
+			bits[frameNo / FRAMES_PER_WORD] &= ~mask;
+  }
+
+	/**
+	 * Change the priority class of a valid frame.
+	 *
+	 * @param frameNo 	Frame number
+	 * @param cls    	New class
+	 */
+  void setClass(FrameId frameNo, PageClass cls)
+  {
+		assign(classBits[pageClass[frameNo]], frameNo, false);
+		pageClass[frameNo] = cls;
+		assign(classBits[cls], frameNo, true);
+  }
+
+	/**
+	 * Set the sweep credit of a frame.
+	 *
+	 * @param frameNo 	Frame number
+	 * @param value  	New credit
+	 */
+  void setCredit(FrameId frameNo, std::uint8_t value)
+  {
+		credit[frameNo] = value;
+		assign(credited, frameNo, value > 0);
+  }
+
+	/**
+	 * Set the pin count of a frame.
+	 *
+	 * @param frameNo 	Frame number
+	 * @param value  	New pin count
+	 */
+  void setPinCnt(FrameId frameNo, int value)
+  {
+		pinCnt[frameNo] = value;
+		assign(pinned, frameNo, value > 0);
+  }
+};
+
+
+/**
+* @brief Class to maintain statistics of buffer usage 
+*/
+struct BufStats
+{
+	/**
+   * Total number of accesses to buffer pool
+	 */
+  int accesses;
+
+	/**
+   * Number of pages read from disk (including allocs)
+	 */
+  int diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  int diskwrites;
+
+	/**
+   * Number of misses served from the compressed tier without a read
+	 */
+  int tierhits;
+
+	/**
+   * Clear all values 
+	 */
+  void clear()
+  {
+		accesses = diskreads = diskwrites = tierhits = 0;
+  }
+      
+	/**
+   * Constructor of BufStats class 
+	 */
+  BufStats()
+  {
+		clear();
+  }
+};
+
+
+/**
+* @brief Page of the buffer pool with logged changes not yet written, as listed by BufMgr::getDirtyPages()
+*/
+struct DirtyPage
+{
+	/**
+   * Name of the file, which may be closed once the list is taken
+	 */
+  std::string fileName;
+
+	/**
+   * Page number in the file
+	 */
+  PageId pageNo;
+
+	/**
+   * LSN of the first logged change to the page since it was last written
+	 */
+  Lsn recLsn;
+};
+
+
+/**
+* @brief Small ring of frames recycled by a bulk access strategy in place of the clock
+*/
+struct BufRing
+{
+	/**
+   * Frame last used by each slot of the ring
+	 */
+  std::vector<FrameId> frames;
+
+	/**
+   * Slot to be recycled next
+	 */
+  std::uint32_t next;
+
+	/**
+   * Constructor of BufRing class 
+	 */
+  BufRing()
+  {
+		next = 0;
+  }
+};
+
+
+/**
+* @brief Asynchronous read of a page into its frame, or write of a copy of a page
+*/
+struct PageIo : public IoRequest
+{
+	/**
+   * File the page belongs to
+	 */
+  File* file;
+
+	/**
+   * Page within file
+	 */
+  PageId pageNo;
+
+	/**
+   * Frame holding the page, pinned until the request completes
+	 */
+  FrameId frameNo;
+
+	/**
+   * True if a completed read leaves the frame pinned for the caller of BufMgr::startReadPage()
+	 */
+  bool keepPin;
+
+	/**
+   * Copy of the page being written
+	 */
+  Page image;
+};
+
+/**
+* @brief Asynchronous read reported by BufMgr::takeCompletedReads()
+*/
+struct ReadCompletion
+{
+	/**
+   * File the page belongs to
+	 */
+  File* file;
+
+	/**
+   * Page within file
+	 */
+  PageId pageNo;
+
+	/**
+   * False if the page could not be read, in which case it is not in the buffer pool
+	 */
+  bool ok;
+
+	/**
+   * True if the page was left pinned for the caller of BufMgr::startReadPage() who started the read
+	 */
+  bool pinned;
+
+	/**
+   * The page, if it was left pinned
+	 */
+  Page* page;
+};
+
+
+/**
+* @brief Optimistic read of a page started by BufMgr::peekPage(), to be checked with BufMgr::validatePeek()
+*/
+struct PagePeek
+{
+	/**
+   * Frame the page was found in
+	 */
+  FrameId frameNo;
+
+	/**
+   * Version of the frame when the page was found in it
+	 */
+  std::uint64_t version;
+};
+
+/**
+* @brief Page held by a frame as BufMgr::peekPage() sees it, written under the pool latch and read without it
+*/
+struct FramePeek
+{
+	/**
+   * Number of times the frame was given up or given a page to peek at; odd while it has none
+	 */
+  std::atomic<std::uint64_t> version;
+
+	/**
+   * File and page number of the page held
+	 */
+  std::atomic<File*> file;
+  std::atomic<PageId> pageNo;
+
+	/**
+   * The frame itself
+	 */
+  std::atomic<Page*> page;
+
+	/**
+   * Constructor of FramePeek class, for a frame with no page
+	 */
+  FramePeek() : version(1), file(NULL), pageNo(Page::INVALID_NUMBER), page(NULL) {}
+};
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*/
+class BufMgr 
+{
+ private:
+	/**
+   * Current position of clockhand in our buffer pool
+	 */
+  FrameId clockHand;
+
+	/**
+   * Number of frames in the buffer pool the clock may allocate from
+	 */
+  std::uint32_t numBufs;
+
+	/**
+   * Number of frames physically present in the buffer pool. Exceeds numBufs while a shrink
+   * is waiting for pinned frames above the new size to be released.
+	 */
+  std::uint32_t poolFrames;
+	
+	/**
+   * Hash table mapping (File, page) to frame
+	 */
+  BufHashTbl *hashTable;
+
+	/**
+   * Information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufFrameTable frames;
+
+	/**
+   * Blocks of at most FRAMES_PER_SEGMENT frames backing the buffer pool, in frame order. A block is
+   * only released once every frame in it lies above the pool size, so a pinned frame never moves.
+	 */
+  std::vector<Page*> poolSegments;
+
+	/**
+   * Number of the first frame held by the corresponding entry of poolSegments
+	 */
+  std::vector<FrameId> segmentStart;
+
+	/**
+   * Memory backing the corresponding entry of poolSegments
+	 */
+  std::vector<SegmentMemory> segmentMemory;
+
+	/**
+   * Bytes allocated for the corresponding entry of poolSegments
+	 */
+  std::vector<std::size_t> segmentBytes;
+
+	/**
+   * Blocks given back by shrinking the pool, which peekPage() readers may still be copying from
+	 */
+  std::vector<RetiredSegment> retiredSegments;
+
+	/**
+   * The page of each frame for peekPage(), in MAX_PEEK_BLOCKS blocks of PEEK_BLOCK_FRAMES frames, each
+   * allocated as the pool grows into it and freed with the pool, so that a reader without the latch
+   * never finds one moved or gone
+	 */
+  std::atomic<FramePeek*>* peekBlocks;
+
+	/**
+   * One more than the frame last given each page, by a hash of the page, or 0. Only a hint, checked
+   * against the frame it names. A larger table takes over as the pool grows, and those it replaces are
+   * kept in oldPeekHints until the pool is freed.
+	 */
+  std::atomic<std::vector<std::atomic<FrameId> >*> peekHints;
+  std::vector<std::vector<std::atomic<FrameId> >*> oldPeekHints;
+
+	/**
+   * PoolOption flags the pool was created with
+	 */
+  int poolOptions;
+
+ protected:
+	/**
+   * Maintains Buffer pool usage statistics 
+	 */
+  BufStats bufStats;
+
+ private:
+	/**
+   * Sampled reuse distances of the pages read, estimating the hit ratio of other pool sizes
+	 */
+  MissRatioCurve missRatioCurve;
+
+	/**
+   * Compressed pages evicted from the pool, empty until setCompressedCacheSize() is called
+	 */
+  CompressedCache compressedCache;
+
+	/**
+   * Rings of the bulk access strategies, indexed by AccessStrategy
+	 */
+  BufRing bufRings[3];
+
+	/**
+   * Number of valid frames holding pages of each PageClass
+	 */
+  std::uint32_t classFrames[NUM_PAGE_CLASSES];
+
+	/**
+   * Most frames each PageClass may hold before it has to replace its own pages; 0 for no limit
+	 */
+  std::uint32_t classQuota[NUM_PAGE_CLASSES];
+
+	/**
+   * False if page classes passed by callers are to be ignored and every page treated as PAGE_HEAP
+	 */
+  bool classHints;
+
+	/**
+   * Backend for asynchronous reads and writes, or NULL until enableAsyncIo() is called
+	 */
+  IoBackend* io;
+
+	/**
+   * Frame from which flushDirtyAsync() resumes its search for dirty pages
+	 */
+  FrameId flushHand;
 
- private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+   * Reads completed since the last call to takeCompletedReads()
 	 */
-  File* file;
+  std::vector<ReadCompletion> completedReads;
 
 	/**
-   * Page within file to which corresponding frame is assigned
+   * Write-ahead log flushed before a changed page is written, or NULL
 	 */
-  PageId pageNo;
+  LogManager* log;
 
 	/**
-   * Frame number of the frame, in the buffer pool, being used
+   * Files written since the last call to syncWrittenFiles() while a log was attached, by device and
+   * inode, each with a descriptor of its own so that it can be synced after the file is closed
 	 */
-  FrameId	frameNo;
+  std::map<std::pair<std::uint64_t, std::uint64_t>, int> unsyncedFiles;
 
 	/**
-   * Number of times this page has been pinned
+   * True once startReadPage() has been called, from when completed reads are recorded
 	 */
-  int pinCnt;
+  bool recordReads;
 
 	/**
-   * True if page is dirty;  false otherwise
+   * Latch protecting the buffer pool state. Held for the duration of each public call, and
+   * released between batches of frames while the pool is being resized.
 	 */
-  bool dirty;
+  std::mutex latch;
 
 	/**
-   * True if page is valid
+	 * Allocate a free frame.  
+	 * A frame is replaced once the clock finds it unpinned, with its reference bit clear and no credit
+	 * left from its page class. If the class of the new page is at its quota, only a frame of that class
+	 * is replaced, unless all of them are pinned.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param pageClass	Class of the page the frame is allocated for
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  bool valid;
+  void allocBuf(FrameId & frame, const PageClass pageClass = PAGE_HEAP);
 
 	/**
-   * Has this buffer frame been reference recently
+	 * Allocate a frame for a bulk access strategy. The next frame of the strategy's ring is reused
+	 * if it still holds an unpinned page loaded through the ring; otherwise a frame is taken from the
+	 * clock and becomes part of the ring.
+	 *
+	 * @param strategy 	BULK_READ or BULK_WRITE
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param pageClass	Class of the page the frame is allocated for
+	 * @throws BufferExceededException If the ring frame is in use and no other buffer can be allocated
 	 */
-  bool refbit;
+  void allocRingBuf(AccessStrategy strategy, FrameId & frame, const PageClass pageClass);
 
 	/**
-   * Initialize buffer frame for a new user
+	 * Assign a newly allocated frame to a page, pinned once.
+	 *
+	 * @param frameNo 	Frame to assign
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param strategy	Access strategy the page was loaded with
+	 * @param pageClass	Class of the page
 	 */
-  void Clear()
-	{
-    pinCnt = 0;
-		file = NULL;
-		pageNo = Page::INVALID_NUMBER;
-    dirty = false;
-    refbit = false;
-		valid = false;
-  };
+  void assignFrame(FrameId frameNo, File* file, const PageId pageNo, const AccessStrategy strategy, PageClass pageClass);
 
 	/**
-	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
-	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * Record an access to a page already in the buffer pool, setting its reference bit and class.
 	 *
-	 * @param filePtr	File object
-	 * @param pageNum	Page number in the file
+	 * @param frameNo 	Frame holding the page
+	 * @param strategy	Access strategy of the access
+	 * @param pageClass	Class of the page
 	 */
-  void Set(File* filePtr, PageId pageNum)
-	{ 
-		file = filePtr;
-    pageNo = pageNum;
-    pinCnt = 1;
-    dirty = false;
-    valid = true;
-    refbit = true;
-  }
+  void referenceFrame(FrameId frameNo, const AccessStrategy strategy, PageClass pageClass);
 
-  void Print()
-	{
-		if(file != NULL)
-		{
-			std::cout << "file:" << file->filename() << " ";
-			std::cout << "pageNo:" << pageNo << " ";
-		}
-		else
-			std::cout << "file:NULL ";
+	/**
+	 * Reset a frame that no longer holds a page.
+	 *
+	 * @param frameNo 	Frame to clear
+	 */
+  void clearFrame(FrameId frameNo);
 
-		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+	/**
+	 * Number of clock sweeps a page of the given class survives after its reference bit is cleared.
+	 *
+	 * @param pageClass	Page class
+	 */
+  static std::uint8_t classCredit(const PageClass pageClass)
+  {
+		return pageClass == PAGE_INDEX_INTERIOR ? 2 : (pageClass == PAGE_INDEX_LEAF ? 1 : 0);
   }
 
 	/**
-   * Constructor of BufDesc class 
+	 * Hash table size used for a pool of the given number of frames.
+	 *
+	 * @param bufs   	Number of frames
 	 */
-  BufDesc()
-	{
-  	Clear();
+  static int hashTableSize(std::uint32_t bufs)
+  {
+		return ((((int) (bufs * 1.2))*2)/2)+1;
   }
-};
 
+	/**
+	 * Add frames to the physical pool so that it holds the given number of frames.
+	 *
+	 * @param bufs   	New number of frames
+	 */
+  void growPool(std::uint32_t bufs);
 
-/**
-* @brief Class to maintain statistics of buffer usage 
-*/
-struct BufStats
-{
 	/**
-   * Total number of accesses to buffer pool
+	 * Allocate and construct a block of frames as the pool options ask, falling back to plainer
+	 * memory if huge pages are not available, and record it in poolSegments.
+	 *
+	 * @param count  	Number of frames
+	 * @param start  	Number of the first frame of the block
+	 * @return  			First frame of the block
 	 */
-  int accesses;
+  Page* allocSegment(std::uint32_t count, FrameId start);
 
 	/**
-   * Number of pages read from disk (including allocs)
+	 * Destroy and release the last block of frames.
+	 *
+	 * @param end    	Number of the frame following the block
+	 * @param keep   	True to keep its memory in retiredSegments until the pool is freed
 	 */
-  int diskreads;
+  void releaseSegment(FrameId end, const bool keep = false);
 
 	/**
-   * Number of pages written back to disk
+	 * Destroy and free the memory of a block of frames.
 	 */
-  int diskwrites;
+  static void freeSegment(Page* segment, std::uint32_t count, SegmentMemory memory, std::size_t bytes);
 
 	/**
-   * Clear all values 
+	 * The FramePeek of a frame, or NULL for a frame beyond the blocks peekPage() covers.
 	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
-      
+  FramePeek* framePeek(FrameId frameNo) const;
+
 	/**
-   * Constructor of BufStats class 
+	 * Let peekPage() find the page a frame holds, once it is read. Called with the latch held.
 	 */
-  BufStats()
+  void publishFrame(FrameId frameNo);
+
+	/**
+	 * Stop peekPage() finding the page of a frame, before the frame is given up or given another page.
+	 * Called with the latch held.
+	 */
+  void unpublishFrame(FrameId frameNo);
+
+	/**
+	 * Slot of a page in a table of peekHints.
+	 */
+  static std::uint32_t peekHash(const File* file, const PageId pageNo, const std::size_t slots)
   {
-		clear();
+		std::uint64_t h = (reinterpret_cast<std::uintptr_t>(file) >> 4) * 0x9E3779B97F4A7C15ULL + pageNo;
+		return (std::uint32_t) ((h * 0x9E3779B97F4A7C15ULL) >> 32) & (slots - 1);
   }
-};
 
+	/**
+	 * Read a page into a frame, directly from the disk if the pool uses direct I/O and the file allows it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo	Frame to read into
+	 * @throws  InvalidPageException  If the page is not in use in the file
+	 */
+  void readFrame(File* file, const PageId pageNo, FrameId frameNo);
 
-/**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
-*/
-class BufMgr 
-{
- private:
 	/**
-   * Current position of clockhand in our buffer pool
+	 * Fill a frame from the compressed tier, if it holds the page.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo	Frame to fill
+	 * @return  			True if the page was in the tier
 	 */
-  FrameId clockHand;
+  bool takeCompressed(File* file, const PageId pageNo, FrameId frameNo);
 
 	/**
-   * Number of frames in the buffer pool
+	 * Read pages into frames assigned to them, coalescing runs of consecutive pages into vectored reads.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers, in increasing order
+	 * @param frameNos	Frame of each page
+	 * @throws  InvalidPageException  If a page is not in use in the file
 	 */
-  std::uint32_t numBufs;
-	
+  void readFrames(File* file, const std::vector<PageId>& pageNos, const std::vector<FrameId>& frameNos);
+
 	/**
-   * Hash table mapping (File, page) to frame
+	 * Write the page held by a frame back to its file, directly to the disk if the pool uses direct I/O
+	 * and the file allows it.
+	 *
+	 * @param frameNo	Frame to write
+	 * @throws  InvalidPageException  If the page has been deleted
 	 */
-  BufHashTbl *hashTable;
+  void writeFrame(FrameId frameNo);
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 * Move the page held by an unpinned frame above numBufs into a free frame below it, or write
+	 * it back and drop it if no free frame is available.
+	 *
+	 * @param frameNo 	Frame to empty
+	 * @param freeScan	Position from which to search for a free frame; advanced past the frame used
 	 */
-  BufDesc *bufDescTable;
+  void retireFrame(FrameId frameNo, FrameId &freeScan);
 
 	/**
-   * Maintains Buffer pool usage statistics 
+	 * Release frames above numBufs from the top of the pool that are no longer in use.
 	 */
-  BufStats bufStats;
+  void trimPool();
 
 	/**
-	 * Allocate a free frame.  
+	 * Drop one pin of a frame, retiring the frame once it is unpinned if a shrink left it above numBufs.
 	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @param frameNo 	Frame to unpin
 	 */
-  void allocBuf(FrameId & frame);
+  void releasePin(FrameId frameNo);
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Submit an asynchronous request, first completing earlier ones if the queue is full.
+	 *
+	 * @param request	Request
 	 */
-  void advanceClock()
-  {
-		clockHand = (clockHand + 1) % numBufs;
-  }
+  void submitIo(PageIo* request);
+
+	/**
+	 * Complete finished asynchronous requests.
+	 *
+	 * @param minDone	Number of requests to wait for
+	 */
+  void reapIo(std::uint32_t minDone);
+
+	/**
+	 * Account for a finished request: a read makes its page available, or drops it from the pool if the
+	 * read failed, and a write releases its frame.
+	 *
+	 * @param request	Completed request, deleted here
+	 */
+  void completeIo(PageIo* request);
+
+	/**
+	 * Wait for every asynchronous request in flight.
+	 */
+  void drainIo();
+
+	/**
+	 * Flush the write-ahead log past the last logged change to the page of a frame, which is about to be
+	 * written.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void forceLog(FrameId frameNo);
 
+	/**
+	 * Account for the page of a frame having been written: its logged changes are no longer needed to
+	 * redo it, and its file is synced by the next call to syncWrittenFiles().
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void frameWritten(FrameId frameNo);
+
+	/**
+	 * Start reading a page into a newly allocated frame, which stays pinned by the read until it completes.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo	Frame allocated for the page
+	 * @param pageClass	Class of the page
+	 * @param keepPin	True to leave the frame pinned for the caller once the read completes
+	 */
+  void readFrameAsync(File* file, const PageId pageNo, FrameId frameNo, const PageClass pageClass,
+                      const bool keepPin);
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Number of frames allocated together as one block of the buffer pool
+	 */
+  static const std::uint32_t FRAMES_PER_SEGMENT = 256;
+
+	/**
+   * Size of the huge pages used by POOL_HUGE_PAGES; a full block of frames fills exactly one
+	 */
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	/**
+   * Most consecutive pages readPages() reads with one call
+	 */
+  static const std::uint32_t READ_RUN_PAGES = 64;
+
+	/**
+   * Default number of asynchronous requests in flight
+	 */
+  static const std::uint32_t IO_QUEUE_DEPTH = 32;
+
+	/**
+   * Largest number of frames in the ring of a bulk access strategy. Rings are further limited
+   * to an eighth of the pool.
+	 */
+  static const std::uint32_t BULK_RING_FRAMES = 32;
+
+	/**
+   * Number of frames in a block of peekBlocks
+	 */
+  static const std::uint32_t PEEK_BLOCK_FRAMES = 1024;
+
+	/**
+   * Most blocks of peekBlocks; pages in frames beyond them are never found by peekPage()
+	 */
+  static const std::uint32_t MAX_PEEK_BLOCKS = 4096;
+
+	/**
+   * Frames of the buffer pool, indexed by frame number. Frames are allocated in blocks,
+   * so the address of a frame stays the same for as long as the frame exists.
 	 */
-  Page* bufPool;
+  std::vector<Page*> bufPool;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Number of frames
+	 * @param options	PoolOption flags
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const int options = POOL_DEFAULT);
 	
 	/**
    * Destructor of BufMgr class
 	 */
-  ~BufMgr();
+  virtual ~BufMgr();
 
 	/**
 	 * Reads the given page from the file into a frame and returns the pointer to page.
@@ -227,8 +981,29 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy	Access strategy hint. BULK_READ and BULK_WRITE pages are read into a small private ring of
+	 *              	frames and do not set the reference bit, so a scan does not evict the rest of the pool.
+	 * @param pageClass	Priority class of the page. Index pages outlive heap pages in the pool, and PAGE_TEMP
+	 *              	pages are replaced before anything else.
+	 */
+  virtual void readPage(File* file, const PageId PageNo, Page*& page, const AccessStrategy strategy = NORMAL,
+                        const PageClass pageClass = PAGE_HEAP);
+
+	/**
+	 * Reads a set of pages of a file and pins each of them, as readPage() would one at a time. Pages already
+	 * in the buffer pool are pinned first; frames are then allocated for all the others, which are read in
+	 * page number order with one vectored read per run of consecutive pages. Either every page is pinned
+	 * or, if a page cannot be read or no frame is left, none is and the exception is passed on.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers, in any order; a page listed twice is pinned twice
+	 * @param pages  	Set to the page of each entry of pageNos
+	 * @param pageClass	Priority class of the pages
+	 * @throws  InvalidPageException  If a page is not in use in the file
+	 * @throws  BufferExceededException  If there are not enough unpinned frames
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  virtual void readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages,
+                         const PageClass pageClass = PAGE_HEAP);
 
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
@@ -238,7 +1013,29 @@ class BufMgr
 	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
    * @throws  PageNotPinnedException If the page is not already pinned
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  virtual void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Start an optimistic read of a page in the buffer pool, taking neither the latch nor a pin. The page is
+	 * found if it has been read or allocated with readPage() or allocPage() and its frame has not been given
+	 * up since. The frame may be given another page at any time, so the caller copies what it needs and
+	 * keeps the copy only if validatePeek() then succeeds; until it does, what was read may be torn or of
+	 * another page, and must not be followed or indexed by unchecked. The frame itself stays readable until
+	 * the pool is freed. A page read this way is not referenced for the clock.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param peek   	Set to what validatePeek() checks
+	 * @return  			The frame of the page, or NULL if it was not found, in which case readPage() is used
+	 */
+  virtual Page* peekPage(File* file, const PageId pageNo, PagePeek& peek);
+
+	/**
+	 * True if the frame of a page found by peekPage() held it throughout what was read since.
+	 *
+	 * @param peek   	Set by peekPage()
+	 */
+  virtual bool validatePeek(const PagePeek& peek);
 
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
@@ -247,8 +1044,11 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param strategy	Access strategy hint. See readPage().
+	 * @param pageClass	Priority class of the page. See readPage().
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  virtual void allocPage(File* file, PageId &PageNo, Page*& page, const AccessStrategy strategy = NORMAL,
+                         const PageClass pageClass = PAGE_HEAP); 
 
 	/**
 	 * Writes out all dirty pages of the file to disk.
@@ -259,7 +1059,7 @@ class BufMgr
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
    * @throws BadBufferException If any frame allocated to the file is found to be invalid
 	 */
-  void flushFile(const File* file);
+  virtual void flushFile(const File* file);
 
 	/**
 	 * Delete page from file and also from buffer pool if present.
@@ -268,7 +1068,54 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  virtual void disposePage(File* file, const PageId PageNo);
+
+	/**
+	 * Change the number of frames in the buffer pool while it is in use.
+	 * Growing adds a new block of frames. Shrinking stops allocation from frames above the new size,
+	 * moves their unpinned pages into free frames below it (writing back and dropping the page when
+	 * no free frame is left), and leaves pinned frames in place until they are unpinned.
+	 * The page table is rehashed to match the new size. Frames are processed in batches with the
+	 * latch released in between, so other callers keep being served during the resize.
+	 *
+	 * @param bufs   	New number of frames in the buffer pool
+	 */
+  void resize(std::uint32_t bufs);
+
+	/**
+	 * Limit the number of frames pages of a class may occupy. Once the class holds that many frames,
+	 * a new page of the class replaces one of its own pages rather than a page of another class.
+	 *
+	 * @param pageClass	Page class
+	 * @param frames  	Most frames the class may hold, or 0 to remove the limit
+	 */
+  void setClassQuota(const PageClass pageClass, const std::uint32_t frames);
+
+	/**
+   * Returns the number of frames currently holding pages of the given class.
+	 */
+  std::uint32_t getClassFrames(const PageClass pageClass)
+  {
+		return classFrames[pageClass];
+  }
+
+	/**
+	 * Enable or disable page class hints. While disabled every page is treated as PAGE_HEAP.
+	 *
+	 * @param enabled 	True to honor page classes passed by callers
+	 */
+  void setClassHints(const bool enabled)
+  {
+		classHints = enabled;
+  }
+
+	/**
+   * Returns the number of frames the buffer pool allocates from.
+	 */
+  std::uint32_t getNumBufs()
+  {
+		return numBufs;
+  }
 
 	/**
    * Print member variable values. 
@@ -289,6 +1136,192 @@ class BufMgr
   void clearBufStats() 
   {
 		bufStats.clear();
+		missRatioCurve.clear();
+  }
+
+	/**
+	 * Start estimating the hit ratio the buffer pool would have at other sizes, by sampling the pages
+	 * read and allocated. The estimate assumes LRU replacement and is restarted by clearBufStats().
+	 *
+	 * @param rate   	Fraction of the pages sampled, e.g. 0.01; 0 stops the estimate
+	 * @param maxSamples	Most pages tracked at once, the sampling rate being lowered as needed; 0 for no limit
+	 */
+  void setMissRatioSampling(const double rate, const std::uint32_t maxSamples = 8192);
+
+	/**
+	 * Estimated hit ratio of a buffer pool of the given size over the pages accessed since sampling
+	 * started.
+	 *
+	 * @param bufs   	Number of frames
+	 * @return  			Fraction of page accesses that would have been hits
+	 */
+  double estimateHitRatio(const std::uint32_t bufs);
+
+	/**
+	 * Estimated number of distinct pages accessed since sampling started, beyond which a larger
+	 * buffer pool gains no more hits.
+	 */
+  std::uint64_t estimateWorkingSet();
+
+	/**
+	 * Keep clean pages evicted from the pool compressed in memory, where a later miss finds them before
+	 * going to the disk. Pages replaced through an access strategy ring and PAGE_TEMP pages are not kept.
+	 *
+	 * @param bytes  	Memory the compressed pages may take; 0 disables the tier and frees it
+	 */
+  void setCompressedCacheSize(const std::size_t bytes);
+
+	/**
+	 * Number of pages held by the compressed tier, and the memory they take in bytes
+	 */
+  std::size_t getCompressedCachePages();
+  std::size_t getCompressedCacheBytes();
+
+	/**
+	 * Start submitting the reads of prefetchPages() and the writes of flushDirtyAsync() asynchronously.
+	 * Other reads and writes stay synchronous.
+	 *
+	 * @param queueDepth	Most requests in flight
+	 * @param kind   	Implementation; IO_AUTO uses io_uring if available, otherwise a thread pool
+	 * @return  			False if the backend asked for is not available
+	 */
+  bool enableAsyncIo(const std::uint32_t queueDepth = IO_QUEUE_DEPTH, const IoBackendKind kind = IO_AUTO);
+
+	/**
+	 * Name of the asynchronous I/O backend, or "none" until enableAsyncIo() succeeds
+	 */
+  const char* getAsyncIoBackend();
+
+	/**
+	 * Start reading pages that will soon be needed, for read-ahead or a batch of index probes, without
+	 * pinning them. Pages already in the buffer pool or not in the file are skipped, and prefetching
+	 * stops early if no frame can be allocated. A later readPage() of a page still being read waits for
+	 * that read. Does nothing unless asynchronous I/O is enabled, nor for a compressed file.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers
+	 * @param pageClass	Class of the pages
+	 * @return  			Number of reads issued
+	 */
+  std::uint32_t prefetchPages(File* file, const std::vector<PageId>& pageNos, const PageClass pageClass = PAGE_HEAP);
+
+	/**
+	 * Start writing back up to the given number of dirty unpinned pages in the background, so that their
+	 * frames can later be replaced without a write. Each page is copied, so it may be pinned and changed
+	 * again while the write is in flight. Does nothing unless asynchronous I/O is enabled. Pages of
+	 * compressed files are left to be written when they are replaced.
+	 *
+	 * @param maxPages	Most pages to write
+	 * @return  			Number of writes issued
+	 */
+  std::uint32_t flushDirtyAsync(const std::uint32_t maxPages);
+
+	/**
+	 * Complete asynchronous reads and writes that have finished, without waiting for the others.
+	 */
+  void pollIo();
+
+	/**
+	 * Pin a page without waiting for the disk, for callers that interleave many page accesses on one
+	 * thread. A page in the buffer pool is pinned at once. Otherwise a read of it is started, unless one
+	 * is already in flight, and the caller learns of its completion from takeCompletedReads(). A read
+	 * started here leaves the page pinned for the caller; waiters for a read started by someone else
+	 * call this again once it completes. Reads synchronously if asynchronous I/O is not enabled or the
+	 * file is compressed.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page  	Set to the page if it was pinned
+	 * @param pageClass	Class of the page
+	 * @return  			True if the page was pinned, false if it is being read
+	 * @throws  InvalidPageException  If the page is not in the file
+	 * @throws  BufferExceededException  If every frame is pinned
+	 */
+  bool startReadPage(File* file, const PageId pageNo, Page*& page, const PageClass pageClass = PAGE_HEAP);
+
+	/**
+	 * Complete finished asynchronous requests and hand over the reads completed since the last call.
+	 *
+	 * @param done   	Completed reads are appended to this vector
+	 * @param wait   	True to wait for at least one request if none has completed and any are in flight
+	 */
+  void takeCompletedReads(std::vector<ReadCompletion>& done, const bool wait);
+
+#if __cplusplus >= 202002L
+	/**
+	 * Read and pin a page from a C++20 coroutine: co_await bufMgr.readPageAsync(file, pageNo) suspends the
+	 * coroutine on a miss and resumes it once the page is read, while the PageLoop running it on this
+	 * thread goes on with other coroutines. Defined in coro.h, and declared only where coro.h compiles.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param pageClass	Class of the page
+	 * @return  			Awaitable yielding the pinned page
+	 */
+  PageRead readPageAsync(File* file, const PageId pageNo, const PageClass pageClass = PAGE_HEAP);
+#endif
+
+	/**
+	 * Attach a write-ahead log, which is flushed past a page's last logged change before the page is
+	 * written. Called by LogManager.
+	 *
+	 * @param log    	Log, or NULL to detach it
+	 */
+  void setLog(LogManager* log);
+
+	/**
+	 * Record the LSN of a change just logged to a page pinned in the pool. Called by LogManager.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param lsn    	LSN of the log record
+	 * @throws  HashNotFoundException  If the page is not in the pool
+	 */
+  void setPageLsn(File* file, const PageId pageNo, const Lsn lsn);
+
+	/**
+	 * List the pages with logged changes that have not been written, for a checkpoint of the log.
+	 *
+	 * @param pages  	Set to the pages
+	 */
+  void getDirtyPages(std::vector<DirtyPage>& pages);
+
+	/**
+	 * Write back up to the given number of unpinned pages with logged changes, those changed the longest
+	 * ago first, so that a later recovery has to redo less of the log. The pages stay in the pool.
+	 *
+	 * @param maxPages	Most pages to write
+	 * @return  			Number of pages written
+	 */
+  std::uint32_t writeOldestPages(const std::uint32_t maxPages);
+
+	/**
+	 * Sync the files written by the pool since the last call while a log was attached, so that pages no
+	 * longer listed by getDirtyPages() are on disk.
+	 */
+  void syncWrittenFiles();
+
+	/**
+	 * Write back the given pages of a file that are dirty in the pool, keeping them in the pool, for
+	 * callers that order their writes, such as a shadow-paged index writing its new nodes before the
+	 * meta page pointing at them. Pages not in the pool are skipped.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers in the file
+	 */
+  virtual void writePages(File* file, const std::vector<PageId>& pageNos);
+
+	/**
+	 * Memory backing the first block of frames: "heap", "aligned", "thp" or "hugetlb"
+	 */
+  const char* getPoolMemory();
+
+	/**
+	 * True if the pool reads and writes pages of aligned files with O_DIRECT
+	 */
+  bool usesDirectIo() const
+  {
+		return (poolOptions & POOL_DIRECT_IO) != 0;
   }
 };
 
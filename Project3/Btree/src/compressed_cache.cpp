@@ -0,0 +1,81 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "compressed_cache.h"
+#include "lz.h"
+
+namespace badgerdb {
+
+CompressedCache::CompressedCache(const std::size_t budget)
+	: budget(budget), used(0), scratch(LzCodec::maxCompressedSize(Page::SIZE), '\0')
+{
+}
+
+void CompressedCache::setBudget(const std::size_t budget)
+{
+  this->budget = budget;
+  while (used > budget)
+  	drop(entries.find(order.back()));
+}
+
+void CompressedCache::drop(std::unordered_map<PageKey, Entry, PageKeyHash>::iterator it)
+{
+  used -= it->second.data.size() + ENTRY_OVERHEAD;
+  order.erase(it->second.order);
+  entries.erase(it);
+}
+
+bool CompressedCache::put(const File* file, const PageId pageNo, const Page& page)
+{
+  erase(file, pageNo);
+
+  std::size_t length = LzCodec::compress(reinterpret_cast<const char*>(&page), Page::SIZE, &scratch[0]);
+  if (length > MAX_STORED_SIZE || length + ENTRY_OVERHEAD > budget)
+  	return false;
+
+  while (used + length + ENTRY_OVERHEAD > budget)
+  	drop(entries.find(order.back()));
+
+  PageKey key(file, pageNo);
+  order.push_front(key);
+  Entry& entry = entries[key];
+  entry.order = order.begin();
+  entry.data.assign(scratch, 0, length);
+  used += length + ENTRY_OVERHEAD;
+  return true;
+}
+
+bool CompressedCache::take(const File* file, const PageId pageNo, Page& page)
+{
+  std::unordered_map<PageKey, Entry, PageKeyHash>::iterator it = entries.find(PageKey(file, pageNo));
+  if (it == entries.end())
+  	return false;
+
+  const std::string& data = it->second.data;
+  bool ok = LzCodec::decompress(data.data(), data.size(), reinterpret_cast<char*>(&page), Page::SIZE);
+  drop(it);
+  return ok;
+}
+
+void CompressedCache::erase(const File* file, const PageId pageNo)
+{
+  std::unordered_map<PageKey, Entry, PageKeyHash>::iterator it = entries.find(PageKey(file, pageNo));
+  if (it != entries.end())
+  	drop(it);
+}
+
+void CompressedCache::eraseFile(const File* file)
+{
+  for (std::list<PageKey>::iterator it = order.begin(); it != order.end(); )
+  {
+  	const PageKey& key = *it++;
+  	if (key.first == file)
+  		drop(entries.find(key));
+  }
+}
+
+}
@@ -0,0 +1,174 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+* @brief Second tier below the buffer pool, holding clean pages evicted from it compressed with LzCodec in
+* a fixed amount of memory, so that a later miss on one of them is served without a read.
+*
+* The tier is exclusive: a page leaves it when it is taken back into the pool. Only clean pages are held,
+* so dropping one never loses a change. The least recently stored pages are dropped to stay within the
+* budget, and pages that do not compress to at most MAX_STORED_SIZE bytes are not stored.
+*
+* @warning This class is not threadsafe.
+*/
+class CompressedCache
+{
+ private:
+	/**
+	 * A page, by file and page number
+	 */
+  typedef std::pair<const File*, PageId> PageKey;
+
+	/**
+	 * Hash function of PageKey
+	 */
+  struct PageKeyHash
+  {
+  	std::size_t operator()(const PageKey& key) const
+  	{
+  		return std::hash<const File*>()(key.first) * 31 + key.second;
+  	}
+  };
+
+	/**
+	 * Stored page
+	 */
+  struct Entry
+  {
+		/**
+		 * Position in the replacement order
+		 */
+  	std::list<PageKey>::iterator order;
+
+		/**
+		 * Compressed image of the page
+		 */
+  	std::string data;
+  };
+
+	/**
+	 * Memory counted for an entry besides its compressed image
+	 */
+  static const std::size_t ENTRY_OVERHEAD = 96;
+
+	/**
+	 * Most memory held; 0 when the tier is disabled
+	 */
+  std::size_t budget;
+
+	/**
+	 * Memory held
+	 */
+  std::size_t used;
+
+	/**
+	 * Stored pages
+	 */
+  std::unordered_map<PageKey, Entry, PageKeyHash> entries;
+
+	/**
+	 * Stored pages, most recently stored first
+	 */
+  std::list<PageKey> order;
+
+	/**
+	 * Scratch buffer for compression
+	 */
+  std::string scratch;
+
+	/**
+	 * Drop a stored page.
+	 */
+  void drop(std::unordered_map<PageKey, Entry, PageKeyHash>::iterator it);
+
+ public:
+	/**
+	 * Largest compressed image stored, three quarters of a page; anything larger saves too little
+	 */
+  static const std::size_t MAX_STORED_SIZE = Page::SIZE * 3 / 4;
+
+	/**
+   * Constructor of CompressedCache class
+	 *
+	 * @param budget 	Most memory held in bytes; 0 disables the tier
+	 */
+  CompressedCache(const std::size_t budget = 0);
+
+	/**
+	 * Change the budget, dropping pages until the tier fits.
+	 *
+	 * @param budget 	Most memory held in bytes; 0 disables the tier and drops every page
+	 */
+  void setBudget(const std::size_t budget);
+
+	/**
+	 * Store a clean page evicted from the pool, replacing any earlier image of it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page   	Page
+	 * @return  			False if the page was not stored as it does not compress well
+	 */
+  bool put(const File* file, const PageId pageNo, const Page& page);
+
+	/**
+	 * Take a page out of the tier.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page   	Set to the page if it was stored
+	 * @return  			True if the page was stored
+	 */
+  bool take(const File* file, const PageId pageNo, Page& page);
+
+	/**
+	 * Drop a page, if stored, as it is about to be changed or deleted.
+	 */
+  void erase(const File* file, const PageId pageNo);
+
+	/**
+	 * Drop every page of a file.
+	 */
+  void eraseFile(const File* file);
+
+	/**
+	 * True if the tier has a budget
+	 */
+  bool enabled() const
+  {
+		return budget > 0;
+  }
+
+	/**
+	 * Memory held in bytes
+	 */
+  std::size_t bytes() const
+  {
+		return used;
+  }
+
+	/**
+	 * Number of pages stored
+	 */
+  std::size_t pages() const
+  {
+		return entries.size();
+  }
+};
+
+}
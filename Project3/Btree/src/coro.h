@@ -0,0 +1,497 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#if __cplusplus < 202002L
+#error "coro.h uses C++20 coroutines; compile with -std=c++20"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include "buffer.h"
+#include "btree.h"
+#include "exceptions/buffer_exceeded_exception.h"
+
+namespace badgerdb {
+
+class PageLoop;
+
+/**
+* @brief Result held by the promise of a PageTask.
+*/
+template <typename T>
+struct PageTaskResult
+{
+  T value;
+
+  void return_value(T result)
+  {
+		value = std::move(result);
+  }
+
+  T take()
+  {
+		return std::move(value);
+  }
+};
+
+template <>
+struct PageTaskResult<void>
+{
+  void return_void() {}
+  void take() {}
+};
+
+/**
+* @brief Coroutine producing a value of type T. It starts when awaited by another coroutine, which resumes
+* once it finishes, or when handed to PageLoop::spawn().
+*/
+template <typename T>
+class PageTask
+{
+ public:
+  struct promise_type : public PageTaskResult<T>
+  {
+		/**
+	   * Coroutine awaiting this one, resumed when it finishes
+		 */
+	  std::coroutine_handle<> continuation;
+
+		/**
+	   * Exception the coroutine ended with
+		 */
+	  std::exception_ptr error;
+
+	  PageTask get_return_object()
+	  {
+			return PageTask(std::coroutine_handle<promise_type>::from_promise(*this));
+	  }
+
+	  std::suspend_always initial_suspend() noexcept
+	  {
+			return std::suspend_always();
+	  }
+
+	  struct FinalAwaiter
+	  {
+	  	bool await_ready() noexcept { return false; }
+
+	  	std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+	  	{
+	  		std::coroutine_handle<> next = handle.promise().continuation;
+	  		return next ? next : std::noop_coroutine();
+	  	}
+
+	  	void await_resume() noexcept {}
+	  };
+
+	  FinalAwaiter final_suspend() noexcept
+	  {
+			return FinalAwaiter();
+	  }
+
+	  void unhandled_exception()
+	  {
+			error = std::current_exception();
+	  }
+  };
+
+  explicit PageTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+  PageTask(PageTask&& other) noexcept : handle(other.handle)
+  {
+		other.handle = nullptr;
+  }
+
+  PageTask(const PageTask&) = delete;
+  PageTask& operator=(const PageTask&) = delete;
+
+  ~PageTask()
+  {
+		if (handle)
+			handle.destroy();
+  }
+
+  bool await_ready() const
+  {
+		return handle.done();
+  }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+  {
+		handle.promise().continuation = awaiting;
+		return handle;
+  }
+
+  T await_resume()
+  {
+		if (handle.promise().error)
+			std::rethrow_exception(handle.promise().error);
+		return handle.promise().take();
+  }
+
+ private:
+  friend class PageLoop;
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+* @brief Awaitable read of a page, returned by BufMgr::readPageAsync(). Yields the page, pinned.
+*
+* A page in the buffer pool is pinned without suspending. On a miss the awaiting coroutine is parked in
+* the PageLoop running on the thread until the read completes. Without a PageLoop the read blocks.
+*/
+struct PageRead
+{
+  BufMgr* bufMgr;
+  File* file;
+  PageId pageNo;
+  PageClass pageClass;
+
+	/**
+   * Page, once pinned
+	 */
+  Page* page;
+
+	/**
+   * Coroutine waiting for the page
+	 */
+  std::coroutine_handle<> waiter;
+
+	/**
+   * True if the asynchronous read failed or could not be started, in which case the page is read
+   * synchronously on resumption so that the caller sees the error readPage() would raise
+	 */
+  bool failed;
+
+  PageRead(BufMgr* bufMgr, File* file, const PageId pageNo, const PageClass pageClass)
+  	: bufMgr(bufMgr), file(file), pageNo(pageNo), pageClass(pageClass), page(nullptr), failed(false)
+  {
+  }
+
+  bool await_ready();
+  void await_suspend(std::coroutine_handle<> handle);
+
+  Page* await_resume()
+  {
+		if (failed)
+			bufMgr->readPage(file, pageNo, page, NORMAL, pageClass);
+		return page;
+  }
+};
+
+/**
+* @brief Runs coroutines reading pages through a BufMgr on the calling thread. Coroutines run until they
+* wait for a page; the loop then runs the others, and resumes each waiter once its read completes, so
+* that as many reads are in flight as there are coroutines waiting. Asynchronous I/O has to be enabled
+* on the BufMgr for reads to overlap.
+*
+* @warning One loop runs per thread at a time.
+*/
+class PageLoop
+{
+ private:
+  typedef std::pair<File*, PageId> PageKey;
+
+	/**
+   * Buffer manager the pages are read through
+	 */
+  BufMgr& bufMgr;
+
+	/**
+   * Coroutines ready to run
+	 */
+  std::deque<std::coroutine_handle<> > ready;
+
+	/**
+   * Reads waiting for a page being read, in the order they started waiting
+	 */
+  std::multimap<PageKey, PageRead*> waiting;
+
+	/**
+   * Reads waiting for a frame to be released
+	 */
+  std::vector<PageRead*> blocked;
+
+	/**
+   * Coroutines started by spawn()
+	 */
+  std::vector<PageTask<void> > tasks;
+
+	/**
+   * Completions handed over by the buffer manager
+	 */
+  std::vector<ReadCompletion> completions;
+
+	/**
+   * Loop running on this thread
+	 */
+  static PageLoop*& running()
+  {
+		static thread_local PageLoop* loop = nullptr;
+		return loop;
+  }
+
+	/**
+	 * Try again to pin the page of a read, parking it again if it is still being read.
+	 */
+  void retry(PageRead* read)
+  {
+		try
+		{
+			if (!bufMgr.startReadPage(read->file, read->pageNo, read->page, read->pageClass))
+			{
+				waiting.insert(std::make_pair(PageKey(read->file, read->pageNo), read));
+				return;
+			}
+		}
+		catch (BufferExceededException e)
+		{
+			blocked.push_back(read);
+			return;
+		}
+		catch (...)
+		{
+			read->failed = true;
+		}
+		ready.push_back(read->waiter);
+  }
+
+	/**
+	 * Wait for reads to complete and make their waiters ready.
+	 */
+  void completeReads()
+  {
+		completions.clear();
+		bufMgr.takeCompletedReads(completions, true);
+
+		// nothing was in flight after all, so every waiter looks for its page again
+		if (completions.empty())
+		{
+			std::multimap<PageKey, PageRead*> stale;
+			stale.swap(waiting);
+			for (std::multimap<PageKey, PageRead*>::iterator it = stale.begin(); it != stale.end(); ++it)
+				retry(it->second);
+		}
+
+		for (std::size_t i = 0; i < completions.size(); i++)
+		{
+			ReadCompletion& done = completions[i];
+			PageKey key(done.file, done.pageNo);
+			std::vector<PageRead*> reads;
+			std::pair<std::multimap<PageKey, PageRead*>::iterator, std::multimap<PageKey, PageRead*>::iterator> range =
+				waiting.equal_range(key);
+			for (std::multimap<PageKey, PageRead*>::iterator it = range.first; it != range.second; ++it)
+				reads.push_back(it->second);
+			waiting.erase(range.first, range.second);
+
+			// a read started by a coroutine kept its pin for the first waiter
+			bool pinHeld = done.pinned;
+			for (std::size_t j = 0; j < reads.size(); j++)
+			{
+				if (!done.ok)
+				{
+					reads[j]->failed = true;
+					ready.push_back(reads[j]->waiter);
+				}
+				else if (pinHeld)
+				{
+					reads[j]->page = done.page;
+					ready.push_back(reads[j]->waiter);
+					pinHeld = false;
+				}
+				else
+					retry(reads[j]);
+			}
+			if (pinHeld)
+				bufMgr.unPinPage(done.file, done.pageNo, false);
+		}
+
+		// frames may have been released for the reads that found none
+		std::vector<PageRead*> stalled;
+		stalled.swap(blocked);
+		for (std::size_t i = 0; i < stalled.size(); i++)
+			retry(stalled[i]);
+  }
+
+ public:
+	/**
+   * Constructor of PageLoop class
+	 *
+	 * @param bufMgr 	Buffer manager the pages are read through
+	 */
+  explicit PageLoop(BufMgr& bufMgr) : bufMgr(bufMgr) {}
+
+	/**
+	 * Loop running on the calling thread, or nullptr
+	 */
+  static PageLoop* current()
+  {
+		return running();
+  }
+
+	/**
+	 * Hand a coroutine to the loop, to be started by run().
+	 *
+	 * @param task   	Coroutine
+	 */
+  void spawn(PageTask<void>&& task)
+  {
+		ready.push_back(task.handle);
+		tasks.push_back(std::move(task));
+  }
+
+	/**
+	 * Run the coroutines handed to the loop until all of them have finished.
+	 *
+	 * @throws  The first exception a coroutine ended with, once all have finished
+	 */
+  void run()
+  {
+		PageLoop* outer = running();
+		running() = this;
+
+		while (true)
+		{
+			while (!ready.empty())
+			{
+				std::coroutine_handle<> next = ready.front();
+				ready.pop_front();
+				next.resume();
+			}
+
+			if (waiting.empty() && blocked.empty())
+				break;
+
+			if (waiting.empty())
+			{
+				// nothing in flight will release a frame, so the reads fail as readPage() would
+				for (std::size_t i = 0; i < blocked.size(); i++)
+				{
+					blocked[i]->failed = true;
+					ready.push_back(blocked[i]->waiter);
+				}
+				blocked.clear();
+				continue;
+			}
+
+			completeReads();
+		}
+
+		running() = outer;
+
+		std::exception_ptr error;
+		for (std::size_t i = 0; i < tasks.size(); i++)
+			if (!error && tasks[i].handle.promise().error)
+				error = tasks[i].handle.promise().error;
+		tasks.clear();
+		if (error)
+			std::rethrow_exception(error);
+  }
+
+	/**
+	 * Park a read until its page has been read.
+	 */
+  void wait(PageRead* read)
+  {
+		if (read->failed)
+			blocked.push_back(read);
+		else
+			waiting.insert(std::make_pair(PageKey(read->file, read->pageNo), read));
+  }
+};
+
+inline bool PageRead::await_ready()
+{
+  if (PageLoop::current() == nullptr)
+  {
+  	bufMgr->readPage(file, pageNo, page, NORMAL, pageClass);
+  	return true;
+  }
+
+  try
+  {
+  	return bufMgr->startReadPage(file, pageNo, page, pageClass);
+  }
+  catch (BufferExceededException e)
+  {
+  	// every frame is pinned; wait for other reads to release one
+  	failed = true;
+  	return false;
+  }
+}
+
+inline void PageRead::await_suspend(std::coroutine_handle<> handle)
+{
+  waiter = handle;
+  PageLoop::current()->wait(this);
+  failed = false;
+}
+
+inline PageRead BufMgr::readPageAsync(File* file, const PageId pageNo, const PageClass pageClass)
+{
+  return PageRead(this, file, pageNo, pageClass);
+}
+
+/**
+* Look up a key in an index, as a scan from key to key would, reading the nodes through
+* BufMgr::readPageAsync() so that many lookups can be in flight on one thread.
+*
+* @param index  	Index on an INTEGER attribute
+* @param key    	Key looked for
+* @return  			Number of entries equal to the key
+*/
+inline PageTask<int> lookupAsync(BTreeIndex& index, int key)
+{
+  BufMgr* bufMgr = index.getBufMgr();
+  File* file = index.getFile();
+
+  bool isLeaf;
+  PageId pageNo = index.getRootPageNum(isLeaf);
+  while (!isLeaf)
+  {
+  	Page* node = co_await bufMgr->readPageAsync(file, pageNo, PAGE_INDEX_INTERIOR);
+  	PageId child = index.childForKey(node, key, isLeaf);
+  	bufMgr->unPinPage(file, pageNo, false);
+  	pageNo = child;
+  }
+
+  int found = 0;
+  while (pageNo != 0)
+  {
+  	Page* leaf = co_await bufMgr->readPageAsync(file, pageNo, PAGE_INDEX_LEAF);
+  	PageId next;
+  	found += index.countInLeaf(leaf, key, next);
+  	bufMgr->unPinPage(file, pageNo, false);
+  	pageNo = next;
+  }
+  co_return found;
+}
+
+/**
+* Fetch a record of a relation, reading its page through BufMgr::readPageAsync().
+*
+* @param bufMgr 	Buffer manager
+* @param file   	Relation file
+* @param rid    	Record id
+* @return  			The record
+*/
+inline PageTask<std::string> fetchRecordAsync(BufMgr& bufMgr, File* file, const RecordId rid)
+{
+  Page* page = co_await bufMgr.readPageAsync(file, rid.page_number, PAGE_HEAP);
+  std::string record = page->getRecord(rid);
+  bufMgr.unPinPage(file, rid.page_number, false);
+  co_return record;
+}
+
+}
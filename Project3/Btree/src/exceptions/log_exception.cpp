@@ -0,0 +1,23 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+LogException::LogException(const std::string& name,
+                           const std::string& reason)
+    : BadgerDbException(""), name_(name) {
+  std::stringstream ss;
+  ss << "Write-ahead log " << name_ << ": " << reason;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,42 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the write-ahead log cannot be
+ *        opened, written or read back.
+ */
+class LogException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a log exception for the given log file.
+   *
+   * @param name    Name of the log file.
+   * @param reason  What went wrong.
+   */
+  LogException(const std::string& name, const std::string& reason);
+
+  /**
+   * Returns the name of the log file that caused this exception.
+   */
+  virtual const std::string& name() const { return name_; }
+
+ protected:
+  /**
+   * Name of log file that caused this exception.
+   */
+  const std::string name_;
+};
+
+}
@@ -0,0 +1,42 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a shared buffer pool segment cannot
+ *        be created or attached to.
+ */
+class SharedPoolException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a shared pool exception for the given segment.
+   *
+   * @param name    Name of the shared-memory segment.
+   * @param reason  What went wrong.
+   */
+  SharedPoolException(const std::string& name, const std::string& reason);
+
+  /**
+   * Returns the name of the segment that caused this exception.
+   */
+  virtual const std::string& name() const { return name_; }
+
+ protected:
+  /**
+   * Name of segment that caused this exception.
+   */
+  const std::string name_;
+};
+
+}
@@ -0,0 +1,30 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a run of sorted entries cannot be
+ *        written to or read back from its temporary file.
+ */
+class SortException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a sort exception.
+   *
+   * @param reason  What went wrong.
+   */
+  explicit SortException(const std::string& reason);
+};
+
+}
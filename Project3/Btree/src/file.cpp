@@ -9,22 +9,145 @@
 
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
+#include "lz.h"
 #include "page.h"
 
 namespace badgerdb {
 
+namespace {
+
+// Compressed pages are stored in whole sectors.
+const std::uint32_t SECTOR_SIZE = 512;
+const std::uint32_t PAGE_SECTORS = Page::SIZE / SECTOR_SIZE;
+
+// Layout of the first page of a compressed file, after the FileHeader and
+// the magic.
+const std::streamoff CODEC_POSITION = sizeof(FileHeader) + 8;
+const std::streamoff CHUNK_COUNT_POSITION = CODEC_POSITION + 4;
+const std::streamoff CHUNK_TABLE_POSITION = CHUNK_COUNT_POSITION + 4;
+const std::uint32_t MAX_CHUNKS =
+    (Page::SIZE - CHUNK_TABLE_POSITION) / sizeof(std::uint32_t);
+
+// A page stored uncompressed, as compressing it saved no sector.
+const std::uint16_t ENTRY_RAW = 1;
+
+// PageHeader as written before it held an LSN.
+struct OldPageHeader {
+  std::uint16_t free_space_lower_bound;
+  std::uint16_t free_space_upper_bound;
+  SlotId num_slots;
+  SlotId num_free_slots;
+  PageId current_page_number;
+  PageId next_page_number;
+};
+
+const std::size_t OLD_DATA_SIZE = Page::SIZE - sizeof(OldPageHeader);
+
+}
+
+/**
+ * @brief Where a page of a compressed file is stored.
+ */
+struct PageMapEntry {
+  /**
+   * First sector of the page; 0 if the page has never been written.
+   */
+  std::uint32_t sector;
+
+  /**
+   * Length of the stored page in bytes.
+   */
+  std::uint16_t length;
+
+  /**
+   * ENTRY_RAW if the page is stored uncompressed.
+   */
+  std::uint16_t flags;
+};
+
+namespace {
+const std::uint32_t ENTRIES_PER_CHUNK = Page::SIZE / sizeof(PageMapEntry);
+}
+
+/**
+ * @brief Page map of a compressed file, kept whole in memory and written
+ *        through to chunks of Page::SIZE bytes stored among the pages.
+ *
+ * Room freed by pages that moved is known only in memory; it is found again
+ * from the gaps between stored pages when the file is opened.
+ */
+struct PageMap {
+  PageCodec codec;
+
+  /**
+   * Entry of each page, by page number.
+   */
+  std::vector<PageMapEntry> entries;
+
+  /**
+   * First sector of each chunk of the map.
+   */
+  std::vector<std::uint32_t> chunks;
+
+  /**
+   * Free extents below end_sector, never adjacent to each other: length by
+   * first sector, and (length, first sector) pairs for the best fit.
+   */
+  std::map<std::uint32_t, std::uint32_t> free_by_start;
+  std::set<std::pair<std::uint32_t, std::uint32_t> > free_by_length;
+
+  /**
+   * Sector after the last one used.
+   */
+  std::uint32_t end_sector;
+
+  /**
+   * Last page read, kept as walking the used list reads each page header
+   * before the page; INVALID_NUMBER if none.
+   */
+  PageId cached_page;
+  Page cached_image;
+
+  /**
+   * Buffer for stored pages.
+   */
+  std::vector<char> scratch;
+
+  PageMap(const PageCodec codec)
+      : codec(codec), end_sector(PAGE_SECTORS),
+        cached_page(Page::INVALID_NUMBER),
+        scratch(LzCodec::maxCompressedSize(Page::SIZE)) {}
+};
+
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+File::CountMap File::open_fds_;
+File::CountMap File::open_direct_fds_;
+File::PageMapMap File::open_page_maps_;
+const std::uint64_t File::ALIGNED_MAGIC;
+const std::uint64_t File::COMPRESSED_MAGIC;
+const std::uint64_t File::OLD_ALIGNED_MAGIC;
+const std::uint64_t File::OLD_COMPRESSED_MAGIC;
+const std::size_t File::DIRECT_IO_ALIGNMENT;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -64,7 +187,13 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+PageId File::getPageCount() {
+  const FileHeader& header = readHeader();
+  return header.num_pages;
+}
+
+File::File(const std::string& name, const bool create_new,
+           const PageCodec codec) : filename_(name) {
   openIfNeeded(create_new);
 
   if (create_new) {
@@ -72,13 +201,39 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
                          0 /* num_free_pages */, 0 /* first_free_page */};
     writeHeader(header);
+
+    // New files keep their pages aligned, so they can be read with O_DIRECT.
+    const std::uint64_t& magic =
+        codec == CODEC_NONE ? ALIGNED_MAGIC : COMPRESSED_MAGIC;
+    stream_->seekp(sizeof(FileHeader), std::ios::beg);
+    stream_->write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    if (codec != CODEC_NONE) {
+      // followed by the codec and an empty page map
+      std::uint32_t fields[2] = {static_cast<std::uint32_t>(codec), 0};
+      stream_->write(reinterpret_cast<const char*>(fields), sizeof(fields));
+      page_map_.reset(new PageMap(codec));
+      open_page_maps_[filename_] = page_map_;
+    }
+    stream_->flush();
+    aligned_ = true;
+    old_page_headers_ = false;
   }
 }
 
+PageCodec File::codec() const {
+  return isCompressed() ? page_map_->codec : CODEC_NONE;
+}
+
 void File::openIfNeeded(const bool create_new) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+    fd_ = open_fds_[filename_];
+    direct_fd_ = open_direct_fds_[filename_];
+    PageMapMap::iterator page_map = open_page_maps_.find(filename_);
+    if (page_map != open_page_maps_.end()) {
+      page_map_ = page_map->second;
+    }
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
@@ -97,8 +252,29 @@ void File::openIfNeeded(const bool create_new) {
       }
     }
     stream_.reset(new std::fstream(filename_, mode));
+    // a second handle for asynchronous I/O; the stream flushes every write,
+    // so the two see the same file contents
+    fd_ = ::open(filename_.c_str(), O_RDWR | O_CLOEXEC);
+    direct_fd_ = ::open(filename_.c_str(), O_RDWR | O_CLOEXEC | O_DIRECT);
     open_streams_[filename_] = stream_;
     open_counts_[filename_] = 1;
+    open_fds_[filename_] = fd_;
+    open_direct_fds_[filename_] = direct_fd_;
+  }
+
+  // Files written before the aligned layout have their first page where the
+  // magic would be.
+  std::uint64_t magic = 0;
+  stream_->seekg(sizeof(FileHeader), std::ios::beg);
+  stream_->read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  stream_->clear();
+  const bool compressed =
+      magic == COMPRESSED_MAGIC || magic == OLD_COMPRESSED_MAGIC;
+  aligned_ = compressed || magic == ALIGNED_MAGIC || magic == OLD_ALIGNED_MAGIC;
+  old_page_headers_ = magic != ALIGNED_MAGIC && magic != COMPRESSED_MAGIC;
+  if (compressed && !page_map_) {
+    loadPageMap();
+    open_page_maps_[filename_] = page_map_;
   }
 }
 
@@ -107,11 +283,23 @@ void File::close() {
   	--open_counts_[filename_];
 
   stream_.reset();
+  page_map_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
+    CountMap* maps[] = {&open_fds_, &open_direct_fds_};
+    for (int i = 0; i < 2; i++) {
+      CountMap::iterator fd = maps[i]->find(filename_);
+      if (fd != maps[i]->end()) {
+        if (fd->second >= 0) {
+          ::close(fd->second);
+        }
+        maps[i]->erase(fd);
+      }
+    }
     open_streams_.erase(filename_);
     open_counts_.erase(filename_);
+    open_page_maps_.erase(filename_);
   }
 }
 
@@ -128,21 +316,282 @@ void File::writeHeader(const FileHeader& header) {
   stream_->flush();
 }
 
+void File::readImage(const PageId page_number, Page& image) const {
+  io_stats_.pages_read++;
+  if (!isCompressed()) {
+    io_stats_.bytes_read += Page::SIZE;
+    stream_->seekg(pagePosition(page_number), std::ios::beg);
+    stream_->read(reinterpret_cast<char*>(&image), Page::SIZE);
+    return;
+  }
+
+  PageMap& map = *page_map_;
+  if (page_number == map.cached_page) {
+    image = map.cached_image;
+    return;
+  }
+
+  // a page never written reads as zeros, as a hole in a plain file does
+  if (page_number >= map.entries.size() ||
+      map.entries[page_number].sector == 0) {
+    memset(reinterpret_cast<char*>(&image), 0, Page::SIZE);
+    return;
+  }
+
+  const PageMapEntry& entry = map.entries[page_number];
+  io_stats_.bytes_read += entry.length;
+  stream_->seekg(static_cast<std::streamoff>(entry.sector) * SECTOR_SIZE,
+                 std::ios::beg);
+  if (entry.flags & ENTRY_RAW) {
+    stream_->read(reinterpret_cast<char*>(&image), Page::SIZE);
+  } else {
+    stream_->read(&map.scratch[0], entry.length);
+    if (!LzCodec::decompress(&map.scratch[0], entry.length,
+                             reinterpret_cast<char*>(&image), Page::SIZE)) {
+      stream_->clear();
+      throw InvalidPageException(page_number, filename_);
+    }
+  }
+  map.cached_page = page_number;
+  map.cached_image = image;
+}
+
+void File::writeImage(const PageId page_number, const PageHeader& header,
+                      const char* data) {
+  io_stats_.pages_written++;
+  if (!isCompressed()) {
+    io_stats_.bytes_written += Page::SIZE;
+    stream_->seekp(pagePosition(page_number), std::ios::beg);
+    stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
+    stream_->write(data, Page::DATA_SIZE);
+    stream_->flush();
+    return;
+  }
+
+  PageMap& map = *page_map_;
+  map.cached_page = page_number;
+  map.cached_image.header_ = header;
+  memcpy(map.cached_image.data_, data, Page::DATA_SIZE);
+
+  const char* stored = &map.scratch[0];
+  std::size_t length = LzCodec::compress(
+      reinterpret_cast<const char*>(&map.cached_image), Page::SIZE,
+      &map.scratch[0]);
+  std::uint16_t flags = 0;
+  if (length > Page::SIZE - SECTOR_SIZE) {
+    // not worth a sector
+    stored = reinterpret_cast<const char*>(&map.cached_image);
+    length = Page::SIZE;
+    flags = ENTRY_RAW;
+  }
+  std::uint32_t sectors = (length + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+  if (page_number >= map.entries.size()) {
+    PageMapEntry none = {0, 0, 0};
+    map.entries.resize(page_number + 1, none);
+  }
+  PageMapEntry entry = map.entries[page_number];
+  std::uint32_t old_sectors =
+      entry.sector == 0 ? 0 : (entry.length + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  if (sectors <= old_sectors) {
+    // shrinks in place
+    if (sectors < old_sectors) {
+      freeExtent(entry.sector + sectors, old_sectors - sectors);
+    }
+  } else if (old_sectors > 0 &&
+             growExtent(entry.sector + old_sectors, sectors - old_sectors)) {
+    // grows into the free sectors after it
+  } else {
+    // moves, the old copy staying valid until the map points elsewhere
+    std::uint32_t start = allocExtent(sectors);
+    if (old_sectors > 0) {
+      freeExtent(entry.sector, old_sectors);
+    }
+    entry.sector = start;
+  }
+  entry.length = static_cast<std::uint16_t>(length);
+  entry.flags = flags;
+
+  io_stats_.bytes_written += length;
+  stream_->seekp(static_cast<std::streamoff>(entry.sector) * SECTOR_SIZE,
+                 std::ios::beg);
+  stream_->write(stored, length);
+  map.entries[page_number] = entry;
+  writeMapEntry(page_number);
+  stream_->flush();
+}
+
+void File::loadPageMap() {
+  std::uint32_t fields[2];
+  stream_->seekg(CODEC_POSITION, std::ios::beg);
+  stream_->read(reinterpret_cast<char*>(fields), sizeof(fields));
+  page_map_.reset(new PageMap(static_cast<PageCodec>(fields[0])));
+  PageMap& map = *page_map_;
+
+  map.chunks.resize(fields[1]);
+  if (!map.chunks.empty()) {
+    stream_->read(reinterpret_cast<char*>(&map.chunks[0]),
+                  map.chunks.size() * sizeof(std::uint32_t));
+  }
+  map.entries.resize(map.chunks.size() * ENTRIES_PER_CHUNK);
+  for (std::size_t i = 0; i < map.chunks.size(); i++) {
+    stream_->seekg(static_cast<std::streamoff>(map.chunks[i]) * SECTOR_SIZE,
+                   std::ios::beg);
+    stream_->read(reinterpret_cast<char*>(&map.entries[i * ENTRIES_PER_CHUNK]),
+                  Page::SIZE);
+  }
+  stream_->clear();
 
+  // whatever lies between the chunks and the pages is free
+  std::vector<std::pair<std::uint32_t, std::uint32_t> > used;
+  for (std::size_t i = 0; i < map.chunks.size(); i++) {
+    used.push_back(std::make_pair(map.chunks[i], PAGE_SECTORS));
+  }
+  for (std::size_t i = 0; i < map.entries.size(); i++) {
+    if (map.entries[i].sector != 0) {
+      used.push_back(std::make_pair(
+          map.entries[i].sector,
+          (map.entries[i].length + SECTOR_SIZE - 1) / SECTOR_SIZE));
+    }
+  }
+  std::sort(used.begin(), used.end());
+  std::uint32_t next = PAGE_SECTORS;
+  for (std::size_t i = 0; i < used.size(); i++) {
+    if (next < used[i].first) {
+      map.free_by_start[next] = used[i].first - next;
+      map.free_by_length.insert(std::make_pair(used[i].first - next, next));
+    }
+    next = std::max(next, used[i].first + used[i].second);
+  }
+  map.end_sector = next;
+}
 
+std::uint32_t File::allocExtent(const std::uint32_t sectors) {
+  PageMap& map = *page_map_;
 
+  // the smallest free extent that fits, split if longer
+  std::set<std::pair<std::uint32_t, std::uint32_t> >::iterator fit =
+      map.free_by_length.lower_bound(std::make_pair(sectors, 0u));
+  if (fit == map.free_by_length.end()) {
+    std::uint32_t start = map.end_sector;
+    map.end_sector += sectors;
+    return start;
+  }
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+  std::uint32_t length = fit->first;
+  std::uint32_t start = fit->second;
+  map.free_by_length.erase(fit);
+  map.free_by_start.erase(start);
+  if (length > sectors) {
+    map.free_by_start[start + sectors] = length - sectors;
+    map.free_by_length.insert(std::make_pair(length - sectors, start + sectors));
+  }
+  return start;
+}
+
+bool File::growExtent(const std::uint32_t start, const std::uint32_t sectors) {
+  PageMap& map = *page_map_;
+  if (start == map.end_sector) {
+    map.end_sector += sectors;
+    return true;
+  }
+
+  std::map<std::uint32_t, std::uint32_t>::iterator next =
+      map.free_by_start.find(start);
+  if (next == map.free_by_start.end() || next->second < sectors) {
+    return false;
+  }
+  std::uint32_t length = next->second;
+  map.free_by_length.erase(std::make_pair(length, start));
+  map.free_by_start.erase(next);
+  if (length > sectors) {
+    map.free_by_start[start + sectors] = length - sectors;
+    map.free_by_length.insert(std::make_pair(length - sectors, start + sectors));
+  }
+  return true;
+}
+
+void File::freeExtent(std::uint32_t start, std::uint32_t sectors) {
+  PageMap& map = *page_map_;
+
+  // merges with the free extents on either side
+  std::map<std::uint32_t, std::uint32_t>::iterator next =
+      map.free_by_start.lower_bound(start);
+  if (next != map.free_by_start.begin()) {
+    std::map<std::uint32_t, std::uint32_t>::iterator prev = next;
+    --prev;
+    if (prev->first + prev->second == start) {
+      start = prev->first;
+      sectors += prev->second;
+      map.free_by_length.erase(std::make_pair(prev->second, prev->first));
+      map.free_by_start.erase(prev);
+    }
+  }
+  if (next != map.free_by_start.end() && start + sectors == next->first) {
+    sectors += next->second;
+    map.free_by_length.erase(std::make_pair(next->second, next->first));
+    map.free_by_start.erase(next);
+  }
+
+  if (start + sectors == map.end_sector) {
+    map.end_sector = start;
+  } else {
+    map.free_by_start[start] = sectors;
+    map.free_by_length.insert(std::make_pair(sectors, start));
+  }
+}
+
+void File::writeMapEntry(const PageId page_number) {
+  PageMap& map = *page_map_;
+
+  std::uint32_t chunk = page_number / ENTRIES_PER_CHUNK;
+  while (map.chunks.size() <= chunk) {
+    if (map.chunks.size() == MAX_CHUNKS) {
+      throw InvalidPageException(page_number, filename_);
+    }
+
+    // a new chunk holds the entries already in memory, all empty
+    std::uint32_t start = allocExtent(PAGE_SECTORS);
+    std::vector<char> zeros(Page::SIZE, 0);
+    stream_->seekp(static_cast<std::streamoff>(start) * SECTOR_SIZE,
+                   std::ios::beg);
+    stream_->write(&zeros[0], Page::SIZE);
+    map.chunks.push_back(start);
+
+    std::uint32_t count = map.chunks.size();
+    stream_->seekp(CHUNK_TABLE_POSITION + (count - 1) * sizeof(std::uint32_t),
+                   std::ios::beg);
+    stream_->write(reinterpret_cast<const char*>(&start), sizeof(start));
+    stream_->seekp(CHUNK_COUNT_POSITION, std::ios::beg);
+    stream_->write(reinterpret_cast<const char*>(&count), sizeof(count));
+  }
+
+  stream_->seekp(static_cast<std::streamoff>(map.chunks[chunk]) * SECTOR_SIZE +
+                     (page_number % ENTRIES_PER_CHUNK) * sizeof(PageMapEntry),
+                 std::ios::beg);
+  stream_->write(reinterpret_cast<const char*>(&map.entries[page_number]),
+                 sizeof(PageMapEntry));
+}
+
+
+
+
+
+PageFile PageFile::create(const std::string& filename, const PageCodec codec) {
+  return PageFile(filename, true /* create_new */, codec);
 }
 
 PageFile PageFile::open(const std::string& filename) {
   return PageFile(filename, false /* create_new */);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const PageCodec codec)
+: File(name, create_new, codec)
 {
+  if (old_page_headers_) {
+    upgradePages();
+  }
 }
 
 PageFile::~PageFile() {
@@ -247,9 +696,7 @@ Page PageFile::readPage(const PageId page_number) const {
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  readImage(page_number, page);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -273,6 +720,31 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::beginRawRead(const PageId page_number) const {
+  FileHeader header = readHeader();
+
+	if (page_number >= header.num_pages)
+	{
+		throw InvalidPageException(page_number, filename_);
+	}
+}
+
+void PageFile::endRawRead(const PageId page_number, const Page& page) const {
+  if (!page.isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+}
+
+void PageFile::beginRawWrite(const PageId page_number, Page& image) const {
+	PageHeader header = readPageHeader(page_number);
+	if (header.current_page_number == Page::INVALID_NUMBER)
+	{
+		// Page has been deleted since it was read.
+		throw InvalidPageException(page_number, filename_);
+	}
+	image.header_.next_page_number = header.next_page_number;
+}
+
 void PageFile::deletePage(const PageId page_number) {
   FileHeader header = readHeader();
 
@@ -315,14 +787,17 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  writeImage(page_number, header, new_page.data_);
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
+  // a compressed page is read whole
+  if (isCompressed()) {
+    Page page;
+    readImage(page_number, page);
+    return page.header_;
+  }
+
   PageHeader header;
   stream_->seekg(pagePosition(page_number), std::ios::beg);
   stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
@@ -332,16 +807,84 @@ PageHeader PageFile::readPageHeader(PageId page_number) const {
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+void PageFile::upgradePages() {
+  const FileHeader header = readHeader();
+  Page image;
+  Page page;
+  for (PageId page_number = 1; page_number < header.num_pages; ++page_number) {
+    readImage(page_number, image);
+    upgradeImage(page_number, reinterpret_cast<const char*>(&image), page);
+  }
+
+  // Pages move further from the start of the file when they become aligned,
+  // so the last is moved first.
+  const bool was_aligned = aligned_;
+  for (PageId page_number = header.num_pages - 1; page_number > 0;
+       --page_number) {
+    aligned_ = was_aligned;
+    readImage(page_number, image);
+    upgradeImage(page_number, reinterpret_cast<const char*>(&image), page);
+    aligned_ = true;
+    writeImage(page_number, page.header_, page.data_);
+  }
+  aligned_ = true;
+
+  const std::uint64_t& magic =
+      isCompressed() ? COMPRESSED_MAGIC : ALIGNED_MAGIC;
+  stream_->seekp(sizeof(FileHeader), std::ios::beg);
+  stream_->write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  stream_->flush();
+  old_page_headers_ = false;
+}
+
+void PageFile::upgradeImage(const PageId page_number, const char* image,
+                            Page& page) {
+  OldPageHeader old;
+  memcpy(&old, image, sizeof(old));
+  const char* old_data = image + sizeof(OldPageHeader);
+
+  page.initialize();
+  page.header_.num_slots = old.num_slots;
+  page.header_.num_free_slots = old.num_free_slots;
+  page.header_.current_page_number = old.current_page_number;
+  page.header_.next_page_number = old.next_page_number;
+  if (old.num_slots == 0) {
+    // free, or never written
+    return;
+  }
+
+  const std::size_t growth = OLD_DATA_SIZE - Page::DATA_SIZE;
+  if (old.free_space_upper_bound < old.free_space_lower_bound + growth) {
+    throw InsufficientSpaceException(
+        page_number, growth,
+        old.free_space_upper_bound - old.free_space_lower_bound);
+  }
+  // the slots stay at the start of the data, the records end earlier
+  memcpy(page.data_, old_data, old.free_space_lower_bound);
+  memcpy(page.data_ + old.free_space_upper_bound - growth,
+         old_data + old.free_space_upper_bound,
+         OLD_DATA_SIZE - old.free_space_upper_bound);
+  page.header_.free_space_lower_bound = old.free_space_lower_bound;
+  page.header_.free_space_upper_bound = old.free_space_upper_bound - growth;
+  for (SlotId i = 1; i <= old.num_slots; ++i) {
+    PageSlot* slot = page.getSlot(i);
+    if (slot->used) {
+      slot->item_offset -= growth;
+    }
+  }
+}
+
+BlobFile BlobFile::create(const std::string& filename, const PageCodec codec) {
+  return BlobFile(filename, true /* create_new */, codec);
 }
 
 BlobFile BlobFile::open(const std::string& filename) {
   return BlobFile(filename, false /* create_new */);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const PageCodec codec)
+: File(name, create_new, codec) {
 }
 
 BlobFile::~BlobFile() {
@@ -381,15 +924,12 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readImage(page_number, page);
 	return page;
 }
 
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writeImage(new_page_number, new_page.header_, new_page.data_);
 }
 
 //delePage should not be called for a blob_file, not supported
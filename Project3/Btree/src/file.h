@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cassert>
 #include <fstream>
 #include <string>
 #include <map>
@@ -17,6 +18,33 @@
 namespace badgerdb {
 
 class FileIterator;
+struct PageMap;
+
+/**
+ * @brief Codec of the pages of a file, chosen when the file is created.
+ */
+enum PageCodec {
+  CODEC_NONE = 0,   /* Pages stored whole at fixed offsets */
+  CODEC_LZ   = 1    /* Pages compressed with LzCodec, found through a page map */
+};
+
+/**
+ * @brief Page reads and writes through a File object, counting the bytes
+ *        moved to and from the file, which are fewer than the bytes of the
+ *        pages in a compressed file.
+ */
+struct FileIoStats {
+  std::uint64_t pages_read;
+  std::uint64_t bytes_read;
+  std::uint64_t pages_written;
+  std::uint64_t bytes_written;
+
+  void clear() {
+    pages_read = bytes_read = pages_written = bytes_written = 0;
+  }
+
+  FileIoStats() { clear(); }
+};
 
 /**
  * @brief Header metadata for files on disk which contain pages.
@@ -80,12 +108,15 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param codec       Codec of the pages of a new file; an existing file
+   *                    keeps the codec it was created with.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const PageCodec codec = CODEC_NONE);
 
   /**
    * Deletes an existing file.
@@ -164,15 +195,135 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Returns the number of pages the file has allocated, counting the header,
+   * which is one more than the number of its last page.
+   *
+   * @return  Number of pages.
+   */
+  PageId getPageCount();
+
+  /**
+   * Returns the descriptor of the underlying file, through which pages may be
+   * read and written asynchronously.
+   * @return  File descriptor.
+   */
+  int descriptor() const { return fd_; }
+
+  /**
+   * Returns a descriptor of the underlying file opened with O_DIRECT, through
+   * which pages may be read and written bypassing the operating system's page
+   * cache from buffers aligned to DIRECT_IO_ALIGNMENT.
+   * @return  File descriptor, or -1 if the file's pages are not aligned or
+   *          the filesystem does not support direct I/O.
+   */
+  int directDescriptor() const {
+    return aligned_ && !isCompressed() ? direct_fd_ : -1;
+  }
+
+  /**
+   * Returns true if the pages of the file start at multiples of Page::SIZE.
+   * Files created since the aligned layout was introduced are aligned.
+   */
+  bool isAligned() const { return aligned_; }
+
+  /**
+   * Returns true if the pages of the file are compressed.  Such pages have no
+   * fixed position, so they cannot be read or written through a descriptor.
+   */
+  bool isCompressed() const { return page_map_.get() != NULL; }
+
+  /**
+   * Returns the codec the file was created with.
+   */
+  PageCodec codec() const;
+
+  /**
+   * Returns the counts of page reads and writes through this object.
+   */
+  const FileIoStats& ioStats() const { return io_stats_; }
+
+  /**
+   * Clears the counts of page reads and writes through this object.
+   */
+  void clearIoStats() { io_stats_.clear(); }
+
+  /**
+   * Returns the position of the page with the given number in the file, at
+   * which a read or write of Page::SIZE bytes through a descriptor is issued.
+   * Not defined for a compressed file.
+   * @param page_number   Number of page.
+   * @return  Position of page in file.
+   */
+  std::uint64_t pageOffset(const PageId page_number) const {
+    assert(!isCompressed());
+    return static_cast<std::streamoff>(pagePosition(page_number));
+  }
+
+  /**
+   * Alignment of buffers, offsets and lengths of direct I/O.
+   */
+  static const std::size_t DIRECT_IO_ALIGNMENT = 4096;
+
+  /**
+   * Checks that a page may be read before a read of it through a descriptor
+   * is issued.
+   * @param page_number   Number of page to read.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
+   */
+  virtual void beginRawRead(const PageId page_number) const {}
+
+  /**
+   * Checks a page once a read of it through a descriptor has completed.
+   * @param page_number   Number of page read.
+   * @param page          Page as read from disk.
+   * @throws  InvalidPageException  If the page is not currently used.
+   */
+  virtual void endRawRead(const PageId page_number, const Page& page) const {}
+
+  /**
+   * Prepares the image of a page to be written through a descriptor, making
+   * the same adjustments to it as writePage() would.
+   * @param page_number   Number of page whose contents to replace.
+   * @param image         Copy of the page, to be written.
+   * @throws  InvalidPageException  If the page has been deleted.
+   */
+  virtual void beginRawWrite(const PageId page_number, Page& image) const {}
+
  protected:
+  /**
+   * Marks a file whose pages are aligned; stored right after the FileHeader,
+   * where the first page used to begin.
+   */
+  static const std::uint64_t ALIGNED_MAGIC = 0x324e474c41424442ULL;
+
+  /**
+   * Marks a file whose pages are compressed, in place of ALIGNED_MAGIC.  The
+   * rest of the first Page::SIZE bytes holds the codec and the positions of
+   * the chunks of the page map.
+   */
+  static const std::uint64_t COMPRESSED_MAGIC = 0x32504d5a4c424442ULL;
+
+  /**
+   * Mark aligned and compressed files written before PageHeader held an LSN,
+   * whose pages have a header 8 bytes shorter.  Files that are not aligned
+   * predate it too.
+   */
+  static const std::uint64_t OLD_ALIGNED_MAGIC = 0x4e47494c41424442ULL;
+  static const std::uint64_t OLD_COMPRESSED_MAGIC = 0x50504d5a4c424442ULL;
+
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file).  In an aligned file the header
+   * takes up the whole of the first Page::SIZE bytes.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
+  std::streampos pagePosition(const PageId page_number) const {
+    if (aligned_) {
+      return static_cast<std::streamoff>(page_number) * Page::SIZE;
+    }
     return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
   }
 
@@ -210,6 +361,67 @@ class File {
    */
   void writeHeader(const FileHeader& header);
 
+  /**
+   * Reads a whole page from the file, decompressing it in a compressed file.
+   * No bounds checking is performed.
+   *
+   * @param page_number   Number of page to read.
+   * @param image         Set to the page as stored.
+   * @throws  InvalidPageException  If the stored page cannot be decompressed.
+   */
+  void readImage(const PageId page_number, Page& image) const;
+
+  /**
+   * Writes a whole page to the file, compressing it in a compressed file.
+   * No bounds checking is performed.
+   *
+   * @param page_number   Number of page to write.
+   * @param header        Header of page to write.
+   * @param data          Data of page to write, Page::DATA_SIZE bytes.
+   * @throws  InvalidPageException  If the page map of the file is full.
+   */
+  void writeImage(const PageId page_number, const PageHeader& header,
+                  const char* data);
+
+  /**
+   * Reads the page map of a compressed file from disk.
+   */
+  void loadPageMap();
+
+  /**
+   * Finds room for a compressed page in a compressed file.
+   *
+   * @param sectors   Length in sectors.
+   * @return  First sector.
+   */
+  std::uint32_t allocExtent(const std::uint32_t sectors);
+
+  /**
+   * Extends the room of a compressed page when the sectors after it are free.
+   *
+   * @param start     First sector after the page.
+   * @param sectors   Sectors to add.
+   * @return  True if the room was extended.
+   */
+  bool growExtent(const std::uint32_t start, const std::uint32_t sectors);
+
+  /**
+   * Returns room no longer used to a compressed file.
+   *
+   * @param start     First sector.
+   * @param sectors   Length in sectors.
+   */
+  void freeExtent(std::uint32_t start, std::uint32_t sectors);
+
+  /**
+   * Writes the page map entry of a page to disk, adding a chunk to the map if
+   * needed.
+   *
+   * @param page_number   Number of page.
+   * @throws  InvalidPageException  If the page map of the file is full.
+   */
+  void writeMapEntry(const PageId page_number);
+
   typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
   typedef std::map<std::string, int> CountMap;
 
@@ -223,6 +435,23 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Descriptors for opened files.
+   */
+  static CountMap open_fds_;
+
+  /**
+   * Descriptors opened with O_DIRECT for opened files.
+   */
+  static CountMap open_direct_fds_;
+
+  typedef std::map<std::string, std::shared_ptr<PageMap> > PageMapMap;
+
+  /**
+   * Page maps of opened compressed files.
+   */
+  static PageMapMap open_page_maps_;
+
   /**
    * Name of the file this object represents.
    */
@@ -233,6 +462,40 @@ class File {
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Descriptor for underlying filesystem object, shared like <stream_>.
+   */
+  int fd_;
+
+  /**
+   * Descriptor opened with O_DIRECT, shared like <stream_>; -1 if the
+   * filesystem does not support it.
+   */
+  int direct_fd_;
+
+  /**
+   * Whether the pages of the file are aligned.
+   */
+  bool aligned_;
+
+  /**
+   * Whether the pages of the file have the PageHeader written before it held
+   * an LSN.  A PageFile upgrades its pages when opened; the pages of a
+   * BlobFile have no PageHeader and are read as they are.
+   */
+  bool old_page_headers_;
+
+  /**
+   * Page map of a compressed file, shared like <stream_>; NULL if the file
+   * is not compressed.
+   */
+  std::shared_ptr<PageMap> page_map_;
+
+  /**
+   * Page reads and writes through this object.
+   */
+  mutable FileIoStats io_stats_;
+
   friend class FileIterator;
 };
 
@@ -243,9 +506,11 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param codec     Codec of the pages of the file.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename,
+                         const PageCodec codec = CODEC_NONE);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
@@ -264,12 +529,14 @@ class PageFile : public File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param codec       Codec of the pages of a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const PageCodec codec = CODEC_NONE);
 
   /**
    * Copy constructor.
@@ -341,6 +608,29 @@ class PageFile : public File {
    */
   FileIterator end();
 
+  /**
+   * Checks that the page is within the file.
+   * @param page_number   Number of page to read.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
+   */
+  void beginRawRead(const PageId page_number) const;
+
+  /**
+   * Checks that the page read is in use.
+   * @param page_number   Number of page read.
+   * @param page          Page as read from disk.
+   * @throws  InvalidPageException  If the page is not currently used.
+   */
+  void endRawRead(const PageId page_number, const Page& page) const;
+
+  /**
+   * Keeps the next page pointer on disk in the image, as writePage() does.
+   * @param page_number   Number of page whose contents to replace.
+   * @param image         Copy of the page, to be written.
+   * @throws  InvalidPageException  If the page has been deleted.
+   */
+  void beginRawWrite(const PageId page_number, Page& image) const;
+
  private:
 
   /**
@@ -379,6 +669,29 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Rewrites the pages of a file written before PageHeader held an LSN with
+   * the current header, moving them to the aligned layout if they are not
+   * aligned.  Every page is checked before any is rewritten.
+   *
+   * @throws  InsufficientSpaceException  If a page has no room left for the
+   *                                      longer header.
+   */
+  void upgradePages();
+
+  /**
+   * Converts the image of a page with the old, shorter PageHeader, moving its
+   * records down by the growth of the header.
+   *
+   * @param page_number   Number of the page.
+   * @param image         Page::SIZE bytes as read from the file.
+   * @param page          Set to the page with the current header.
+   * @throws  InsufficientSpaceException  If the page has no room left for the
+   *                                      longer header.
+   */
+  static void upgradeImage(const PageId page_number, const char* image,
+                           Page& page);
+
   friend class FileIterator;
 };
 
@@ -389,9 +702,11 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param codec     Codec of the pages of the file.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename,
+                         const PageCodec codec = CODEC_NONE);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
@@ -412,12 +727,14 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param codec       Codec of the pages of a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const PageCodec codec = CODEC_NONE);
 
   /**
    * Copy constructor.
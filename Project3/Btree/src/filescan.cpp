@@ -10,10 +10,11 @@
 
 namespace badgerdb { 
 
-FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr, const AccessStrategy accessStrategy)
 {
   file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
+	strategy = accessStrategy;
 	curDirtyFlag = false;
   curPage = NULL;
 	filePageIter = file->begin();
@@ -53,7 +54,7 @@ void FileScan::scanNext(RecordId& outRid)
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
+    bufMgr->readPage(file, (*filePageIter).page_number(), curPage, strategy); 
 		curDirtyFlag = false;
 
 		// get the first record off the page
@@ -88,7 +89,7 @@ void FileScan::scanNext(RecordId& outRid)
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    bufMgr->readPage(file, (*filePageIter).page_number(), curPage, strategy);
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
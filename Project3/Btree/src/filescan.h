@@ -24,7 +24,11 @@ class FileScan
 {
  public:
 
-  FileScan(const std::string &name, BufMgr *bufMgr);
+  /**
+   * Opens the relation for a scan. Pages are read with the BULK_READ strategy by default so that
+   * a full scan recycles a small ring of frames instead of flushing the buffer pool.
+   */
+  FileScan(const std::string &name, BufMgr *bufMgr, const AccessStrategy strategy = BULK_READ);
 
   ~FileScan();
 
@@ -60,6 +64,11 @@ class FileScan
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
+
+  /**
+   * Access strategy used to read pages of the relation.
+   */
+  AccessStrategy strategy;
 };
 
 }
@@ -0,0 +1,253 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include "io.h"
+
+namespace badgerdb {
+
+IoBackend* IoBackend::create(const std::uint32_t queueDepth, const IoBackendKind kind)
+{
+  assert(queueDepth > 0);
+
+  if (kind != IO_THREADS)
+  {
+  	UringBackend* uring = UringBackend::open(queueDepth);
+  	if (uring != NULL || kind == IO_URING)
+  		return uring;
+  }
+  return new ThreadPoolBackend(queueDepth);
+}
+
+//----------------------------------------
+// io_uring
+//----------------------------------------
+
+UringBackend::UringBackend(std::uint32_t queueDepth)
+	: IoBackend(queueDepth), ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes(NULL),
+	  sqRingSize(0), cqRingSize(0), sqesSize(0), queued(0)
+{
+}
+
+UringBackend* UringBackend::open(const std::uint32_t queueDepth)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = syscall(__NR_io_uring_setup, queueDepth, &params);
+  if (fd < 0)
+  	return NULL;
+
+  UringBackend* ring = new UringBackend(queueDepth);
+  ring->ringFd = fd;
+
+  ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+  	if (ring->cqRingSize > ring->sqRingSize)
+  		ring->sqRingSize = ring->cqRingSize;
+  	ring->cqRingSize = ring->sqRingSize;
+  }
+
+  ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQ_RING);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  	ring->cqRing = ring->sqRing;
+  else
+  	ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+  	                    IORING_OFF_CQ_RING);
+  ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQES);
+
+  if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || sqes == MAP_FAILED)
+  {
+  	if (sqes != MAP_FAILED)
+  		munmap(sqes, ring->sqesSize);
+  	delete ring;
+  	return NULL;
+  }
+  ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+  char* sq = static_cast<char*>(ring->sqRing);
+  ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+  char* cq = static_cast<char*>(ring->cqRing);
+  ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  return ring;
+}
+
+UringBackend::~UringBackend()
+{
+  if (sqes != NULL)
+  	munmap(sqes, sqesSize);
+  if (cqRing != MAP_FAILED && cqRing != sqRing)
+  	munmap(cqRing, cqRingSize);
+  if (sqRing != MAP_FAILED)
+  	munmap(sqRing, sqRingSize);
+  if (ringFd >= 0)
+  	close(ringFd);
+}
+
+void UringBackend::submit(IoRequest* request)
+{
+  assert(pending < depth);
+
+  request->iov.iov_base = request->buf;
+  request->iov.iov_len = request->len;
+
+  // vectored operations are supported by every kernel with io_uring
+  unsigned tail = *sqTail;
+  unsigned index = tail & *sqMask;
+  io_uring_sqe* sqe = &sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = request->op == IO_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+  sqe->fd = request->fd;
+  sqe->off = request->offset;
+  sqe->addr = reinterpret_cast<std::uint64_t>(&request->iov);
+  sqe->len = 1;
+  sqe->user_data = reinterpret_cast<std::uint64_t>(request);
+  sqArray[index] = index;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  queued++;
+  pending++;
+}
+
+std::uint32_t UringBackend::reap(std::vector<IoRequest*>& done, std::uint32_t minDone)
+{
+  if (minDone > pending)
+  	minDone = pending;
+
+  std::uint32_t reaped = 0;
+  while (true)
+  {
+  	// collect whatever has completed
+  	unsigned head = *cqHead;
+  	unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  	for (; head != tail; head++)
+  	{
+  		io_uring_cqe* cqe = &cqes[head & *cqMask];
+  		IoRequest* request = reinterpret_cast<IoRequest*>(cqe->user_data);
+  		request->result = cqe->res;
+  		done.push_back(request);
+  		reaped++;
+  	}
+  	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+  	if (queued == 0 && reaped >= minDone)
+  		break;
+
+  	// pass on the queued requests, waiting for the rest of the completions asked for
+  	std::uint32_t wait = reaped < minDone ? minDone - reaped : 0;
+  	int ret = syscall(__NR_io_uring_enter, ringFd, queued, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  	if (ret < 0)
+  	{
+  		if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+  			continue;
+  		break;
+  	}
+  	queued -= ret;
+  }
+
+  pending -= reaped;
+  return reaped;
+}
+
+//----------------------------------------
+// Thread pool
+//----------------------------------------
+
+ThreadPoolBackend::ThreadPoolBackend(const std::uint32_t queueDepth)
+	: IoBackend(queueDepth), stopping(false)
+{
+  std::uint32_t threads = queueDepth < 16 ? queueDepth : 16;
+  for (std::uint32_t i = 0; i < threads; i++)
+  	workers.push_back(std::thread(&ThreadPoolBackend::work, this));
+}
+
+ThreadPoolBackend::~ThreadPoolBackend()
+{
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	stopping = true;
+  }
+  queuedCond.notify_all();
+  for (std::size_t i = 0; i < workers.size(); i++)
+  	workers[i].join();
+}
+
+void ThreadPoolBackend::work()
+{
+  std::unique_lock<std::mutex> guard(latch);
+  while (true)
+  {
+  	while (todo.empty() && !stopping)
+  		queuedCond.wait(guard);
+  	if (todo.empty())
+  		return;
+
+  	IoRequest* request = todo.front();
+  	todo.pop_front();
+  	guard.unlock();
+
+  	ssize_t ret;
+  	if (request->op == IO_READ)
+  		ret = pread(request->fd, request->buf, request->len, request->offset);
+  	else
+  		ret = pwrite(request->fd, request->buf, request->len, request->offset);
+  	request->result = ret < 0 ? -errno : ret;
+
+  	guard.lock();
+  	completed.push_back(request);
+  	doneCond.notify_one();
+  }
+}
+
+void ThreadPoolBackend::submit(IoRequest* request)
+{
+  assert(pending < depth);
+
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	todo.push_back(request);
+  }
+  queuedCond.notify_one();
+  pending++;
+}
+
+std::uint32_t ThreadPoolBackend::reap(std::vector<IoRequest*>& done, std::uint32_t minDone)
+{
+  if (minDone > pending)
+  	minDone = pending;
+
+  std::unique_lock<std::mutex> guard(latch);
+  while (completed.size() < minDone)
+  	doneCond.wait(guard);
+
+  std::uint32_t reaped = completed.size();
+  done.insert(done.end(), completed.begin(), completed.end());
+  completed.clear();
+  pending -= reaped;
+  return reaped;
+}
+
+}
@@ -0,0 +1,299 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <sys/uio.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace badgerdb {
+
+/**
+* @brief Operation of an asynchronous I/O request.
+*/
+enum IoOp {
+  IO_READ  = 0,
+  IO_WRITE = 1
+};
+
+/**
+* @brief Implementation of asynchronous I/O, passed to IoBackend::create().
+*/
+enum IoBackendKind {
+  IO_AUTO    = 0,   /* io_uring if the kernel supports it, otherwise the thread pool */
+  IO_URING   = 1,   /* Linux io_uring */
+  IO_THREADS = 2    /* Pool of threads issuing blocking pread and pwrite calls */
+};
+
+/**
+* @brief Asynchronous read or write of a byte range of a file. The memory is owned by the caller, and
+* must stay valid until the request is returned by IoBackend::reap().
+*/
+struct IoRequest
+{
+	/**
+   * Read or write
+	 */
+  IoOp op;
+
+	/**
+   * Descriptor of the file
+	 */
+  int fd;
+
+	/**
+   * Offset in the file
+	 */
+  std::uint64_t offset;
+
+	/**
+   * Buffer read into or written from
+	 */
+  void* buf;
+
+	/**
+   * Number of bytes to transfer
+	 */
+  std::uint32_t len;
+
+	/**
+   * Once complete, the number of bytes transferred, or minus the error number
+	 */
+  std::int64_t result;
+
+	/**
+   * Vector describing buf, for backends that submit vectored operations
+	 */
+  struct iovec iov;
+
+	/**
+   * Destructor of IoRequest class; requests may be extended by their submitters
+	 */
+  virtual ~IoRequest() {}
+};
+
+/**
+* @brief Submits I/O requests without waiting for them and reports their completion.
+*
+* A backend holds at most queueDepth() requests in flight; callers reap completions before submitting
+* more. Submitted requests may be held back until the next call to reap(), so that requests submitted
+* together reach the kernel together.
+*
+* @warning This class is not threadsafe.
+*/
+class IoBackend
+{
+ protected:
+	/**
+   * Most requests in flight
+	 */
+  std::uint32_t depth;
+
+	/**
+   * Requests submitted and not yet reaped
+	 */
+  std::uint32_t pending;
+
+	/**
+   * Constructor of IoBackend class
+	 */
+  IoBackend(std::uint32_t queueDepth) : depth(queueDepth), pending(0) {}
+
+ public:
+	/**
+   * Destructor of IoBackend class. Requests still in flight must have been reaped.
+	 */
+  virtual ~IoBackend() {}
+
+	/**
+	 * Create a backend.
+	 *
+	 * @param queueDepth	Most requests in flight
+	 * @param kind   	Implementation; IO_AUTO falls back to the thread pool if io_uring is unavailable
+	 * @return  			The backend, or NULL if io_uring was asked for and is unavailable
+	 */
+  static IoBackend* create(const std::uint32_t queueDepth, const IoBackendKind kind = IO_AUTO);
+
+	/**
+	 * Queue a request. No more than queueDepth() requests may be in flight.
+	 *
+	 * @param request	Request, returned by reap() once complete
+	 */
+  virtual void submit(IoRequest* request) = 0;
+
+	/**
+	 * Send the queued requests on their way and collect the completed ones.
+	 *
+	 * @param done   	Completed requests are appended to this vector
+	 * @param minDone	Number of completions to wait for, limited to the requests in flight
+	 * @return  			Number of requests appended
+	 */
+  virtual std::uint32_t reap(std::vector<IoRequest*>& done, std::uint32_t minDone) = 0;
+
+	/**
+	 * Name of the implementation
+	 */
+  virtual const char* name() const = 0;
+
+	/**
+	 * Number of requests submitted and not yet reaped
+	 */
+  std::uint32_t inFlight() const
+  {
+		return pending;
+  }
+
+	/**
+	 * Most requests in flight
+	 */
+  std::uint32_t queueDepth() const
+  {
+		return depth;
+  }
+};
+
+/**
+* @brief IoBackend over a Linux io_uring, set up through the raw system calls.
+*/
+class UringBackend : public IoBackend
+{
+ private:
+	/**
+   * Descriptor of the ring
+	 */
+  int ringFd;
+
+	/**
+   * Mapped submission ring, completion ring and submission entries
+	 */
+  void* sqRing;
+  void* cqRing;
+  io_uring_sqe* sqes;
+  std::size_t sqRingSize;
+  std::size_t cqRingSize;
+  std::size_t sqesSize;
+
+	/**
+   * Fields of the submission ring
+	 */
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+
+	/**
+   * Fields of the completion ring
+	 */
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  io_uring_cqe* cqes;
+
+	/**
+   * Requests placed in the submission ring and not yet passed to the kernel
+	 */
+  std::uint32_t queued;
+
+	/**
+	 * Constructor of UringBackend class; use open().
+	 */
+  UringBackend(std::uint32_t queueDepth);
+
+ public:
+	/**
+	 * Set up a ring.
+	 *
+	 * @param queueDepth	Most requests in flight
+	 * @return  			The backend, or NULL if the kernel does not provide io_uring
+	 */
+  static UringBackend* open(const std::uint32_t queueDepth);
+
+	/**
+   * Destructor of UringBackend class
+	 */
+  ~UringBackend();
+
+  void submit(IoRequest* request);
+  std::uint32_t reap(std::vector<IoRequest*>& done, std::uint32_t minDone);
+  const char* name() const { return "io_uring"; }
+};
+
+/**
+* @brief IoBackend issuing blocking pread and pwrite calls from a pool of threads, for systems
+* without io_uring.
+*/
+class ThreadPoolBackend : public IoBackend
+{
+ private:
+	/**
+   * Worker threads
+	 */
+  std::vector<std::thread> workers;
+
+	/**
+   * Latch protecting the queues
+	 */
+  std::mutex latch;
+
+	/**
+   * Signalled when a request is queued or the pool stops
+	 */
+  std::condition_variable queuedCond;
+
+	/**
+   * Signalled when a request completes
+	 */
+  std::condition_variable doneCond;
+
+	/**
+   * Requests waiting for a worker
+	 */
+  std::deque<IoRequest*> todo;
+
+	/**
+   * Completed requests not yet reaped
+	 */
+  std::vector<IoRequest*> completed;
+
+	/**
+   * True once the workers are to exit
+	 */
+  bool stopping;
+
+	/**
+   * Body of a worker thread
+	 */
+  void work();
+
+ public:
+	/**
+   * Constructor of ThreadPoolBackend class
+	 *
+	 * @param queueDepth	Most requests in flight; one worker is started per request, up to 16
+	 */
+  ThreadPoolBackend(const std::uint32_t queueDepth);
+
+	/**
+   * Destructor of ThreadPoolBackend class
+	 */
+  ~ThreadPoolBackend();
+
+  void submit(IoRequest* request);
+  std::uint32_t reap(std::vector<IoRequest*>& done, std::uint32_t minDone);
+  const char* name() const { return "threads"; }
+};
+
+}
@@ -0,0 +1,186 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "key_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KEY_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Halve the range holding the answer until it fits in a block of keys, and return the start of a block
+ * covering it that lies inside the array, so that the block can be loaded whole. n is at least block.
+ */
+template <class T, bool UPPER>
+inline const T* narrow(const T* keys, const int n, const T& key, const int block)
+{
+  const T* base = keys;
+  int len = n;
+  while (len > block)
+  {
+  	int half = len / 2;
+  	base = KeySearch::before<T, UPPER>(base[half], key) ? base + half : base;
+  	len -= half;
+  }
+  return base < keys + n - block ? base : keys + n - block;
+}
+
+#ifdef KEY_SEARCH_X86
+
+/**
+ * Keys in a block of each vectorized search, two vectors' worth, which beat larger blocks.
+ */
+const int AVX2_INT_BLOCK = 16;
+const int AVX2_DOUBLE_BLOCK = 8;
+const int SSE_INT_BLOCK = 8;
+const int SSE_DOUBLE_BLOCK = 4;
+
+__attribute__((target("avx2,popcnt")))
+int avx2Bound(const int* keys, const int n, const int key, const bool upper)
+{
+  const int* block = upper ? narrow<int, true>(keys, n, key, AVX2_INT_BLOCK)
+                           : narrow<int, false>(keys, n, key, AVX2_INT_BLOCK);
+  __m256i k = _mm256_set1_epi32(key);
+  int count = 0;
+  for (int i = 0; i < AVX2_INT_BLOCK; i += 8)
+  {
+  	__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+  	__m256i past = upper ? _mm256_cmpgt_epi32(v, k) : _mm256_cmpgt_epi32(k, v);
+  	count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(past)));
+  }
+  // an upper bound counts the keys past the key, a lower bound those before it
+  return (block - keys) + (upper ? AVX2_INT_BLOCK - count : count);
+}
+
+__attribute__((target("avx2,popcnt")))
+int avx2Bound(const double* keys, const int n, const double key, const bool upper)
+{
+  const double* block = upper ? narrow<double, true>(keys, n, key, AVX2_DOUBLE_BLOCK)
+                              : narrow<double, false>(keys, n, key, AVX2_DOUBLE_BLOCK);
+  __m256d k = _mm256_set1_pd(key);
+  int count = 0;
+  for (int i = 0; i < AVX2_DOUBLE_BLOCK; i += 4)
+  {
+  	__m256d v = _mm256_loadu_pd(block + i);
+  	__m256d before = upper ? _mm256_cmp_pd(v, k, _CMP_LE_OQ) : _mm256_cmp_pd(v, k, _CMP_LT_OQ);
+  	count += __builtin_popcount(_mm256_movemask_pd(before));
+  }
+  return (block - keys) + count;
+}
+
+__attribute__((target("sse4.1,popcnt")))
+int sseBound(const int* keys, const int n, const int key, const bool upper)
+{
+  const int* block = upper ? narrow<int, true>(keys, n, key, SSE_INT_BLOCK)
+                           : narrow<int, false>(keys, n, key, SSE_INT_BLOCK);
+  __m128i k = _mm_set1_epi32(key);
+  int count = 0;
+  for (int i = 0; i < SSE_INT_BLOCK; i += 4)
+  {
+  	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+  	__m128i past = upper ? _mm_cmpgt_epi32(v, k) : _mm_cmplt_epi32(v, k);
+  	count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(past)));
+  }
+  return (block - keys) + (upper ? SSE_INT_BLOCK - count : count);
+}
+
+__attribute__((target("sse4.1,popcnt")))
+int sseBound(const double* keys, const int n, const double key, const bool upper)
+{
+  const double* block = upper ? narrow<double, true>(keys, n, key, SSE_DOUBLE_BLOCK)
+                              : narrow<double, false>(keys, n, key, SSE_DOUBLE_BLOCK);
+  __m128d k = _mm_set1_pd(key);
+  int count = 0;
+  for (int i = 0; i < SSE_DOUBLE_BLOCK; i += 2)
+  {
+  	__m128d v = _mm_loadu_pd(block + i);
+  	__m128d before = upper ? _mm_cmple_pd(v, k) : _mm_cmplt_pd(v, k);
+  	count += __builtin_popcount(_mm_movemask_pd(before));
+  }
+  return (block - keys) + count;
+}
+
+#endif
+
+/**
+ * Vectorized search of int or double keys, or the binary search if the node has fewer keys than a block.
+ */
+template <class T>
+int vectorSearch(const T* keys, const int n, const T& key, const bool upper, const SearchStrategy strategy)
+{
+#ifdef KEY_SEARCH_X86
+  const int block = sizeof(T) == sizeof(int) ? (strategy == SEARCH_AVX2 ? AVX2_INT_BLOCK : SSE_INT_BLOCK)
+                                             : (strategy == SEARCH_AVX2 ? AVX2_DOUBLE_BLOCK : SSE_DOUBLE_BLOCK);
+  if (n >= block)
+  	return strategy == SEARCH_AVX2 ? avx2Bound(keys, n, key, upper) : sseBound(keys, n, key, upper);
+#endif
+  return upper ? KeySearch::binaryBound<T, true>(keys, n, key) : KeySearch::binaryBound<T, false>(keys, n, key);
+}
+
+}
+
+SearchStrategy KeySearch::best()
+{
+  static const SearchStrategy strategy = supported(SEARCH_AVX2) ? SEARCH_AVX2
+                                       : supported(SEARCH_SSE) ? SEARCH_SSE : SEARCH_BINARY;
+  return strategy;
+}
+
+bool KeySearch::supported(const SearchStrategy strategy)
+{
+  switch (strategy)
+  {
+  	case SEARCH_LINEAR:
+  	case SEARCH_BINARY:
+  		return true;
+#ifdef KEY_SEARCH_X86
+  	case SEARCH_SSE:
+  		__builtin_cpu_init();
+  		return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt");
+  	case SEARCH_AVX2:
+  		__builtin_cpu_init();
+  		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+  	default:
+  		return false;
+  }
+}
+
+const char* KeySearch::name(const SearchStrategy strategy)
+{
+  switch (strategy)
+  {
+  	case SEARCH_LINEAR:
+  		return "linear";
+  	case SEARCH_BINARY:
+  		return "binary";
+  	case SEARCH_SSE:
+  		return "sse4.1";
+  	case SEARCH_AVX2:
+  		return "avx2";
+  }
+  return "unknown";
+}
+
+int KeySearch::vectorBound(const int* keys, const int n, const int& key, const bool upper,
+                           const SearchStrategy strategy)
+{
+  return vectorSearch(keys, n, key, upper, strategy);
+}
+
+int KeySearch::vectorBound(const double* keys, const int n, const double& key, const bool upper,
+                           const SearchStrategy strategy)
+{
+  return vectorSearch(keys, n, key, upper, strategy);
+}
+
+}
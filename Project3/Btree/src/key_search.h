@@ -0,0 +1,144 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+namespace badgerdb {
+
+/**
+ * @brief How the keys of a B+ tree node are searched.
+ */
+enum SearchStrategy {
+    SEARCH_LINEAR = 0,  /* Compare the keys in order */
+    SEARCH_BINARY = 1,  /* Branch-free binary search */
+    SEARCH_SSE    = 2,  /* Binary search down to a block of keys compared at once with SSE4.1 and POPCNT */
+    SEARCH_AVX2   = 3   /* Binary search down to a block of keys compared at once with AVX2 and POPCNT */
+};
+
+/**
+* @brief Search of the sorted keys of a node.
+*
+* The binary search halves the range with a conditional move rather than a branch, so that it does not
+* pay for mispredicting half of its comparisons. The vectorized searches stop halving once the range fits
+* in a block of 32 or 64 bytes and count the keys of the block below the key looked for with a few
+* vector compares. They are compiled for their instruction set function by function, so the build needs
+* no extra flags, and are only used for int and double keys on a CPU that has the instructions; other
+* keys are searched by the binary search instead.
+*/
+class KeySearch
+{
+ public:
+	/**
+	 * Fastest strategy the CPU supports.
+	 */
+  static SearchStrategy best();
+
+	/**
+	 * True if the CPU has the instructions the strategy needs.
+	 */
+  static bool supported(const SearchStrategy strategy);
+
+	/**
+	 * Name of a strategy, for reports.
+	 */
+  static const char* name(const SearchStrategy strategy);
+
+	/**
+	 * Number of keys less than or equal to a key, which is the index of the child of a non-leaf node
+	 * to descend to, or where to insert into a leaf after the entries equal to the key.
+	 *
+	 * @param keys     	Keys in ascending order
+	 * @param n        	Number of keys
+	 * @param key      	Key looked for
+	 * @param strategy	How to search
+	 */
+  template <class T>
+  static int upperBound(const T* keys, const int n, const T& key, const SearchStrategy strategy)
+  {
+		if (strategy == SEARCH_LINEAR)
+			return linearBound<T, true>(keys, n, key);
+		if (strategy == SEARCH_BINARY)
+			return binaryBound<T, true>(keys, n, key);
+		return vectorBound(keys, n, key, true, strategy);
+  }
+
+	/**
+	 * Number of keys less than a key, which is the index of the first entry of a leaf equal to or
+	 * greater than the key.
+	 *
+	 * @param keys     	Keys in ascending order
+	 * @param n        	Number of keys
+	 * @param key      	Key looked for
+	 * @param strategy	How to search
+	 */
+  template <class T>
+  static int lowerBound(const T* keys, const int n, const T& key, const SearchStrategy strategy)
+  {
+		if (strategy == SEARCH_LINEAR)
+			return linearBound<T, false>(keys, n, key);
+		if (strategy == SEARCH_BINARY)
+			return binaryBound<T, false>(keys, n, key);
+		return vectorBound(keys, n, key, false, strategy);
+  }
+
+	/**
+	 * True if a key sorts before the one looked for: at or before it for an upper bound.
+	 */
+  template <class T, bool UPPER>
+  static bool before(const T& k, const T& key)
+  {
+		return UPPER ? k <= key : k < key;
+  }
+
+	/**
+	 * Search comparing the keys in order.
+	 */
+  template <class T, bool UPPER>
+  static int linearBound(const T* keys, const int n, const T& key)
+  {
+		int idx = 0;
+		while (idx < n && before<T, UPPER>(keys[idx], key))
+			idx++;
+		return idx;
+  }
+
+	/**
+	 * Branch-free binary search: the range [base, base + n] holding the answer halves each round.
+	 */
+  template <class T, bool UPPER>
+  static int binaryBound(const T* keys, int n, const T& key)
+  {
+		if (n == 0)
+			return 0;
+		const T* base = keys;
+		while (n > 1)
+		{
+			int half = n / 2;
+			base = before<T, UPPER>(base[half], key) ? base + half : base;
+			n -= half;
+		}
+		return (base - keys) + before<T, UPPER>(*base, key);
+  }
+
+ private:
+	/**
+	 * Keys without a vectorized search fall back to the binary search.
+	 */
+  template <class T>
+  static int vectorBound(const T* keys, const int n, const T& key, const bool upper, const SearchStrategy)
+  {
+		return upper ? binaryBound<T, true>(keys, n, key) : binaryBound<T, false>(keys, n, key);
+  }
+
+  static int vectorBound(const int* keys, const int n, const int& key, const bool upper,
+                         const SearchStrategy strategy);
+
+  static int vectorBound(const double* keys, const int n, const double& key, const bool upper,
+                         const SearchStrategy strategy);
+};
+
+}
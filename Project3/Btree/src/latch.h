@@ -0,0 +1,88 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+* @brief Version latch of a node, taken by writers and validated by readers.
+*
+* The word counts the changes made under the latch and is odd while a writer holds it. A reader
+* writes nothing: it notes the version with readBegin(), reads the node into locals and keeps what
+* it read only if validate() finds the version unchanged, reading again otherwise. What a reader
+* reads before validating may be torn, so it must not follow or index by it unchecked.
+* A thread waiting for the latch yields between attempts, for its holder may be descheduled on a
+* busy machine.
+*/
+class NodeLatch
+{
+ public:
+  NodeLatch() : word(0) {}
+
+	/**
+	 * Wait for the latch to be free and return its version, to validate what is read after.
+	 */
+  std::uint64_t readBegin() const
+  {
+		while (true)
+		{
+			std::uint64_t version = word.load(std::memory_order_acquire);
+			if (!(version & 1))
+				return version;
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+	 * True if no writer took the latch since readBegin() returned the version.
+	 *
+	 * @param version	Version returned by readBegin()
+	 */
+  bool validate(const std::uint64_t version) const
+  {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return word.load(std::memory_order_relaxed) == version;
+  }
+
+	/**
+	 * Take the latch for a writer.
+	 */
+  void lock()
+  {
+		while (true)
+		{
+			std::uint64_t version = word.load(std::memory_order_relaxed);
+			if (!(version & 1) &&
+			    word.compare_exchange_weak(version, version + 1, std::memory_order_acquire))
+				break;
+			std::this_thread::yield();
+		}
+		// readers seeing any change made under the latch see the odd version too
+		std::atomic_thread_fence(std::memory_order_release);
+  }
+
+	/**
+	 * Release the latch taken by a writer, moving it to the next version.
+	 */
+  void unlock()
+  {
+		word.fetch_add(1, std::memory_order_release);
+  }
+
+ private:
+	/**
+	 * Version, odd while a writer holds the latch.
+	 */
+  std::atomic<std::uint64_t> word;
+};
+
+}
@@ -0,0 +1,176 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cassert>
+#include <cstring>
+#include "lz.h"
+
+namespace badgerdb {
+
+namespace {
+
+const int HASH_BITS = 12;
+
+// a block ends with literals, so that matching never reads past the input
+const std::size_t LAST_LITERALS = 5;
+const std::size_t MATCH_LIMIT = 12;
+
+inline std::uint32_t read32(const char* p)
+{
+  std::uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline std::uint32_t hashPrefix(const std::uint32_t prefix)
+{
+  return (prefix * 2654435761u) >> (32 - HASH_BITS);
+}
+
+char* writeLength(char* op, std::size_t length)
+{
+  for (; length >= 255; length -= 255)
+  	*op++ = static_cast<char>(255);
+  *op++ = static_cast<char>(length);
+  return op;
+}
+
+char* writeSequence(char* op, const char* literals, const std::size_t literalLength, const std::size_t offset,
+                    const std::size_t matchLength)
+{
+  unsigned char* token = reinterpret_cast<unsigned char*>(op++);
+  *token = (literalLength >= 15 ? 15 : literalLength) << 4;
+  if (literalLength >= 15)
+  	op = writeLength(op, literalLength - 15);
+  memcpy(op, literals, literalLength);
+  op += literalLength;
+
+  // the last sequence has no match
+  if (matchLength == 0)
+  	return op;
+
+  *op++ = static_cast<char>(offset & 0xff);
+  *op++ = static_cast<char>(offset >> 8);
+  std::size_t extra = matchLength - LzCodec::MIN_MATCH;
+  *token |= extra >= 15 ? 15 : extra;
+  if (extra >= 15)
+  	op = writeLength(op, extra - 15);
+  return op;
+}
+
+bool readLength(const unsigned char*& ip, const unsigned char* end, std::size_t& length)
+{
+  unsigned char byte;
+  do
+  {
+  	if (ip == end)
+  		return false;
+  	byte = *ip++;
+  	length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}
+
+std::size_t LzCodec::compress(const char* src, const std::size_t length, char* dst)
+{
+  assert(length <= MAX_INPUT);
+
+  char* op = dst;
+  std::size_t anchor = 0;
+  if (length >= MATCH_LIMIT)
+  {
+  	// positions are 16 bits, which is every position of an input of at most 64 kB
+  	std::uint16_t table[1 << HASH_BITS];
+  	memset(table, 0, sizeof(table));
+
+  	std::size_t limit = length - MATCH_LIMIT;
+  	std::size_t matchEnd = length - LAST_LITERALS;
+  	std::size_t ip = 0;
+  	std::uint32_t misses = 0;
+  	while (ip <= limit)
+  	{
+  		std::uint32_t prefix = read32(src + ip);
+  		std::uint32_t slot = hashPrefix(prefix);
+  		std::size_t ref = table[slot];
+  		table[slot] = static_cast<std::uint16_t>(ip);
+
+  		if (ref < ip && ip - ref < 65536 && read32(src + ref) == prefix)
+  		{
+  			std::size_t matchLength = MIN_MATCH;
+  			while (ip + matchLength < matchEnd && src[ref + matchLength] == src[ip + matchLength])
+  				matchLength++;
+
+  			op = writeSequence(op, src + anchor, ip - anchor, ip - ref, matchLength);
+  			ip += matchLength;
+  			anchor = ip;
+  			misses = 0;
+  		}
+  		else
+  		{
+  			// step further the longer nothing matches
+  			ip += 1 + (misses++ >> 5);
+  		}
+  	}
+  }
+
+  return writeSequence(op, src + anchor, length - anchor, 0, 0) - dst;
+}
+
+bool LzCodec::decompress(const char* src, const std::size_t length, char* dst, const std::size_t capacity)
+{
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* end = ip + length;
+  char* op = dst;
+  char* outEnd = dst + capacity;
+
+  while (ip < end)
+  {
+  	unsigned char token = *ip++;
+
+  	std::size_t literalLength = token >> 4;
+  	if (literalLength == 15 && !readLength(ip, end, literalLength))
+  		return false;
+  	if (literalLength > static_cast<std::size_t>(end - ip) || literalLength > static_cast<std::size_t>(outEnd - op))
+  		return false;
+  	memcpy(op, ip, literalLength);
+  	op += literalLength;
+  	ip += literalLength;
+
+  	// the last sequence ends the block
+  	if (ip == end)
+  		break;
+
+  	if (end - ip < 2)
+  		return false;
+  	std::size_t offset = ip[0] | (ip[1] << 8);
+  	ip += 2;
+  	if (offset == 0 || offset > static_cast<std::size_t>(op - dst))
+  		return false;
+
+  	std::size_t matchLength = token & 15;
+  	if (matchLength == 15 && !readLength(ip, end, matchLength))
+  		return false;
+  	matchLength += MIN_MATCH;
+  	if (matchLength > static_cast<std::size_t>(outEnd - op))
+  		return false;
+
+  	// a match may overlap its own output, repeating the bytes it copies
+  	const char* ref = op - offset;
+  	if (offset >= matchLength)
+  		memcpy(op, ref, matchLength);
+  	else
+  		for (std::size_t i = 0; i < matchLength; i++)
+  			op[i] = ref[i];
+  	op += matchLength;
+  }
+
+  return op == outEnd;
+}
+
+}
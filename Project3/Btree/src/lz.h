@@ -0,0 +1,70 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+* @brief Byte-oriented LZ77 codec in the manner of LZ4, fast enough to compress pages on their way out of
+* the buffer pool.
+*
+* A block is a series of sequences, each a token byte, the literal run, a 2 byte offset back into the
+* output and the match length. The token holds the literal length in its high nibble and the match length
+* less MIN_MATCH in its low nibble, a nibble of 15 being continued by bytes added to it up to one below
+* 255. The last sequence has literals only. Matches are found through a hash table of 4 byte prefixes, and
+* the search skips ahead faster the longer it goes without a match, so incompressible data passes quickly.
+*
+* @warning Inputs are limited to 64 kB.
+*/
+class LzCodec
+{
+ public:
+	/**
+	 * Shortest match encoded
+	 */
+  static const std::size_t MIN_MATCH = 4;
+
+	/**
+	 * Longest input accepted
+	 */
+  static const std::size_t MAX_INPUT = 1 << 16;
+
+	/**
+	 * Size of the buffer compress() needs for an input of the given length.
+	 */
+  static std::size_t maxCompressedSize(const std::size_t length)
+  {
+		return length + length / 255 + 16;
+  }
+
+	/**
+	 * Compress a block.
+	 *
+	 * @param src    	Input
+	 * @param length 	Length of the input, at most MAX_INPUT
+	 * @param dst    	Output, of at least maxCompressedSize(length) bytes
+	 * @return  			Length of the output
+	 */
+  static std::size_t compress(const char* src, const std::size_t length, char* dst);
+
+	/**
+	 * Decompress a block made by compress().
+	 *
+	 * @param src    	Compressed block
+	 * @param length 	Length of the block
+	 * @param dst    	Output
+	 * @param capacity	Length of the original input
+	 * @return  			False if the block is malformed or does not expand to exactly capacity bytes
+	 */
+  static bool decompress(const char* src, const std::size_t length, char* dst, const std::size_t capacity);
+};
+
+}
@@ -6,10 +6,21 @@
  * of Wisconsin-Madison.
  */
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "lz.h"
+#include "shared_buffer.h"
+#include "wal.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
@@ -20,6 +31,12 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 
 #define checkPassFail(a, b)                                                  \
   \
@@ -77,6 +94,14 @@ void createRelationStress();
 void intTests();
 int intScan(BTreeIndex* index, int lowVal, Operator lowOp, int highVal,
             Operator highOp);
+void doubleTests();
+int doubleScan(BTreeIndex* index, double lowVal, Operator lowOp,
+               double highVal, Operator highOp);
+void stringTests();
+int stringScan(BTreeIndex* index, std::string lowVal, Operator lowOp,
+               std::string highVal, Operator highOp);
+int indexScan(BTreeIndex* index, const void* lowVal, Operator lowOp,
+              const void* highVal, Operator highOp);
 void indexTests();
 void test1();
 void test2();
@@ -84,13 +109,65 @@ void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
 void intTestsFileLoad();
+void resizeTests();
+void strategyTests();
+void classTests();
+void sweepTests();
+void missRatioTests();
+void asyncIoTests();
+void directIoTests();
+void readPagesTests();
+void startReadTests();
+void sharedPoolTests();
+void compressedCacheTests();
+void compressedFileTests();
+void walTests();
+void checkpointTests();
+void shadowPagingTests();
+void keySearchTests();
+void formatUpgradeTests();
+void bulkLoadTests();
+void parallelBuildTests();
+void deleteTests();
+void concurrentTests();
+void optimisticReadTests();
+void cursorTests();
+void batchScanTests();
 void errorTests();
 void deleteRelation();
 
 int main(int argc, char** argv) {
   std::cout << "leaf size:" << INTARRAYLEAFSIZE
             << " non-leaf size:" << INTARRAYNONLEAFSIZE << std::endl;
+  std::cout << "double leaf size:" << DOUBLEARRAYLEAFSIZE
+            << " non-leaf size:" << DOUBLEARRAYNONLEAFSIZE << std::endl;
+  std::cout << "string leaf size:" << STRINGARRAYLEAFSIZE
+            << " non-leaf size:" << STRINGARRAYNONLEAFSIZE << std::endl;
 
   // Clean up from any previous runs that crashed.
   try {
@@ -146,6 +223,30 @@ int main(int argc, char** argv) {
   test4();
   test6();
   test5();
+  test7();
+  test8();
+  test9();
+  test10();
+  test11();
+  test12();
+  test13();
+  test14();
+  test15();
+  test16();
+  test17();
+  test18();
+  test19();
+  test20();
+  test21();
+  test22();
+  test23();
+  test24();
+  test25();
+  test26();
+  test27();
+  test28();
+  test29();
+  test30();
   // destructor doesn't get called after errorTests //
   errorTests();
 
@@ -216,6 +317,196 @@ void test6() {
   deleteRelation();
 }
 
+void test7() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "resize-buffer-test" << std::endl;
+  createRelationForward();
+  resizeTests();
+  deleteRelation();
+}
+
+void test8() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "bulk-read-strategy-test" << std::endl;
+  createRelationForward();
+  strategyTests();
+  deleteRelation();
+}
+
+void test9() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "page-class-test" << std::endl;
+  createRelationForward();
+  classTests();
+  deleteRelation();
+}
+
+void test10() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "clock-sweep-test" << std::endl;
+  sweepTests();
+}
+
+void test11() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "miss-ratio-curve-test" << std::endl;
+  createRelationForward();
+  missRatioTests();
+  deleteRelation();
+}
+
+void test12() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "async-io-test" << std::endl;
+  createRelationForward();
+  asyncIoTests();
+  deleteRelation();
+}
+
+void test13() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "direct-io-test" << std::endl;
+  createRelationForward();
+  directIoTests();
+  deleteRelation();
+}
+
+void test14() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "read-pages-test" << std::endl;
+  createRelationForward();
+  readPagesTests();
+  deleteRelation();
+}
+
+void test15() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "start-read-test" << std::endl;
+  createRelationForward();
+  startReadTests();
+  deleteRelation();
+}
+
+void test16() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "shared-pool-test" << std::endl;
+  createRelationForward();
+  sharedPoolTests();
+  deleteRelation();
+}
+
+void test17() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "compressed-cache-test" << std::endl;
+  createRelationForward();
+  compressedCacheTests();
+  deleteRelation();
+}
+
+void test18() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "compressed-file-test" << std::endl;
+  createRelationForward();
+  compressedFileTests();
+  deleteRelation();
+}
+
+void test19() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "write-ahead-log-test" << std::endl;
+  createRelationForward();
+  walTests();
+  deleteRelation();
+}
+
+void test20() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "checkpoint-test" << std::endl;
+  createRelationForward();
+  checkpointTests();
+  deleteRelation();
+}
+
+void test21() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "shadow-paging-test" << std::endl;
+  createRelationForward();
+  shadowPagingTests();
+  deleteRelation();
+}
+
+void test22() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "key-search-test" << std::endl;
+  createRelationRandom();
+  keySearchTests();
+  deleteRelation();
+}
+
+void test23() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "format-upgrade-test" << std::endl;
+  createRelationForward();
+  formatUpgradeTests();
+  deleteRelation();
+}
+
+void test24() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "bulk-load-test" << std::endl;
+  createRelationRandom();
+  bulkLoadTests();
+  deleteRelation();
+}
+
+void test25() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "parallel-build-test" << std::endl;
+  createRelationRandom();
+  parallelBuildTests();
+  deleteRelation();
+}
+
+void test26() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "delete-test" << std::endl;
+  createRelationRandom();
+  deleteTests();
+  deleteRelation();
+}
+
+void test27() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "concurrent-test" << std::endl;
+  createEmptyRelation();
+  concurrentTests();
+  deleteRelation();
+}
+
+void test28() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "optimistic-read-test" << std::endl;
+  createEmptyRelation();
+  optimisticReadTests();
+  deleteRelation();
+}
+
+void test29() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "cursor-test" << std::endl;
+  createRelationForward();
+  cursorTests();
+  deleteRelation();
+}
+
+void test30() {
+  std::cout << "--------------------" << std::endl;
+  std::cout << "batch-scan-test" << std::endl;
+  createRelationRandom();
+  batchScanTests();
+  deleteRelation();
+}
+
 // -----------------------------------------------------------------------------
 // createEmptyRelation
 // -----------------------------------------------------------------------------
@@ -411,6 +702,16 @@ void indexTests() {
       File::remove(intIndexName);
     } catch (FileNotFoundException e) {
     }
+    doubleTests();
+    try {
+      File::remove(doubleIndexName);
+    } catch (FileNotFoundException e) {
+    }
+    stringTests();
+    try {
+      File::remove(stringIndexName);
+    } catch (FileNotFoundException e) {
+    }
   }
 }
 
@@ -451,7 +752,59 @@ void intTests() {
     checkPassFail(intScan(&index, 25, GT, 40, LT), 0)
         checkPassFail(intScan(&index, 20, GTE, 35, LTE), 0)
             checkPassFail(intScan(&index, 996, GT, 1001, LT), 0)
-                isRelationEmpty = false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests() {
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple, d),
+                   DOUBLE);
+
+  if (!isRelationEmpty) {
+    checkPassFail(doubleScan(&index, 25, GT, 40, LT), 14)
+    checkPassFail(doubleScan(&index, 20, GTE, 35, LTE), 16)
+    checkPassFail(doubleScan(&index, -3, GT, 3, LT), 3)
+    checkPassFail(doubleScan(&index, 996, GT, 1001, LT), 4)
+    checkPassFail(doubleScan(&index, 0, GT, 1, LT), 0)
+    checkPassFail(doubleScan(&index, 300, GT, 400, LT), 99)
+    checkPassFail(doubleScan(&index, 3000, GTE, 4000, LT), 1000)
+    checkPassFail(doubleScan(&index, 24.5, GT, 30.5, LTE), 6)
+    checkPassFail(doubleScan(&index, 500, GTE, 2070, LT), 1570)
+  } else {
+    checkPassFail(doubleScan(&index, 25, GT, 40, LT), 0)
+    checkPassFail(doubleScan(&index, 996, GT, 1001, LT), 0)
+  }
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests() {
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple, s),
+                   STRING);
+
+  // keys are the first STRINGSIZE characters, "00025 stri" for record 25, so
+  // a bound of five digits lies before every key starting with it
+  if (!isRelationEmpty) {
+    checkPassFail(stringScan(&index, "00010", GT, "00035", LT), 25)
+    checkPassFail(stringScan(&index, "00020 stri", GTE, "00035 stri", LTE), 16)
+    checkPassFail(stringScan(&index, "00020 stri", GT, "00035 stri", LT), 14)
+    checkPassFail(stringScan(&index, "00996", GT, "01001", LT), 5)
+    checkPassFail(stringScan(&index, "00000", GT, "00001", LT), 1)
+    checkPassFail(stringScan(&index, "00300", GT, "00400", LT), 100)
+    checkPassFail(stringScan(&index, "03000", GTE, "04000", LT), 1000)
+    // only the first STRINGSIZE characters of a bound are compared, so this
+    // one is "00042 stri"
+    checkPassFail(stringScan(&index, "00042 strizz", GTE, "00043", LT), 1)
+  } else {
+    checkPassFail(stringScan(&index, "00010", GT, "00035", LT), 0)
+    checkPassFail(stringScan(&index, "00996", GT, "01001", LT), 0)
   }
 }
 
@@ -479,9 +832,44 @@ void intTestsFileLoad() {
 
 int intScan(BTreeIndex* index, int lowVal, Operator lowOp, int highVal,
             Operator highOp) {
-  RecordId scanRid;
-  Page* curPage;
+  std::cout << "Scan for ";
+  if (lowOp == GT) {
+    std::cout << "(";
+  } else {
+    std::cout << "[";
+  }
+  std::cout << lowVal << "," << highVal;
+  if (highOp == LT) {
+    std::cout << ")";
+  } else {
+    std::cout << "]";
+  }
+  std::cout << std::endl;
+
+  return indexScan(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+int doubleScan(BTreeIndex* index, double lowVal, Operator lowOp,
+               double highVal, Operator highOp) {
+  std::cout << "Scan for ";
+  if (lowOp == GT) {
+    std::cout << "(";
+  } else {
+    std::cout << "[";
+  }
+  std::cout << lowVal << "," << highVal;
+  if (highOp == LT) {
+    std::cout << ")";
+  } else {
+    std::cout << "]";
+  }
+  std::cout << std::endl;
+
+  return indexScan(index, &lowVal, lowOp, &highVal, highOp);
+}
 
+int stringScan(BTreeIndex* index, std::string lowVal, Operator lowOp,
+               std::string highVal, Operator highOp) {
   std::cout << "Scan for ";
   if (lowOp == GT) {
     std::cout << "(";
@@ -496,10 +884,18 @@ int intScan(BTreeIndex* index, int lowVal, Operator lowOp, int highVal,
   }
   std::cout << std::endl;
 
+  return indexScan(index, lowVal.c_str(), lowOp, highVal.c_str(), highOp);
+}
+
+int indexScan(BTreeIndex* index, const void* lowVal, Operator lowOp,
+              const void* highVal, Operator highOp) {
+  RecordId scanRid;
+  Page* curPage;
+
   int numResults = 0;
 
   try {
-    index->startScan(&lowVal, lowOp, &highVal, highOp);
+    index->startScan(lowVal, lowOp, highVal, highOp);
   } catch (NoSuchKeyFoundException e) {
     std::cout << "No Key Found satisfying the scan criteria." << std::endl;
     return 0;
@@ -537,90 +933,998 @@ int intScan(BTreeIndex* index, int lowVal, Operator lowOp, int highVal,
 }
 
 // -----------------------------------------------------------------------------
-// errorTests
+// resizeTests
 // -----------------------------------------------------------------------------
 
-void errorTests() {
-  std::cout << "Error handling tests" << std::endl;
-  std::cout << "--------------------" << std::endl;
-  // Given error test
-
-  try {
-    File::remove(relationName);
-  } catch (FileNotFoundException e) {
+void resizeTests() {
+  BufMgr* mgr = new BufMgr(20);
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
   }
 
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-  PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+  // fill the pool, leaving the last page read pinned in the top frame
+  Page* page;
+  for (int i = 0; i < 20; i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    if (i < 19) {
+      mgr->unPinPage(file1, pageNos[i], false);
+    }
+  }
+  Page* pinnedPage = page;
+  PageId pinnedNo = pageNos[19];
+  std::string pinnedRecord = *pinnedPage->begin();
+
+  std::cout << "Grow pool to 60 frames" << std::endl;
+  mgr->resize(60);
+  checkPassFail(mgr->getNumBufs(), 60)
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
 
-  // Insert a bunch of tuples into the relation.
-  for (int i = 0; i < 10; i++) {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+  std::cout << "Shrink pool to 10 frames with a page pinned above it"
+            << std::endl;
+  mgr->resize(10);
+  checkPassFail(mgr->getNumBufs(), 10)
+  checkPassFail((*pinnedPage->begin() == pinnedRecord), true)
 
-    while (1) {
-      try {
-        new_page.insertRecord(new_data);
-        break;
-      } catch (InsufficientSpaceException e) {
-        file1->writePage(new_page_number, new_page);
-        new_page = file1->allocatePage(new_page_number);
+  int numPinned = 0;
+  try {
+    for (std::size_t i = 0; i < pageNos.size(); i++) {
+      if (pageNos[i] == pinnedNo) {
+        continue;
       }
+      mgr->readPage(file1, pageNos[i], page);
+      numPinned++;
     }
+  } catch (BufferExceededException e) {
   }
+  checkPassFail(numPinned, 10)
 
-  file1->writePage(new_page_number, new_page);
+  for (std::size_t i = 0, unpinned = 0; unpinned < 10; i++) {
+    if (pageNos[i] == pinnedNo) {
+      continue;
+    }
+    mgr->unPinPage(file1, pageNos[i], false);
+    unpinned++;
+  }
+  mgr->unPinPage(file1, pinnedNo, false);
 
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
-                   INTEGER);
+  mgr->flushFile(file1);
+  delete mgr;
+  std::cout << "Success: resizeTests Passed." << std::endl;
+}
 
-  int int2 = 2;
-  int int5 = 5;
+// -----------------------------------------------------------------------------
+// strategyTests
+// -----------------------------------------------------------------------------
 
-  // Scan Tests
-  std::cout << "Call endScan before startScan" << std::endl;
+void scanRelation(BufMgr* mgr, AccessStrategy strategy) {
+  FileScan fscan(relationName, mgr, strategy);
   try {
-    index.endScan();
-    std::cout << "ScanNotInitialized Test 1 Failed." << std::endl;
-  } catch (ScanNotInitializedException e) {
-    std::cout << "ScanNotInitialized Test 1 Passed." << std::endl;
+    RecordId scanRid;
+    while (1) {
+      fscan.scanNext(scanRid);
+    }
+  } catch (EndOfFileException e) {
   }
+}
 
-  std::cout << "Call scanNext before startScan" << std::endl;
-  try {
-    RecordId foo;
-    index.scanNext(foo);
-    std::cout << "ScanNotInitialized Test 2 Failed." << std::endl;
-  } catch (ScanNotInitializedException e) {
-    std::cout << "ScanNotInitialized Test 2 Passed." << std::endl;
+int rereadPages(BufMgr* mgr, const std::vector<PageId>& pageNos, int count) {
+  Page* page;
+  mgr->clearBufStats();
+  for (int i = 0; i < count; i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    mgr->unPinPage(file1, pageNos[i], false);
   }
+  return mgr->getBufStats().diskreads;
+}
 
-  std::cout << "Scan with bad lowOp" << std::endl;
-  try {
-    index.startScan(&int2, LTE, &int5, LTE);
-    std::cout << "BadOpcodesException Test 1 Failed." << std::endl;
-  } catch (BadOpcodesException e) {
-    std::cout << "BadOpcodesException Test 1 Passed." << std::endl;
+void strategyTests() {
+  BufMgr* mgr = new BufMgr(40);
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
   }
 
-  std::cout << "Scan with bad highOp" << std::endl;
-  try {
-    index.startScan(&int2, GTE, &int5, GTE);
-    std::cout << "BadOpcodesException Test 2 Failed." << std::endl;
-  } catch (BadOpcodesException e) {
-    std::cout << "BadOpcodesException Test 2 Passed." << std::endl;
-  }
+  // warm up a working set through the shared pool
+  rereadPages(mgr, pageNos, 10);
 
-  std::cout << "Scan with bad range" << std::endl;
-  try {
-    index.startScan(&int5, GTE, &int2, LTE);
-    std::cout << "BadScanrangeException Test 1 Failed." << std::endl;
+  std::cout << "Full scan with BULK_READ keeps the working set" << std::endl;
+  scanRelation(mgr, BULK_READ);
+  checkPassFail(rereadPages(mgr, pageNos, 10), 0)
+
+  std::cout << "Full scan with NORMAL evicts the working set" << std::endl;
+  scanRelation(mgr, NORMAL);
+  checkPassFail((rereadPages(mgr, pageNos, 10) > 0), true)
+
+  mgr->flushFile(file1);
+  delete mgr;
+  std::cout << "Success: strategyTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// classTests
+// -----------------------------------------------------------------------------
+
+int classEviction(bool hints, const std::vector<PageId>& pageNos) {
+  BufMgr* mgr = new BufMgr(20);
+  mgr->setClassHints(hints);
+  Page* page;
+
+  // five index pages, then enough heap pages to cycle the clock
+  for (int i = 0; i < 30; i++) {
+    mgr->readPage(file1, pageNos[i], page, NORMAL,
+                  i < 5 ? PAGE_INDEX_INTERIOR : PAGE_HEAP);
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  int reads = rereadPages(mgr, pageNos, 5);
+
+  mgr->flushFile(file1);
+  delete mgr;
+  return reads;
+}
+
+void classTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+
+  std::cout << "Interior pages outlive heap pages" << std::endl;
+  checkPassFail(classEviction(true, pageNos), 0)
+  checkPassFail((classEviction(false, pageNos) > 0), true)
+
+  std::cout << "Quota holds temporary pages to their share of the pool"
+            << std::endl;
+  BufMgr* mgr = new BufMgr(20);
+  mgr->setClassQuota(PAGE_TEMP, 4);
+  Page* page;
+  for (int i = 0; i < 12; i++) {
+    mgr->readPage(file1, pageNos[i], page, NORMAL, PAGE_TEMP);
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(mgr->getClassFrames(PAGE_TEMP), 4)
+
+  mgr->flushFile(file1);
+  delete mgr;
+  std::cout << "Success: classTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// sweepTests
+// -----------------------------------------------------------------------------
+
+// One frame at a time, the way the clock ran before the frame table kept
+// bitmaps.
+bool frameSweep(BufFrameTable& table, FrameId& hand, std::uint32_t numBufs,
+                std::uint32_t maxScans, int onlyClass) {
+  for (std::uint32_t scanned = 0; scanned < maxScans; scanned++) {
+    hand = (hand + 1) % numBufs;
+    bool valid = BufFrameTable::test(table.valid, hand);
+    if (!valid) {
+      if (onlyClass < 0) return true;
+    } else if (onlyClass < 0 || table.pageClass[hand] == onlyClass) {
+      if (BufFrameTable::test(table.refbit, hand))
+        BufFrameTable::assign(table.refbit, hand, false);
+      else if (table.credit[hand] > 0)
+        table.setCredit(hand, table.credit[hand] - 1);
+      else if (table.pinCnt[hand] == 0)
+        return true;
+    }
+  }
+  return false;
+}
+
+void sweepTests() {
+  const std::uint32_t numBufs = 1000;
+  BufFrameTable words, frames;
+  words.resize(numBufs);
+  srand(11);
+  for (FrameId i = 0; i < numBufs; i++) {
+    if (rand() % 10 == 0) continue;
+    words.Set(i, NULL, i);
+    words.setClass(i, PageClass(rand() % NUM_PAGE_CLASSES));
+    words.setCredit(i, rand() % 3);
+    words.setPinCnt(i, rand() % 8 == 0);
+    BufFrameTable::assign(words.refbit, i, rand() % 2);
+  }
+  frames = words;
+
+  std::cout << "Word sweep picks the same victims as a frame sweep"
+            << std::endl;
+  FrameId wordHand = numBufs - 1, frameHand = numBufs - 1;
+  int mismatches = 0;
+  for (int i = 0; i < 5000; i++) {
+    int onlyClass = i % 3 == 0 ? rand() % NUM_PAGE_CLASSES : -1;
+    std::uint32_t maxScans = 1 + rand() % (3 * numBufs);
+    std::uint32_t refsCleared = 0;
+    bool wordFound =
+        words.sweep(wordHand, numBufs, maxScans, onlyClass, refsCleared);
+    bool frameFound =
+        frameSweep(frames, frameHand, numBufs, maxScans, onlyClass);
+    if (wordFound != frameFound || wordHand != frameHand) mismatches++;
+
+    // reload the victim and reference a few other frames
+    if (wordFound) {
+      PageClass cls = PageClass(rand() % NUM_PAGE_CLASSES);
+      words.Set(wordHand, NULL, i);
+      words.setClass(wordHand, cls);
+      words.setPinCnt(wordHand, 0);
+      frames.Set(frameHand, NULL, i);
+      frames.setClass(frameHand, cls);
+      frames.setPinCnt(frameHand, 0);
+    }
+    FrameId hit = rand() % numBufs;
+    BufFrameTable::assign(words.refbit, hit, true);
+    BufFrameTable::assign(frames.refbit, hit, true);
+  }
+  checkPassFail(mismatches, 0)
+  checkPassFail((words.refbit == frames.refbit), true)
+  checkPassFail((words.credit == frames.credit), true)
+
+  std::cout << "Success: sweepTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// missRatioTests
+// -----------------------------------------------------------------------------
+
+void missRatioTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+
+  std::cout << "Every page sampled: exact LRU hit ratios of a cyclic scan"
+            << std::endl;
+  BufMgr* mgr = new BufMgr(50);
+  mgr->setMissRatioSampling(1.0, 0);
+  Page* page;
+  for (int pass = 0; pass < 10; pass++) {
+    for (int i = 0; i < 30; i++) {
+      mgr->readPage(file1, pageNos[i], page);
+      mgr->unPinPage(file1, pageNos[i], false);
+    }
+  }
+  checkPassFail(mgr->estimateWorkingSet(), 30)
+  checkPassFail((mgr->estimateHitRatio(30) > 0.89), true)
+  checkPassFail((mgr->estimateHitRatio(29) < 0.01), true)
+
+  mgr->clearBufStats();
+  checkPassFail(mgr->estimateWorkingSet(), 0)
+  mgr->flushFile(file1);
+  delete mgr;
+
+  std::cout << "Bounded sample still estimates the working set" << std::endl;
+  MissRatioCurve curve(1.0, 16);
+  for (int pass = 0; pass < 5; pass++) {
+    for (PageId i = 0; i < 1000; i++) {
+      curve.access(file1, i);
+    }
+  }
+  checkPassFail((curve.trackedPages() <= 16), true)
+  checkPassFail((curve.workingSet() > 500 && curve.workingSet() < 2000), true)
+
+  std::cout << "Success: missRatioTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// asyncIoTests
+// -----------------------------------------------------------------------------
+
+void asyncIo(IoBackendKind kind, const std::vector<PageId>& pageNos) {
+  BufMgr* mgr = new BufMgr(20);
+  checkPassFail(mgr->enableAsyncIo(4, kind), true)
+  std::cout << "Backend " << mgr->getAsyncIoBackend() << std::endl;
+  Page* page;
+
+  std::cout << "Prefetched pages are read once and match the file"
+            << std::endl;
+  std::vector<PageId> batch(pageNos.begin(), pageNos.begin() + 10);
+  batch.push_back(100000);
+  checkPassFail(mgr->prefetchPages(file1, batch), 10)
+  checkPassFail(mgr->getBufStats().diskreads, 10)
+  int mismatches = 0;
+  for (int i = 0; i < 10; i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    Page onDisk = file1->readPage(pageNos[i]);
+    if (memcmp(page, &onDisk, Page::SIZE) != 0) mismatches++;
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(mismatches, 0)
+  checkPassFail(mgr->getBufStats().diskreads, 10)
+
+  std::cout << "Background flush writes dirty pages" << std::endl;
+  mgr->readPage(file1, pageNos[0], page);
+  RecordId first = page->begin().getCurrentRecord();
+  std::string changed = page->getRecord(first);
+  changed[offsetof(RECORD, s)] = '#';
+  page->updateRecord(first, changed);
+  mgr->unPinPage(file1, pageNos[0], true);
+  checkPassFail(mgr->flushDirtyAsync(10), 1)
+  checkPassFail(mgr->flushDirtyAsync(10), 0)
+  mgr->pollIo();
+  mgr->flushFile(file1);
+  checkPassFail((file1->readPage(pageNos[0]).getRecord(first) == changed),
+                true)
+
+  delete mgr;
+}
+
+void asyncIoTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+
+  asyncIo(IO_AUTO, pageNos);
+  asyncIo(IO_THREADS, pageNos);
+  std::cout << "Success: asyncIoTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// directIoTests
+// -----------------------------------------------------------------------------
+
+void directIoTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  checkPassFail(file1->isAligned(), true)
+  checkPassFail((file1->pageOffset(1) % File::DIRECT_IO_ALIGNMENT), 0)
+
+  BufMgr* mgr = new BufMgr(20, POOL_DIRECT_IO | POOL_HUGE_PAGES);
+  std::cout << "Pool memory " << mgr->getPoolMemory() << ", direct "
+            << (file1->directDescriptor() >= 0 ? "yes" : "no") << std::endl;
+  checkPassFail((std::string(mgr->getPoolMemory()) != "heap"), true)
+  int misaligned = 0;
+  for (std::size_t i = 0; i < mgr->bufPool.size(); i++) {
+    if (reinterpret_cast<std::uintptr_t>(mgr->bufPool[i]) %
+            File::DIRECT_IO_ALIGNMENT != 0)
+      misaligned++;
+  }
+  checkPassFail(misaligned, 0)
+  Page* page;
+
+  std::cout << "Pages read directly match the file" << std::endl;
+  int mismatches = 0;
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    Page onDisk = file1->readPage(pageNos[i]);
+    if (memcmp(page, &onDisk, Page::SIZE) != 0) mismatches++;
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(mismatches, 0)
+
+  std::cout << "Pages written directly are seen through the file" << std::endl;
+  mgr->readPage(file1, pageNos[1], page);
+  RecordId first = page->begin().getCurrentRecord();
+  std::string changed = page->getRecord(first);
+  changed[offsetof(RECORD, s)] = '#';
+  page->updateRecord(first, changed);
+  mgr->unPinPage(file1, pageNos[1], true);
+  mgr->flushFile(file1);
+  checkPassFail((file1->readPage(pageNos[1]).getRecord(first) == changed),
+                true)
+
+  std::cout << "Reading a deleted page fails as through the file" << std::endl;
+  file1->deletePage(pageNos[2]);
+  try {
+    mgr->readPage(file1, pageNos[2], page);
+    std::cout << "InvalidPageException Test Failed." << std::endl;
+    exit(1);
+  } catch (InvalidPageException e) {
+    std::cout << "InvalidPageException Test Passed." << std::endl;
+  }
+
+  delete mgr;
+  std::cout << "Success: directIoTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// readPagesTests
+// -----------------------------------------------------------------------------
+
+void readPagesTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  BufMgr* mgr = new BufMgr(20);
+  std::vector<Page*> pages;
+  Page* page;
+
+  std::cout << "A batch pins every entry and reads each missing page once"
+            << std::endl;
+  mgr->readPage(file1, pageNos[3], page);
+  mgr->unPinPage(file1, pageNos[3], false);
+  mgr->clearBufStats();
+  std::vector<PageId> batch;
+  batch.push_back(pageNos[7]);
+  batch.push_back(pageNos[3]);
+  batch.push_back(pageNos[5]);
+  batch.push_back(pageNos[6]);
+  batch.push_back(pageNos[7]);
+  batch.push_back(pageNos[12]);
+  mgr->readPages(file1, batch, pages);
+  checkPassFail(mgr->getBufStats().diskreads, 4)
+  int mismatches = 0;
+  for (std::size_t i = 0; i < batch.size(); i++) {
+    Page onDisk = file1->readPage(batch[i]);
+    if (memcmp(pages[i], &onDisk, Page::SIZE) != 0) mismatches++;
+  }
+  checkPassFail(mismatches, 0)
+  checkPassFail((pages[0] == pages[4]), true)
+  for (std::size_t i = 0; i < batch.size(); i++) {
+    mgr->unPinPage(file1, batch[i], false);
+  }
+  try {
+    mgr->unPinPage(file1, pageNos[7], false);
+    std::cout << "PageNotPinnedException Test Failed." << std::endl;
+    exit(1);
+  } catch (PageNotPinnedException e) {
+    std::cout << "PageNotPinnedException Test Passed." << std::endl;
+  }
+
+  std::cout << "A batch that cannot be read pins nothing" << std::endl;
+  std::vector<PageId> tooMany(pageNos.begin(), pageNos.begin() + 21);
+  try {
+    mgr->readPages(file1, tooMany, pages);
+    std::cout << "BufferExceededException Test Failed." << std::endl;
+    exit(1);
+  } catch (BufferExceededException e) {
+    std::cout << "BufferExceededException Test Passed." << std::endl;
+  }
+  std::vector<PageId> full(pageNos.begin(), pageNos.begin() + 20);
+  mgr->readPages(file1, full, pages);
+  for (std::size_t i = 0; i < full.size(); i++) {
+    mgr->unPinPage(file1, full[i], false);
+  }
+
+  mgr->flushFile(file1);
+  file1->deletePage(pageNos[9]);
+  try {
+    mgr->readPages(file1, full, pages);
+    std::cout << "InvalidPageException Test Failed." << std::endl;
+    exit(1);
+  } catch (InvalidPageException e) {
+    std::cout << "InvalidPageException Test Passed." << std::endl;
+  }
+  full.erase(full.begin() + 9);
+  full.push_back(pageNos[20]);
+  mgr->readPages(file1, full, pages);
+  checkPassFail((pages[0] != NULL), true)
+  for (std::size_t i = 0; i < full.size(); i++) {
+    mgr->unPinPage(file1, full[i], false);
+  }
+
+  delete mgr;
+  std::cout << "Success: readPagesTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// startReadTests
+// -----------------------------------------------------------------------------
+
+// Wait for the read of a page started by startReadPage.
+ReadCompletion awaitRead(BufMgr* mgr, PageId pageNo) {
+  std::vector<ReadCompletion> done;
+  while (true) {
+    done.clear();
+    mgr->takeCompletedReads(done, true);
+    for (std::size_t i = 0; i < done.size(); i++) {
+      if (done[i].file == file1 && done[i].pageNo == pageNo) return done[i];
+    }
+  }
+}
+
+void startReadTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  Page* page;
+
+  std::cout << "Without asynchronous I/O pages are read at once" << std::endl;
+  BufMgr* mgr = new BufMgr(20);
+  checkPassFail(mgr->startReadPage(file1, pageNos[0], page), true)
+  mgr->unPinPage(file1, pageNos[0], false);
+  delete mgr;
+
+  mgr = new BufMgr(20);
+  checkPassFail(mgr->enableAsyncIo(4), true)
+
+  std::cout << "A miss starts a read that leaves the page pinned" << std::endl;
+  checkPassFail(mgr->startReadPage(file1, pageNos[1], page), false)
+  ReadCompletion read = awaitRead(mgr, pageNos[1]);
+  checkPassFail(read.ok, true)
+  checkPassFail(read.pinned, true)
+  Page onDisk = file1->readPage(pageNos[1]);
+  checkPassFail(memcmp(read.page, &onDisk, Page::SIZE), 0)
+  checkPassFail(mgr->startReadPage(file1, pageNos[1], page), true)
+  checkPassFail((page == read.page), true)
+  mgr->unPinPage(file1, pageNos[1], false);
+  mgr->unPinPage(file1, pageNos[1], false);
+  checkPassFail(mgr->getBufStats().diskreads, 1)
+
+  std::cout << "A read of a deleted page fails" << std::endl;
+  file1->deletePage(pageNos[2]);
+  checkPassFail(mgr->startReadPage(file1, pageNos[2], page), false)
+  read = awaitRead(mgr, pageNos[2]);
+  checkPassFail(read.ok, false)
+  try {
+    mgr->startReadPage(file1, 100000, page);
+    std::cout << "InvalidPageException Test Failed." << std::endl;
+    exit(1);
+  } catch (InvalidPageException e) {
+    std::cout << "InvalidPageException Test Passed." << std::endl;
+  }
+
+  delete mgr;
+  std::cout << "Success: startReadTests Passed." << std::endl;
+}
+
+void sharedPoolTests() {
+  const std::string segment = "/badgerdb_test";
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  bufMgr->flushFile(file1);
+  SharedBufMgr::unlink(segment);
+  SharedBufMgr* shared = new SharedBufMgr(segment, 50);
+  Page* page;
+
+  std::cout << "Pages read by one process are hits for another" << std::endl;
+  for (int i = 0; i < 10; i++) {
+    shared->readPage(file1, pageNos[i], page);
+    shared->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(shared->getBufStats().diskreads, 10)
+  checkPassFail(shared->attachedProcesses(), 1)
+  std::cout.flush();
+  pid_t child = fork();
+  if (child == 0) {
+    int failures = 0;
+    {
+      PageFile relation(relationName, false);
+      SharedBufMgr attached(segment, 10);
+      if (attached.numFrames() != 50 || attached.attachedProcesses() != 2)
+        failures |= 1;
+      for (int i = 0; i < 10; i++) {
+        attached.readPage(&relation, pageNos[i], page);
+        attached.unPinPage(&relation, pageNos[i], false);
+      }
+      if (attached.getBufStats().diskreads != 0) failures |= 2;
+
+      // change the first record of a page, and leave it to the other process
+      attached.readPage(&relation, pageNos[2], page);
+      RecordId first = {pageNos[2], 1};
+      std::string record = page->getRecord(first);
+      record[offsetof(RECORD, s)] = '#';
+      page->updateRecord(first, record);
+      attached.unPinPage(&relation, pageNos[2], true);
+    }
+    _exit(failures);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  checkPassFail(shared->attachedProcesses(), 1)
+  checkPassFail(shared->getSharedStats().diskreads, 10)
+
+  std::cout << "Changes are seen before they are written back" << std::endl;
+  RecordId first = {pageNos[2], 1};
+  shared->readPage(file1, pageNos[2], page);
+  std::string record = page->getRecord(first);
+  checkPassFail(record[offsetof(RECORD, s)], '#')
+  shared->unPinPage(file1, pageNos[2], false);
+  Page onDisk = file1->readPage(pageNos[2]);
+  checkPassFail(onDisk.getRecord(first)[offsetof(RECORD, s)], '0')
+  shared->flushFile(file1);
+  onDisk = file1->readPage(pageNos[2]);
+  checkPassFail(onDisk.getRecord(first)[offsetof(RECORD, s)], '#')
+
+  std::cout << "An index built in one process is scanned from another"
+            << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, shared, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+  }
+  std::cout.flush();
+  child = fork();
+  if (child == 0) {
+    int failures = 0;
+    {
+      SharedBufMgr attached(segment, 50);
+      BTreeIndex index(relationName, intIndexName, &attached,
+                       offsetof(tuple, i), INTEGER);
+      if (intScan(&index, 300, GT, 400, LT) != 99) failures |= 1;
+    }
+    _exit(failures);
+  }
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+
+  std::cout << "A shadow-paged index commits through the shared pool"
+            << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, shared, offsetof(tuple, i),
+                     INTEGER);
+    index.enableShadowPaging();
+    RecordId rid = {pageNos[0], 1};
+    for (int key = 5000; key < 5100; key++) {
+      index.insertEntry(&key, rid);
+    }
+    int written = shared->getSharedStats().diskwrites;
+    index.commitVersion();
+    checkPassFail((shared->getSharedStats().diskwrites > written), true)
+    std::cout.flush();
+    // a private pool reads the committed version from disk
+    child = fork();
+    if (child == 0) {
+      int failures = 0;
+      {
+        BufMgr pool(50);
+        BTreeIndex reopened(relationName, intIndexName, &pool,
+                            offsetof(tuple, i), INTEGER);
+        if (intScan(&reopened, 4990, GTE, 6000, LT) != 110) failures |= 1;
+      }
+      _exit(failures);
+    }
+    waitpid(child, &status, 0);
+    checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  }
+
+  std::cout << "Flushed files leave their slots to new files" << std::endl;
+  // kept until the end, so that each file has an inode of its own
+  int misplaced = 0;
+  for (int i = 0; i < 2 * (int)SharedBufMgr::MAX_FILES; i++) {
+    std::string name = "sharedScratch" + std::to_string(i);
+    PageFile scratch(name, true);
+    PageId pageNo;
+    shared->allocPage(&scratch, pageNo, page);
+    RecordId rid = page->insertRecord(name);
+    shared->unPinPage(&scratch, pageNo, true);
+    shared->flushFile(&scratch);
+    if (scratch.readPage(pageNo).getRecord(rid) != name) misplaced++;
+  }
+  checkPassFail(misplaced, 0)
+  for (int i = 0; i < 2 * (int)SharedBufMgr::MAX_FILES; i++) {
+    File::remove("sharedScratch" + std::to_string(i));
+  }
+
+  try {
+    shared->unPinPage(file1, pageNos[2], false);
+    std::cout << "HashNotFoundException Test Failed." << std::endl;
+    exit(1);
+  } catch (HashNotFoundException e) {
+    std::cout << "HashNotFoundException Test Passed." << std::endl;
+  }
+
+  delete shared;
+  SharedBufMgr::unlink(segment);
+  try {
+    File::remove(intIndexName);
+  } catch (FileNotFoundException e) {
+  }
+  std::cout << "Success: sharedPoolTests Passed." << std::endl;
+}
+
+void compressedCacheTests() {
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  bufMgr->flushFile(file1);
+
+  std::cout << "Relation pages compress and expand back" << std::endl;
+  Page onDisk = file1->readPage(pageNos[1]);
+  std::vector<char> packed(LzCodec::maxCompressedSize(Page::SIZE));
+  std::size_t length = LzCodec::compress(reinterpret_cast<char*>(&onDisk),
+                                         Page::SIZE, &packed[0]);
+  checkPassFail((length < Page::SIZE / 2), true)
+  Page unpacked;
+  checkPassFail(LzCodec::decompress(&packed[0], length,
+                                    reinterpret_cast<char*>(&unpacked),
+                                    Page::SIZE), true)
+  checkPassFail(memcmp(&unpacked, &onDisk, Page::SIZE), 0)
+  checkPassFail(LzCodec::decompress(&packed[0], length - 1,
+                                    reinterpret_cast<char*>(&unpacked),
+                                    Page::SIZE), false)
+  std::vector<char> noise(Page::SIZE);
+  srand(5);
+  for (std::size_t i = 0; i < noise.size(); i++) noise[i] = rand();
+  length = LzCodec::compress(&noise[0], noise.size(), &packed[0]);
+  checkPassFail((length > CompressedCache::MAX_STORED_SIZE), true)
+  std::vector<char> expanded(Page::SIZE);
+  checkPassFail(LzCodec::decompress(&packed[0], length, &expanded[0],
+                                    Page::SIZE), true)
+  checkPassFail((expanded == noise), true)
+
+  std::cout << "Evicted pages are read back from the compressed tier"
+            << std::endl;
+  BufMgr* mgr = new BufMgr(5);
+  mgr->setCompressedCacheSize(1 << 20);
+  Page* page;
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(mgr->getCompressedCachePages(), pageNos.size() - 5)
+  checkPassFail((mgr->getCompressedCacheBytes() <
+                 mgr->getCompressedCachePages() * Page::SIZE / 2), true)
+  mgr->clearBufStats();
+  int mismatches = 0;
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    onDisk = file1->readPage(pageNos[i]);
+    if (memcmp(page, &onDisk, Page::SIZE) != 0) mismatches++;
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(mgr->getBufStats().diskreads, 0)
+  checkPassFail(mgr->getBufStats().tierhits, (int)pageNos.size())
+  checkPassFail(mismatches, 0)
+
+  std::cout << "A changed page is written back before it is compressed"
+            << std::endl;
+  RecordId first = {pageNos[0], 1};
+  mgr->readPage(file1, pageNos[0], page);
+  std::string record = page->getRecord(first);
+  record[offsetof(RECORD, s)] = '#';
+  page->updateRecord(first, record);
+  mgr->unPinPage(file1, pageNos[0], true);
+  for (std::size_t i = 1; i < 6; i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  mgr->clearBufStats();
+  mgr->readPage(file1, pageNos[0], page);
+  checkPassFail(mgr->getBufStats().tierhits, 1)
+  checkPassFail(page->getRecord(first)[offsetof(RECORD, s)], '#')
+  mgr->unPinPage(file1, pageNos[0], false);
+  onDisk = file1->readPage(pageNos[0]);
+  checkPassFail(onDisk.getRecord(first)[offsetof(RECORD, s)], '#')
+
+  std::cout << "The tier keeps to its budget and forgets flushed files"
+            << std::endl;
+  mgr->setCompressedCacheSize(4096);
+  checkPassFail((mgr->getCompressedCacheBytes() <= 4096), true)
+  checkPassFail((mgr->getCompressedCachePages() > 0), true)
+  mgr->flushFile(file1);
+  checkPassFail(mgr->getCompressedCachePages(), 0)
+  mgr->setCompressedCacheSize(0);
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    mgr->readPage(file1, pageNos[i], page);
+    mgr->unPinPage(file1, pageNos[i], false);
+  }
+  checkPassFail(mgr->getCompressedCachePages(), 0)
+
+  delete mgr;
+  std::cout << "Success: compressedCacheTests Passed." << std::endl;
+}
+
+void compressedFileTests() {
+  const std::string packedName = relationName + ".lz";
+  try {
+    File::remove(packedName);
+  } catch (FileNotFoundException e) {
+  }
+
+  std::cout << "A compressed copy of the relation reads back the same"
+            << std::endl;
+  std::vector<PageId> pageNos;
+  {
+    PageFile packed = PageFile::create(packedName, CODEC_LZ);
+    checkPassFail(packed.isCompressed(), true)
+    checkPassFail(packed.codec(), CODEC_LZ)
+    checkPassFail(packed.directDescriptor(), -1)
+    for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+      Page original = *iter;
+      PageId pageNo;
+      Page copy = packed.allocatePage(pageNo);
+      for (PageIterator rec = original.begin(); rec != original.end(); ++rec) {
+        copy.insertRecord(*rec);
+      }
+      packed.writePage(pageNo, copy);
+      pageNos.push_back(pageNo);
+    }
+  }
+  PageFile* packed = new PageFile(packedName, false);
+  checkPassFail(packed->codec(), CODEC_LZ)
+  int mismatches = 0;
+  std::size_t pages = 0;
+  FileIterator copyIter = packed->begin();
+  for (FileIterator iter = file1->begin(); iter != file1->end();
+       ++iter, ++copyIter, ++pages) {
+    Page original = *iter;
+    Page copy = *copyIter;
+    PageIterator copyRec = copy.begin();
+    for (PageIterator rec = original.begin(); rec != original.end();
+         ++rec, ++copyRec) {
+      if (*rec != *copyRec) mismatches++;
+    }
+  }
+  checkPassFail((copyIter == packed->end()), true)
+  checkPassFail(pages, pageNos.size())
+  checkPassFail(mismatches, 0)
+  const FileIoStats& stats = packed->ioStats();
+  checkPassFail((stats.bytes_read * 2 < stats.pages_read * Page::SIZE), true)
+  struct stat plainStat, packedStat;
+  stat(relationName.c_str(), &plainStat);
+  stat(packedName.c_str(), &packedStat);
+  checkPassFail((packedStat.st_size * 2 < plainStat.st_size), true)
+
+  std::cout << "Pages that grow move, and the file reopens consistently"
+            << std::endl;
+  std::vector<Page> expected;
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    expected.push_back(packed->readPage(pageNos[i]));
+  }
+  srand(11);
+  for (std::size_t i = 0; i < 6; i++) {
+    // the first three before reopening, the others after, so that they reuse
+    // the room found free when the file was opened
+    if (i == 3) {
+      delete packed;
+      packed = new PageFile(packedName, false);
+    }
+    Page& page = expected[i * 7];
+    for (SlotId slot = 1; slot <= 30; slot++) {
+      RecordId rid = {pageNos[i * 7], slot};
+      page.deleteRecord(rid);
+    }
+    std::string noise;
+    for (int j = 0; j < 2000; j++) noise.push_back((char)rand());
+    page.insertRecord(noise);
+    packed->writePage(pageNos[i * 7], page);
+  }
+  delete packed;
+  packed = new PageFile(packedName, false);
+  mismatches = 0;
+  for (std::size_t i = 0; i < pageNos.size(); i++) {
+    Page copy = packed->readPage(pageNos[i]);
+    if (memcmp(&copy, &expected[i], Page::SIZE) != 0) mismatches++;
+  }
+  checkPassFail(mismatches, 0)
+
+  std::cout << "Compressed pages go through the buffer pool" << std::endl;
+  BufMgr* mgr = new BufMgr(10);
+  checkPassFail(mgr->enableAsyncIo(4), true)
+  checkPassFail(mgr->prefetchPages(packed, pageNos), 0)
+  std::vector<Page*> batch;
+  std::vector<PageId> first(pageNos.begin() + 20, pageNos.begin() + 28);
+  mgr->readPages(packed, first, batch);
+  Page onDisk = packed->readPage(first[3]);
+  checkPassFail(memcmp(batch[3], &onDisk, Page::SIZE), 0)
+  RecordId changed = {first[3], 1};
+  std::string record = batch[3]->getRecord(changed);
+  record[offsetof(RECORD, s)] = '#';
+  batch[3]->updateRecord(changed, record);
+  for (std::size_t i = 0; i < first.size(); i++) {
+    mgr->unPinPage(packed, first[i], i == 3);
+  }
+  checkPassFail(mgr->flushDirtyAsync(10), 0)
+  mgr->flushFile(packed);
+  onDisk = packed->readPage(first[3]);
+  checkPassFail(onDisk.getRecord(changed)[offsetof(RECORD, s)], '#')
+  delete mgr;
+  delete packed;
+
+  // keys on the pages changed above are gone from the copy
+  std::cout << "An index over the compressed relation may be compressed too"
+            << std::endl;
+  std::string packedIndexName;
+  {
+    BTreeIndex index(packedName, packedIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER, CODEC_LZ);
+    checkPassFail(intScan(&index, 4500, GT, 4600, LT), 99)
+    checkPassFail(intScan(&index, 4000, GTE, 4500, LT), 500)
+  }
+  {
+    BlobFile indexFile(packedIndexName, false);
+    checkPassFail(indexFile.isCompressed(), true)
+  }
+  {
+    BTreeIndex index(packedName, packedIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 4990, GT, 5000, LT), 9)
+  }
+
+  File::remove(packedIndexName);
+  File::remove(packedName);
+  std::cout << "Success: compressedFileTests Passed." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// errorTests
+// -----------------------------------------------------------------------------
+
+void errorTests() {
+  std::cout << "Error handling tests" << std::endl;
+  std::cout << "--------------------" << std::endl;
+  // Given error test
+
+  try {
+    File::remove(relationName);
+  } catch (FileNotFoundException e) {
+  }
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+  PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for (int i = 0; i < 10; i++) {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+    while (1) {
+      try {
+        new_page.insertRecord(new_data);
+        break;
+      } catch (InsufficientSpaceException e) {
+        file1->writePage(new_page_number, new_page);
+        new_page = file1->allocatePage(new_page_number);
+      }
+    }
+  }
+
+  file1->writePage(new_page_number, new_page);
+
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                   INTEGER);
+
+  int int2 = 2;
+  int int5 = 5;
+
+  // Scan Tests
+  std::cout << "Call endScan before startScan" << std::endl;
+  try {
+    index.endScan();
+    std::cout << "ScanNotInitialized Test 1 Failed." << std::endl;
+  } catch (ScanNotInitializedException e) {
+    std::cout << "ScanNotInitialized Test 1 Passed." << std::endl;
+  }
+
+  std::cout << "Call scanNext before startScan" << std::endl;
+  try {
+    RecordId foo;
+    index.scanNext(foo);
+    std::cout << "ScanNotInitialized Test 2 Failed." << std::endl;
+  } catch (ScanNotInitializedException e) {
+    std::cout << "ScanNotInitialized Test 2 Passed." << std::endl;
+  }
+
+  std::cout << "Scan with bad lowOp" << std::endl;
+  try {
+    index.startScan(&int2, LTE, &int5, LTE);
+    std::cout << "BadOpcodesException Test 1 Failed." << std::endl;
+  } catch (BadOpcodesException e) {
+    std::cout << "BadOpcodesException Test 1 Passed." << std::endl;
+  }
+
+  std::cout << "Scan with bad highOp" << std::endl;
+  try {
+    index.startScan(&int2, GTE, &int5, GTE);
+    std::cout << "BadOpcodesException Test 2 Failed." << std::endl;
+  } catch (BadOpcodesException e) {
+    std::cout << "BadOpcodesException Test 2 Passed." << std::endl;
+  }
+
+  std::cout << "Scan with bad range" << std::endl;
+  try {
+    index.startScan(&int5, GTE, &int2, LTE);
+    std::cout << "BadScanrangeException Test 1 Failed." << std::endl;
   } catch (BadScanrangeException e) {
     std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
   }
@@ -645,3 +1949,2019 @@ void deleteRelation() {
   } catch (FileNotFoundException e) {
   }
 }
+
+std::vector<std::string> pageRecords(Page page) {
+  std::vector<std::string> records;
+  for (PageIterator iter = page.begin(); iter != page.end(); ++iter) {
+    records.push_back(*iter);
+  }
+  return records;
+}
+
+void walTests() {
+  const std::string logName = relationName + ".log";
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  bufMgr->flushFile(file1);
+  try {
+    File::remove(logName);
+  } catch (FileNotFoundException e) {
+  }
+  std::vector<std::string> page0 = pageRecords(file1->readPage(pageNos[0]));
+  std::vector<std::string> page1 = pageRecords(file1->readPage(pageNos[1]));
+  std::vector<std::string> page2 = pageRecords(file1->readPage(pageNos[2]));
+  RecordId first = {pageNos[0], 1};
+
+  std::cout << "Committed changes outlive a crash, stolen pages of a loser "
+               "do not" << std::endl;
+  std::cout.flush();
+  pid_t child = fork();
+  if (child == 0) {
+    // the process dies without writing back its pool
+    int failures = 0;
+    BufMgr* pool = new BufMgr(50);
+    LogManager* log = new LogManager(logName, pool);
+    PageFile* relation = new PageFile(relationName, false);
+    Page* page;
+
+    TxnId loser = log->begin();
+    pool->readPage(relation, pageNos[1], page);
+    RecordId changed = {pageNos[1], 1};
+    std::string record = page->getRecord(changed);
+    record[offsetof(RECORD, s)] = '$';
+    log->updateRecord(loser, relation, page, changed, record);
+    RecordId removed = {pageNos[1], 3};
+    log->deleteRecord(loser, relation, page, removed);
+    log->insertRecord(loser, relation, page, "short record");
+    pool->unPinPage(relation, pageNos[1], true);
+    pool->flushFile(relation);
+    Page stolen = relation->readPage(pageNos[1]);
+    if (stolen.getRecord(changed)[offsetof(RECORD, s)] != '$') failures |= 1;
+    if (stolen.lsn() == 0 || stolen.lsn() >= log->getDurableLsn())
+      failures |= 2;
+
+    TxnId committed = log->begin();
+    pool->readPage(relation, pageNos[0], page);
+    record = page->getRecord(first);
+    record[offsetof(RECORD, s)] = '#';
+    log->updateRecord(committed, relation, page, first, record);
+    RecordId second = {pageNos[0], 2};
+    log->deleteRecord(committed, relation, page, second);
+    pool->unPinPage(relation, pageNos[0], true);
+    log->commit(committed);
+    _exit(failures);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  checkPassFail(file1->readPage(pageNos[0]).getRecord(first)[offsetof(RECORD, s)], '0')
+  checkPassFail((pageRecords(file1->readPage(pageNos[1])) != page1), true)
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    checkPassFail(log.recover(), 1)
+  }
+  Page recovered = file1->readPage(pageNos[0]);
+  checkPassFail(recovered.getRecord(first)[offsetof(RECORD, s)], '#')
+  checkPassFail(pageRecords(recovered).size(), page0.size() - 1)
+  checkPassFail((recovered.lsn() > 0), true)
+  checkPassFail((pageRecords(file1->readPage(pageNos[1])) == page1), true)
+
+  std::cout << "Recovery is repeatable" << std::endl;
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    checkPassFail(log.recover(), 0)
+  }
+  checkPassFail(pageRecords(file1->readPage(pageNos[0])).size(), page0.size() - 1)
+  checkPassFail((pageRecords(file1->readPage(pageNos[1])) == page1), true)
+
+  std::cout << "An abort rolls back changes in the pool" << std::endl;
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    Page* page;
+    TxnId txn = log.begin();
+    pool.readPage(file1, pageNos[2], page);
+    RecordId one = {pageNos[2], 1};
+    RecordId two = {pageNos[2], 2};
+    log.deleteRecord(txn, file1, page, one);
+    log.updateRecord(txn, file1, page, two, "shorter");
+    log.insertRecord(txn, file1, page, "inserted");
+    pool.unPinPage(file1, pageNos[2], true);
+    log.abort(txn);
+    pool.readPage(file1, pageNos[2], page);
+    checkPassFail((pageRecords(*page) == page2), true)
+    pool.unPinPage(file1, pageNos[2], false);
+    checkPassFail(log.getStats().aborts, 1)
+    checkPassFail(log.getStats().flushes, 1)
+    pool.flushFile(file1);
+  }
+
+  std::cout << "Index inserts of an aborted transaction leave the tree"
+            << std::endl;
+  {
+    BufMgr pool(100);
+    LogManager log(logName, &pool);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    TxnId kept = log.begin();
+    index.setLog(&log, kept);
+    for (int key = 5000; key < 5500; key++) {
+      index.insertEntry(&key, first);
+    }
+    log.commit(kept);
+    TxnId dropped = log.begin();
+    index.setLog(&log, dropped);
+    for (int key = 5500; key < 7000; key++) {
+      index.insertEntry(&key, first);
+    }
+    index.setLog(NULL, 0);
+    log.abort(dropped);
+    checkPassFail(intScan(&index, 4990, GTE, 5499, LT), 509)
+    checkPassFail(intScan(&index, 5499, GT, 7000, LT), 0)
+  }
+
+  std::cout << "Index inserts of a crashed transaction are undone, with its "
+               "splits" << std::endl;
+  std::cout.flush();
+  child = fork();
+  if (child == 0) {
+    BufMgr* pool = new BufMgr(100);
+    LogManager* log = new LogManager(logName, pool);
+    BTreeIndex* index = new BTreeIndex(relationName, intIndexName, pool,
+                                       offsetof(tuple, i), INTEGER);
+    TxnId committed = log->begin();
+    index->setLog(log, committed);
+    for (int key = 9000; key < 9100; key++) {
+      index->insertEntry(&key, first);
+    }
+    log->commit(committed);
+    TxnId loser = log->begin();
+    index->setLog(log, loser);
+    for (int key = 7000; key < 8500; key++) {
+      index->insertEntry(&key, first);
+      if (key == 8000) {
+        pool->flushFile(index->getFile());
+      }
+    }
+    _exit(0);
+  }
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  {
+    BufMgr pool(100);
+    LogManager log(logName, &pool);
+    checkPassFail(log.recover(), 1)
+  }
+  bufMgr->flushFile(file1);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 5000, GTE, 5500, LT), 500)
+    checkPassFail(intScan(&index, 7000, GTE, 9000, LT), 0)
+    checkPassFail(intScan(&index, 9000, GTE, 9099, LT), 99)
+    // the record of key 1 was deleted by the first transaction
+    checkPassFail(intScan(&index, 0, GTE, 9099, LT), 5598)
+  }
+
+  std::cout << "Nodes split off by a committed transaction are rebuilt if "
+               "the index file lost its growth" << std::endl;
+  std::cout.flush();
+  FileHeader grownFrom;
+  struct stat before;
+  {
+    int fd = open(intIndexName.c_str(), O_RDONLY);
+    checkPassFail((pread(fd, &grownFrom, sizeof(grownFrom), 0) ==
+                   sizeof(grownFrom)), true)
+    fstat(fd, &before);
+    close(fd);
+  }
+  child = fork();
+  if (child == 0) {
+    BufMgr* pool = new BufMgr(100);
+    LogManager* log = new LogManager(logName, pool);
+    BTreeIndex* index = new BTreeIndex(relationName, intIndexName, pool,
+                                       offsetof(tuple, i), INTEGER);
+    TxnId committed = log->begin();
+    index->setLog(log, committed);
+    for (int key = 10000; key < 12000; key++) {
+      index->insertEntry(&key, first);
+    }
+    log->commit(committed);
+    _exit(0);
+  }
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  {
+    // a power loss takes the pages the file grew by and its count of them,
+    // which were never synced
+    int fd = open(intIndexName.c_str(), O_RDWR);
+    struct stat grown;
+    fstat(fd, &grown);
+    checkPassFail((grown.st_size > before.st_size), true)
+    checkPassFail((ftruncate(fd, before.st_size) == 0 &&
+                   pwrite(fd, &grownFrom, sizeof(grownFrom), 0) ==
+                       sizeof(grownFrom)), true)
+    close(fd);
+  }
+  {
+    BufMgr pool(100);
+    LogManager log(logName, &pool);
+    checkPassFail(log.recover(), 0)
+  }
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 10000, GTE, 11999, LT), 1999)
+    checkPassFail(intScan(&index, 0, GTE, 11999, LT), 7598)
+  }
+
+  try {
+    File::remove(intIndexName);
+  } catch (FileNotFoundException e) {
+  }
+  File::remove(logName);
+  std::cout << "Success: walTests Passed." << std::endl;
+}
+
+void markRecord(LogManager& log, BufMgr& pool, File* file, const TxnId txn,
+                const RecordId rid, const char mark) {
+  Page* page;
+  pool.readPage(file, rid.page_number, page);
+  std::string record = page->getRecord(rid);
+  record[offsetof(RECORD, s)] = mark;
+  log.updateRecord(txn, file, page, rid, record);
+  pool.unPinPage(file, rid.page_number, true);
+}
+
+void checkpointTests() {
+  const std::string logName = relationName + ".log";
+  std::vector<PageId> pageNos;
+  for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter) {
+    pageNos.push_back((*iter).page_number());
+  }
+  bufMgr->flushFile(file1);
+  try {
+    File::remove(logName);
+  } catch (FileNotFoundException e) {
+  }
+  std::vector<std::string> page1 = pageRecords(file1->readPage(pageNos[1]));
+  std::vector<std::string> page3 = pageRecords(file1->readPage(pageNos[3]));
+
+  std::cout << "The dirty page table lists pages until they are written"
+            << std::endl;
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    TxnId txn = log.begin();
+    RecordId rid = {pageNos[0], 10};
+    markRecord(log, pool, file1, txn, rid, '+');
+    log.commit(txn);
+    std::vector<DirtyPage> pages;
+    pool.getDirtyPages(pages);
+    checkPassFail(pages.size(), 1)
+    checkPassFail(pages[0].pageNo, pageNos[0])
+    checkPassFail((pages[0].recLsn >= LogManager::LOG_HEADER_SIZE), true)
+    checkPassFail(pool.writeOldestPages(10), 1)
+    pool.getDirtyPages(pages);
+    checkPassFail(pages.size(), 0)
+    checkPassFail((log.checkpoint() > pages.size()), true)
+    checkPassFail(log.getStats().checkpoints, 1)
+    pool.flushFile(file1);
+  }
+
+  std::cout << "Recovery only redoes the log from the last checkpoint on"
+            << std::endl;
+  std::cout.flush();
+  pid_t child = fork();
+  if (child == 0) {
+    int failures = 0;
+    BufMgr* pool = new BufMgr(50);
+    LogManager* log = new LogManager(logName, pool);
+    PageFile* relation = new PageFile(relationName, false);
+
+    TxnId committed = log->begin();
+    for (SlotId slot = 1; slot <= 5; slot++) {
+      RecordId rid = {pageNos[0], slot};
+      markRecord(*log, *pool, relation, committed, rid, '#');
+    }
+    log->commit(committed);
+    TxnId loser = log->begin();
+    RecordId before = {pageNos[1], 1};
+    markRecord(*log, *pool, relation, loser, before, '$');
+
+    if (pool->writeOldestPages(100) != 2) failures |= 1;
+    log->checkpoint();
+    std::vector<DirtyPage> pages;
+    pool->getDirtyPages(pages);
+    if (!pages.empty()) failures |= 2;
+
+    TxnId later = log->begin();
+    RecordId rid = {pageNos[2], 1};
+    markRecord(*log, *pool, relation, later, rid, '#');
+    log->commit(later);
+    RecordId after = {pageNos[3], 1};
+    markRecord(*log, *pool, relation, loser, after, '$');
+    // the commit takes the change of the loser before it to disk
+    TxnId last = log->begin();
+    rid.page_number = pageNos[4];
+    markRecord(*log, *pool, relation, last, rid, '#');
+    log->commit(last);
+    _exit(failures);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    checkPassFail((log.getCheckpointLsn() > 0), true)
+    checkPassFail(log.recover(), 1)
+    // the changes after the checkpoint, not the five before
+    checkPassFail(log.getStats().redone, 3)
+    checkPassFail(log.getStats().checkpoints, 1)
+  }
+  Page recovered = file1->readPage(pageNos[0]);
+  for (SlotId slot = 1; slot <= 5; slot++) {
+    RecordId rid = {pageNos[0], slot};
+    checkPassFail(recovered.getRecord(rid)[offsetof(RECORD, s)], '#')
+  }
+  RecordId rid = {pageNos[2], 1};
+  checkPassFail(file1->readPage(pageNos[2]).getRecord(rid)[offsetof(RECORD, s)], '#')
+  rid.page_number = pageNos[4];
+  checkPassFail(file1->readPage(pageNos[4]).getRecord(rid)[offsetof(RECORD, s)], '#')
+  checkPassFail((pageRecords(file1->readPage(pageNos[1])) == page1), true)
+  checkPassFail((pageRecords(file1->readPage(pageNos[3])) == page3), true)
+
+  std::cout << "Recovery after a clean shutdown reads only the checkpoint"
+            << std::endl;
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    checkPassFail(log.recover(), 0)
+    checkPassFail(log.getStats().redone, 0)
+  }
+
+  std::cout << "The background checkpointer writes pages and takes checkpoints"
+            << std::endl;
+  {
+    BufMgr pool(50);
+    LogManager log(logName, &pool);
+    log.startCheckpointer(4096, 2, 1);
+    for (int i = 0; i < 64; i++) {
+      TxnId txn = log.begin();
+      RecordId rid = {pageNos[i % 4], (SlotId)(20 + i / 4)};
+      markRecord(log, pool, file1, txn, rid, '*');
+      log.commit(txn);
+    }
+    std::vector<DirtyPage> pages;
+    for (int wait = 0; wait < 500; wait++) {
+      pool.getDirtyPages(pages);
+      if (pages.empty() && log.getStats().checkpoints > 1) {
+        break;
+      }
+      usleep(10000);
+    }
+    log.stopCheckpointer();
+    checkPassFail(pages.size(), 0)
+    checkPassFail((log.getStats().checkpoints > 1), true)
+    checkPassFail((pool.getBufStats().diskwrites >= 4), true)
+    pool.flushFile(file1);
+  }
+  RecordId last = {pageNos[3], 35};
+  checkPassFail(file1->readPage(pageNos[3]).getRecord(last)[offsetof(RECORD, s)], '*')
+
+  File::remove(logName);
+  std::cout << "Success: checkpointTests Passed." << std::endl;
+}
+
+// number of entries with keys in [lowVal, highVal), read without the records
+int countKeys(BTreeIndex* index, int lowVal, int highVal) {
+  RecordId rid;
+  int found = 0;
+  index->startScan(&lowVal, GTE, &highVal, LT);
+  try {
+    while (true) {
+      index->scanNext(rid);
+      found++;
+    }
+  } catch (IndexScanCompletedException e) {
+  }
+  index->endScan();
+  return found;
+}
+
+off_t fileSize(const std::string& name) {
+  struct stat st;
+  return stat(name.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+void shadowPagingTests() {
+  try {
+    File::remove(intIndexName);
+  } catch (FileNotFoundException e) {
+  }
+
+  RecordId first;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    // scanned to the end, so that the leaf is unpinned
+    int low = 0;
+    index.startScan(&low, GTE, &low, LTE);
+    index.scanNext(first);
+    try {
+      RecordId next;
+      index.scanNext(next);
+    } catch (IndexScanCompletedException e) {
+    }
+    index.endScan();
+
+    std::cout << "Inserts are seen once committed" << std::endl;
+    index.enableShadowPaging();
+    for (int key = 5000; key < 6000; key++) {
+      index.insertEntry(&key, first);
+    }
+    checkPassFail(countKeys(&index, 4990, 5500), 10)
+    index.commitVersion();
+    checkPassFail(countKeys(&index, 4990, 5500), 510)
+    // the last key of the tree is returned, as the scan finds leaves through
+    // their parents
+    checkPassFail(countKeys(&index, 0, 10000), 6000)
+
+    std::cout << "A scan reads the version committed when it started"
+              << std::endl;
+    int low2 = 0, high = 100000;
+    RecordId rid;
+    index.startScan(&low2, GTE, &high, LT);
+    index.scanNext(rid);
+    off_t before = fileSize(intIndexName);
+    for (int round = 0; round < 5; round++) {
+      for (int key = 6000 + round * 400; key < 6400 + round * 400; key++) {
+        index.insertEntry(&key, first);
+      }
+      index.commitVersion();
+    }
+    int seen = 1;
+    try {
+      while (true) {
+        index.scanNext(rid);
+        seen++;
+      }
+    } catch (IndexScanCompletedException e) {
+    }
+    index.endScan();
+    checkPassFail(seen, 6000)
+    checkPassFail(countKeys(&index, 0, 10000), 8000)
+    // no page the scan could reach was reused
+    off_t grown = fileSize(intIndexName);
+    checkPassFail((grown >= before + 10 * (off_t)Page::SIZE), true)
+
+    std::cout << "Pages of old versions are reused once no scan reads them"
+              << std::endl;
+    for (int key = 10000; key < 10020; key++) {
+      index.insertEntry(&key, first);
+      index.commitVersion();
+    }
+    checkPassFail(fileSize(intIndexName), grown)
+
+    std::cout << "Scans on another thread read whole committed versions"
+              << std::endl;
+    std::atomic<bool> done(false);
+    std::atomic<int> scans(0), bad(0);
+    std::thread reader([&]() {
+      int last = 0;
+      while (!done) {
+        int found = countKeys(&index, 0, 20000);
+        if ((found - 8020) % 200 != 0 || found < last) {
+          bad++;
+        }
+        last = found;
+        scans++;
+      }
+    });
+    for (int key = 12000; key < 16000; key++) {
+      index.insertEntry(&key, first);
+      if (key % 200 == 199) {
+        index.commitVersion();
+      }
+    }
+    while (scans < 3) {
+      std::this_thread::yield();
+    }
+    done = true;
+    reader.join();
+    checkPassFail(bad, 0)
+    checkPassFail(countKeys(&index, 0, 20000), 12020)
+
+    // dropped when the index is closed
+    for (int key = 20000; key < 20100; key++) {
+      index.insertEntry(&key, first);
+    }
+  }
+
+  std::cout << "A reopened index is shadow-paged and has the committed inserts"
+            << std::endl;
+  off_t closed = fileSize(intIndexName);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(countKeys(&index, 0, 30000), 12020)
+    // the free pages saved at close are reused
+    for (int key = 20000; key < 20100; key++) {
+      index.insertEntry(&key, first);
+    }
+    index.commitVersion();
+    checkPassFail(countKeys(&index, 0, 30000), 12120)
+    checkPassFail(fileSize(intIndexName), closed)
+  }
+
+  std::cout << "A crash before a commit leaves the last committed version"
+            << std::endl;
+  std::cout.flush();
+  pid_t child = fork();
+  if (child == 0) {
+    // a small pool writes uncommitted nodes as it evicts them
+    BufMgr* pool = new BufMgr(20);
+    BTreeIndex* index = new BTreeIndex(relationName, intIndexName, pool,
+                                       offsetof(tuple, i), INTEGER);
+    for (int key = 30000; key < 32000; key++) {
+      index->insertEntry(&key, first);
+    }
+    index->commitVersion();
+    for (int key = 32000; key < 36000; key++) {
+      index->insertEntry(&key, first);
+    }
+    _exit(0);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  checkPassFail((WIFEXITED(status) && WEXITSTATUS(status) == 0), true)
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(countKeys(&index, 0, 40000), 14120)
+    checkPassFail(countKeys(&index, 32000, 40000), 0)
+
+    std::cout << "A scan finds every duplicate of its low key" << std::endl;
+    // the duplicates fill several leaves, with separators equal to them
+    for (int copy = 0; copy < 3000; copy++) {
+      int key = 40000;
+      index.insertEntry(&key, first);
+    }
+    int above = 40001;
+    index.insertEntry(&above, first);
+    index.commitVersion();
+    checkPassFail(countKeys(&index, 40000, 40001), 3000)
+    checkPassFail(intScan(&index, 40000, GT, 50000, LT), 1)
+  }
+
+  File::remove(intIndexName);
+  std::cout << "Success: shadowPagingTests Passed." << std::endl;
+}
+
+// Number of searches with a strategy, over every prefix of the keys, that
+// disagree with the linear search.
+template <class T>
+int searchMismatches(const std::vector<T>& keys, const std::vector<T>& probes,
+                     SearchStrategy strategy) {
+  int mismatches = 0;
+  for (int n = 0; n <= (int)keys.size(); n++) {
+    for (std::size_t i = 0; i < probes.size(); i++) {
+      if (KeySearch::upperBound(keys.data(), n, probes[i], strategy) !=
+          KeySearch::linearBound<T, true>(keys.data(), n, probes[i])) {
+        mismatches++;
+      }
+      if (KeySearch::lowerBound(keys.data(), n, probes[i], strategy) !=
+          KeySearch::linearBound<T, false>(keys.data(), n, probes[i])) {
+        mismatches++;
+      }
+    }
+  }
+  return mismatches;
+}
+
+void keySearchTests() {
+  std::cout << "Node searches agree with the linear search" << std::endl;
+  // a full int leaf of keys with many duplicates, probed below, between, on
+  // and above them
+  srand(7);
+  std::vector<int> intKeys(INTARRAYLEAFSIZE);
+  for (std::size_t i = 0; i < intKeys.size(); i++) {
+    intKeys[i] = rand() % 500;
+  }
+  std::sort(intKeys.begin(), intKeys.end());
+  std::vector<int> intProbes;
+  std::vector<double> doubleKeys(intKeys.begin(),
+                                 intKeys.begin() + DOUBLEARRAYLEAFSIZE);
+  std::vector<double> doubleProbes;
+  std::vector<StringKey> stringKeys(STRINGARRAYLEAFSIZE);
+  std::vector<StringKey> stringProbes;
+  for (int probe = -1; probe <= 501; probe += 3) {
+    intProbes.push_back(probe);
+    doubleProbes.push_back(probe);
+    doubleProbes.push_back(probe + 0.5);
+    char digits[16];
+    sprintf(digits, "%05d", probe + 1);
+    StringKey key;
+    strncpy(key.data, digits, STRINGSIZE);
+    stringProbes.push_back(key);
+  }
+  for (std::size_t i = 0; i < stringKeys.size(); i++) {
+    char digits[16];
+    sprintf(digits, "%05d", intKeys[i]);
+    strncpy(stringKeys[i].data, digits, STRINGSIZE);
+  }
+
+  for (int s = SEARCH_LINEAR; s <= SEARCH_AVX2; s++) {
+    SearchStrategy strategy = (SearchStrategy)s;
+    if (!KeySearch::supported(strategy)) {
+      std::cout << KeySearch::name(strategy) << " not supported" << std::endl;
+      continue;
+    }
+    std::cout << KeySearch::name(strategy) << std::endl;
+    checkPassFail(searchMismatches(intKeys, intProbes, strategy), 0)
+    checkPassFail(searchMismatches(doubleKeys, doubleProbes, strategy), 0)
+    checkPassFail(searchMismatches(stringKeys, stringProbes, strategy), 0)
+  }
+
+  std::cout << "Trees built with each strategy" << std::endl;
+  RecordId entryRid;
+  entryRid.page_number = 1;
+  entryRid.slot_number = 1;
+  for (int s = SEARCH_LINEAR; s <= SEARCH_AVX2; s++) {
+    SearchStrategy strategy = (SearchStrategy)s;
+    if (!KeySearch::supported(strategy)) {
+      continue;
+    }
+    try {
+      File::remove(intIndexName);
+    } catch (FileNotFoundException e) {
+    }
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    index.setSearchStrategy(strategy);
+    checkPassFail((index.getSearchStrategy() == strategy), true)
+
+    // duplicates of the keys past the relation, inserted in descending order
+    // so that the splits land on runs of equal keys
+    for (int key = 6999; key >= 5000; key--) {
+      index.insertEntry(&key, entryRid);
+      index.insertEntry(&key, entryRid);
+    }
+    checkPassFail(countKeys(&index, 25, 40), 15)
+    checkPassFail(countKeys(&index, 4990, 5010), 30)
+    checkPassFail(intScan(&index, 5999, GT, 6500, LTE), 1002)
+    checkPassFail(intScan(&index, 3000, GTE, 3000, LTE), 1)
+  }
+
+  File::remove(intIndexName);
+  std::cout << "Success: keySearchTests Passed." << std::endl;
+}
+
+// Rewrite an int index in version 1 of the file format: the slots past the
+// keys of each node emptied, the counts and the format version cleared, and
+// the free list moved back to where the format version is.
+void downgradeIndex(const std::string& name) {
+  BlobFile file(name, false);
+  PageId metaNo = file.getFirstPageNo();
+  Page metaPage = file.readPage(metaNo);
+  IndexMetaInfo* meta = (IndexMetaInfo*)&metaPage;
+
+  std::vector<std::pair<PageId, bool> > nodes;
+  nodes.push_back(std::make_pair(
+      meta->rootPageNo,
+      meta->shadowPaging ? meta->rootIsLeaf != 0 : meta->rootPageNo == 2));
+  while (!nodes.empty()) {
+    PageId pageNo = nodes.back().first;
+    bool isLeaf = nodes.back().second;
+    nodes.pop_back();
+
+    Page page = file.readPage(pageNo);
+    if (isLeaf) {
+      LeafNodeInt* leaf = (LeafNodeInt*)&page;
+      for (int i = leaf->numKeys; i < INTARRAYLEAFSIZE; i++) {
+        leaf->ridArray[i].page_number = 0;
+      }
+      leaf->numKeys = 0;
+    } else {
+      NonLeafNodeInt* node = (NonLeafNodeInt*)&page;
+      for (int i = 0; i <= node->numKeys; i++) {
+        nodes.push_back(std::make_pair(node->pageNoArray[i], node->level == 1));
+      }
+      for (int i = node->numKeys + 1; i <= INTARRAYNONLEAFSIZE; i++) {
+        node->pageNoArray[i] = 0;
+      }
+      node->numKeys = 0;
+    }
+    file.writePage(pageNo, page);
+  }
+
+  meta->formatVersion = 0;
+  memmove(&meta->formatVersion, meta->freePages,
+          meta->freeCount * sizeof(PageId));
+  file.writePage(metaNo, metaPage);
+}
+
+// Rewrite a closed relation file with the page header written before it held
+// an LSN: records moved up by the 8 bytes the header lost, and the magic of
+// the time, or the layout from before pages were aligned.
+void downgradePageFile(const std::string& name, bool aligned) {
+  const std::size_t oldHeader = sizeof(PageHeader) - sizeof(Lsn);
+  std::fstream file(name, std::fstream::in | std::fstream::out |
+                              std::fstream::binary);
+  FileHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  for (PageId pageNo = 1; pageNo < header.num_pages; pageNo++) {
+    char image[Page::SIZE];
+    file.seekg((std::streamoff)pageNo * Page::SIZE);
+    file.read(image, Page::SIZE);
+    PageHeader current;
+    memcpy(&current, image, sizeof(current));
+    char* data = image + sizeof(PageHeader);
+
+    char old[Page::SIZE];
+    memset(old, 0, sizeof(old));
+    PageHeader moved = current;
+    moved.free_space_upper_bound = Page::SIZE - oldHeader;
+    if (current.num_slots > 0) {
+      memcpy(old + oldHeader, data, current.free_space_lower_bound);
+      memcpy(old + sizeof(PageHeader) + current.free_space_upper_bound, data +
+             current.free_space_upper_bound, Page::DATA_SIZE -
+             current.free_space_upper_bound);
+      moved.free_space_upper_bound = current.free_space_upper_bound + 8;
+      for (int slot = 0; slot < current.num_slots; slot++) {
+        PageSlot* entry = (PageSlot*)(old + oldHeader) + slot;
+        if (entry->used) entry->item_offset += 8;
+      }
+    }
+    memcpy(old, &moved, oldHeader);
+    file.seekp(aligned ? (std::streamoff)pageNo * Page::SIZE
+                       : sizeof(FileHeader) + (pageNo - 1) * Page::SIZE);
+    file.write(old, Page::SIZE);
+  }
+  if (aligned) {
+    const std::uint64_t magic = 0x4e47494c41424442ULL;
+    file.seekp(sizeof(FileHeader));
+    file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  }
+  file.close();
+  if (!aligned) {
+    truncate(name.c_str(), sizeof(FileHeader) +
+                               (header.num_pages - 1) * Page::SIZE);
+  }
+}
+
+// Meta page of a closed index.
+IndexMetaInfo readIndexMeta(const std::string& name) {
+  BlobFile file(name, false);
+  Page metaPage = file.readPage(file.getFirstPageNo());
+  IndexMetaInfo meta;
+  memcpy(&meta, &metaPage, sizeof(meta));
+  return meta;
+}
+
+void formatUpgradeTests() {
+  try {
+    File::remove(intIndexName);
+  } catch (FileNotFoundException e) {
+  }
+
+  std::cout << "A file of version 1 is upgraded when opened" << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  }
+  checkPassFail(readIndexMeta(intIndexName).formatVersion,
+                (INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION))
+  downgradeIndex(intIndexName);
+  checkPassFail(readIndexMeta(intIndexName).formatVersion, 0)
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+    checkPassFail(intScan(&index, 0, GTE, 5000, LT), 4999)
+    RecordId entryRid;
+    entryRid.page_number = 1;
+    entryRid.slot_number = 1;
+    for (int key = 5000; key < 8000; key++) {
+      index.insertEntry(&key, entryRid);
+    }
+    checkPassFail(countKeys(&index, 0, 7999), 7999)
+  }
+  checkPassFail(readIndexMeta(intIndexName).formatVersion,
+                (INDEX_FORMAT_TAG | INDEX_FORMAT_VERSION))
+  {
+    // an upgraded file opens as it is
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(countKeys(&index, 4000, 7000), 3000)
+  }
+
+  std::cout << "The free list of a shadow-paged tree survives the upgrade"
+            << std::endl;
+  File::remove(intIndexName);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    index.enableShadowPaging();
+    RecordId entryRid;
+    entryRid.page_number = 1;
+    entryRid.slot_number = 1;
+    for (int key = 5000; key < 7000; key++) {
+      index.insertEntry(&key, entryRid);
+      if (key % 100 == 0) {
+        index.commitVersion();
+      }
+    }
+    index.commitVersion();
+  }
+  IndexMetaInfo before = readIndexMeta(intIndexName);
+  checkPassFail((before.freeCount > 0), true)
+  downgradeIndex(intIndexName);
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(countKeys(&index, 0, 10000), 7000)
+  }
+  IndexMetaInfo after = readIndexMeta(intIndexName);
+  checkPassFail(after.freeCount, before.freeCount)
+  checkPassFail(memcmp(after.freePages, before.freePages,
+                       before.freeCount * sizeof(PageId)),
+                0)
+
+  std::cout << "Relation pages of the old header are upgraded when opened"
+            << std::endl;
+  const std::string scratchName = "formatScratch";
+  std::vector<std::pair<RecordId, std::string> > records;
+  PageId freed;
+  {
+    PageFile scratch(scratchName, true);
+    for (int p = 0; p < 4; p++) {
+      PageId pageNo;
+      Page page = scratch.allocatePage(pageNo);
+      for (int r = 0; page.hasSpaceForRecord(std::string(40 + r % 50, 'x'));
+           r++) {
+        std::string record =
+            std::to_string(p) + ":" + std::string(40 + r % 50, 'a' + r % 26);
+        records.push_back(std::make_pair(page.insertRecord(record), record));
+      }
+      // a hole left in the records of a page
+      page.deleteRecord(records[records.size() - 3].first);
+      records.erase(records.end() - 3);
+      scratch.writePage(pageNo, page);
+    }
+    // and a free page
+    freed = records[0].first.page_number;
+    scratch.deletePage(freed);
+    while (records[0].first.page_number == freed) {
+      records.erase(records.begin());
+    }
+  }
+  for (int aligned = 1; aligned >= 0; aligned--) {
+    downgradePageFile(scratchName, aligned);
+    int mismatches = 0;
+    {
+      PageFile scratch(scratchName, false);
+      checkPassFail(scratch.isAligned(), true)
+      for (std::size_t i = 0; i < records.size(); i++) {
+        Page page = scratch.readPage(records[i].first.page_number);
+        if (page.getRecord(records[i].first) != records[i].second) mismatches++;
+      }
+      PageId pageNo;
+      Page page = scratch.allocatePage(pageNo);
+      checkPassFail(pageNo, freed)
+      checkPassFail((int)page.getFreeSpace(), (int)Page::DATA_SIZE)
+      scratch.deletePage(freed);
+    }
+    checkPassFail(mismatches, 0)
+  }
+  File::remove(scratchName);
+
+  std::cout << "A file of a later version is refused" << std::endl;
+  {
+    BlobFile file(intIndexName, false);
+    Page metaPage = file.readPage(file.getFirstPageNo());
+    ((IndexMetaInfo*)&metaPage)->formatVersion =
+        INDEX_FORMAT_TAG | (INDEX_FORMAT_VERSION + 1);
+    file.writePage(file.getFirstPageNo(), metaPage);
+  }
+  bool refused = false;
+  try {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+  } catch (BadIndexInfoException e) {
+    refused = true;
+  }
+  checkPassFail(refused, true)
+
+  File::remove(intIndexName);
+  std::cout << "Success: formatUpgradeTests Passed." << std::endl;
+}
+
+// Scans of an int index of the relation, as intTests() does.
+void checkIntIndex(BTreeIndex* index) {
+  checkPassFail(intScan(index, 25, GT, 40, LT), 14)
+  checkPassFail(intScan(index, 20, GTE, 35, LTE), 16)
+  checkPassFail(intScan(index, -3, GT, 3, LT), 3)
+  checkPassFail(intScan(index, 996, GT, 1001, LT), 4)
+  checkPassFail(intScan(index, 0, GT, 1, LT), 0)
+  checkPassFail(intScan(index, 300, GT, 400, LT), 99)
+  checkPassFail(intScan(index, 3000, GTE, 4000, LT), 1000)
+}
+
+void bulkLoadTests() {
+  const BuildOptions builds[] = {
+      BuildOptions(false),
+      BuildOptions(true, 1.0),
+      // entries sorted in runs of 1024 and merged
+      BuildOptions(true, 0.5, 1),
+      // a few keys per node, for a deep tree
+      BuildOptions(true, 0.01, 1)};
+  for (int b = 0; b < 4; b++) {
+    std::cout << "int index, bulk " << builds[b].bulk << ", fill factor "
+              << builds[b].fillFactor << ", sort memory "
+              << builds[b].sortMemory << std::endl;
+    try {
+      File::remove(intIndexName);
+    } catch (FileNotFoundException e) {
+    }
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER, CODEC_NONE, builds[b]);
+      checkIntIndex(&index);
+
+      // later inserts split the packed nodes
+      RecordId entryRid;
+      entryRid.page_number = 1;
+      entryRid.slot_number = 1;
+      for (int key = 0; key < relationSize; key += 2) {
+        index.insertEntry(&key, entryRid);
+      }
+      checkPassFail(countKeys(&index, 0, 100), 150)
+      checkPassFail(countKeys(&index, 4000, 4999), 1499)
+    }
+    {
+      // reopened
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+      checkPassFail(countKeys(&index, 1000, 3000), 3000)
+    }
+  }
+  File::remove(intIndexName);
+
+  std::cout << "A fill factor of 1 packs the tree in fewer pages" << std::endl;
+  off_t sizes[3];
+  const BuildOptions packed[] = {BuildOptions(true, 1.0),
+                                 BuildOptions(true, 0.5),
+                                 BuildOptions(false)};
+  for (int b = 0; b < 3; b++) {
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER, CODEC_NONE, packed[b]);
+    }
+    sizes[b] = fileSize(intIndexName);
+    File::remove(intIndexName);
+  }
+  checkPassFail((sizes[0] < sizes[1]), true)
+  checkPassFail((sizes[0] <= sizes[2]), true)
+
+  std::cout << "double and string indexes sorted in runs" << std::endl;
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr,
+                     offsetof(tuple, d), DOUBLE, CODEC_NONE,
+                     BuildOptions(true, 0.7, 1));
+    checkPassFail(doubleScan(&index, 25, GT, 40, LT), 14)
+    checkPassFail(doubleScan(&index, 3000, GTE, 4000, LT), 1000)
+  }
+  File::remove(doubleIndexName);
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr,
+                     offsetof(tuple, s), STRING, CODEC_NONE,
+                     BuildOptions(true, 0.7, 1));
+    checkPassFail(stringScan(&index, "00010", GT, "00035", LT), 25)
+    checkPassFail(stringScan(&index, "03000", GTE, "04000", LT), 1000)
+  }
+  File::remove(stringIndexName);
+
+  std::cout << "Success: bulkLoadTests Passed." << std::endl;
+}
+
+void parallelBuildTests() {
+  const int threads[] = {2, 3, 8};
+  const double fills[] = {0.9, 0.01};
+  for (int t = 0; t < 3; t++) {
+    for (int f = 0; f < 2; f++) {
+      std::cout << "int index, " << threads[t] << " threads, fill factor "
+                << fills[f] << std::endl;
+      off_t sequentialSize;
+      {
+        BTreeIndex index(relationName, intIndexName, bufMgr,
+                         offsetof(tuple, i), INTEGER, CODEC_NONE,
+                         BuildOptions(true, fills[f]));
+      }
+      sequentialSize = fileSize(intIndexName);
+      File::remove(intIndexName);
+      {
+        BTreeIndex index(relationName, intIndexName, bufMgr,
+                         offsetof(tuple, i), INTEGER, CODEC_NONE,
+                         BuildOptions(true, fills[f], 64 << 20, threads[t]));
+        checkIntIndex(&index);
+        checkPassFail(countKeys(&index, 0, 4000), 4000)
+      }
+      // the same tree as a build on one thread
+      checkPassFail((fileSize(intIndexName) == sequentialSize), true)
+      {
+        BTreeIndex index(relationName, intIndexName, bufMgr,
+                         offsetof(tuple, i), INTEGER);
+        RecordId entryRid;
+        entryRid.page_number = 1;
+        entryRid.slot_number = 1;
+        for (int key = 0; key < relationSize; key += 2) {
+          index.insertEntry(&key, entryRid);
+        }
+        checkPassFail(countKeys(&index, 4000, 4999), 1499)
+      }
+      File::remove(intIndexName);
+    }
+  }
+
+  std::cout << "double and string indexes on 4 threads" << std::endl;
+  {
+    BTreeIndex index(relationName, doubleIndexName, bufMgr,
+                     offsetof(tuple, d), DOUBLE, CODEC_NONE,
+                     BuildOptions(true, 0.7, 64 << 20, 4));
+    checkPassFail(doubleScan(&index, 25, GT, 40, LT), 14)
+    checkPassFail(doubleScan(&index, 3000, GTE, 4000, LT), 1000)
+  }
+  File::remove(doubleIndexName);
+  {
+    BTreeIndex index(relationName, stringIndexName, bufMgr,
+                     offsetof(tuple, s), STRING, CODEC_NONE,
+                     BuildOptions(true, 0.7, 64 << 20, 4));
+    checkPassFail(stringScan(&index, "00010", GT, "00035", LT), 25)
+    checkPassFail(stringScan(&index, "03000", GTE, "04000", LT), 1000)
+  }
+  File::remove(stringIndexName);
+
+  std::cout << "Success: parallelBuildTests Passed." << std::endl;
+}
+
+// Entries of the int attribute of the relation, in the order of the relation.
+std::vector<std::pair<int, RecordId> > relationIntEntries() {
+  std::vector<std::pair<int, RecordId> > entries;
+  FileScan fscan(relationName, bufMgr);
+  try {
+    RecordId rid;
+    while (true) {
+      fscan.scanNext(rid);
+      std::string record = fscan.getRecord();
+      entries.push_back(
+          std::make_pair(*(int*)(record.c_str() + offsetof(tuple, i)), rid));
+    }
+  } catch (EndOfFileException e) {
+  }
+  return entries;
+}
+
+// Walk the subtree of an int index below a node, checking that its keys are
+// in order and within the range its parents give them, that its leaves are
+// all at one depth and, if full, that its nodes other than the root are at
+// least half full. Leaves are appended with their right siblings. Returns the
+// number of entries, or -1 if a check failed.
+int checkIntNode(BTreeIndex* index, PageId pageNo, bool isLeaf, int low,
+                 int high, bool isRoot, bool full, int depth, int& leafDepth,
+                 std::vector<std::pair<PageId, PageId> >& leaves) {
+  Page* page;
+  index->getBufMgr()->readPage(index->getFile(), pageNo, page);
+
+  if (isLeaf) {
+    LeafNodeInt* leaf = (LeafNodeInt*)page;
+    bool ok = (!full || isRoot || leaf->numKeys >= INTARRAYLEAFSIZE / 2) &&
+              (leafDepth < 0 || leafDepth == depth);
+    for (int i = 0; i < leaf->numKeys; i++) {
+      ok = ok && low <= leaf->keyArray[i] && leaf->keyArray[i] <= high &&
+           (i == 0 || leaf->keyArray[i - 1] <= leaf->keyArray[i]);
+    }
+    int entries = leaf->numKeys;
+    leafDepth = depth;
+    leaves.push_back(std::make_pair(pageNo, leaf->rightSibPageNo));
+    index->getBufMgr()->unPinPage(index->getFile(), pageNo, false);
+    return ok ? entries : -1;
+  }
+
+  NonLeafNodeInt* node = (NonLeafNodeInt*)page;
+  bool ok = node->numKeys > 0 &&
+            (!full || isRoot || node->numKeys >= INTARRAYNONLEAFSIZE / 2);
+  std::vector<int> keys(node->keyArray, node->keyArray + node->numKeys);
+  std::vector<PageId> children(node->pageNoArray,
+                               node->pageNoArray + node->numKeys + 1);
+  bool childrenAreLeaves = node->level == 1;
+  index->getBufMgr()->unPinPage(index->getFile(), pageNo, false);
+
+  int entries = 0;
+  for (size_t c = 0; ok && c < children.size(); c++) {
+    int childLow = c == 0 ? low : keys[c - 1];
+    int childHigh = c == keys.size() ? high : keys[c];
+    ok = low <= childLow && childLow <= childHigh && childHigh <= high;
+    int childEntries =
+        checkIntNode(index, children[c], childrenAreLeaves, childLow, childHigh,
+                     false, full, depth + 1, leafDepth, leaves);
+    ok = ok && childEntries >= 0;
+    entries += childEntries;
+  }
+  return ok ? entries : -1;
+}
+
+// checkIntNode() from the root, also checking the chain of leaves unless the
+// tree is shadow paged, whose copied leaves keep stale sibling links.
+int checkIntTree(BTreeIndex* index, bool full, bool siblings = true) {
+  bool isLeaf;
+  PageId root = index->getRootPageNum(isLeaf);
+  int leafDepth = -1;
+  std::vector<std::pair<PageId, PageId> > leaves;
+  int entries = checkIntNode(index, root, isLeaf, std::numeric_limits<int>::min(),
+                             std::numeric_limits<int>::max(), true, full,
+                             0, leafDepth, leaves);
+  for (size_t i = 0; siblings && i < leaves.size(); i++) {
+    PageId next = i + 1 < leaves.size() ? leaves[i + 1].first : 0;
+    if (leaves[i].second != next) {
+      return -1;
+    }
+  }
+  return entries;
+}
+
+void deleteTests() {
+  std::vector<std::pair<int, RecordId> > inOrder = relationIntEntries();
+  checkPassFail((int)inOrder.size(), relationSize)
+  // byKey[k] is the entry of key k
+  std::vector<std::pair<int, RecordId> > byKey(relationSize);
+  for (int i = 0; i < relationSize; i++) {
+    byKey[inOrder[i].first] = inOrder[i];
+  }
+
+  const BuildOptions builds[] = {BuildOptions(false), BuildOptions(true, 0.05),
+                                 BuildOptions(true, 0.01)};
+  for (int b = 0; b < 3; b++) {
+    std::cout << "int index, bulk " << builds[b].bulk << ", fill factor "
+              << builds[b].fillFactor << std::endl;
+    try {
+      File::remove(intIndexName);
+    } catch (FileNotFoundException e) {
+    }
+    off_t builtSize;
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER, CODEC_NONE, builds[b]);
+      builtSize = fileSize(intIndexName);
+      // only the tree built by inserts has nodes half full to begin with
+      const bool full = !builds[b].bulk;
+      checkPassFail(checkIntTree(&index, full), relationSize)
+
+      std::vector<int> odd;
+      for (int key = 1; key < relationSize; key += 2) {
+        odd.push_back(key);
+      }
+      srand(b);
+      std::random_shuffle(odd.begin(), odd.end());
+      bool valid = true;
+      for (size_t i = 0; i < odd.size(); i++) {
+        index.deleteEntry(&byKey[odd[i]].first, byKey[odd[i]].second);
+        if (i % 250 == 0) {
+          valid = valid && checkIntTree(&index, full) ==
+                               relationSize - (int)i - 1;
+        }
+      }
+      checkPassFail(valid, true)
+      checkPassFail(checkIntTree(&index, full), relationSize / 2)
+      checkPassFail(intScan(&index, 25, GT, 40, LT), 7)
+      checkPassFail(countKeys(&index, 0, 1000), 500)
+
+      std::cout << "An entry deleted already, or of another record, is not "
+                   "found" << std::endl;
+      bool missing = false;
+      try {
+        index.deleteEntry(&byKey[1].first, byKey[1].second);
+      } catch (NoSuchKeyFoundException e) {
+        missing = true;
+      }
+      checkPassFail(missing, true)
+      missing = false;
+      try {
+        index.deleteEntry(&byKey[2].first, byKey[4].second);
+      } catch (NoSuchKeyFoundException e) {
+        missing = true;
+      }
+      checkPassFail(missing, true)
+      checkPassFail(checkIntTree(&index, full), relationSize / 2)
+    }
+    {
+      std::cout << "Deleting all but one entry leaves the root leaf on page 2"
+                << std::endl;
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+      for (int key = 2; key < relationSize; key += 2) {
+        index.deleteEntry(&byKey[key].first, byKey[key].second);
+      }
+      checkPassFail(checkIntTree(&index, false), 1)
+      bool isLeaf;
+      checkPassFail(index.getRootPageNum(isLeaf), 2)
+      checkPassFail(isLeaf, true)
+    }
+    {
+      std::cout << "Pages freed by merges are reused after reopening"
+                << std::endl;
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                       INTEGER);
+      checkPassFail(checkIntTree(&index, false), 1)
+      for (int i = 0; i < relationSize; i++) {
+        if (inOrder[i].first != 0) {
+          index.insertEntry(&inOrder[i].first, inOrder[i].second);
+        }
+      }
+      checkPassFail(checkIntTree(&index, true), relationSize)
+      checkPassFail(countKeys(&index, 0, 4000), 4000)
+      checkPassFail((fileSize(intIndexName) <= builtSize), true)
+    }
+    File::remove(intIndexName);
+  }
+
+  std::cout << "Entries of one key over several leaves" << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    const int dup = 2500;
+    std::vector<RecordId> rids(3000);
+    for (int i = 0; i < 3000; i++) {
+      rids[i].page_number = 1000 + i / 100;
+      rids[i].slot_number = i % 100 + 1;
+      index.insertEntry(&dup, rids[i]);
+    }
+    checkPassFail(checkIntTree(&index, false), relationSize + 3000)
+    srand(7);
+    std::random_shuffle(rids.begin(), rids.end());
+    for (int i = 0; i < 3000; i++) {
+      index.deleteEntry(&dup, rids[i]);
+    }
+    checkPassFail(checkIntTree(&index, false), relationSize)
+    checkPassFail(countKeys(&index, 2500, 2501), 1)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Deletes of a shadow-paged tree are seen once committed"
+            << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    index.enableShadowPaging();
+    for (int key = 0; key < 2000; key++) {
+      index.deleteEntry(&byKey[key].first, byKey[key].second);
+      if (key % 100 == 99) {
+        index.commitVersion();
+      }
+    }
+    index.deleteEntry(&byKey[2000].first, byKey[2000].second);
+    checkPassFail(countKeys(&index, 0, 2001), 1)
+    index.commitVersion();
+    checkPassFail(countKeys(&index, 0, 5000), 2999)
+    checkPassFail(checkIntTree(&index, false, false), 2999)
+  }
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(countKeys(&index, 0, 5000), 2999)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Deletes of an aborted transaction are undone" << std::endl;
+  const std::string logName = relationName + ".log";
+  {
+    BufMgr pool(100);
+    LogManager log(logName, &pool);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    TxnId txn = log.begin();
+    index.setLog(&log, txn);
+    for (int key = 0; key < 3000; key++) {
+      index.deleteEntry(&byKey[key].first, byKey[key].second);
+    }
+    checkPassFail(checkIntTree(&index, false), relationSize - 3000)
+    index.setLog(NULL, 0);
+    log.abort(txn);
+    checkPassFail(checkIntTree(&index, false), relationSize)
+    checkPassFail(countKeys(&index, 0, 4000), 4000)
+  }
+  File::remove(intIndexName);
+  File::remove(logName);
+
+  std::cout << "Success: deleteTests Passed." << std::endl;
+}
+
+// Entry of key k inserted by the concurrent tests.
+RecordId concurrentRid(int k) {
+  RecordId rid;
+  rid.page_number = 1 + k / 100;
+  rid.slot_number = 1 + k % 100;
+  return rid;
+}
+
+void concurrentTests() {
+  const int threads = 4;
+  const int perThread = 150000;
+
+  std::cout << "Inserts on " << threads << " threads, looked up on two more"
+            << std::endl;
+  {
+    BufMgr pool(2000);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+
+    // thread t inserts the keys k with k % threads == t in random order,
+    // announcing how many it has inserted
+    std::vector<std::vector<int> > keys(threads);
+    std::atomic<int> inserted[threads];
+    for (int t = 0; t < threads; t++) {
+      for (int k = t; k < threads * perThread; k += threads) {
+        keys[t].push_back(k);
+      }
+      srand(t + 1);
+      std::random_shuffle(keys[t].begin(), keys[t].end());
+      inserted[t] = 0;
+    }
+
+    std::atomic<bool> inserting(true);
+    std::atomic<int> misses(0);
+    std::atomic<int> lookups(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&, t]() {
+        for (int i = 0; i < perThread; i++) {
+          index.insertEntry(&keys[t][i], concurrentRid(keys[t][i]));
+          inserted[t] = i + 1;
+        }
+      }));
+    }
+    for (int r = 0; r < 2; r++) {
+      workers.push_back(std::thread([&, r]() {
+        unsigned int seed = r + 1;
+        while (inserting) {
+          int t = rand_r(&seed) % threads;
+          int done = inserted[t];
+          if (done == 0) {
+            continue;
+          }
+          int key = keys[t][rand_r(&seed) % done];
+          std::vector<RecordId> rids;
+          if (index.lookupEntries(&key, rids) != 1 ||
+              rids[0] != concurrentRid(key)) {
+            misses++;
+          }
+          lookups++;
+        }
+      }));
+    }
+    for (int t = 0; t < threads; t++) {
+      workers[t].join();
+    }
+    inserting = false;
+    workers[threads].join();
+    workers[threads + 1].join();
+
+    checkPassFail(misses.load(), 0)
+    checkPassFail((lookups.load() > 0), true)
+    checkPassFail(checkIntTree(&index, true), threads * perThread)
+
+    bool isLeaf;
+    PageId root = index.getRootPageNum(isLeaf);
+    Page* rootPage;
+    pool.readPage(index.getFile(), root, rootPage);
+    // the root split in turn, above non-leaf nodes
+    checkPassFail((!isLeaf && ((NonLeafNodeInt*)rootPage)->level == 0), true)
+    pool.unPinPage(index.getFile(), root, false);
+
+    int found = 0;
+    for (int k = 0; k < threads * perThread; k += 7) {
+      std::vector<RecordId> rids;
+      found += index.lookupEntries(&k, rids) == 1 && rids[0] == concurrentRid(k);
+    }
+    checkPassFail(found, (threads * perThread + 6) / 7)
+  }
+  {
+    BufMgr pool(2000);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(checkIntTree(&index, true), threads * perThread)
+    std::vector<RecordId> rids;
+    int key = threads * perThread - 1;
+    checkPassFail(index.lookupEntries(&key, rids), 1)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Entries of one key inserted on " << threads << " threads"
+            << std::endl;
+  {
+    BufMgr pool(200);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    const int dup = 7;
+    const int perThreadDups = 2000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&, t]() {
+        for (int i = 0; i < perThreadDups; i++) {
+          int other = t * perThreadDups + i;
+          index.insertEntry(&dup, concurrentRid(t * perThreadDups + i));
+          index.insertEntry(&other, concurrentRid(other));
+        }
+      }));
+    }
+    for (int t = 0; t < threads; t++) {
+      workers[t].join();
+    }
+
+    std::vector<RecordId> rids;
+    checkPassFail(index.lookupEntries(&dup, rids), threads * perThreadDups + 1)
+    std::vector<RecordId> expected;
+    for (int i = 0; i < threads * perThreadDups; i++) {
+      expected.push_back(concurrentRid(i));
+    }
+    expected.push_back(concurrentRid(dup));
+    std::sort(rids.begin(), rids.end(), [](const RecordId& a, const RecordId& b) {
+      return a.page_number != b.page_number ? a.page_number < b.page_number
+                                            : a.slot_number < b.slot_number;
+    });
+    std::sort(expected.begin(), expected.end(), [](const RecordId& a, const RecordId& b) {
+      return a.page_number != b.page_number ? a.page_number < b.page_number
+                                            : a.slot_number < b.slot_number;
+    });
+    checkPassFail((rids == expected), true)
+    checkPassFail(checkIntTree(&index, false), 2 * threads * perThreadDups)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Lookups of a shadow-paged tree read the committed version"
+            << std::endl;
+  {
+    BufMgr pool(200);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    index.enableShadowPaging();
+    const int dup = 3;
+    for (int i = 0; i < 3000; i++) {
+      index.insertEntry(&dup, concurrentRid(i));
+    }
+    std::vector<RecordId> rids;
+    checkPassFail(index.lookupEntries(&dup, rids), 0)
+    index.commitVersion();
+    checkPassFail(index.lookupEntries(&dup, rids), 3000)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Success: concurrentTests Passed." << std::endl;
+}
+
+// Buffer manager counting the pages read through it.
+class CountingBufMgr : public BufMgr {
+ public:
+  CountingBufMgr(std::uint32_t bufs) : BufMgr(bufs), reads(0) {}
+
+  void readPage(File* file, const PageId pageNo, Page*& page,
+                const AccessStrategy strategy = NORMAL,
+                const PageClass pageClass = PAGE_HEAP) {
+    reads++;
+    BufMgr::readPage(file, pageNo, page, strategy, pageClass);
+  }
+
+  int reads;
+};
+
+void optimisticReadTests() {
+  const int keys = 100000;
+  const int probes = 1000;
+
+  std::cout << "Lookups peek at nodes in the pool without pinning them"
+            << std::endl;
+  {
+    CountingBufMgr pool(2000);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    for (int k = 0; k < keys; k++) {
+      index.insertEntry(&k, concurrentRid(k));
+    }
+    bool isLeaf;
+    PageId root = index.getRootPageNum(isLeaf);
+    Page* rootPage;
+    pool.readPage(index.getFile(), root, rootPage);
+    // a root above the leaves
+    checkPassFail((!isLeaf && ((NonLeafNodeInt*)rootPage)->level == 1), true)
+    pool.unPinPage(index.getFile(), root, false);
+
+    // a page read is found without a pin until its frame is given up
+    PagePeek peek;
+    checkPassFail((pool.peekPage(index.getFile(), root, peek) == rootPage), true)
+    checkPassFail(pool.validatePeek(peek), true)
+
+    for (int pass = 0; pass < 3; pass++) {
+      pool.reads = 0;
+      int found = 0;
+      for (int k = 0; k < keys; k += keys / probes) {
+        std::vector<RecordId> rids;
+        found += index.lookupEntries(&k, rids) == 1 && rids[0] == concurrentRid(k);
+      }
+      checkPassFail(found, probes)
+      // only pages whose hints another page took are pinned, once the pages
+      // flushed are read back
+      if (pass != 1) {
+        checkPassFail((pool.reads < probes / 10), true)
+      }
+
+      if (pass == 0) {
+        // no lookup left a page pinned
+        pool.flushFile(index.getFile());
+        checkPassFail(pool.validatePeek(peek), false)
+        checkPassFail((pool.peekPage(index.getFile(), root, peek) == NULL), true)
+      }
+    }
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Lookups in a pool of 8 frames peek at pages replaced under them"
+            << std::endl;
+  {
+    BufMgr pool(8);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    for (int k = 0; k < keys; k++) {
+      index.insertEntry(&k, concurrentRid(k));
+    }
+    int found = 0;
+    for (int k = 0; k < keys; k += keys / probes) {
+      std::vector<RecordId> rids;
+      found += index.lookupEntries(&k, rids) == 1 && rids[0] == concurrentRid(k);
+    }
+    checkPassFail(found, probes)
+    checkPassFail(checkIntTree(&index, true), keys)
+  }
+  File::remove(intIndexName);
+
+  const int threads = 4;
+  const int perThread = 50000;
+  std::cout << "Inserts on " << threads
+            << " threads, looked up on two more in a pool of 64 frames" << std::endl;
+  {
+    BufMgr pool(64);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+
+    std::atomic<int> inserted[threads];
+    for (int t = 0; t < threads; t++) {
+      inserted[t] = 0;
+    }
+    std::atomic<bool> inserting(true);
+    std::atomic<int> misses(0);
+    std::atomic<int> lookups(0);
+    std::vector<std::thread> workers;
+    // thread t inserts the keys k with k % threads == t in descending order,
+    // so that lookups of the keys inserted race splits of their leaves
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&, t]() {
+        for (int i = 0; i < perThread; i++) {
+          int key = (perThread - 1 - i) * threads + t;
+          index.insertEntry(&key, concurrentRid(key));
+          inserted[t] = i + 1;
+        }
+      }));
+    }
+    for (int r = 0; r < 2; r++) {
+      workers.push_back(std::thread([&, r]() {
+        unsigned int seed = r + 1;
+        while (inserting) {
+          int t = rand_r(&seed) % threads;
+          int done = inserted[t];
+          if (done == 0) {
+            continue;
+          }
+          int key = (perThread - 1 - rand_r(&seed) % done) * threads + t;
+          std::vector<RecordId> rids;
+          if (index.lookupEntries(&key, rids) != 1 ||
+              rids[0] != concurrentRid(key)) {
+            misses++;
+          }
+          lookups++;
+        }
+      }));
+    }
+    for (int t = 0; t < threads; t++) {
+      workers[t].join();
+    }
+    inserting = false;
+    workers[threads].join();
+    workers[threads + 1].join();
+
+    checkPassFail(misses.load(), 0)
+    checkPassFail((lookups.load() > 0), true)
+    checkPassFail(checkIntTree(&index, true), threads * perThread)
+  }
+  {
+    BufMgr pool(2000);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    checkPassFail(checkIntTree(&index, true), threads * perThread)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Success: optimisticReadTests Passed." << std::endl;
+}
+
+// number of entries with keys in [lowVal, highVal) scanned with a cursor
+int cursorCount(BTreeIndex* index, IndexCursor& cursor, int lowVal, int highVal) {
+  RecordId rid;
+  int found = 0;
+  index->startScan(cursor, &lowVal, GTE, &highVal, LT);
+  try {
+    while (true) {
+      index->scanNext(cursor, rid);
+      found++;
+    }
+  } catch (IndexScanCompletedException e) {
+  }
+  index->endScan(cursor);
+  return found;
+}
+
+void cursorTests() {
+  try {
+    File::remove(intIndexName);
+  } catch (FileNotFoundException e) {
+  }
+
+  std::cout << "Two cursors scan one index in turn" << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    IndexCursor up;
+    IndexCursor down;
+    int low = 100;
+    int high = 200;
+    index.startScan(up, &low, GTE, &high, LT);
+    int found = 0;
+    bool ordered = true;
+    RecordId upRid;
+    RecordId downRid;
+    for (int k = 100; k < 200; k++) {
+      index.scanNext(up, upRid);
+      // each step of the first cursor restarts the second at its key
+      index.startScan(down, &k, GTE, &high, LT);
+      index.scanNext(down, downRid);
+      ordered = ordered && upRid == downRid;
+      found++;
+    }
+    checkPassFail(ordered, true)
+    checkPassFail(found, 100)
+    bool completed = false;
+    try {
+      index.scanNext(up, upRid);
+    } catch (IndexScanCompletedException e) {
+      completed = true;
+    }
+    checkPassFail(completed, true)
+    index.endScan(up);
+    checkPassFail(up.isScanning(), false)
+    checkPassFail(down.isScanning(), true)
+
+    std::cout << "The scan of the index's own cursor leaves cursor scans running"
+              << std::endl;
+    checkPassFail(intScan(&index, 25, GT, 40, LT), 14)
+    checkPassFail(down.isScanning(), true)
+    // the second cursor, last started at 199, is past the end of its range
+    completed = false;
+    try {
+      index.scanNext(down, downRid);
+    } catch (IndexScanCompletedException e) {
+      completed = true;
+    }
+    checkPassFail(completed, true)
+    index.endScan(down);
+
+    std::cout << "A cursor is reused for many scans" << std::endl;
+    IndexCursor probe;
+    int matched = 0;
+    for (int k = 0; k < relationSize - 1; k += 7) {
+      matched += cursorCount(&index, probe, k, k + 1);
+    }
+    checkPassFail(matched, (relationSize - 2) / 7 + 1)
+    checkPassFail(cursorCount(&index, probe, 0, 3000), 3000)
+  }
+  // a cursor destroyed while scanning unpinned its leaf, or closing the index would have failed
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    {
+      IndexCursor open;
+      int low = 10;
+      int high = 20;
+      index.startScan(open, &low, GTE, &high, LT);
+      RecordId rid;
+      index.scanNext(open, rid);
+    }
+    bufMgr->flushFile(index.getFile());
+
+    std::cout << "A cursor only scans the index it was started on" << std::endl;
+    IndexCursor cursor;
+    bool rejected = false;
+    try {
+      RecordId rid;
+      index.scanNext(cursor, rid);
+    } catch (ScanNotInitializedException e) {
+      rejected = true;
+    }
+    checkPassFail(rejected, true)
+  }
+
+  const int threads = 4;
+  std::cout << "Cursors scan one index on " << threads << " threads" << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    std::vector<int> found(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&, t]() {
+        IndexCursor cursor;
+        for (int round = 0; round < 20; round++) {
+          int low = (t * 997 + round * 131) % (relationSize - 500);
+          found[t] += cursorCount(&index, cursor, low, low + 500) == 500;
+        }
+      }));
+    }
+    for (int t = 0; t < threads; t++) {
+      workers[t].join();
+    }
+    int total = 0;
+    for (int t = 0; t < threads; t++) {
+      total += found[t];
+    }
+    checkPassFail(total, threads * 20)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Cursors scan an index while " << threads
+            << " threads insert into it" << std::endl;
+  {
+    BufMgr pool(500);
+    BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple, i),
+                     INTEGER);
+    const int perThread = 40000;
+    const int span = 5000;
+
+    // thread t inserts the keys k with k % threads == t in random order, above
+    // those of the relation, announcing how many it has inserted
+    std::vector<std::vector<int> > keys(threads);
+    std::atomic<int> inserted[threads];
+    for (int t = 0; t < threads; t++) {
+      for (int k = t; k < threads * perThread; k += threads) {
+        keys[t].push_back(relationSize + k);
+      }
+      srand(t + 1);
+      std::random_shuffle(keys[t].begin(), keys[t].end());
+      inserted[t] = 0;
+    }
+
+    std::atomic<bool> inserting(true);
+    std::atomic<int> bad(0);
+    std::atomic<int> scans(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&, t]() {
+        for (int i = 0; i < perThread; i++) {
+          index.insertEntry(&keys[t][i], concurrentRid(keys[t][i] - relationSize));
+          inserted[t] = i + 1;
+        }
+      }));
+    }
+    workers.push_back(std::thread([&]() {
+      unsigned int seed = 1;
+      IndexCursor cursor;
+      while (inserting) {
+        int low = relationSize + rand_r(&seed) % (threads * perThread - span);
+        int high = low + span;
+
+        // keys a scan must return are those inserted before it started
+        std::vector<char> before(span, 0);
+        for (int t = 0; t < threads; t++) {
+          int done = inserted[t];
+          for (int i = 0; i < done; i++) {
+            if (keys[t][i] >= low && keys[t][i] < high) {
+              before[keys[t][i] - low] = 1;
+            }
+          }
+        }
+
+        std::vector<char> seen(span, 0);
+        int last = low - 1;
+        RecordId rid;
+        index.startScan(cursor, &low, GTE, &high, LT);
+        try {
+          while (true) {
+            index.scanNext(cursor, rid);
+            int key = relationSize + (rid.page_number - 1) * 100 + rid.slot_number - 1;
+            // in key order, each key once, within the range
+            if (key <= last || key >= high) {
+              bad++;
+              break;
+            }
+            seen[key - low] = 1;
+            last = key;
+          }
+        } catch (IndexScanCompletedException e) {
+        }
+        index.endScan(cursor);
+
+        for (int k = 0; k < span; k++) {
+          if (before[k] && !seen[k]) {
+            bad++;
+            break;
+          }
+        }
+        scans++;
+      }
+    }));
+    for (int t = 0; t < threads; t++) {
+      workers[t].join();
+    }
+    inserting = false;
+    workers[threads].join();
+
+    checkPassFail(bad.load(), 0)
+    checkPassFail((scans.load() > 0), true)
+    IndexCursor cursor;
+    checkPassFail(cursorCount(&index, cursor, relationSize, relationSize + span), span)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Cursors of a shadow-paged tree each read their own version"
+            << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    index.enableShadowPaging();
+    IndexCursor before;
+    int low = relationSize - 10;
+    int high = relationSize + 10;
+    index.startScan(before, &low, GTE, &high, LT);
+    RecordId rid = {1, 1};
+    for (int key = relationSize; key < relationSize + 10; key++) {
+      index.insertEntry(&key, rid);
+    }
+    index.commitVersion();
+    IndexCursor after;
+    checkPassFail(cursorCount(&index, after, low, high), 20)
+    int found = 0;
+    try {
+      while (true) {
+        index.scanNext(before, rid);
+        found++;
+      }
+    } catch (IndexScanCompletedException e) {
+    }
+    index.endScan(before);
+    checkPassFail(found, 10)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Success: cursorTests Passed." << std::endl;
+}
+
+// record ids of the scan of a range, fetched batch at a time, with the number
+// of calls made
+std::vector<RecordId> batchScan(BTreeIndex* index, IndexCursor& cursor,
+                                int lowVal, Operator lowOp, int highVal,
+                                Operator highOp, int batch, int& calls) {
+  std::vector<RecordId> rids;
+  std::vector<RecordId> out(batch);
+  index->startScan(cursor, &lowVal, lowOp, &highVal, highOp);
+  calls = 0;
+  int got;
+  do {
+    got = index->scanNextBatch(cursor, out.data(), batch);
+    rids.insert(rids.end(), out.begin(), out.begin() + got);
+    calls++;
+  } while (got == batch);
+  index->endScan(cursor);
+  return rids;
+}
+
+// record ids of the scan of a range, fetched one at a time
+std::vector<RecordId> ridScan(BTreeIndex* index, IndexCursor& cursor,
+                              int lowVal, Operator lowOp, int highVal,
+                              Operator highOp) {
+  std::vector<RecordId> rids;
+  RecordId rid;
+  index->startScan(cursor, &lowVal, lowOp, &highVal, highOp);
+  try {
+    while (true) {
+      index->scanNext(cursor, rid);
+      rids.push_back(rid);
+    }
+  } catch (IndexScanCompletedException e) {
+  }
+  index->endScan(cursor);
+  return rids;
+}
+
+void batchScanTests() {
+  try {
+    File::remove(intIndexName);
+  } catch (FileNotFoundException e) {
+  }
+
+  const int ranges[][2] = {{25, 40},    {0, 1},       {-10, 3000}, {1000, 4000},
+                          {4000, 4990}, {4000, 5000}, {7000, 8000}};
+  const int batches[] = {1, 7, 512, 5000};
+
+  std::cout << "Batches hold the entries scanNext() returns one at a time"
+            << std::endl;
+  // but for the last entry of the tree, which an index that is not
+  // shadow-paged completes its scanNext() scans on without returning
+  for (int shadow = 0; shadow < 2; shadow++) {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    if (shadow) {
+      index.enableShadowPaging();
+    }
+    IndexCursor cursor;
+    bool same = true;
+    for (int r = 0; r < 7; r++) {
+      for (int op = 0; op < 4; op++) {
+        Operator lowOp = op & 1 ? GT : GTE;
+        Operator highOp = op & 2 ? LT : LTE;
+        std::vector<RecordId> one = ridScan(&index, cursor, ranges[r][0], lowOp,
+                                            ranges[r][1], highOp);
+        std::size_t dropped = !shadow && ranges[r][0] < relationSize - 1 &&
+                              ranges[r][1] >= relationSize;
+        for (int b = 0; b < 4; b++) {
+          int calls;
+          std::vector<RecordId> many =
+              batchScan(&index, cursor, ranges[r][0], lowOp, ranges[r][1],
+                        highOp, batches[b], calls);
+          same = same && many.size() == one.size() + dropped &&
+                 std::equal(one.begin(), one.end(), many.begin()) &&
+                 calls == (int)many.size() / batches[b] + 1;
+        }
+      }
+    }
+    checkPassFail(same, true)
+
+    int last = relationSize - 1;
+    int calls;
+    checkPassFail((int)ridScan(&index, cursor, 4000, GTE, last, LTE).size(),
+                  shadow ? 1000 : 999)
+    checkPassFail((int)batchScan(&index, cursor, 4000, GTE, last, LTE, 512,
+                                 calls).size(), 1000)
+  }
+  File::remove(intIndexName);
+
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i),
+                     INTEGER);
+    std::cout << "A batch scan of the whole tree, after one entry from scanNext()"
+              << std::endl;
+    int low = 0;
+    int high = relationSize;
+    index.startScan(&low, GTE, &high, LT);
+    RecordId first;
+    index.scanNext(first);
+    std::vector<RecordId> out(300);
+    int found = 1;
+    int got;
+    while ((got = index.scanNextBatch(out.data(), 300)) > 0) {
+      found += got;
+    }
+    checkPassFail(found, relationSize)
+    // the end of the scan is returned again rather than thrown
+    checkPassFail(index.scanNextBatch(out.data(), 300), 0)
+    bool completed = false;
+    try {
+      index.scanNext(first);
+    } catch (IndexScanCompletedException e) {
+      completed = true;
+    }
+    checkPassFail(completed, true)
+    index.endScan();
+
+    bool rejected = false;
+    try {
+      index.scanNextBatch(out.data(), 300);
+    } catch (ScanNotInitializedException e) {
+      rejected = true;
+    }
+    checkPassFail(rejected, true)
+  }
+  File::remove(intIndexName);
+
+  std::cout << "Success: batchScanTests Passed." << std::endl;
+}
@@ -10,6 +10,7 @@
  *     <li> @ref prereq_sec
  *     <li> @ref commands_sec
  *     <li> @ref modify_run_main_sec
+ *     <li> @ref benchmark_sec
  *     <li> @ref documentation_sec
  *   </ol>
  *   <li> @ref api_sec
@@ -68,6 +69,17 @@
  * If you want to edit what <code>badgerdb_main</code> does, edit
  * <code>src/main.cpp</code>.
  *
+ * @subsection benchmark_sec Running the benchmarks
+ *
+ * Benchmarks for the buffer manager and the B+ tree live in
+ * <code>src/benchmark.cpp</code>.  To build and run one:
+ * @code
+ *   $ make bench
+ *   $ ./src/badgerdb_bench classes
+ * @endcode
+ * Running <code>badgerdb_bench</code> without arguments lists the benchmarks
+ * and their options.
+ *
  * @subsection documentation_sec Rebuilding the documentation
  *
  * Documentation is generated by using Doxygen.  If you have updated the
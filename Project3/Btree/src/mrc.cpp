@@ -0,0 +1,172 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "mrc.h"
+
+namespace badgerdb {
+
+MissRatioCurve::MissRatioCurve(const double rate, const std::uint32_t maxSamples)
+{
+  reset(rate, maxSamples);
+}
+
+void MissRatioCurve::reset(const double rate, const std::uint32_t maxSamples)
+{
+  double clamped = rate < 0 ? 0 : (rate > 1 ? 1 : rate);
+  threshold = static_cast<std::uint32_t>(clamped * HASH_MODULUS);
+  this->maxSamples = maxSamples;
+  clear();
+}
+
+void MissRatioCurve::clear()
+{
+  samples.clear();
+  byHash = std::priority_queue<std::pair<std::uint32_t, PageKey> >();
+  lastRefs.assign(1025, 0);
+  clock = 0;
+  histogram.clear();
+  coldWeight = 0;
+  sampledWeight = 0;
+  references = 0;
+}
+
+std::uint64_t MissRatioCurve::hash(const File* file, const PageId pageNo)
+{
+  // splitmix64 finalizer, so that sampling does not favour any range of pages
+  std::uint64_t x = reinterpret_cast<std::uintptr_t>(file) ^ (static_cast<std::uint64_t>(pageNo) << 32 | pageNo);
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+void MissRatioCurve::addRef(std::uint32_t time, int delta)
+{
+  for (; time < lastRefs.size(); time += time & -time)
+  	lastRefs[time] += delta;
+}
+
+int MissRatioCurve::countRefs(std::uint32_t time) const
+{
+  int count = 0;
+  for (; time > 0; time -= time & -time)
+  	count += lastRefs[time];
+  return count;
+}
+
+void MissRatioCurve::compact()
+{
+  std::vector<std::pair<std::uint32_t, Sample*> > order;
+  order.reserve(samples.size());
+  for (std::unordered_map<PageKey, Sample, PageKeyHash>::iterator it = samples.begin(); it != samples.end(); ++it)
+  	order.push_back(std::make_pair(it->second.time, &it->second));
+  std::sort(order.begin(), order.end());
+
+  // leave as much room again for the references to come
+  std::size_t size = std::max<std::size_t>(2 * order.size(), 1024) + 1;
+  lastRefs.assign(size, 0);
+  for (std::size_t i = 0; i < order.size(); i++)
+  {
+  	order[i].second->time = i + 1;
+  	addRef(i + 1, 1);
+  }
+  clock = order.size();
+}
+
+void MissRatioCurve::shrinkSample()
+{
+  double oldRate = rate();
+
+  while (samples.size() > maxSamples)
+  {
+  	// drop every page sharing the highest hash, which becomes the new threshold
+  	threshold = byHash.top().first;
+  	while (!byHash.empty() && byHash.top().first >= threshold)
+  	{
+  		std::unordered_map<PageKey, Sample, PageKeyHash>::iterator it = samples.find(byHash.top().second);
+  		addRef(it->second.time, -1);
+  		samples.erase(it);
+  		byHash.pop();
+  	}
+  }
+
+  // weights so far were sampled at the old rate
+  double scale = rate() / oldRate;
+  for (std::map<std::uint32_t, double>::iterator it = histogram.begin(); it != histogram.end(); ++it)
+  	it->second *= scale;
+  coldWeight *= scale;
+  sampledWeight *= scale;
+}
+
+void MissRatioCurve::access(const File* file, const PageId pageNo)
+{
+  references++;
+
+  std::uint64_t h = hash(file, pageNo);
+  std::uint32_t hashValue = static_cast<std::uint32_t>(h % HASH_MODULUS);
+  if (hashValue >= threshold)
+  	return;
+
+  if (clock + 1 >= lastRefs.size())
+  	compact();
+  std::uint32_t now = ++clock;
+  sampledWeight++;
+
+  PageKey key(file, pageNo);
+  std::unordered_map<PageKey, Sample, PageKeyHash>::iterator it = samples.find(key);
+  if (it != samples.end())
+  {
+  	// distinct sampled pages referenced since, scaled up to all pages
+  	Sample& sample = it->second;
+  	int distance = countRefs(now - 1) - countRefs(sample.time);
+  	histogram[static_cast<std::uint32_t>(distance / rate())]++;
+
+  	addRef(sample.time, -1);
+  	sample.time = now;
+  	addRef(now, 1);
+  	return;
+  }
+
+  coldWeight++;
+  Sample sample;
+  sample.time = now;
+  samples[key] = sample;
+  byHash.push(std::make_pair(hashValue, key));
+  addRef(now, 1);
+
+  if (maxSamples > 0 && samples.size() > maxSamples)
+  	shrinkSample();
+}
+
+double MissRatioCurve::hitRatio(const std::uint32_t bufs) const
+{
+  double expected = references * rate();
+  if (expected <= 0)
+  	return 0;
+
+  // a pool of bufs frames, replacing the least recently used page, hits every reuse closer than bufs pages
+  double hits = 0;
+  std::map<std::uint32_t, double>::const_iterator end = histogram.lower_bound(bufs);
+  for (std::map<std::uint32_t, double>::const_iterator it = histogram.begin(); it != end; ++it)
+  	hits += it->second;
+
+  // references sampled more or less often than the rate predicts are taken as the shortest reuses
+  if (bufs > 0)
+  	hits += expected - sampledWeight;
+
+  double ratio = hits / expected;
+  return ratio < 0 ? 0 : (ratio > 1 ? 1 : ratio);
+}
+
+std::uint64_t MissRatioCurve::workingSet() const
+{
+  if (threshold == 0)
+  	return 0;
+  return static_cast<std::uint64_t>(coldWeight / rate());
+}
+
+}
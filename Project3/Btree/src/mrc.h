@@ -0,0 +1,218 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+* @brief Online estimate of the hit ratio an LRU buffer pool of any size would have had on the pages
+* referenced so far, from which the pool can be sized for a workload.
+*
+* Follows SHARDS (Waldspurger et al., FAST '15): only pages whose hash falls below a threshold are
+* tracked, and the reuse distance of each reference to such a page, the number of distinct sampled pages
+* referenced since its previous reference, is scaled up by the sampling rate into a histogram. When
+* more than the allowed number of pages are tracked, the threshold is lowered to drop the pages with the
+* highest hash, so memory stays bounded whatever the size of the data.
+*
+* @warning This class is not threadsafe.
+*/
+class MissRatioCurve
+{
+ private:
+	/**
+	 * A page, by file and page number
+	 */
+  typedef std::pair<const File*, PageId> PageKey;
+
+	/**
+	 * Hash function of PageKey for the tracked page table
+	 */
+  struct PageKeyHash
+  {
+  	std::size_t operator()(const PageKey& key) const
+  	{
+  		return static_cast<std::size_t>(MissRatioCurve::hash(key.first, key.second));
+  	}
+  };
+
+	/**
+	 * Tracked page
+	 */
+  struct Sample
+  {
+		/**
+		 * Time of the last reference to the page
+		 */
+  	std::uint32_t time;
+  };
+
+	/**
+	 * Modulus of the sampling hash
+	 */
+  static const std::uint32_t HASH_MODULUS = 1 << 24;
+
+	/**
+	 * Pages with a sampling hash below the threshold are sampled
+	 */
+  std::uint32_t threshold;
+
+	/**
+	 * Most pages tracked at once; 0 for no limit
+	 */
+  std::uint32_t maxSamples;
+
+	/**
+	 * Tracked pages
+	 */
+  std::unordered_map<PageKey, Sample, PageKeyHash> samples;
+
+	/**
+	 * Tracked pages by sampling hash, highest first, for lowering the threshold
+	 */
+  std::priority_queue<std::pair<std::uint32_t, PageKey> > byHash;
+
+	/**
+	 * Fenwick tree over times, counting the tracked pages whose last reference was at each time
+	 */
+  std::vector<int> lastRefs;
+
+	/**
+	 * Time of the latest sampled reference
+	 */
+  std::uint32_t clock;
+
+	/**
+	 * Weight of the references at each scaled reuse distance, in frames
+	 */
+  std::map<std::uint32_t, double> histogram;
+
+	/**
+	 * Weight of the references to pages not referenced before
+	 */
+  double coldWeight;
+
+	/**
+	 * Weight of all sampled references
+	 */
+  double sampledWeight;
+
+	/**
+	 * Number of references, sampled or not
+	 */
+  std::uint64_t references;
+
+	/**
+	 * 64 bit hash of a page, used both for sampling and the page table.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  static std::uint64_t hash(const File* file, const PageId pageNo);
+
+	/**
+	 * Add to the count of the Fenwick tree at a time.
+	 *
+	 * @param time   	Time
+	 * @param delta  	Amount added
+	 */
+  void addRef(std::uint32_t time, int delta);
+
+	/**
+	 * Number of tracked pages last referenced at or before a time.
+	 *
+	 * @param time   	Time
+	 */
+  int countRefs(std::uint32_t time) const;
+
+	/**
+	 * Renumber the times of the tracked pages from 1 once the clock reaches the end of the Fenwick tree.
+	 */
+  void compact();
+
+	/**
+	 * Lower the threshold until no more than maxSamples pages are tracked, rescaling the weights
+	 * recorded so far to the new sampling rate.
+	 */
+  void shrinkSample();
+
+ public:
+	/**
+   * Constructor of MissRatioCurve class
+	 *
+	 * @param rate   	Fraction of the pages sampled; 0 disables the estimate
+	 * @param maxSamples	Most pages tracked at once; 0 for no limit
+	 */
+  MissRatioCurve(const double rate = 0, const std::uint32_t maxSamples = 0);
+
+	/**
+	 * Restart the estimate with a new sampling rate and limit.
+	 *
+	 * @param rate   	Fraction of the pages sampled; 0 disables the estimate
+	 * @param maxSamples	Most pages tracked at once; 0 for no limit
+	 */
+  void reset(const double rate, const std::uint32_t maxSamples);
+
+	/**
+	 * Forget every reference recorded so far, keeping the sampling rate and limit.
+	 */
+  void clear();
+
+	/**
+	 * Record a reference to a page.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  void access(const File* file, const PageId pageNo);
+
+	/**
+	 * Estimated hit ratio of an LRU buffer pool of the given size over the references recorded.
+	 *
+	 * @param bufs   	Number of frames
+	 * @return  			Fraction of references that would have been hits, or 0 if none were recorded
+	 */
+  double hitRatio(const std::uint32_t bufs) const;
+
+	/**
+	 * Estimated number of distinct pages referenced, the pool size beyond which no more hits are gained.
+	 */
+  std::uint64_t workingSet() const;
+
+	/**
+	 * Current sampling rate; lower than the initial rate once the sample has been shrunk
+	 */
+  double rate() const
+  {
+		return (double) threshold / HASH_MODULUS;
+  }
+
+	/**
+	 * Number of pages tracked
+	 */
+  std::uint32_t trackedPages() const
+  {
+		return samples.size();
+  }
+
+	/**
+	 * True if references are being recorded
+	 */
+  bool enabled() const
+  {
+		return threshold > 0;
+  }
+};
+
+}
@@ -59,7 +59,17 @@ struct PageHeader {
   PageId next_page_number;
 
   /**
-   * Returns true if this page header is equal to the other.
+   * LSN of the last logged change to the page, 0 if it was never changed
+   * through the write-ahead log.  Files written before the header held it
+   * are upgraded when opened as a PageFile.
+   */
+  Lsn lsn;
+
+  /**
+   * Returns true if this page header is equal to the other.  The LSN is left
+   * out: it tells how far the write-ahead log had reached when the page was
+   * last changed, not what the page holds, so a page logged and one changed
+   * directly compare equal if their contents do.
    *
    * @param rhs   Other page header to compare against.
    * @return  True if the other header is equal to this one.
@@ -200,6 +210,13 @@ class Page {
    */
   PageId next_page_number() const { return header_.next_page_number; }
 
+  /**
+   * Returns the LSN of the last logged change to this page.
+   *
+   * @return  LSN, or 0 if the page was never changed through the log.
+   */
+  Lsn lsn() const { return header_.lsn; }
+
   /**
    * Returns an iterator at the first record in the page.
    *
@@ -239,6 +256,15 @@ class Page {
     header_.next_page_number = new_next_page_number;
   }
 
+  /**
+   * Sets the LSN of the last logged change to this page.
+   *
+   * @param new_lsn   LSN of the change.
+   */
+  void set_lsn(const Lsn new_lsn) {
+    header_.lsn = new_lsn;
+  }
+
   /**
    * Deletes the record with the given ID.  Page is compacted upon delete to
    * ensure that data of all records is contiguous.  Slot array is compacted if
@@ -337,11 +363,14 @@ class Page {
   friend class PageFile;
   friend class BlobFile;
   friend class PageIterator;
+  friend class LogManager;
 };
 
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page must be laid out as on disk to be read and written whole.");
 
 }
@@ -0,0 +1,558 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "shared_buffer.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/shared_pool_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+const std::uint64_t SHARED_POOL_MAGIC = 0x4c4f4f5042474442ULL;
+
+/**
+ * Offsets of the parts of a segment, the pages starting on a page boundary.
+ */
+struct SegmentLayout
+{
+  std::size_t frames;
+  std::size_t buckets;
+  std::size_t files;
+  std::size_t pages;
+  std::size_t size;
+
+  SegmentLayout(std::uint32_t numBufs, std::uint32_t hashSize)
+  {
+  	frames = (sizeof(SharedPoolHeader) + 63) / 64 * 64;
+  	buckets = frames + numBufs * sizeof(SharedFrame);
+  	files = (buckets + hashSize * sizeof(std::int32_t) + 63) / 64 * 64;
+  	pages = (files + SharedBufMgr::MAX_FILES * sizeof(SharedFileEntry) + File::DIRECT_IO_ALIGNMENT - 1) /
+  	        File::DIRECT_IO_ALIGNMENT * File::DIRECT_IO_ALIGNMENT;
+  	size = pages + (std::size_t) numBufs * sizeof(Page);
+  }
+};
+
+}
+
+SharedBufMgr::SharedBufMgr(const std::string& name, std::uint32_t bufs)
+	: BufMgr(1), segmentName(name), segment(MAP_FAILED), segmentSize(0)
+{
+  std::uint32_t hashSize = ((bufs * 6 / 5) | 1);
+
+  bool created = true;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST)
+  {
+  	created = false;
+  	fd = shm_open(name.c_str(), O_RDWR, 0600);
+  }
+  if (fd < 0)
+  	throw SharedPoolException(name, strerror(errno));
+
+  if (created)
+  {
+  	SegmentLayout layout(bufs, hashSize);
+  	segmentSize = layout.size;
+  	if (ftruncate(fd, segmentSize) != 0)
+  	{
+  		int error = errno;
+  		close(fd);
+  		shm_unlink(name.c_str());
+  		throw SharedPoolException(name, strerror(error));
+  	}
+  }
+  else
+  {
+  	// the creator sizes the segment before initializing it
+  	struct stat st;
+  	for (int tries = 0; fstat(fd, &st) == 0 && st.st_size == 0 && tries < 5000; tries++)
+  		usleep(1000);
+  	segmentSize = st.st_size;
+  }
+
+  segment = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segmentSize == 0 || segment == MAP_FAILED)
+  	throw SharedPoolException(name, "cannot map segment");
+
+  header = static_cast<SharedPoolHeader*>(segment);
+  if (created)
+  {
+  	SegmentLayout layout(bufs, hashSize);
+  	header->numBufs = bufs;
+  	header->hashSize = hashSize;
+  	header->numFiles = 0;
+  	header->clockHand = 0;
+  	header->attached = 0;
+  	header->stats.clear();
+
+  	pthread_mutexattr_t attr;
+  	pthread_mutexattr_init(&attr);
+  	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  	pthread_mutex_init(&header->latch, &attr);
+  	pthread_mutexattr_destroy(&attr);
+
+  	char* base = static_cast<char*>(segment);
+  	SharedFrame* frameTable = reinterpret_cast<SharedFrame*>(base + layout.frames);
+  	for (std::uint32_t i = 0; i < bufs; i++)
+  	{
+  		frameTable[i].fileSlot = -1;
+  		frameTable[i].pageNo = Page::INVALID_NUMBER;
+  		frameTable[i].pinCnt = 0;
+  		frameTable[i].next = -1;
+  		frameTable[i].valid = frameTable[i].refbit = frameTable[i].dirty = false;
+  	}
+  	std::int32_t* bucketTable = reinterpret_cast<std::int32_t*>(base + layout.buckets);
+  	for (std::uint32_t i = 0; i < hashSize; i++)
+  		bucketTable[i] = -1;
+  	Page* pageArray = reinterpret_cast<Page*>(base + layout.pages);
+  	for (std::uint32_t i = 0; i < bufs; i++)
+  		new (&pageArray[i]) Page();
+
+  	__atomic_store_n(&header->magic, SHARED_POOL_MAGIC, __ATOMIC_RELEASE);
+  }
+  else
+  {
+  	int tries = 0;
+  	while (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_POOL_MAGIC && tries++ < 5000)
+  		usleep(1000);
+  	if (header->magic != SHARED_POOL_MAGIC)
+  	{
+  		munmap(segment, segmentSize);
+  		throw SharedPoolException(name, "segment was never initialized");
+  	}
+  }
+
+  SegmentLayout layout(header->numBufs, header->hashSize);
+  char* base = static_cast<char*>(segment);
+  sharedFrames = reinterpret_cast<SharedFrame*>(base + layout.frames);
+  buckets = reinterpret_cast<std::int32_t*>(base + layout.buckets);
+  files = reinterpret_cast<SharedFileEntry*>(base + layout.files);
+  pages = reinterpret_cast<Page*>(base + layout.pages);
+
+  lockPool();
+  header->attached++;
+  unlockPool();
+}
+
+SharedBufMgr::~SharedBufMgr()
+{
+  lockPool();
+  bool last = --header->attached == 0;
+  if (last)
+  {
+  	for (FrameId i = 0; i < header->numBufs; i++)
+  	{
+  		try
+  		{
+  			writeBack(i);
+  		}
+  		catch (BadgerDbException e)
+  		{
+  		}
+  	}
+  }
+  while (!fileSlots.empty())
+  	releaseSlot(fileSlots.begin()->first);
+  unlockPool();
+
+  for (std::map<std::int32_t, std::pair<std::uint32_t, File*> >::iterator it = writers.begin();
+  	   it != writers.end(); ++it)
+  	delete it->second.second;
+  munmap(segment, segmentSize);
+}
+
+void SharedBufMgr::unlink(const std::string& name)
+{
+  shm_unlink(name.c_str());
+}
+
+void SharedBufMgr::lockPool()
+{
+  // a holder that died leaves the latch to the next process, which takes over the pool as it is
+  if (pthread_mutex_lock(&header->latch) == EOWNERDEAD)
+  	pthread_mutex_consistent(&header->latch);
+}
+
+void SharedBufMgr::unlockPool()
+{
+  pthread_mutex_unlock(&header->latch);
+}
+
+std::int32_t SharedBufMgr::fileSlot(const File* file, const bool add)
+{
+  std::map<std::string, std::int32_t>::iterator known = fileSlots.find(file->filename());
+  if (known != fileSlots.end())
+  	return known->second;
+
+  struct stat st;
+  if (fstat(file->descriptor(), &st) != 0)
+  	throw FileNotFoundException(file->filename());
+
+  std::int32_t slot = -1;
+  for (std::uint32_t i = 0; i < header->numFiles && slot < 0; i++)
+  	if (files[i].dev == st.st_dev && files[i].ino == st.st_ino)
+  		slot = i;
+
+  // a slot left by a file that was flushed and removed may match the inode of a new file, and is taken
+  // over as a free one
+  if (slot < 0 || !slotInUse(slot))
+  {
+  	if (!add)
+  		return -1;
+  	for (std::uint32_t i = 0; i < header->numFiles && slot < 0; i++)
+  		if (!slotInUse(i))
+  			slot = i;
+  	if (slot < 0 && header->numFiles == MAX_FILES)
+  		throw SharedPoolException(segmentName, "too many files");
+
+  	char path[PATH_MAX];
+  	if (realpath(file->filename().c_str(), path) == NULL || strlen(path) >= sizeof(files[0].path))
+  		throw SharedPoolException(segmentName, "cannot record path of " + file->filename());
+
+  	if (slot < 0)
+  	{
+  		slot = header->numFiles++;
+  		files[slot].generation = 0;
+  	}
+  	files[slot].dev = st.st_dev;
+  	files[slot].ino = st.st_ino;
+  	files[slot].pageFile = dynamic_cast<const PageFile*>(file) != NULL;
+  	files[slot].users = 0;
+  	files[slot].generation++;
+  	strcpy(files[slot].path, path);
+  }
+
+  files[slot].users++;
+  fileSlots[file->filename()] = slot;
+  return slot;
+}
+
+void SharedBufMgr::releaseSlot(const std::string& filename)
+{
+  std::map<std::string, std::int32_t>::iterator known = fileSlots.find(filename);
+  if (known == fileSlots.end())
+  	return;
+  files[known->second].users--;
+  fileSlots.erase(known);
+}
+
+bool SharedBufMgr::slotInUse(const std::int32_t slot) const
+{
+  if (files[slot].users > 0)
+  	return true;
+  for (FrameId i = 0; i < header->numBufs; i++)
+  	if (sharedFrames[i].valid && sharedFrames[i].fileSlot == slot)
+  		return true;
+  return false;
+}
+
+File* SharedBufMgr::writer(const std::int32_t slot)
+{
+  std::map<std::int32_t, std::pair<std::uint32_t, File*> >::iterator it = writers.find(slot);
+  if (it != writers.end())
+  {
+  	if (it->second.first == files[slot].generation)
+  		return it->second.second;
+  	// opened for a file that has since left the slot
+  	delete it->second.second;
+  	writers.erase(it);
+  }
+
+  File* file;
+  if (files[slot].pageFile)
+  	file = new PageFile(files[slot].path, false);
+  else
+  	file = new BlobFile(files[slot].path, false);
+  writers[slot] = std::make_pair(files[slot].generation, file);
+  return file;
+}
+
+std::uint32_t SharedBufMgr::hash(const std::int32_t slot, const PageId pageNo) const
+{
+  return (static_cast<std::uint32_t>(slot) * 2654435761u + pageNo) % header->hashSize;
+}
+
+std::int32_t SharedBufMgr::lookup(const std::int32_t slot, const PageId pageNo) const
+{
+  for (std::int32_t f = buckets[hash(slot, pageNo)]; f >= 0; f = sharedFrames[f].next)
+  	if (sharedFrames[f].fileSlot == slot && sharedFrames[f].pageNo == pageNo)
+  		return f;
+  return -1;
+}
+
+void SharedBufMgr::insert(const std::int32_t slot, const PageId pageNo, const FrameId frameNo)
+{
+  SharedFrame& frame = sharedFrames[frameNo];
+  frame.fileSlot = slot;
+  frame.pageNo = pageNo;
+  frame.pinCnt = 1;
+  frame.valid = true;
+  frame.refbit = true;
+  frame.dirty = false;
+
+  std::uint32_t bucket = hash(slot, pageNo);
+  frame.next = buckets[bucket];
+  buckets[bucket] = frameNo;
+}
+
+void SharedBufMgr::remove(const FrameId frameNo)
+{
+  SharedFrame& frame = sharedFrames[frameNo];
+  std::int32_t* link = &buckets[hash(frame.fileSlot, frame.pageNo)];
+  while (*link != static_cast<std::int32_t>(frameNo))
+  	link = &sharedFrames[*link].next;
+  *link = frame.next;
+
+  frame.fileSlot = -1;
+  frame.pageNo = Page::INVALID_NUMBER;
+  frame.pinCnt = 0;
+  frame.next = -1;
+  frame.valid = frame.refbit = frame.dirty = false;
+}
+
+void SharedBufMgr::writeBack(const FrameId frameNo)
+{
+  SharedFrame& frame = sharedFrames[frameNo];
+  if (!frame.valid || !frame.dirty)
+  	return;
+
+  header->stats.diskwrites++;
+  bufStats.diskwrites++;
+  frame.dirty = false;
+  writer(frame.fileSlot)->writePage(frame.pageNo, pages[frameNo]);
+}
+
+FrameId SharedBufMgr::allocFrame()
+{
+  for (std::uint32_t scanned = 0; scanned < 2 * header->numBufs; scanned++)
+  {
+  	FrameId frameNo = header->clockHand;
+  	header->clockHand = (header->clockHand + 1) % header->numBufs;
+
+  	SharedFrame& frame = sharedFrames[frameNo];
+  	if (!frame.valid)
+  		return frameNo;
+  	if (frame.pinCnt > 0)
+  		continue;
+  	if (frame.refbit)
+  	{
+  		frame.refbit = false;
+  		continue;
+  	}
+
+  	try
+  	{
+  		writeBack(frameNo);
+  	}
+  	catch (FileNotFoundException e)
+  	{
+  		// the file was removed, and its pages with it
+  	}
+  	remove(frameNo);
+  	return frameNo;
+  }
+  throw BufferExceededException();
+}
+
+void SharedBufMgr::readPage(File* file, const PageId pageNo, Page*& page, const AccessStrategy strategy,
+                            const PageClass pageClass)
+{
+  lockPool();
+  try
+  {
+  	std::int32_t slot = fileSlot(file, true);
+  	header->stats.accesses++;
+  	bufStats.accesses++;
+
+  	std::int32_t frameNo = lookup(slot, pageNo);
+  	if (frameNo >= 0)
+  	{
+  		sharedFrames[frameNo].refbit = true;
+  		sharedFrames[frameNo].pinCnt++;
+  	}
+  	else
+  	{
+  		frameNo = allocFrame();
+  		pages[frameNo] = file->readPage(pageNo);
+  		header->stats.diskreads++;
+  		bufStats.diskreads++;
+  		insert(slot, pageNo, frameNo);
+  	}
+  	page = &pages[frameNo];
+  }
+  catch (...)
+  {
+  	unlockPool();
+  	throw;
+  }
+  unlockPool();
+}
+
+void SharedBufMgr::readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages,
+                             const PageClass pageClass)
+{
+  pages.assign(pageNos.size(), NULL);
+  std::size_t pinned = 0;
+  try
+  {
+  	for (; pinned < pageNos.size(); pinned++)
+  		readPage(file, pageNos[pinned], pages[pinned], NORMAL, pageClass);
+  }
+  catch (...)
+  {
+  	// leave the pool as it was
+  	while (pinned > 0)
+  	{
+  		pinned--;
+  		unPinPage(file, pageNos[pinned], false);
+  	}
+  	pages.assign(pageNos.size(), NULL);
+  	throw;
+  }
+}
+
+void SharedBufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+  lockPool();
+  std::int32_t slot = fileSlot(file, false);
+  std::int32_t frameNo = slot < 0 ? -1 : lookup(slot, pageNo);
+  if (frameNo < 0 || sharedFrames[frameNo].pinCnt == 0)
+  {
+  	unlockPool();
+  	if (frameNo < 0)
+  		throw HashNotFoundException(file->filename(), pageNo);
+  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+  }
+
+  if (dirty)
+  	sharedFrames[frameNo].dirty = true;
+  sharedFrames[frameNo].pinCnt--;
+  unlockPool();
+}
+
+void SharedBufMgr::allocPage(File* file, PageId& pageNo, Page*& page, const AccessStrategy strategy,
+                             const PageClass pageClass)
+{
+  lockPool();
+  try
+  {
+  	std::int32_t slot = fileSlot(file, true);
+  	FrameId frameNo = allocFrame();
+  	pages[frameNo] = file->allocatePage(pageNo);
+  	header->stats.diskreads++;
+  	bufStats.diskreads++;
+  	insert(slot, pageNo, frameNo);
+  	page = &pages[frameNo];
+  }
+  catch (...)
+  {
+  	unlockPool();
+  	throw;
+  }
+  unlockPool();
+}
+
+void SharedBufMgr::flushFile(const File* file)
+{
+  lockPool();
+  try
+  {
+  	std::int32_t slot = fileSlot(file, false);
+  	for (FrameId i = 0; slot >= 0 && i < header->numBufs; i++)
+  	{
+  		if (!sharedFrames[i].valid || sharedFrames[i].fileSlot != slot)
+  			continue;
+  		if (sharedFrames[i].pinCnt > 0)
+  			throw PagePinnedException(file->filename(), sharedFrames[i].pageNo, i);
+  		writeBack(i);
+  		remove(i);
+  	}
+  	// the file may be removed and its name reused once flushed, and its slot given to another file once
+  	// no process uses it
+  	releaseSlot(file->filename());
+  }
+  catch (...)
+  {
+  	unlockPool();
+  	throw;
+  }
+  unlockPool();
+}
+
+void SharedBufMgr::disposePage(File* file, const PageId pageNo)
+{
+  lockPool();
+  try
+  {
+  	std::int32_t slot = fileSlot(file, false);
+  	std::int32_t frameNo = slot < 0 ? -1 : lookup(slot, pageNo);
+  	if (frameNo >= 0)
+  		remove(frameNo);
+  	file->deletePage(pageNo);
+  }
+  catch (...)
+  {
+  	unlockPool();
+  	throw;
+  }
+  unlockPool();
+}
+
+void SharedBufMgr::writePages(File* file, const std::vector<PageId>& pageNos)
+{
+  lockPool();
+  try
+  {
+  	std::int32_t slot = fileSlot(file, false);
+  	for (std::size_t i = 0; slot >= 0 && i < pageNos.size(); i++)
+  	{
+  		std::int32_t frameNo = lookup(slot, pageNos[i]);
+  		if (frameNo >= 0)
+  			writeBack(frameNo);
+  	}
+  }
+  catch (...)
+  {
+  	unlockPool();
+  	throw;
+  }
+  unlockPool();
+}
+
+int SharedBufMgr::attachedProcesses()
+{
+  lockPool();
+  int attached = header->attached;
+  unlockPool();
+  return attached;
+}
+
+BufStats SharedBufMgr::getSharedStats()
+{
+  lockPool();
+  BufStats stats = header->stats;
+  unlockPool();
+  return stats;
+}
+
+}
@@ -0,0 +1,273 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <map>
+#include <string>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Frame of a shared buffer pool, kept in the shared-memory segment.
+*/
+struct SharedFrame
+{
+	/**
+   * Slot of the file of the page in the segment's file table, or -1 if the frame is free
+	 */
+  std::int32_t fileSlot;
+
+	/**
+   * Page within file
+	 */
+  PageId pageNo;
+
+	/**
+   * Pins held by all processes attached to the pool
+	 */
+  std::int32_t pinCnt;
+
+	/**
+   * Next frame in the same bucket of the page table, or -1
+	 */
+  std::int32_t next;
+
+	/**
+   * True if the frame holds a page, the page was referenced since the clock last passed, or the page
+   * has changed since it was read
+	 */
+  bool valid;
+  bool refbit;
+  bool dirty;
+};
+
+/**
+* @brief File known to a shared buffer pool. Files are identified by device and inode, so that processes
+* may open them under different names.
+*/
+struct SharedFileEntry
+{
+  dev_t dev;
+  ino_t ino;
+
+	/**
+   * True if the file is a PageFile, whose pages are written back as PageFile::writePage() does
+	 */
+  bool pageFile;
+
+	/**
+   * Entries in the file slot maps of the attached processes. A slot with no users and no valid frame
+   * is free, and is given to the next file added
+	 */
+  std::int32_t users;
+
+	/**
+   * Bumped each time the slot is given to a file, so that processes drop the writers they opened for
+   * the file that held it before
+	 */
+  std::uint32_t generation;
+
+	/**
+   * Absolute path, through which any attached process can open the file to write back its pages
+	 */
+  char path[256];
+};
+
+/**
+* @brief Start of the shared-memory segment of a shared buffer pool.
+*/
+struct SharedPoolHeader
+{
+	/**
+   * Set once the creating process has initialized the segment
+	 */
+  std::uint64_t magic;
+
+	/**
+   * Latch protecting the whole segment, shared between processes and recovered if its holder dies
+	 */
+  pthread_mutex_t latch;
+
+  std::uint32_t numBufs;
+  std::uint32_t hashSize;
+  std::uint32_t numFiles;
+  std::uint32_t clockHand;
+
+	/**
+   * Number of processes attached
+	 */
+  std::int32_t attached;
+
+	/**
+   * Usage statistics of all processes together
+	 */
+  BufStats stats;
+};
+
+/**
+* @brief Buffer pool whose frames, frame table and page table live in a named POSIX shared-memory
+* segment, so that processes on one host working on the same files share one pool: a page read by one is
+* a hit for the others, and a change by one is seen by the others without going through the disk.
+*
+* Takes the place of a BufMgr for readPage(), readPages(), unPinPage(), allocPage(), flushFile(),
+* disposePage() and writePages(); access strategies and page classes are ignored, and the pool has a fixed size. The
+* rest of the BufMgr interface acts on a private pool of one frame and is of no use here. Pages are read
+* and written under the segment latch. The files' own metadata is not shared, so pages of a file may
+* only be allocated and disposed of by one process at a time.
+*
+* The pool stays usable if a process dies holding the latch, but pins it held are never released.
+*/
+class SharedBufMgr : public BufMgr
+{
+ private:
+	/**
+   * Name of the segment
+	 */
+  std::string segmentName;
+
+	/**
+   * Mapping of the segment
+	 */
+  void* segment;
+  std::size_t segmentSize;
+
+	/**
+   * Parts of the segment
+	 */
+  SharedPoolHeader* header;
+  SharedFrame* sharedFrames;
+  std::int32_t* buckets;
+  SharedFileEntry* files;
+  Page* pages;
+
+	/**
+   * Slots of the files this process has used, by file name
+	 */
+  std::map<std::string, std::int32_t> fileSlots;
+
+	/**
+   * Files this process opened to write back pages, by slot, with the generation of the slot they were
+   * opened for
+	 */
+  std::map<std::int32_t, std::pair<std::uint32_t, File*> > writers;
+
+	/**
+	 * Slot of a file in the segment's file table, added if not yet known. Called with the latch held.
+	 *
+	 * @param file   	File object
+	 * @param add    	False to return -1 rather than add an unknown file
+	 */
+  std::int32_t fileSlot(const File* file, const bool add);
+
+	/**
+	 * Drop a file name from this process's slot map. Called with the latch held.
+	 */
+  void releaseSlot(const std::string& filename);
+
+	/**
+	 * True if a slot has users or holds a page. Called with the latch held.
+	 */
+  bool slotInUse(const std::int32_t slot) const;
+
+	/**
+	 * File through which this process writes back pages of a slot, opened on first use.
+	 */
+  File* writer(const std::int32_t slot);
+
+  std::uint32_t hash(const std::int32_t slot, const PageId pageNo) const;
+
+	/**
+	 * Frame holding a page, or -1.
+	 */
+  std::int32_t lookup(const std::int32_t slot, const PageId pageNo) const;
+
+  void insert(const std::int32_t slot, const PageId pageNo, const FrameId frameNo);
+  void remove(const FrameId frameNo);
+
+	/**
+	 * Find a frame with the clock, writing back and dropping the page it held.
+	 *
+	 * @throws  BufferExceededException  If every frame is pinned
+	 */
+  FrameId allocFrame();
+
+	/**
+	 * Write back the page held by a frame, if it is dirty.
+	 */
+  void writeBack(const FrameId frameNo);
+
+	/**
+	 * Take the segment latch, recovering it if its holder died.
+	 */
+  void lockPool();
+  void unlockPool();
+
+ public:
+	/**
+   * Most files a shared pool keeps track of at once. The slot of a file is taken by another once the file
+   * was flushed by every process that used it.
+	 */
+  static const std::uint32_t MAX_FILES = 64;
+
+	/**
+   * Constructor of SharedBufMgr class. Creates the segment if it does not exist, and attaches to it
+   * otherwise, in which case the size it was created with is kept.
+	 *
+	 * @param name   	Name of the segment, starting with '/'
+	 * @param bufs   	Number of frames of a new segment
+	 * @throws  SharedPoolException  If the segment cannot be created or attached to
+	 */
+  SharedBufMgr(const std::string& name, std::uint32_t bufs);
+
+	/**
+   * Destructor of SharedBufMgr class. The last process to detach writes back every dirty page. The
+   * segment itself remains until unlink() is called.
+	 */
+  ~SharedBufMgr();
+
+	/**
+	 * Remove a segment. Processes attached keep using it.
+	 *
+	 * @param name   	Name of the segment
+	 */
+  static void unlink(const std::string& name);
+
+  void readPage(File* file, const PageId PageNo, Page*& page, const AccessStrategy strategy = NORMAL,
+                const PageClass pageClass = PAGE_HEAP);
+  void readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages,
+                 const PageClass pageClass = PAGE_HEAP);
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  void allocPage(File* file, PageId &PageNo, Page*& page, const AccessStrategy strategy = NORMAL,
+                 const PageClass pageClass = PAGE_HEAP);
+  void flushFile(const File* file);
+  void disposePage(File* file, const PageId PageNo);
+  void writePages(File* file, const std::vector<PageId>& pageNos);
+
+	/**
+	 * Number of frames of the shared pool
+	 */
+  std::uint32_t numFrames() const
+  {
+		return header->numBufs;
+  }
+
+	/**
+	 * Number of processes attached to the pool
+	 */
+  int attachedProcesses();
+
+	/**
+	 * Usage statistics of all attached processes together; getBufStats() counts this process only
+	 */
+  BufStats getSharedStats();
+};
+
+}
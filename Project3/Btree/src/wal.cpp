@@ -0,0 +1,970 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wal.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/log_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+const std::uint64_t LOG_MAGIC = 0x4c41574244524742ULL;
+
+// changed ranges closer than this are logged as one segment
+const std::size_t SEGMENT_GAP = 16;
+
+// the log file grows by this many bytes of zeros at a time, ahead of the records written into them
+const Lsn LOG_EXTENT = 1 << 20;
+
+std::uint32_t checksum(const char* data, const std::size_t length)
+{
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < length; i++)
+  	hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  return hash;
+}
+
+void put(std::vector<char>& out, const void* data, const std::size_t length)
+{
+  const char* bytes = static_cast<const char*>(data);
+  out.insert(out.end(), bytes, bytes + length);
+}
+
+// Append the ranges where two page images differ, each as a LogSegment followed by its bytes in both.
+std::uint32_t diffPages(const char* before, const char* after, std::vector<char>& out)
+{
+  std::uint32_t segments = 0;
+  std::size_t i = 0;
+  while (i < Page::SIZE)
+  {
+  	// skip equal words, then equal bytes
+  	while (i + 8 <= Page::SIZE && memcmp(before + i, after + i, 8) == 0)
+  		i += 8;
+  	while (i < Page::SIZE && before[i] == after[i])
+  		i++;
+  	if (i == Page::SIZE)
+  		break;
+
+  	std::size_t start = i;
+  	std::size_t last = i;
+  	for (std::size_t j = i + 1; j < Page::SIZE && j - last <= SEGMENT_GAP; j++)
+  		if (before[j] != after[j])
+  			last = j;
+
+  	LogSegment segment = { static_cast<std::uint16_t>(start), static_cast<std::uint16_t>(last + 1 - start) };
+  	put(out, &segment, sizeof(segment));
+  	put(out, before + start, segment.length);
+  	put(out, after + start, segment.length);
+  	segments++;
+  	i = last + 1;
+  }
+  return segments;
+}
+
+bool isChange(const std::uint16_t type)
+{
+  return type >= LOG_INSERT && type <= LOG_CLR;
+}
+
+}
+
+//----------------------------------------
+// Constructor and destructor
+//----------------------------------------
+
+LogManager::LogManager(const std::string& name, BufMgr* bufMgr)
+	: name(name), fd(-1), bufMgr(bufMgr), bufferStart(0), durableEnd(0), fileEnd(0), lastAppended(0),
+	  flushing(false), nextTxn(1), checkpointLsn(0), checkpointBytes(0), pagesPerRound(0), roundMillis(0), stopping(false)
+{
+  fd = open(name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  	throw LogException(name, "cannot be opened");
+
+  struct stat st;
+  fstat(fd, &st);
+  Lsn end = LOG_HEADER_SIZE;
+  if (st.st_size == 0)
+  {
+  	std::uint64_t header[2] = { LOG_MAGIC, 0 };
+  	if (pwrite(fd, header, sizeof(header), 0) != sizeof(header) || fdatasync(fd) != 0)
+  	{
+  		close(fd);
+  		throw LogException(name, "cannot be written");
+  	}
+  }
+  else
+  {
+  	std::uint64_t header[2] = { 0, 0 };
+  	if (pread(fd, header, sizeof(header), 0) != sizeof(header) || header[0] != LOG_MAGIC)
+  	{
+  		close(fd);
+  		throw LogException(name, "is not a write-ahead log");
+  	}
+
+  	// everything before the last checkpoint was on disk before the header pointed to it
+  	LogRecord record;
+  	if (header[1] != 0 && readRecord(header[1], record, st.st_size) &&
+  	    record.header.type == LOG_CHECKPOINT_BEGIN)
+  		end = checkpointLsn = header[1];
+
+  	// the log ends at the first record not written whole
+  	while (readRecord(end, record, st.st_size))
+  	{
+  		if (record.header.txn >= nextTxn)
+  			nextTxn = record.header.txn + 1;
+  		if (record.header.type == LOG_CHECKPOINT_END)
+  		{
+  			LogCheckpointHeader checkpoint;
+  			memcpy(&checkpoint, &record.bytes[sizeof(LogRecordHeader)], sizeof(checkpoint));
+  			nextTxn = std::max(nextTxn, checkpoint.nextTxn);
+  		}
+  		end += record.header.length;
+  	}
+  	// a record a torn flush left whole further on must not be taken for part of the log once the
+  	// records written from here reach it
+  	fileEnd = st.st_size;
+  	if (end < fileEnd && (!writeZeros(end, fileEnd) || fdatasync(fd) != 0))
+  	{
+  		close(fd);
+  		throw LogException(name, "cannot be written");
+  	}
+  }
+
+  bufferStart = durableEnd = end;
+  if (fileEnd < end)
+  	fileEnd = end;
+  bufMgr->setLog(this);
+}
+
+LogManager::~LogManager()
+{
+  stopCheckpointer();
+  bufMgr->setLog(NULL);
+  try
+  {
+  	flush(lastAppended);
+  }
+  catch (LogException e)
+  {
+  }
+  close(fd);
+}
+
+//----------------------------------------
+// Appending and reading records
+//----------------------------------------
+
+Lsn LogManager::append(LogRecordHeader& header, const std::vector<char>& body)
+{
+  header.length = sizeof(LogRecordHeader) + body.size();
+  header.lsn = bufferStart + buffer.size();
+  header.checksum = 0;
+
+  std::size_t at = buffer.size();
+  buffer.resize(at + header.length);
+  memcpy(&buffer[at], &header, sizeof(header));
+  if (!body.empty())
+  	memcpy(&buffer[at + sizeof(header)], &body[0], body.size());
+  header.checksum = checksum(&buffer[at], header.length);
+  memcpy(&buffer[at + offsetof(LogRecordHeader, checksum)], &header.checksum, sizeof(header.checksum));
+
+  logStats.records++;
+  logStats.bytes += header.length;
+  lastAppended = header.lsn;
+  return header.lsn;
+}
+
+Lsn LogManager::appendChange(LogRecordHeader& header, const std::vector<char>& body)
+{
+  Lsn lsn = append(header, body);
+  stamping.insert(lsn);
+  return lsn;
+}
+
+void LogManager::finishStamp(const Lsn lsn)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  stamping.erase(lsn);
+  stamped.notify_all();
+}
+
+bool LogManager::writeZeros(Lsn from, const Lsn to)
+{
+  std::vector<char> zeros(std::min<Lsn>(to - from, LOG_EXTENT), 0);
+  while (from < to)
+  {
+  	std::size_t length = std::min<Lsn>(to - from, zeros.size());
+  	if (pwrite(fd, &zeros[0], length, from) != static_cast<ssize_t>(length))
+  		return false;
+  	from += length;
+  }
+  return true;
+}
+
+bool LogManager::readRecord(const Lsn lsn, LogRecord& record, const Lsn end)
+{
+  if (lsn + sizeof(LogRecordHeader) > end ||
+      pread(fd, &record.header, sizeof(LogRecordHeader), lsn) != sizeof(LogRecordHeader))
+  	return false;
+  if (record.header.lsn != lsn || record.header.length < sizeof(LogRecordHeader) ||
+      lsn + record.header.length > end)
+  	return false;
+
+  record.bytes.resize(record.header.length);
+  if (pread(fd, &record.bytes[0], record.header.length, lsn) != static_cast<ssize_t>(record.header.length))
+  	return false;
+  std::uint32_t stored = record.header.checksum;
+  memset(&record.bytes[offsetof(LogRecordHeader, checksum)], 0, sizeof(stored));
+  return checksum(&record.bytes[0], record.header.length) == stored;
+}
+
+void LogManager::flush(const Lsn lsn)
+{
+  std::unique_lock<std::mutex> guard(latch);
+  while (lsn >= durableEnd)
+  {
+  	if (flushing)
+  	{
+  		flushDone.wait(guard);
+  		continue;
+  	}
+  	if (buffer.empty())
+  		return;
+
+  	// take everything appended so far, including the records of whoever arrived during the last flush
+  	std::vector<char> out;
+  	out.swap(buffer);
+  	Lsn start = bufferStart;
+  	bufferStart += out.size();
+  	flushing = true;
+  	guard.unlock();
+
+  	// a write within the file leaves its size alone, so that the sync has only the records to write;
+  	// the zeros of a new extent go out with the first sync into them
+  	bool ok = true;
+  	if (start + out.size() > fileEnd)
+  	{
+  		Lsn grown = (start + out.size() + LOG_EXTENT - 1) / LOG_EXTENT * LOG_EXTENT;
+  		ok = writeZeros(fileEnd, grown);
+  		if (ok)
+  			fileEnd = grown;
+  	}
+  	ok = ok && pwrite(fd, &out[0], out.size(), start) == static_cast<ssize_t>(out.size()) && fdatasync(fd) == 0;
+
+  	guard.lock();
+  	flushing = false;
+  	flushDone.notify_all();
+  	if (!ok)
+  		throw LogException(name, "cannot be written");
+  	durableEnd = start + out.size();
+  	logStats.flushes++;
+  }
+}
+
+//----------------------------------------
+// Transactions
+//----------------------------------------
+
+TxnId LogManager::begin()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  TxnId txn = nextTxn++;
+  transactions[txn].lastLsn = 0;
+  return txn;
+}
+
+void LogManager::track(const TxnId txn, File* file, const PageId pageNo, Page* page, const bool allocated)
+{
+  Transaction* t;
+  {
+  	// entries stay where they are as others are added, and only this transaction's thread uses this one
+  	std::lock_guard<std::mutex> guard(latch);
+  	t = &transactions.at(txn);
+  }
+
+  for (std::size_t i = 0; i < t->tracked.size(); i++)
+  	if (t->tracked[i].file == file && t->tracked[i].pageNo == pageNo)
+  		return;
+
+  t->tracked.push_back(TrackedPage());
+  TrackedPage& tracked = t->tracked.back();
+  tracked.file = file;
+  tracked.pageNo = pageNo;
+  tracked.page = page;
+  tracked.heap = dynamic_cast<PageFile*>(file) != NULL;
+  tracked.allocated = allocated;
+  tracked.before = *page;
+
+  if (std::find(t->files.begin(), t->files.end(), file) == t->files.end())
+  	t->files.push_back(file);
+}
+
+Lsn LogManager::logChanges(const TxnId txn, const LogRecordType type)
+{
+  Transaction* t;
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	t = &transactions.at(txn);
+  }
+
+  std::vector<char> body;
+  std::vector<bool> changed(t->tracked.size(), false);
+  std::uint16_t pages = 0;
+  for (std::size_t i = 0; i < t->tracked.size(); i++)
+  {
+  	TrackedPage& tracked = t->tracked[i];
+  	const std::string& fileName = tracked.file->filename();
+
+  	std::size_t at = body.size();
+  	LogPageHeader header = { tracked.heap, tracked.allocated, static_cast<std::uint16_t>(fileName.size()),
+  	                         tracked.pageNo, 0 };
+  	put(body, &header, sizeof(header));
+  	put(body, fileName.data(), fileName.size());
+  	header.segments = diffPages(reinterpret_cast<const char*>(&tracked.before),
+  	                            reinterpret_cast<const char*>(tracked.page), body);
+  	if (header.segments == 0 && !tracked.allocated)
+  	{
+  		body.resize(at);
+  		continue;
+  	}
+  	memcpy(&body[at], &header, sizeof(header));
+  	changed[i] = true;
+  	pages++;
+  }
+
+  Lsn lsn = 0;
+  if (pages > 0)
+  {
+  	LogRecordHeader header = { 0, static_cast<std::uint16_t>(type), pages, txn, 0, 0, t->lastLsn, 0 };
+  	{
+  		std::lock_guard<std::mutex> guard(latch);
+  		lsn = appendChange(header, body);
+  		t->lastLsn = lsn;
+  	}
+
+  	for (std::size_t i = 0; i < t->tracked.size(); i++)
+  	{
+  		if (!changed[i])
+  			continue;
+  		if (t->tracked[i].heap)
+  			t->tracked[i].page->set_lsn(lsn);
+  		bufMgr->setPageLsn(t->tracked[i].file, t->tracked[i].pageNo, lsn);
+  	}
+  	finishStamp(lsn);
+  }
+
+  t->tracked.clear();
+  return lsn;
+}
+
+RecordId LogManager::insertRecord(const TxnId txn, File* file, Page* page, const std::string& record_data)
+{
+  track(txn, file, page->page_number(), page);
+  RecordId rid;
+  try
+  {
+  	rid = page->insertRecord(record_data);
+  }
+  catch (...)
+  {
+  	// nothing changed, so this only forgets the page
+  	logChanges(txn, LOG_INSERT);
+  	throw;
+  }
+  logChanges(txn, LOG_INSERT);
+  return rid;
+}
+
+void LogManager::updateRecord(const TxnId txn, File* file, Page* page, const RecordId& record_id,
+                              const std::string& record_data)
+{
+  track(txn, file, page->page_number(), page);
+  try
+  {
+  	page->updateRecord(record_id, record_data);
+  }
+  catch (...)
+  {
+  	logChanges(txn, LOG_UPDATE);
+  	throw;
+  }
+  logChanges(txn, LOG_UPDATE);
+}
+
+void LogManager::deleteRecord(const TxnId txn, File* file, Page* page, const RecordId& record_id)
+{
+  track(txn, file, page->page_number(), page);
+  try
+  {
+  	page->deleteRecord(record_id);
+  }
+  catch (...)
+  {
+  	logChanges(txn, LOG_DELETE);
+  	throw;
+  }
+  logChanges(txn, LOG_DELETE);
+}
+
+void LogManager::commit(const TxnId txn)
+{
+  Lsn lsn;
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	Transaction& t = transactions.at(txn);
+  	assert(t.tracked.empty());
+  	logStats.commits++;
+  	if (t.lastLsn == 0)
+  	{
+  		// nothing to make durable
+  		transactions.erase(txn);
+  		return;
+  	}
+  	LogRecordHeader header = { 0, LOG_COMMIT, 0, txn, 0, 0, t.lastLsn, 0 };
+  	lsn = append(header, std::vector<char>());
+  	transactions.erase(txn);
+  }
+  flush(lsn);
+}
+
+void LogManager::abort(const TxnId txn)
+{
+  Lsn lsn;
+  Lsn* lastLsn;
+  FileSet files;
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	Transaction& t = transactions.at(txn);
+  	assert(t.tracked.empty());
+  	logStats.aborts++;
+  	lsn = t.lastLsn;
+  	if (lsn == 0)
+  	{
+  		transactions.erase(txn);
+  		return;
+  	}
+  	for (std::size_t i = 0; i < t.files.size(); i++)
+  		files.byName[t.files[i]->filename()] = t.files[i];
+
+  	LogRecordHeader header = { 0, LOG_ABORT, 0, txn, 0, 0, lsn, 0 };
+  	t.lastLsn = append(header, std::vector<char>());
+  	// the transaction stays listed until it ends, so that a checkpoint taken meanwhile has it
+  	lastLsn = &t.lastLsn;
+  }
+
+  while (lsn != 0)
+  	lsn = undoRecord(txn, lsn, *lastLsn, files);
+  closeFiles(files);
+
+  std::lock_guard<std::mutex> guard(latch);
+  LogRecordHeader header = { 0, LOG_END, 0, txn, 0, 0, *lastLsn, 0 };
+  append(header, std::vector<char>());
+  transactions.erase(txn);
+}
+
+//----------------------------------------
+// Redo and undo
+//----------------------------------------
+
+void LogManager::parseRecord(const LogRecord& record, std::vector<RecordPage>& pages)
+{
+  const char* p = &record.bytes[0] + sizeof(LogRecordHeader);
+  pages.resize(record.header.pages);
+  for (std::uint16_t i = 0; i < record.header.pages; i++)
+  {
+  	RecordPage& entry = pages[i];
+  	memcpy(&entry.header, p, sizeof(LogPageHeader));
+  	p += sizeof(LogPageHeader);
+  	entry.fileName.assign(p, entry.header.nameLength);
+  	p += entry.header.nameLength;
+  	entry.segments = p;
+  	for (std::uint32_t s = 0; s < entry.header.segments; s++)
+  	{
+  		LogSegment segment;
+  		memcpy(&segment, p, sizeof(segment));
+  		p += sizeof(segment) + 2 * segment.length;
+  	}
+  }
+}
+
+void LogManager::applySegments(const RecordPage& entry, Page* page, const bool after)
+{
+  char* image = reinterpret_cast<char*>(page);
+  const char* p = entry.segments;
+  for (std::uint32_t s = 0; s < entry.header.segments; s++)
+  {
+  	LogSegment segment;
+  	memcpy(&segment, p, sizeof(segment));
+  	p += sizeof(segment);
+  	memcpy(image + segment.offset, after ? p + segment.length : p, segment.length);
+  	p += 2 * segment.length;
+  }
+}
+
+File* LogManager::resolveFile(FileSet& files, const std::string& fileName, const bool heap)
+{
+  std::map<std::string, File*>::iterator it = files.byName.find(fileName);
+  if (it != files.byName.end())
+  	return it->second;
+
+  File* file = NULL;
+  try
+  {
+  	if (heap)
+  		file = new PageFile(fileName, false);
+  	else
+  		file = new BlobFile(fileName, false);
+  	files.opened.push_back(file);
+  }
+  catch (FileNotFoundException e)
+  {
+  	// the file was removed after it was logged to, and its changes with it
+  }
+  files.byName[fileName] = file;
+  return file;
+}
+
+void LogManager::closeFiles(FileSet& files)
+{
+  for (std::size_t i = 0; i < files.opened.size(); i++)
+  {
+  	bufMgr->flushFile(files.opened[i]);
+  	delete files.opened[i];
+  }
+  files.opened.clear();
+  files.byName.clear();
+}
+
+void LogManager::restorePage(File* file, const PageId pageNo)
+{
+  while (file->getPageCount() <= pageNo)
+  {
+  	PageId allocated;
+  	file->allocatePage(allocated);
+  }
+
+  // the header may have reached the disk without the page it counts; pages of a PageFile have their
+  // own header, which only the file writes
+  struct stat st;
+  if (dynamic_cast<BlobFile*>(file) != NULL && !file->isCompressed() && fstat(file->descriptor(), &st) == 0 &&
+      static_cast<std::uint64_t>(st.st_size) < file->pageOffset(pageNo) + Page::SIZE)
+  	file->writePage(pageNo, Page());
+}
+
+void LogManager::pinPages(const std::vector<RecordPage>& entries, FileSet& files, std::vector<Page*>& pages,
+                          std::vector<File*>& pageFiles)
+{
+  pages.assign(entries.size(), NULL);
+  pageFiles.assign(entries.size(), NULL);
+  for (std::size_t i = 0; i < entries.size(); i++)
+  {
+  	File* file = resolveFile(files, entries[i].fileName, entries[i].header.heap != 0);
+  	if (file == NULL)
+  		continue;
+
+  	// a file grows without a sync, so a page allocated before the crash may be gone from it; the record
+  	// allocating it has its bytes as changed from the blank page the allocation wrote, so it is rebuilt
+  	// on a blank page allocated again
+  	PageId pageNo = entries[i].header.pageNo;
+  	std::string missing;
+  	if (entries[i].header.allocated)
+  		restorePage(file, pageNo);
+  	else if (pageNo >= file->getPageCount())
+  		missing = "missing from ";
+  	if (missing.empty())
+  	{
+  		try
+  		{
+  			bufMgr->readPage(file, pageNo, pages[i]);
+  			pageFiles[i] = file;
+  			continue;
+  		}
+  		catch (InvalidPageException e)
+  		{
+  			missing = "deleted from ";
+  		}
+  	}
+
+  	for (std::size_t j = 0; j < i; j++)
+  		if (pages[j] != NULL)
+  			bufMgr->unPinPage(pageFiles[j], entries[j].header.pageNo, false);
+  	throw LogException(name, "has a change to page " + std::to_string(pageNo) + " " + missing +
+  	                   entries[i].fileName);
+  }
+}
+
+void LogManager::readCheckpoint(const LogRecord& record, std::map<TxnId, Lsn>& losers, DirtyPageTable& dirty)
+{
+  const char* p = &record.bytes[0] + sizeof(LogRecordHeader);
+  LogCheckpointHeader header;
+  memcpy(&header, p, sizeof(header));
+  p += sizeof(header);
+
+  // records written since the checkpoint started have been seen already, and may be later
+  for (std::uint32_t i = 0; i < header.transactions; i++)
+  {
+  	LogCheckpointTxn entry;
+  	memcpy(&entry, p, sizeof(entry));
+  	p += sizeof(entry);
+  	Lsn& lastLsn = losers[entry.txn];
+  	lastLsn = std::max(lastLsn, entry.lastLsn);
+  }
+  for (std::uint32_t i = 0; i < header.pages; i++)
+  {
+  	LogCheckpointPage entry;
+  	memcpy(&entry, p, sizeof(entry));
+  	p += sizeof(entry);
+  	std::pair<std::string, PageId> key(std::string(p, entry.nameLength), entry.pageNo);
+  	p += entry.nameLength;
+  	std::pair<DirtyPageTable::iterator, bool> added = dirty.insert(std::make_pair(key, entry.recLsn));
+  	if (!added.second)
+  		added.first->second = std::min(added.first->second, entry.recLsn);
+  }
+}
+
+bool LogManager::redoRecord(const LogRecord& record, FileSet& files, const DirtyPageTable& dirty)
+{
+  std::vector<RecordPage> changed;
+  parseRecord(record, changed);
+
+  // pages written since the change are skipped without being read
+  std::vector<RecordPage> entries;
+  for (std::size_t i = 0; i < changed.size(); i++)
+  {
+  	DirtyPageTable::const_iterator first =
+  		dirty.find(std::make_pair(changed[i].fileName, changed[i].header.pageNo));
+  	if (first != dirty.end() && record.header.lsn >= first->second)
+  		entries.push_back(changed[i]);
+  }
+  if (entries.empty())
+  	return false;
+
+  bool redone = false;
+  std::vector<Page*> pages;
+  std::vector<File*> pageFiles;
+  pinPages(entries, files, pages, pageFiles);
+
+  for (std::size_t i = 0; i < entries.size(); i++)
+  {
+  	if (pages[i] == NULL)
+  		continue;
+
+  	// a page with a header tells whether the change reached the disk; other pages are redone anyway
+  	bool heap = entries[i].header.heap != 0;
+  	if (heap && pages[i]->lsn() >= record.header.lsn)
+  	{
+  		bufMgr->unPinPage(pageFiles[i], entries[i].header.pageNo, false);
+  		continue;
+  	}
+  	applySegments(entries[i], pages[i], true);
+  	if (heap)
+  		pages[i]->set_lsn(record.header.lsn);
+  	bufMgr->setPageLsn(pageFiles[i], entries[i].header.pageNo, record.header.lsn);
+  	bufMgr->unPinPage(pageFiles[i], entries[i].header.pageNo, true);
+  	redone = true;
+  }
+  return redone;
+}
+
+Lsn LogManager::undoRecord(const TxnId txn, const Lsn lsn, Lsn& lastLsn, FileSet& files)
+{
+  flush(lsn);
+  LogRecord record;
+  if (!readRecord(lsn, record, getDurableLsn()))
+  	throw LogException(name, "has lost a record to undo");
+
+  if (record.header.type == LOG_CLR)
+  	return record.header.undoNextLsn;
+  if (!isChange(record.header.type))
+  	return record.header.prevLsn;
+
+  std::vector<RecordPage> entries;
+  parseRecord(record, entries);
+  std::vector<Page*> pages;
+  std::vector<File*> pageFiles;
+  pinPages(entries, files, pages, pageFiles);
+
+  // the compensation restores the images before the change, and replaces the current ones
+  std::vector<char> body;
+  std::uint16_t count = 0;
+  for (std::size_t i = 0; i < entries.size(); i++)
+  {
+  	if (pages[i] == NULL)
+  		continue;
+
+  	LogPageHeader header = entries[i].header;
+  	header.allocated = 0;
+  	put(body, &header, sizeof(header));
+  	put(body, entries[i].fileName.data(), entries[i].fileName.size());
+  	const char* image = reinterpret_cast<const char*>(pages[i]);
+  	const char* p = entries[i].segments;
+  	for (std::uint32_t s = 0; s < header.segments; s++)
+  	{
+  		LogSegment segment;
+  		memcpy(&segment, p, sizeof(segment));
+  		p += sizeof(segment);
+  		put(body, &segment, sizeof(segment));
+  		put(body, image + segment.offset, segment.length);
+  		put(body, p, segment.length);
+  		p += 2 * segment.length;
+  	}
+  	applySegments(entries[i], pages[i], false);
+  	count++;
+  }
+
+  Lsn clr = 0;
+  if (count > 0)
+  {
+  	LogRecordHeader header = { 0, LOG_CLR, count, txn, 0, 0, lastLsn, record.header.prevLsn };
+  	std::lock_guard<std::mutex> guard(latch);
+  	clr = appendChange(header, body);
+  	lastLsn = clr;
+  }
+
+  for (std::size_t i = 0; i < entries.size(); i++)
+  {
+  	if (pages[i] == NULL)
+  		continue;
+  	if (entries[i].header.heap)
+  		pages[i]->set_lsn(clr);
+  	bufMgr->setPageLsn(pageFiles[i], entries[i].header.pageNo, clr);
+  	bufMgr->unPinPage(pageFiles[i], entries[i].header.pageNo, true);
+  }
+  if (clr != 0)
+  	finishStamp(clr);
+  return record.header.prevLsn;
+}
+
+std::uint32_t LogManager::recover()
+{
+  flush(lastAppended);
+  Lsn end = getDurableLsn();
+  FileSet files;
+
+  // from the last checkpoint on, find the transactions that never finished and the pages that may be
+  // missing changes
+  std::map<TxnId, Lsn> losers;
+  DirtyPageTable dirty;
+  LogRecord record;
+  Lsn start = getCheckpointLsn() != 0 ? getCheckpointLsn() : LOG_HEADER_SIZE;
+  for (Lsn lsn = start; lsn < end && readRecord(lsn, record, end); lsn += record.header.length)
+  {
+  	std::uint16_t type = record.header.type;
+  	if (type == LOG_CHECKPOINT_END)
+  		readCheckpoint(record, losers, dirty);
+  	else if (type == LOG_COMMIT || type == LOG_END)
+  		losers.erase(record.header.txn);
+  	else if (type != LOG_CHECKPOINT_BEGIN)
+  		losers[record.header.txn] = lsn;
+
+  	if (isChange(type))
+  	{
+  		std::vector<RecordPage> entries;
+  		parseRecord(record, entries);
+  		for (std::size_t i = 0; i < entries.size(); i++)
+  			dirty.insert(std::make_pair(std::make_pair(entries[i].fileName, entries[i].header.pageNo), lsn));
+  	}
+  }
+
+  // repeat history from the oldest change a page may be missing
+  Lsn redoLsn = end;
+  for (DirtyPageTable::iterator it = dirty.begin(); it != dirty.end(); ++it)
+  	redoLsn = std::min(redoLsn, it->second);
+  std::uint64_t redone = 0;
+  for (Lsn lsn = redoLsn; lsn < end && readRecord(lsn, record, end); lsn += record.header.length)
+  	if (isChange(record.header.type) && redoRecord(record, files, dirty))
+  		redone++;
+
+  // undo the losers together, latest change first
+  std::map<Lsn, TxnId> toUndo;
+  std::map<TxnId, Lsn> lastLsns = losers;
+  for (std::map<TxnId, Lsn>::iterator it = losers.begin(); it != losers.end(); ++it)
+  	toUndo[it->second] = it->first;
+  while (!toUndo.empty())
+  {
+  	std::map<Lsn, TxnId>::iterator last = --toUndo.end();
+  	Lsn lsn = last->first;
+  	TxnId txn = last->second;
+  	toUndo.erase(last);
+
+  	Lsn next = undoRecord(txn, lsn, lastLsns[txn], files);
+  	if (next != 0)
+  		toUndo[next] = txn;
+  	else
+  	{
+  		std::lock_guard<std::mutex> guard(latch);
+  		LogRecordHeader header = { 0, LOG_END, 0, txn, 0, 0, lastLsns[txn], 0 };
+  		append(header, std::vector<char>());
+  	}
+  }
+
+  flush(lastAppended);
+  closeFiles(files);
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	logStats.redone += redone;
+  }
+
+  // the next recovery starts from here
+  checkpoint();
+  return losers.size();
+}
+
+//----------------------------------------
+// Checkpoints
+//----------------------------------------
+
+Lsn LogManager::checkpoint()
+{
+  std::lock_guard<std::mutex> checkpointGuard(checkpointLatch);
+
+  Lsn begin;
+  {
+  	std::unique_lock<std::mutex> guard(latch);
+  	LogRecordHeader header = { 0, LOG_CHECKPOINT_BEGIN, 0, 0, 0, 0, 0, 0 };
+  	begin = append(header, std::vector<char>());
+  	// a change logged before the checkpoint started has to be known to the pool when its pages are listed
+  	while (!stamping.empty() && *stamping.begin() < begin)
+  		stamped.wait(guard);
+  }
+
+  // a page written before the list is taken is left out of it, so it has to be on disk
+  std::vector<DirtyPage> pages;
+  bufMgr->getDirtyPages(pages);
+  bufMgr->syncWrittenFiles();
+
+  std::vector<char> pageBytes;
+  for (std::size_t i = 0; i < pages.size(); i++)
+  {
+  	LogCheckpointPage entry = { pages[i].recLsn, pages[i].pageNo,
+  	                            static_cast<std::uint16_t>(pages[i].fileName.size()), 0 };
+  	put(pageBytes, &entry, sizeof(entry));
+  	put(pageBytes, pages[i].fileName.data(), pages[i].fileName.size());
+  }
+
+  Lsn end;
+  {
+  	// transactions are listed as of the end record, so that none of them commits before it
+  	std::lock_guard<std::mutex> guard(latch);
+  	LogCheckpointHeader checkpointHeader = { nextTxn, 0, static_cast<std::uint32_t>(pages.size()), 0 };
+  	std::vector<char> body(sizeof(checkpointHeader));
+  	for (std::unordered_map<TxnId, Transaction>::iterator it = transactions.begin(); it != transactions.end();
+  	     ++it)
+  	{
+  		if (it->second.lastLsn == 0)
+  			continue;
+  		LogCheckpointTxn entry = { it->first, 0, it->second.lastLsn };
+  		put(body, &entry, sizeof(entry));
+  		checkpointHeader.transactions++;
+  	}
+  	memcpy(&body[0], &checkpointHeader, sizeof(checkpointHeader));
+  	body.insert(body.end(), pageBytes.begin(), pageBytes.end());
+
+  	LogRecordHeader header = { 0, LOG_CHECKPOINT_END, 0, 0, 0, 0, begin, 0 };
+  	end = append(header, body);
+  }
+  flush(end);
+
+  // recovery starts from the checkpoint once all of it is on disk
+  if (pwrite(fd, &begin, sizeof(begin), sizeof(LOG_MAGIC)) != sizeof(begin) || fdatasync(fd) != 0)
+  	throw LogException(name, "cannot be written");
+
+  std::lock_guard<std::mutex> guard(latch);
+  checkpointLsn = begin;
+  logStats.checkpoints++;
+  return begin;
+}
+
+void LogManager::startCheckpointer(const std::uint64_t logBytes, const std::uint32_t pagesPerRound,
+                                   const std::uint32_t roundMillis)
+{
+  stopCheckpointer();
+
+  std::lock_guard<std::mutex> guard(latch);
+  checkpointBytes = logBytes;
+  this->pagesPerRound = pagesPerRound;
+  this->roundMillis = roundMillis;
+  stopping = false;
+  checkpointer = std::thread(&LogManager::runCheckpointer, this);
+}
+
+void LogManager::stopCheckpointer()
+{
+  {
+  	std::lock_guard<std::mutex> guard(latch);
+  	stopping = true;
+  	checkpointerWake.notify_all();
+  }
+  if (checkpointer.joinable())
+  	checkpointer.join();
+}
+
+void LogManager::runCheckpointer()
+{
+  std::unique_lock<std::mutex> guard(latch);
+  while (!stopping)
+  {
+  	checkpointerWake.wait_for(guard, std::chrono::milliseconds(roundMillis));
+  	if (stopping)
+  		break;
+
+  	bool due = bufferStart + buffer.size() - checkpointLsn >= checkpointBytes;
+  	guard.unlock();
+  	try
+  	{
+  		if (pagesPerRound > 0)
+  			bufMgr->writeOldestPages(pagesPerRound);
+  		if (due)
+  			checkpoint();
+  	}
+  	catch (LogException e)
+  	{
+  		// tried again in the next round
+  	}
+  	guard.lock();
+  }
+}
+
+Lsn LogManager::getCheckpointLsn()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return checkpointLsn;
+}
+
+//----------------------------------------
+// Statistics
+//----------------------------------------
+
+Lsn LogManager::getDurableLsn()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return durableEnd;
+}
+
+LogStats LogManager::getStats()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return logStats;
+}
+
+void LogManager::clearStats()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  logStats.clear();
+}
+
+}
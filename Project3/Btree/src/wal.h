@@ -0,0 +1,706 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+* @brief Identifier of a transaction; 0 is never handed out.
+*/
+typedef std::uint32_t TxnId;
+
+/**
+* @brief Type of a record of the write-ahead log.
+*/
+enum LogRecordType {
+  LOG_INSERT = 1,   /* Record inserted into a page */
+  LOG_UPDATE = 2,   /* Record of a page updated */
+  LOG_DELETE = 3,   /* Record deleted from a page */
+  LOG_SPLIT  = 4,   /* B+ tree node split, or the separator of a split posted to its parent */
+  LOG_PAGE   = 5,   /* Any other change to pages */
+  LOG_CLR    = 6,   /* Compensation: a change undone, never undone itself */
+  LOG_COMMIT = 7,   /* Transaction committed */
+  LOG_ABORT  = 8,   /* Transaction rolling back */
+  LOG_END    = 9,   /* Transaction rolled back */
+  LOG_CHECKPOINT_BEGIN = 10,   /* Checkpoint started; where recovery starts reading if it completed */
+  LOG_CHECKPOINT_END   = 11    /* Checkpoint completed, with the transactions and dirty pages of the start */
+};
+
+/**
+* @brief Start of every record of the log. Change records are followed by the pages they changed.
+*/
+struct LogRecordHeader
+{
+	/**
+   * Length of the whole record in bytes
+	 */
+  std::uint32_t length;
+
+	/**
+   * LogRecordType
+	 */
+  std::uint16_t type;
+
+	/**
+   * Number of LogPageHeader entries following
+	 */
+  std::uint16_t pages;
+
+	/**
+   * Transaction that wrote the record
+	 */
+  TxnId txn;
+
+	/**
+   * Checksum of the record, computed with this field 0; a record whose checksum does not match ends the log
+	 */
+  std::uint32_t checksum;
+
+	/**
+   * Offset of the record in the log
+	 */
+  Lsn lsn;
+
+	/**
+   * Previous record of the same transaction, 0 if none
+	 */
+  Lsn prevLsn;
+
+	/**
+   * For a LOG_CLR, the next record of the transaction left to undo
+	 */
+  Lsn undoNextLsn;
+};
+
+/**
+* @brief Page changed by a record, followed by its file name and then its segments.
+*/
+struct LogPageHeader
+{
+	/**
+   * True if the page belongs to a PageFile and keeps its LSN in its header
+	 */
+  std::uint8_t heap;
+
+	/**
+   * True if the change allocated the page, which redo allocates again if the file lost it in the crash
+	 */
+  std::uint8_t allocated;
+
+	/**
+   * Length of the file name following
+	 */
+  std::uint16_t nameLength;
+
+	/**
+   * Page number in the file
+	 */
+  PageId pageNo;
+
+	/**
+   * Number of LogSegment entries following the name
+	 */
+  std::uint32_t segments;
+};
+
+/**
+* @brief Changed bytes of a page, followed by their image before and then after the change.
+*/
+struct LogSegment
+{
+  std::uint16_t offset;
+  std::uint16_t length;
+};
+
+/**
+* @brief Body of a LOG_CHECKPOINT_END record, followed by its LogCheckpointTxn and then its
+* LogCheckpointPage entries.
+*/
+struct LogCheckpointHeader
+{
+	/**
+   * Next transaction identifier to hand out
+	 */
+  TxnId nextTxn;
+
+	/**
+   * Number of transactions and of dirty pages following
+	 */
+  std::uint32_t transactions;
+  std::uint32_t pages;
+  std::uint32_t reserved;
+};
+
+/**
+* @brief Transaction in progress at a checkpoint.
+*/
+struct LogCheckpointTxn
+{
+  TxnId txn;
+  std::uint32_t reserved;
+
+	/**
+   * Last record written by the transaction
+	 */
+  Lsn lastLsn;
+};
+
+/**
+* @brief Page of the buffer pool with logged changes not yet on disk at a checkpoint, followed by its file
+* name.
+*/
+struct LogCheckpointPage
+{
+	/**
+   * LSN of the first change to the page not on disk
+	 */
+  Lsn recLsn;
+
+	/**
+   * Page number in the file
+	 */
+  PageId pageNo;
+
+	/**
+   * Length of the file name following
+	 */
+  std::uint16_t nameLength;
+  std::uint16_t reserved;
+};
+
+/**
+* @brief Statistics of a write-ahead log.
+*/
+struct LogStats
+{
+	/**
+   * Records and bytes appended
+	 */
+  std::uint64_t records;
+  std::uint64_t bytes;
+
+	/**
+   * Writes of the log to disk, each followed by one fdatasync
+	 */
+  std::uint64_t flushes;
+
+	/**
+   * Transactions committed and rolled back
+	 */
+  std::uint64_t commits;
+  std::uint64_t aborts;
+
+	/**
+   * Checkpoints completed
+	 */
+  std::uint64_t checkpoints;
+
+	/**
+   * Change records redone by recover()
+	 */
+  std::uint64_t redone;
+
+	/**
+   * Constructor of LogStats class
+	 */
+  LogStats()
+  {
+		clear();
+  }
+
+	/**
+   * Clear all values
+	 */
+  void clear()
+  {
+		records = bytes = flushes = commits = aborts = checkpoints = redone = 0;
+  }
+};
+
+/**
+* @brief Write-ahead log of the changes made to pages through a buffer pool, with ARIES recovery.
+*
+* Callers change pinned pages within transactions. A page is registered with track() before it is
+* changed, and logChanges() then logs everything changed on the registered pages as one record of
+* byte ranges with their images before and after, before the pages are unpinned. insertRecord(),
+* updateRecord() and deleteRecord() do both around the Page method of the same name.
+*
+* The pool may write a changed page at any time, even one of a transaction that has not committed
+* (steal), as it first flushes the log past the page's last record. Pages are not written at commit
+* (no force): commit() appends a commit record and waits for one flush of the log, which takes along
+* the commits of every other transaction that arrived meanwhile (group commit).
+*
+* recover() repeats history from the log, redoing every change, then rolls back the transactions that
+* did not commit, logging a compensation record for each change undone. Pages of a PageFile carry the
+* LSN of their last change in their header and are only redone if it is older than the record; pages
+* of a BlobFile have no header, so their changes are redone unconditionally, which byte images allow.
+* A file logged to stays with its log, as its pages carry the LSNs of that log.
+*
+* Changes are undone by restoring their bytes, so transactions changing the same page must not
+* overlap, which holds as long as a page is changed by one transaction at a time until it commits.
+* A page allocated by a transaction is marked as such in the first record changing it, and redo
+* allocates it again if the file's growth did not reach the disk before the crash; any other page
+* missing from its file stops recovery. Files created are not logged, and pages allocated stay
+* allocated after a rollback.
+*
+* checkpoint() bounds the part of the log recovery reads without stopping the callers or writing the
+* pool: it records the transactions in progress and the pool's dirty page table, the pages with logged
+* changes not yet written and the first record each is missing. The log header keeps the LSN of the last
+* completed checkpoint, from which recovery finds the losers, and redo starts at the oldest change of the
+* dirty page table. startCheckpointer() runs checkpoints in the background as the log grows, and writes
+* the pages with the oldest changes at a limited rate in between, so that redo stays short without the
+* burst of writes of flushing the whole pool.
+*
+* @warning Only for a BufMgr, not a SharedBufMgr. Transactions may run on different threads, but the
+* changes of one transaction must come from one thread at a time.
+*/
+class LogManager
+{
+ private:
+	/**
+   * Page registered with track(), with its image before the change
+	 */
+  struct TrackedPage
+  {
+  	File* file;
+  	PageId pageNo;
+  	Page* page;
+  	bool heap;
+  	bool allocated;
+  	Page before;
+  };
+
+	/**
+   * Transaction in progress
+	 */
+  struct Transaction
+  {
+		/**
+		 * Last record written by the transaction, 0 if none
+		 */
+  	Lsn lastLsn;
+
+		/**
+		 * Pages registered since the last call to logChanges()
+		 */
+  	std::vector<TrackedPage> tracked;
+
+		/**
+		 * Files the transaction changed, through which a rollback reaches them
+		 */
+  	std::vector<File*> files;
+  };
+
+	/**
+   * Log record read back
+	 */
+  struct LogRecord
+  {
+  	LogRecordHeader header;
+  	std::vector<char> bytes;
+  };
+
+	/**
+   * Page of a change record, pointing into the bytes of the record
+	 */
+  struct RecordPage
+  {
+  	LogPageHeader header;
+  	std::string fileName;
+  	const char* segments;
+  };
+
+	/**
+   * Files reached by name while redoing or undoing, with those opened for the purpose
+	 */
+  struct FileSet
+  {
+  	std::map<std::string, File*> byName;
+  	std::vector<File*> opened;
+  };
+
+	/**
+   * First change of each page, by file name and page number, that recovery may have to redo
+	 */
+  typedef std::map<std::pair<std::string, PageId>, Lsn> DirtyPageTable;
+
+	/**
+   * Name of the log file
+	 */
+  std::string name;
+
+	/**
+   * Descriptor of the log file
+	 */
+  int fd;
+
+	/**
+   * Buffer pool the logged pages live in
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Records appended and not yet handed to a flush, starting at bufferStart in the log
+	 */
+  std::vector<char> buffer;
+  Lsn bufferStart;
+
+	/**
+   * End of the part of the log known to be on disk
+	 */
+  Lsn durableEnd;
+
+	/**
+   * Size of the log file. The part past the last record is zeros written ahead of the records, so that a
+   * flush overwrites bytes the file has and its sync need not also record the file growing.
+	 */
+  Lsn fileEnd;
+
+	/**
+   * Last record appended, 0 if none
+	 */
+  Lsn lastAppended;
+
+	/**
+   * True while a flush is writing the log, with the latch released
+	 */
+  bool flushing;
+
+	/**
+   * Transactions in progress
+	 */
+  std::unordered_map<TxnId, Transaction> transactions;
+
+	/**
+   * Next transaction identifier handed out
+	 */
+  TxnId nextTxn;
+
+	/**
+   * Log statistics
+	 */
+  LogStats logStats;
+
+	/**
+   * LOG_CHECKPOINT_BEGIN record of the last completed checkpoint, 0 if none
+	 */
+  Lsn checkpointLsn;
+
+	/**
+   * Change records appended whose LSN is still being recorded in the pool
+	 */
+  std::set<Lsn> stamping;
+
+	/**
+   * Settings of the background checkpointer: log bytes between checkpoints, and most pages written per
+   * round and pause between rounds
+	 */
+  std::uint64_t checkpointBytes;
+  std::uint32_t pagesPerRound;
+  std::uint32_t roundMillis;
+
+	/**
+   * True while the background checkpointer is asked to stop
+	 */
+  bool stopping;
+
+	/**
+   * Latch protecting the state above
+	 */
+  std::mutex latch;
+
+	/**
+   * Signalled when a flush completes
+	 */
+  std::condition_variable flushDone;
+
+	/**
+   * Signalled when the LSN of a change has been recorded in the pool
+	 */
+  std::condition_variable stamped;
+
+	/**
+   * Signalled to stop the background checkpointer
+	 */
+  std::condition_variable checkpointerWake;
+
+	/**
+   * Background checkpointer, if started
+	 */
+  std::thread checkpointer;
+
+	/**
+   * Held by a checkpoint, so that checkpoints are taken one at a time
+	 */
+  std::mutex checkpointLatch;
+
+	/**
+	 * Append a record to the buffer.
+	 *
+	 * @param header 	Header of the record; its length, lsn and checksum are filled in
+	 * @param body   	Bytes following the header
+	 * @return  			LSN of the record
+	 */
+  Lsn append(LogRecordHeader& header, const std::vector<char>& body);
+
+	/**
+	 * Append a change record, marking it as being recorded in the pool until finishStamp().
+	 */
+  Lsn appendChange(LogRecordHeader& header, const std::vector<char>& body);
+
+	/**
+	 * Mark the LSN of a change record as recorded in the pool.
+	 */
+  void finishStamp(const Lsn lsn);
+
+	/**
+	 * Write zeros over part of the log file, without syncing them.
+	 *
+	 * @return  			False if they could not be written
+	 */
+  bool writeZeros(Lsn from, const Lsn to);
+
+	/**
+	 * Read a record of the part of the log on disk.
+	 *
+	 * @param lsn    	LSN of the record
+	 * @param record 	Set to the record
+	 * @param end    	End of the valid part of the log
+	 * @return  			False if there is no complete, intact record at lsn
+	 */
+  bool readRecord(const Lsn lsn, LogRecord& record, const Lsn end);
+
+	/**
+	 * Split the bytes of a change record into its pages.
+	 */
+  static void parseRecord(const LogRecord& record, std::vector<RecordPage>& pages);
+
+	/**
+	 * Copy the images before or after the change of a record's page into the page.
+	 */
+  static void applySegments(const RecordPage& entry, Page* page, const bool after);
+
+	/**
+	 * Find a file by name, opening it if it is not yet in the set.
+	 *
+	 * @return  			The file, or NULL if it no longer exists
+	 */
+  File* resolveFile(FileSet& files, const std::string& fileName, const bool heap);
+
+	/**
+	 * Write back and close the files opened for a set.
+	 */
+  void closeFiles(FileSet& files);
+
+	/**
+	 * Allocate a page again, with the pages before it, if its file lost them in a crash.
+	 */
+  void restorePage(File* file, const PageId pageNo);
+
+	/**
+	 * Pin the pages of a change record, allocating again those the record allocated and the file lost.
+	 *
+	 * @param entries	Pages of the record
+	 * @param files  	Files by name
+	 * @param pages  	Set to each page, or NULL where its file no longer exists
+	 * @param pageFiles	Set to the file of each page
+	 * @throws  LogException  If a page the record did not allocate is missing from its file
+	 */
+  void pinPages(const std::vector<RecordPage>& entries, FileSet& files, std::vector<Page*>& pages,
+                std::vector<File*>& pageFiles);
+
+	/**
+	 * Add the transactions and dirty pages of a LOG_CHECKPOINT_END record to those found by recovery.
+	 */
+  static void readCheckpoint(const LogRecord& record, std::map<TxnId, Lsn>& losers, DirtyPageTable& dirty);
+
+	/**
+	 * Redo a change or compensation record on the pages that may not have it yet.
+	 *
+	 * @param record 	Record
+	 * @param files  	Files by name
+	 * @param dirty  	Pages that may be missing changes, with the first of them
+	 * @return  			True if the record was redone on any page
+	 */
+  bool redoRecord(const LogRecord& record, FileSet& files, const DirtyPageTable& dirty);
+
+	/**
+	 * Body of the background checkpointer.
+	 */
+  void runCheckpointer();
+
+	/**
+	 * Undo one record of a transaction, logging a compensation if it is a change.
+	 *
+	 * @param txn    	Transaction
+	 * @param lsn    	Record to undo
+	 * @param lastLsn	Last record of the transaction, advanced to the compensation
+	 * @param files  	Files by name
+	 * @return  			Next record of the transaction to undo, 0 once none is left
+	 */
+  Lsn undoRecord(const TxnId txn, const Lsn lsn, Lsn& lastLsn, FileSet& files);
+
+ public:
+	/**
+   * Bytes at the start of the log file before the first record
+	 */
+  static const Lsn LOG_HEADER_SIZE = 16;
+
+	/**
+	 * Open a log, creating it if it does not exist, and attach it to a buffer pool. A torn record left at
+	 * the end by a crash is cut off. Call recover() before changing pages if the last run did not end
+	 * with every transaction committed or aborted.
+	 *
+	 * @param name   	Name of the log file
+	 * @param bufMgr 	Buffer pool the logged pages live in
+	 * @throws  LogException  If the log cannot be opened or is not a log
+	 */
+  LogManager(const std::string& name, BufMgr* bufMgr);
+
+	/**
+	 * Flush the log and detach it from the buffer pool. Transactions still in progress are left for
+	 * recover() to roll back.
+	 */
+  ~LogManager();
+
+	/**
+	 * Start a transaction.
+	 */
+  TxnId begin();
+
+	/**
+	 * Register a pinned page about to be changed by a transaction, keeping its current image. A page
+	 * registered twice before logChanges() keeps its first image.
+	 *
+	 * @param txn    	Transaction
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page   	Page, pinned until logChanges() returns
+	 * @param allocated	True for a page the transaction just allocated, which is logged even if unchanged
+	 */
+  void track(const TxnId txn, File* file, const PageId pageNo, Page* page, const bool allocated = false);
+
+	/**
+	 * Log the changes made to the pages registered by a transaction as one record, and stamp the pages
+	 * with its LSN. Call before unpinning the pages.
+	 *
+	 * @param txn    	Transaction
+	 * @param type   	Record type, one of LOG_INSERT to LOG_PAGE
+	 * @return  			LSN of the record, or 0 if no registered page changed
+	 */
+  Lsn logChanges(const TxnId txn, const LogRecordType type);
+
+	/**
+	 * Insert, update or delete a record of a pinned page of a PageFile within a transaction, logging the
+	 * change.
+	 *
+	 * @param txn    	Transaction
+	 * @param file   	File object
+	 * @param page   	Page, pinned by the caller
+	 */
+  RecordId insertRecord(const TxnId txn, File* file, Page* page, const std::string& record_data);
+  void updateRecord(const TxnId txn, File* file, Page* page, const RecordId& record_id,
+                    const std::string& record_data);
+  void deleteRecord(const TxnId txn, File* file, Page* page, const RecordId& record_id);
+
+	/**
+	 * Commit a transaction, returning once its commit record is on disk.
+	 *
+	 * @param txn    	Transaction
+	 */
+  void commit(const TxnId txn);
+
+	/**
+	 * Roll back a transaction. The pages it changed must be unpinned, and their files still open.
+	 *
+	 * @param txn    	Transaction
+	 */
+  void abort(const TxnId txn);
+
+	/**
+	 * Make sure the log is on disk up to and including the record at an LSN. A caller arriving while
+	 * another flush is being written waits for it and then writes everything appended meanwhile, so
+	 * concurrent commits share flushes.
+	 *
+	 * @param lsn    	LSN of the record
+	 */
+  void flush(const Lsn lsn);
+
+	/**
+	 * Bring the files logged to back to the state of the committed transactions after a crash: redo
+	 * every change in the log, then roll back the transactions that neither committed nor ended. Files
+	 * are opened by name for the duration, written back and closed, so none of them may be open in
+	 * the buffer pool.
+	 *
+	 * @return  			Number of transactions rolled back
+	 * @throws  LogException  If a record to undo cannot be read back, or a page changed by a record is
+	 *                        missing from its file and was not allocated by it
+	 */
+  std::uint32_t recover();
+
+	/**
+	 * Take a fuzzy checkpoint, while transactions keep running: record the transactions in progress and
+	 * the pages with logged changes not yet written, and make it the point from which recovery reads the
+	 * log. Pages are not written, but the files the pool has written since the last checkpoint are synced.
+	 * Not to be called during recover().
+	 *
+	 * @return  			LSN of the checkpoint
+	 * @throws  LogException  If the log cannot be written
+	 */
+  Lsn checkpoint();
+
+	/**
+	 * Start taking checkpoints in the background. The checkpointer wakes up at an interval, writes up to
+	 * a number of the pool's pages changed longest ago, and takes a checkpoint once enough log has been
+	 * written since the last one. Recovery then reads about logBytes of log plus whatever the oldest
+	 * unwritten change reaches back to, and the checkpointer writes at most pagesPerRound pages every
+	 * roundMillis milliseconds.
+	 *
+	 * @param logBytes	Bytes of log between checkpoints
+	 * @param pagesPerRound	Most pages written per round; 0 to only take checkpoints
+	 * @param roundMillis	Milliseconds between rounds
+	 */
+  void startCheckpointer(const std::uint64_t logBytes, const std::uint32_t pagesPerRound,
+                         const std::uint32_t roundMillis);
+
+	/**
+	 * Stop the background checkpointer, waiting for a checkpoint it is taking.
+	 */
+  void stopCheckpointer();
+
+	/**
+	 * LSN of the last completed checkpoint, 0 if none
+	 */
+  Lsn getCheckpointLsn();
+
+	/**
+	 * End of the part of the log on disk
+	 */
+  Lsn getDurableLsn();
+
+	/**
+	 * Get and clear log statistics
+	 */
+  LogStats getStats();
+  void clearStats();
+};
+
+}